@@ -21,6 +21,9 @@
 #include "pxAnimate.h"
 #include "pxScene2d.h"
 
+#include <math.h>
+#include <assert.h>
+
 static rtString mapStatus(pxConstantsAnimation::animationStatus status)
 {
   switch(status) 
@@ -97,11 +100,18 @@ void pxAnimate::setStatus (pxConstantsAnimation::animationStatus status)
     mStatus = status;
 }
 
+rtObjectRef pxAnimate::params(const char* prop)
+{
+  if (NULL != mCurrDetails.getPtr())
+    return mCurrDetails.get<rtObjectRef>(prop);
+  return rtObjectRef();
+}
+
 void pxAnimate::update (const char* prop, struct animation* params, pxConstantsAnimation::animationStatus status)
 {
   if (NULL != mCurrDetails.getPtr())
   {
-    rtObjectRef propParams = mCurrDetails.get<rtObjectRef>(prop);
+    rtObjectRef propParams = params->animateParams ? params->animateParams : mCurrDetails.get<rtObjectRef>(prop);
     pxAnimate::pxAnimationParams* propParamsPtr = (pxAnimate::pxAnimationParams*) propParams.getPtr();
 
     if (propParamsPtr != NULL)
@@ -151,3 +161,356 @@ rtDefineProperty(pxAnimate::pxAnimationParams, to);
 rtDefineProperty(pxAnimate::pxAnimationParams, duration);
 rtDefineProperty(pxAnimate::pxAnimationParams, cancelled);
 rtDefineProperty(pxAnimate::pxAnimationParams, count);
+
+/**********************************************************************
+ * 
+ * pxAnimationEngine
+ * 
+ **********************************************************************/
+
+static const uint32_t PX_ANIMATION_RETIRED = 0xffffffff;
+
+pxAnimationEngine::pxAnimationEngine()
+  : mGroups(), mEvents(), mRetired(), mUpdating(false), mPhase(), mValue(), mEdge()
+{
+}
+
+pxAnimationEngine::~pxAnimationEngine()
+{
+  clear();
+}
+
+animation* pxAnimationEngine::add(pxObject* o, const animation& a)
+{
+  uint32_t g = 0;
+  for (; g < mGroups.size(); g++)
+  {
+    if (mGroups[g].mInterp == a.interpFunc)
+      break;
+  }
+  if (g == mGroups.size())
+  {
+    mGroups.push_back(group());
+    mGroups[g].mInterp = a.interpFunc;
+  }
+  group& grp = mGroups[g];
+
+  animation* r = new animation(a);
+  r->object = o;
+  r->group = g;
+  r->index = static_cast<uint32_t>(grp.mAnimations.size());
+
+  grp.mStart.push_back(a.start);
+  grp.mDuration.push_back(a.duration);
+  grp.mFrom.push_back(a.from);
+  grp.mTo.push_back(a.to);
+  grp.mOscillate.push_back((a.options & pxConstantsAnimation::OPTION_OSCILLATE) ? 1 : 0);
+  grp.mAnimations.push_back(r);
+
+  o->mAnimations.push_back(r);
+  return r;
+}
+
+void pxAnimationEngine::remove(animation* a)
+{
+  if (a->index == PX_ANIMATION_RETIRED)
+    return;
+
+  // swap remove from the group arrays
+  group& g = mGroups[a->group];
+  uint32_t i = a->index;
+  uint32_t last = static_cast<uint32_t>(g.mAnimations.size()) - 1;
+  if (i != last)
+  {
+    g.mStart[i]      = g.mStart[last];
+    g.mDuration[i]   = g.mDuration[last];
+    g.mFrom[i]       = g.mFrom[last];
+    g.mTo[i]         = g.mTo[last];
+    g.mOscillate[i]  = g.mOscillate[last];
+    g.mAnimations[i] = g.mAnimations[last];
+    g.mAnimations[i]->index = i;
+  }
+  g.mStart.pop_back();
+  g.mDuration.pop_back();
+  g.mFrom.pop_back();
+  g.mTo.pop_back();
+  g.mOscillate.pop_back();
+  g.mAnimations.pop_back();
+
+  std::vector<animation*>& l = a->object->mAnimations;
+  for (std::vector<animation*>::iterator it = l.begin(); it != l.end(); ++it)
+  {
+    if (*it == a)
+    {
+      l.erase(it);
+      break;
+    }
+  }
+
+  // records may still be referenced by pending events so they are only
+  // deleted once the update is done
+  a->index = PX_ANIMATION_RETIRED;
+  mRetired.push_back(a);
+  if (!mUpdating)
+    deleteRetired();
+}
+
+void pxAnimationEngine::remove(pxObject* o)
+{
+  while (!o->mAnimations.empty())
+    remove(o->mAnimations.back());
+}
+
+void pxAnimationEngine::clear()
+{
+  for (std::vector<group>::iterator g = mGroups.begin(); g != mGroups.end(); ++g)
+  {
+    for (std::vector<animation*>::iterator it = g->mAnimations.begin(); it != g->mAnimations.end(); ++it)
+    {
+      (*it)->object->mAnimations.clear();
+      (*it)->index = PX_ANIMATION_RETIRED;
+      mRetired.push_back(*it);
+    }
+  }
+  mGroups.clear();
+  mEvents.clear();
+  if (!mUpdating)
+    deleteRetired();
+}
+
+size_t pxAnimationEngine::size() const
+{
+  size_t n = 0;
+  for (std::vector<group>::const_iterator g = mGroups.begin(); g != mGroups.end(); ++g)
+    n += g->mAnimations.size();
+  return n;
+}
+
+void pxAnimationEngine::update(double t)
+{
+  if (mUpdating)
+    return;
+  mUpdating = true;
+
+  for (size_t g = 0; g < mGroups.size(); g++)
+    updateGroup(mGroups[g], t);
+
+  dispatchEvents();
+
+  mUpdating = false;
+  deleteRetired();
+}
+
+void pxAnimationEngine::updateGroup(group& g, double t)
+{
+  const size_t n = g.mAnimations.size();
+  if (n == 0)
+    return;
+
+  mPhase.resize(n);
+  mValue.resize(n);
+  mEdge.resize(n);
+
+  double* start = &g.mStart[0];
+  const double* duration = &g.mDuration[0];
+  const float* from = &g.mFrom[0];
+  const float* to = &g.mTo[0];
+  const uint8_t* oscillate = &g.mOscillate[0];
+  double* phase = &mPhase[0];
+  float* value = &mValue[0];
+  uint8_t* edge = &mEdge[0];
+
+  // Tweens that complete an iteration or oscillate this frame need the
+  // full state machine in updateEdge, everything else is a plain lerp
+  for (size_t i = 0; i < n; i++)
+  {
+    start[i] = (start[i] < 0) ? t : start[i];
+    edge[i]  = (t >= start[i] + duration[i]) | oscillate[i];
+    phase[i] = (t - start[i]) / duration[i];
+  }
+
+  if (g.mInterp == pxInterpLinear)
+  {
+    for (size_t i = 0; i < n; i++)
+      phase[i] = phase[i] - floor(phase[i]);
+  }
+  else
+  {
+    pxInterp interp = g.mInterp;
+    for (size_t i = 0; i < n; i++)
+      phase[i] = interp(phase[i] - floor(phase[i]));
+  }
+
+  for (size_t i = 0; i < n; i++)
+    value[i] = static_cast<float>(from[i] + (to[i] - from[i]) * phase[i]);
+
+  for (size_t i = 0; i < n; i++)
+  {
+    if (!edge[i])
+    {
+      animation* a = g.mAnimations[i];
+      apply(a, value[i]);
+      if (a->animateObj)
+        addEvent(a, EVENT_INPROGRESS);
+    }
+  }
+
+  // Walk backwards so swap removal only moves tweens already visited
+  for (size_t i = n; i-- > 0;)
+  {
+    if (edge[i])
+      updateEdge(g, static_cast<uint32_t>(i), t);
+  }
+}
+
+void pxAnimationEngine::updateEdge(group& g, uint32_t i, double t)
+{
+  animation* a = g.mAnimations[i];
+  double& start = g.mStart[i];
+  double end = start + a->duration;
+  bool forever = (a->count == pxConstantsAnimation::COUNT_FOREVER);
+
+  // if duration has elapsed, increment the count for this animation
+  if (t >= end && !forever && !(a->options & pxConstantsAnimation::OPTION_OSCILLATE))
+  {
+    a->actualCount++;
+    start = -1;
+  }
+  // if duration has elapsed and count is met, end the animation
+  if (t >= end && !forever && a->actualCount >= a->count)
+  {
+    apply(a, a->to);
+    a->cancelled = true;
+    addEvent(a, EVENT_ENDED);
+    remove(a);
+    return;
+  }
+
+  // a new iteration starts from the beginning on this frame
+  double t1 = (start < 0) ? 0 : (t - start) / a->duration;
+  double t2 = floor(t1);
+  t1 = t1 - t2; // 0-1
+
+  double d = g.mInterp(t1);
+  float from = a->from;
+  float   to = a->to;
+
+  if (a->options & pxConstantsAnimation::OPTION_OSCILLATE)
+  {
+    bool justReverseChange = false;
+    double toVal = a->to;
+    if( (fmod(t2,2) != 0))
+    {
+      if(!a->reversing)
+      {
+        a->reversing = true;
+        justReverseChange = true;
+        a->actualCount++;
+      }
+      from = a->to;
+      to   = a->from;
+    }
+    else if( a->reversing && (fmod(t2,2) == 0))
+    {
+      toVal = a->from;
+      justReverseChange = true;
+      a->reversing = false;
+      a->actualCount++;
+      start = -1;
+    }
+    // Prevent one more loop through oscillate
+    if(!forever && a->actualCount >= a->count )
+    {
+      if (true == justReverseChange)
+      {
+        apply(a, static_cast<float>(toVal));
+      }
+      a->cancelled = true;
+      addEvent(a, EVENT_OSCILLATE_ENDED);
+      remove(a);
+      return;
+    }
+  }
+
+  apply(a, static_cast<float>(from + (to - from) * d));
+  if (a->animateObj)
+    addEvent(a, EVENT_INPROGRESS);
+}
+
+void pxAnimationEngine::apply(animation* a, float v)
+{
+  pxObject* o = a->object;
+  assert(o->mCancelInSet);
+  o->mCancelInSet = false;
+  o->setAnimatedValue(*a, v);
+  o->mCancelInSet = true;
+}
+
+void pxAnimationEngine::addEvent(animation* a, eventType type)
+{
+  // progress events only touch the pxAnimate, the others call back into
+  // the object so keep it alive until they are dispatched
+  mEvents.push_back(event(a, (type == EVENT_INPROGRESS) ? rtRef<pxObject>() : rtRef<pxObject>(a->object), type));
+}
+
+void pxAnimationEngine::dispatchEvents()
+{
+  // callbacks can schedule new animations, those only land in the
+  // group arrays and are not visited until the next frame
+  std::vector<event> events;
+  events.swap(mEvents);
+
+  for (std::vector<event>::iterator it = events.begin(); it != events.end(); ++it)
+  {
+    animation* a = it->mAnimation;
+    pxObject* o = it->mObject.getPtr();
+    pxAnimate* animObj = (pxAnimate*)a->animateObj.getPtr();
+
+    switch (it->mType)
+    {
+      case EVENT_INPROGRESS:
+        // cancelled from a callback earlier in this pass
+        if (a->index != PX_ANIMATION_RETIRED && NULL != animObj)
+          animObj->update(a->prop, a, pxConstantsAnimation::STATUS_INPROGRESS);
+        break;
+
+      case EVENT_ENDED:
+        if (a->ended)
+          a->ended.send(o);
+        if (a->promise)
+        {
+          a->promise.send("resolve",o);
+          if (NULL != animObj)
+            animObj->setStatus(pxConstantsAnimation::STATUS_ENDED);
+        }
+        if (NULL != animObj)
+          animObj->update(a->prop, a, pxConstantsAnimation::STATUS_ENDED);
+        break;
+
+      case EVENT_OSCILLATE_ENDED:
+        if (NULL != animObj)
+          animObj->setStatus(pxConstantsAnimation::STATUS_ENDED);
+        if (a->ended)
+          a->ended.send(o);
+        if (a->promise)
+        {
+          a->promise.send("resolve",o);
+          if (NULL != animObj)
+            animObj->setStatus(pxConstantsAnimation::STATUS_CANCELLED);
+        }
+        if (NULL != animObj)
+        {
+          animObj->update(a->prop, a, pxConstantsAnimation::STATUS_CANCELLED);
+          animObj->update(a->prop, a, pxConstantsAnimation::STATUS_ENDED);
+        }
+        break;
+    }
+  }
+}
+
+void pxAnimationEngine::deleteRetired()
+{
+  for (std::vector<animation*>::iterator it = mRetired.begin(); it != mRetired.end(); ++it)
+    delete *it;
+  mRetired.clear();
+}
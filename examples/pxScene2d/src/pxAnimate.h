@@ -21,10 +21,17 @@
 #ifndef PX_ANIMATE_H
 #define PX_ANIMATE_H
 
+#include <vector>
+
 #include "pxConstants.h"
+#include "pxInterpolators.h"
 class pxObject;
 struct animation;
 
+// Typed float setter resolved once when an animation is scheduled so that
+// the per frame update does not go through the string keyed property lookup
+typedef rtError (pxObject::*pxAnimationSetter)(float v);
+
 /**********************************************************************
  * 
  * pxAnimate
@@ -70,6 +77,8 @@ class pxAnimate: public rtObject
     // update the animation details of every parameter
     // this is invoked on every parameter update during the process of animation
     void update(const char* prop, struct animation* params, pxConstantsAnimation::animationStatus status);
+    // details entry for prop, cached by the animation to skip the lookup in update
+    rtObjectRef params(const char* prop);
 
     class pxAnimationParams : public rtObject
     {
@@ -115,4 +124,79 @@ class pxAnimate: public rtObject
 typedef rtRef<pxAnimate> pxAnimateRef;
 typedef rtRef<pxAnimate::pxAnimationParams> pxAnimateParamsRef;
 
+/**********************************************************************
+ * 
+ * pxAnimationEngine
+ *
+ * Scene wide storage of the active tweens. The per frame state is kept
+ * in structure of arrays grouped by interpolator so that each group is
+ * evaluated in one tight loop, completed tweens are swap removed and
+ * promise/pxAnimate callbacks are deferred to a single pass after all
+ * the values have been applied.
+ * 
+ **********************************************************************/
+class pxAnimationEngine
+{
+  public:
+    pxAnimationEngine();
+    ~pxAnimationEngine();
+
+    // schedules a copy of a on o and returns the record owned by the engine
+    animation* add(pxObject* o, const animation& a);
+    // removes a from the engine and from its object's list
+    void remove(animation* a);
+    // removes all the animations of o
+    void remove(pxObject* o);
+    // drops every animation and detaches them from their objects
+    void clear();
+
+    void update(double t);
+
+    size_t size() const;
+
+  private:
+    enum eventType
+    {
+      EVENT_INPROGRESS = 0,
+      EVENT_ENDED,
+      EVENT_OSCILLATE_ENDED
+    };
+
+    struct event
+    {
+      event(animation* a, rtRef<pxObject> o, eventType type): mAnimation(a), mObject(o), mType(type) {}
+      animation* mAnimation;
+      rtRef<pxObject> mObject;
+      eventType mType;
+    };
+
+    struct group
+    {
+      pxInterp mInterp;
+      std::vector<double> mStart;
+      std::vector<double> mDuration;
+      std::vector<float> mFrom;
+      std::vector<float> mTo;
+      std::vector<uint8_t> mOscillate;
+      std::vector<animation*> mAnimations;
+    };
+
+    void updateGroup(group& g, double t);
+    void updateEdge(group& g, uint32_t i, double t);
+    void apply(animation* a, float v);
+    void addEvent(animation* a, eventType type);
+    void dispatchEvents();
+    void deleteRetired();
+
+    std::vector<group> mGroups;
+    std::vector<event> mEvents;
+    std::vector<animation*> mRetired;
+    bool mUpdating;
+
+    // per group scratch buffers reused across frames
+    std::vector<double> mPhase;
+    std::vector<float> mValue;
+    std::vector<uint8_t> mEdge;
+};
+
 #endif
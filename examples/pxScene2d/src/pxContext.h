@@ -108,6 +108,9 @@ class pxContext {
 
   void snapshot(pxOffscreen& o);
 
+  // submit draws that have been batched up so far
+  void flush();
+
   void drawRect(float w, float h, float lineWidth, float* fillColor, float* lineColor);
 
   // conveinience method
@@ -162,7 +162,7 @@ static int gResW, gResH;
 static pxMatrix4f gMatrix;
 static float gAlpha = 1.0;
 uint32_t gRenderTick = 0;
-std::vector<pxTexture*> textureList;
+pxTextureCache gTextureCache;
 #ifdef ENABLE_BACKGROUND_TEXTURE_CREATION
 rtMutex contextLock;
 #endif //ENABLE_BACKGROUND_TEXTURE_CREATION
@@ -183,60 +183,17 @@ pxError unlockContext()
   return PX_OK;
 }
 
-pxError addToTextureList(pxTexture* texture)
-{
-  if(texture == NULL)
-  {
-    //rtLogError("addToTextureList() - Passed NULL - ignoring.");
-    return PX_OK; // skip
-  }
-
-  textureList.push_back(texture);
-  return PX_OK;
-}
-
-pxError removeFromTextureList(pxTexture* texture)
-{
-  for(std::vector<pxTexture*>::iterator it = textureList.begin(); it != textureList.end(); ++it)
-  {
-    if ((*it) == texture)
-    {
-      textureList.erase(it);
-      return PX_OK;
-    }
-  }
-  return PX_OK;
-}
-
 pxError ejectNotRecentlyUsedTextureMemory(int64_t bytesNeeded, uint32_t maxAge=5)
 {
   rtLogDebug("attempting to eject %d bytes of texture memory with max age %u", bytesNeeded, maxAge);
 #if !defined(DISABLE_TEXTURE_EJECTION)
   int numberEjected = 0;
-  int64_t beforeTextureMemoryUsage = context.currentTextureMemoryUsageInBytes();
-
-  std::random_shuffle(textureList.begin(), textureList.end());
-  for(std::vector<pxTexture*>::iterator it = textureList.begin(); it != textureList.end(); ++it)
-  {
-    pxTexture* texture = (*it);
-    uint32_t lastRenderTickAge = gRenderTick - texture->lastRenderTick();
-    if (lastRenderTickAge >= maxAge)
-    {
-      numberEjected++;
-      texture->unloadTextureData();
-      int64_t currentTextureMemory = context.currentTextureMemoryUsageInBytes();
-      if ((beforeTextureMemoryUsage - currentTextureMemory) > bytesNeeded)
-      {
-        break;
-      }
-    }
-  }
+  int64_t released = gTextureCache.eject(bytesNeeded, maxAge, gRenderTick, numberEjected);
 
   if (numberEjected > 0)
   {
-    int64_t afterTextureMemoryUsage = context.currentTextureMemoryUsageInBytes();
     rtLogWarn("%d textures have been ejected and %d bytes of texture memory has been freed",
-        numberEjected, (beforeTextureMemoryUsage - afterTextureMemoryUsage));
+        numberEjected, released);
   }
 #endif //!DISABLE_TEXTURE_EJECTION
   return PX_OK;
@@ -566,7 +523,6 @@ public:
                          mFreeOffscreenDataRequested(false), mCompressedData(NULL), mCompressedDataSize(0)
   {
     mTextureType = PX_TEXTURE_OFFSCREEN;
-    addToTextureList(this);
   }
 
   pxTextureOffscreen(pxOffscreen& o, const char *compressedData = NULL, size_t compressedDataSize = 0) 
@@ -578,10 +534,9 @@ public:
     mTextureType = PX_TEXTURE_OFFSCREEN;
     setCompressedData(compressedData, compressedDataSize);
     createTexture(o);
-    addToTextureList(this);
   }
 
-~pxTextureOffscreen() { deleteTexture(); removeFromTextureList(this);};
+~pxTextureOffscreen() { deleteTexture(); };
 
   virtual pxError createTexture(pxOffscreen& o)
   {
@@ -613,6 +568,10 @@ public:
     mHeight = mOffscreen.height();
 
     createSurface(o);
+    if (mTexture)
+    {
+      gTextureCache.add(this, getSurfaceByteSize(mTexture));
+    }
 
     mFreeOffscreenDataRequested = false;
     mOffscreenMutex.unlock();
@@ -662,6 +621,7 @@ public:
         mTexture->Release(mTexture);
         mTexture = NULL;
       }
+      gTextureCache.remove(this);
 
       mOffscreenMutex.lock();
       mOffscreen.term();
@@ -2756,6 +2716,11 @@ pxTextureRef pxContext::createTexture(float w, float h, float iw, float ih, void
   return alphaTexture;
 }
 
+// DirectFB blits immediately, there is nothing to batch
+void pxContext::flush()
+{
+}
+
 void pxContext::pushState()
 {
   pxContextState contextState;
@@ -2842,30 +2807,35 @@ void pxContext::mapToScreenCoordinates(pxMatrix4f& m, float inX, float inY, int
   }
 }
 
-bool pxContext::isObjectOnScreen(float /*x*/, float /*y*/, float /*width*/, float /*height*/)
+// Conservative test of the transformed rectangle's bounding box against the
+// current render target.  Clipping and snapshots render into framebuffers
+// sized to the object so this also culls against the active clip.
+bool pxContext::isObjectOnScreen(float x, float y, float width, float height)
 {
-#if 1
-  return true;
-#else
-  int outX1, outX2, outY1, outY2;
-  mapToScreenCoordinates(width,height,outX2, outY2);
-  mapToScreenCoordinates(x,y,outX1, outY1);
-  int fboWidth = currentFramebuffer->width();
-  int fboHeight = currentFramebuffer->height();
-  if (currentFramebuffer == defaultFramebuffer)
+  const float cornersX[4] = { x, x + width, x,          x + width  };
+  const float cornersY[4] = { y, y,         y + height, y + height };
+
+  float minX = 0, minY = 0, maxX = 0, maxY = 0;
+  for (int i = 0; i < 4; i++)
   {
-    fboWidth = gResW;
-    fboHeight = gResH;
+    pxVector4f v = gMatrix.multiply(pxVector4f(cornersX[i], cornersY[i], 0, 1));
+    if (v.w() <= 0)
+    {
+      return true; // behind the eye, don't try to reject
+    }
+    float sx = v.x() / v.w();
+    float sy = v.y() / v.w();
+    if (i == 0 || sx < minX) minX = sx;
+    if (i == 0 || sx > maxX) maxX = sx;
+    if (i == 0 || sy < minY) minY = sy;
+    if (i == 0 || sy > maxY) maxY = sy;
   }
-  if ((outX1 < 0 && outX2 < 0) ||
-      (outX1 > fboWidth && outX2 > fboWidth) ||
-      (outY1 < 0 && outY2 < 0) ||
-      (outY1 > fboHeight && outY2 > fboHeight))
+
+  if (maxX < 0 || maxY < 0 || minX > gResW || minY > gResH)
   {
     return false;
   }
   return true;
-#endif
 }
 
 void pxContext::adjustCurrentTextureMemorySize(int64_t changeInBytes, bool allowGarbageCollect)
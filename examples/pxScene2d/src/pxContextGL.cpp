@@ -137,8 +137,7 @@ static int gResW, gResH;
 static pxMatrix4f gMatrix;
 static float gAlpha = 1.0;
 uint32_t gRenderTick = 0;
-std::vector<pxTexture*> textureList;
-rtMutex textureListMutex;
+pxTextureCache gTextureCache;
 #ifdef ENABLE_BACKGROUND_TEXTURE_CREATION
 rtMutex contextLock;
 #endif //ENABLE_BACKGROUND_TEXTURE_CREATION
@@ -160,60 +159,17 @@ pxError unlockContext()
   return PX_OK;
 }
 
-pxError addToTextureList(pxTexture* texture)
-{
-  textureListMutex.lock();
-  textureList.push_back(texture);
-  textureListMutex.unlock();
-  return PX_OK;
-}
-
-pxError removeFromTextureList(pxTexture* texture)
-{
-  textureListMutex.lock();
-  for(std::vector<pxTexture*>::iterator it = textureList.begin(); it != textureList.end(); ++it)
-  {
-    if ((*it) == texture)
-    {
-      textureList.erase(it);
-      break;
-    }
-  }
-  textureListMutex.unlock();
-  return PX_OK;
-}
-
 pxError ejectNotRecentlyUsedTextureMemory(int64_t bytesNeeded, uint32_t maxAge=5)
 {
   //rtLogDebug("attempting to eject %" PRId64 " bytes of texture memory with max age %u", bytesNeeded, maxAge);
 #if !defined(DISABLE_TEXTURE_EJECTION)
   int numberEjected = 0;
-  int64_t beforeTextureMemoryUsage = context.currentTextureMemoryUsageInBytes();
-
-  textureListMutex.lock();
-  std::random_shuffle(textureList.begin(), textureList.end());
-  for(std::vector<pxTexture*>::iterator it = textureList.begin(); it != textureList.end(); ++it)
-  {
-    pxTexture* texture = (*it);
-    uint32_t lastRenderTickAge = gRenderTick - texture->lastRenderTick();
-    if (lastRenderTickAge >= maxAge)
-    {
-      numberEjected++;
-      texture->unloadTextureData();
-      int64_t currentTextureMemory = context.currentTextureMemoryUsageInBytes();
-      if ((beforeTextureMemoryUsage - currentTextureMemory) > bytesNeeded)
-      {
-        break;
-      }
-    }
-  }
-  textureListMutex.unlock();
+  int64_t released = gTextureCache.eject(bytesNeeded, maxAge, gRenderTick, numberEjected);
 
   if (numberEjected > 0)
   {
-    int64_t afterTextureMemoryUsage = context.currentTextureMemoryUsageInBytes();
     rtLogWarn("%d textures have been ejected and %" PRId64 " bytes of texture memory has been freed",
-        numberEjected, (beforeTextureMemoryUsage - afterTextureMemoryUsage));
+        numberEjected, released);
   }
 #else
   (void)bytesNeeded;
@@ -613,7 +569,6 @@ public:
                          mMipmapCreated(false), mTextureListener(NULL), mTextureListenerMutex()
   {
     mTextureType = PX_TEXTURE_OFFSCREEN;
-    addToTextureList(this);
   }
 
   pxTextureOffscreen(pxOffscreen& o, const char *compressedData = NULL, size_t compressedDataSize = 0)
@@ -626,10 +581,9 @@ public:
     mTextureType = PX_TEXTURE_OFFSCREEN;
     setCompressedData(compressedData, compressedDataSize);
     createTexture(o);
-    addToTextureList(this);
   }
 
-  ~pxTextureOffscreen() { deleteTexture(); removeFromTextureList(this);};
+  ~pxTextureOffscreen() { deleteTexture(); };
 
   virtual pxError createTexture(pxOffscreen& o)
   {
@@ -739,6 +693,7 @@ public:
         mMipmapCreated = true;
       }
       context.adjustCurrentTextureMemorySize(mOffscreen.width()*mOffscreen.height()*4, false);
+      gTextureCache.add(this, mOffscreen.width()*mOffscreen.height()*4);
     }
     return PX_OK;
   }
@@ -782,6 +737,7 @@ public:
         glDeleteTextures(1, &mTextureName);
         context.adjustCurrentTextureMemorySize(-1 * mWidth * mHeight * 4);
       }
+      gTextureCache.remove(this);
 
       mTextureName = 0;
       mInitialized = false;
@@ -867,6 +823,7 @@ public:
           mMipmapCreated = true;
         }
         context.adjustCurrentTextureMemorySize(mOffscreen.width()*mOffscreen.height()*4);
+        gTextureCache.add(this, mOffscreen.width()*mOffscreen.height()*4);
       }
       else
       {
@@ -938,6 +895,7 @@ public:
                    GL_UNSIGNED_BYTE, mOffscreen.base());
       mTextureUploaded = true;
       context.adjustCurrentTextureMemorySize(mOffscreen.width()*mOffscreen.height()*4);
+      gTextureCache.add(this, mOffscreen.width()*mOffscreen.height()*4);
 
       //free up unneeded offscreen memory
       freeOffscreenDataInBackground();
@@ -1454,7 +1412,8 @@ public:
             GLenum mode,
             const void* pos,
             int count,
-            const float* color)
+            const float* color,
+            GLsizei stride = 0)
   {
     if (currentGLProgram != PROGRAM_SOLID_SHADER)
     {
@@ -1466,9 +1425,9 @@ public:
     glUniform1f(mAlphaLoc, alpha);
     glUniform4fv(mColorLoc, 1, color);
 
-    glVertexAttribPointer(mPosLoc, 2, GL_FLOAT, GL_FALSE, 0, pos);
+    glVertexAttribPointer(mPosLoc, 2, GL_FLOAT, GL_FALSE, stride, pos);
     glEnableVertexAttribArray(mPosLoc);
-    glDrawArrays(mode, 0, count);  ;
+    glDrawArrays(mode, 0, count);  TRACK_DRAW_CALLS();
     glDisableVertexAttribArray(mPosLoc);
 
     return PX_OK;
@@ -1517,7 +1476,8 @@ public:
             const void* pos,
             const void* uv,
             pxTextureRef texture,
-            const float* color)
+            const float* color,
+            GLsizei stride = 0)
   {
     if (currentGLProgram != PROGRAM_A_TEXTURE_SHADER)
     {
@@ -1534,8 +1494,8 @@ public:
       return PX_FAIL;
     }
 
-    glVertexAttribPointer(mPosLoc, 2, GL_FLOAT, GL_FALSE, 0, pos);
-    glVertexAttribPointer(mUVLoc, 2, GL_FLOAT, GL_FALSE, 0, uv);
+    glVertexAttribPointer(mPosLoc, 2, GL_FLOAT, GL_FALSE, stride, pos);
+    glVertexAttribPointer(mUVLoc, 2, GL_FLOAT, GL_FALSE, stride, uv);
     glEnableVertexAttribArray(mPosLoc);
     glEnableVertexAttribArray(mUVLoc);
     glDrawArrays(mode, 0, count);  TRACK_DRAW_CALLS();
@@ -1587,7 +1547,9 @@ public:
             int count,
             const void* pos, const void* uv,
             pxTextureRef texture,
-            int32_t stretchX, int32_t stretchY)
+            int32_t stretchX, int32_t stretchY,
+            GLenum mode = GL_TRIANGLE_STRIP,
+            GLsizei stride = 0)
   {
     if (currentGLProgram != PROGRAM_TEXTURE_SHADER)
     {
@@ -1608,11 +1570,11 @@ public:
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
 		    (stretchY==pxConstantsStretch::REPEAT)?GL_REPEAT:GL_CLAMP_TO_EDGE);
 
-    glVertexAttribPointer(mPosLoc, 2, GL_FLOAT, GL_FALSE, 0, pos);
-    glVertexAttribPointer(mUVLoc, 2, GL_FLOAT, GL_FALSE, 0, uv);
+    glVertexAttribPointer(mPosLoc, 2, GL_FLOAT, GL_FALSE, stride, pos);
+    glVertexAttribPointer(mUVLoc, 2, GL_FLOAT, GL_FALSE, stride, uv);
     glEnableVertexAttribArray(mPosLoc);
     glEnableVertexAttribArray(mUVLoc);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, count);  TRACK_DRAW_CALLS();
+    glDrawArrays(mode, 0, count);  TRACK_DRAW_CALLS();
     glDisableVertexAttribArray(mPosLoc);
     glDisableVertexAttribArray(mUVLoc);
 
@@ -1803,6 +1765,166 @@ textureMaskedShaderProgram *gTextureMaskedShader = NULL;
 
 //====================================================================================================================================================================================
 
+// Deferred batch of triangles that share a program, texture, alpha and color.
+// Vertices are transformed by the current matrix on the CPU so consecutive
+// objects with different transforms still end up in one glDrawArrays call.
+// Anything that changes GL state outside of the batch must flush() it first.
+class pxQuadBatch
+{
+public:
+  pxQuadBatch(): mProgram(PROGRAM_UNKNOWN), mResW(0), mResH(0), mAlpha(0),
+                 mStretchX(0), mStretchY(0), mTexture(), mVerts(), mFallback(), mFlushing(false)
+  {
+    mColor[0] = mColor[1] = mColor[2] = mColor[3] = 0;
+  }
+
+  // A matrix that keeps z == 0 and w == 1 can be flattened to 2d without
+  // changing what the vertex shader computes
+  static bool canBatch(const float* m)
+  {
+    return m[2] == 0 && m[6] == 0 && m[14] == 0 &&
+           m[3] == 0 && m[7] == 0 && m[15] == 1;
+  }
+
+  // Starts a new batch unless the state matches the one being accumulated
+  void begin(pxCurrentGLProgram program, pxTextureRef texture, const float* color,
+             int32_t stretchX = 0, int32_t stretchY = 0)
+  {
+    if (program == mProgram && texture.getPtr() == mTexture.getPtr() &&
+        gAlpha == mAlpha && gResW == mResW && gResH == mResH &&
+        stretchX == mStretchX && stretchY == mStretchY &&
+        (color == NULL || memcmp(color, mColor, sizeof(mColor)) == 0))
+    {
+      return;
+    }
+    flush();
+    mProgram = program;
+    mTexture = texture;
+    mAlpha = gAlpha;
+    mResW = gResW;
+    mResH = gResH;
+    mStretchX = stretchX;
+    mStretchY = stretchY;
+    if (color)
+      memcpy(mColor, color, sizeof(mColor));
+    else
+      mColor[0] = mColor[1] = mColor[2] = mColor[3] = 0;
+  }
+
+  // count vertices forming a triangle strip, uv may be NULL
+  void addStrip(int count, const float* pos, const float* uv)
+  {
+    for (int i = 2; i < count; i++)
+    {
+      addVertex(pos, uv, i-2);
+      addVertex(pos, uv, i-1);
+      addVertex(pos, uv, i);
+    }
+  }
+
+  void addTriangles(int count, const float* pos, const float* uv)
+  {
+    for (int i = 0; i < count; i++)
+      addVertex(pos, uv, i);
+  }
+
+  // Black rectangle drawn in place of the batch if its texture fails to bind
+  void addFallback(float w, float h)
+  {
+    const float verts[4][2] = { { 0, 0 }, { w, 0 }, { 0, h }, { w, h } };
+    const float* m = gMatrix.data();
+    for (int i = 2; i < 4; i++)
+    {
+      for (int j = i-2; j <= i; j++)
+      {
+        mFallback.push_back(m[0]*verts[j][0] + m[4]*verts[j][1] + m[12]);
+        mFallback.push_back(m[1]*verts[j][0] + m[5]*verts[j][1] + m[13]);
+      }
+    }
+  }
+
+  void flush();
+
+private:
+  inline void addVertex(const float* pos, const float* uv, int i)
+  {
+    const float* m = gMatrix.data();
+    float x = pos[i*2];
+    float y = pos[i*2+1];
+    mVerts.push_back(m[0]*x + m[4]*y + m[12]);
+    mVerts.push_back(m[1]*x + m[5]*y + m[13]);
+    mVerts.push_back(uv?uv[i*2]:0);
+    mVerts.push_back(uv?uv[i*2+1]:0);
+  }
+
+  pxCurrentGLProgram mProgram;
+  int mResW, mResH;
+  float mAlpha;
+  float mColor[4];
+  int32_t mStretchX, mStretchY;
+  pxTextureRef mTexture;
+  std::vector<float> mVerts;    // interleaved x, y, u, v
+  std::vector<float> mFallback; // x, y
+  bool mFlushing; // binding a texture can eject texture memory which flushes
+};
+
+static pxQuadBatch gQuadBatch;
+
+void pxQuadBatch::flush()
+{
+  if (mFlushing)
+  {
+    return;
+  }
+  if (mVerts.empty())
+  {
+    mProgram = PROGRAM_UNKNOWN;
+    mTexture = NULL;
+    return;
+  }
+
+  static pxMatrix4f identity;
+  static float blackColor[4] = {0.0, 0.0, 0.0, 1.0};
+
+  const GLsizei stride = 4*sizeof(float);
+  const int count = static_cast<int>(mVerts.size()/4);
+  const float* pos = &mVerts[0];
+  const float* uv = &mVerts[2];
+
+  mFlushing = true;
+  pxError e = PX_OK;
+  switch (mProgram)
+  {
+    case PROGRAM_SOLID_SHADER:
+      e = gSolidShader->draw(mResW,mResH,identity.data(),mAlpha,GL_TRIANGLES,pos,count,mColor,stride);
+      break;
+    case PROGRAM_TEXTURE_SHADER:
+      e = gTextureShader->draw(mResW,mResH,identity.data(),mAlpha,count,pos,uv,mTexture,
+                               mStretchX,mStretchY,GL_TRIANGLES,stride);
+      break;
+    case PROGRAM_A_TEXTURE_SHADER:
+      e = gATextureShader->draw(mResW,mResH,identity.data(),mAlpha,GL_TRIANGLES,count,pos,uv,mTexture,mColor,stride);
+      break;
+    default:
+      break;
+  }
+
+  if (e != PX_OK && !mFallback.empty())
+  {
+    // DEFAULT - "Missing" - BLACK RECTANGLE
+    gSolidShader->draw(mResW,mResH,identity.data(),mAlpha,GL_TRIANGLES,&mFallback[0],
+                       static_cast<int>(mFallback.size()/2),blackColor);
+  }
+
+  mVerts.clear();
+  mFallback.clear();
+  mProgram = PROGRAM_UNKNOWN;
+  mTexture = NULL;
+  mFlushing = false;
+}
+
+//====================================================================================================================================================================================
+
 static void drawRect2(GLfloat x, GLfloat y, GLfloat w, GLfloat h, const float* c)
 {
   // args are tested at call site...
@@ -1818,6 +1940,13 @@ static void drawRect2(GLfloat x, GLfloat y, GLfloat w, GLfloat h, const float* c
   float colorPM[4];
   premultiply(colorPM,c);
 
+  if (pxQuadBatch::canBatch(gMatrix.data()))
+  {
+    gQuadBatch.begin(PROGRAM_SOLID_SHADER, pxTextureRef(), colorPM);
+    gQuadBatch.addStrip(4, &verts[0][0], NULL);
+    return;
+  }
+  gQuadBatch.flush();
   gSolidShader->draw(gResW,gResH,gMatrix.data(),gAlpha,GL_TRIANGLE_STRIP,verts,4,colorPM);
 }
 
@@ -1852,6 +1981,13 @@ static void drawRectOutline(GLfloat x, GLfloat y, GLfloat w, GLfloat h, GLfloat
   float colorPM[4];
   premultiply(colorPM,c);
 
+  if (pxQuadBatch::canBatch(gMatrix.data()))
+  {
+    gQuadBatch.begin(PROGRAM_SOLID_SHADER, pxTextureRef(), colorPM);
+    gQuadBatch.addStrip(10, &verts[0][0], NULL);
+    return;
+  }
+  gQuadBatch.flush();
   gSolidShader->draw(gResW,gResH,gMatrix.data(),gAlpha,GL_TRIANGLE_STRIP,verts,10,colorPM);
 }
 
@@ -1934,6 +2070,24 @@ static void drawImageTexture(float x, float y, float w, float h, pxTextureRef te
 
   static float blackColor[4] = {0.0, 0.0, 0.0, 1.0};
 
+  if (mask.getPtr() == NULL && pxQuadBatch::canBatch(gMatrix.data()))
+  {
+    if (texture->getType() != PX_TEXTURE_ALPHA)
+    {
+      gQuadBatch.begin(PROGRAM_TEXTURE_SHADER, texture, NULL, xStretch, yStretch);
+    }
+    else
+    {
+      float colorPM[4];
+      premultiply(colorPM,color);
+      gQuadBatch.begin(PROGRAM_A_TEXTURE_SHADER, texture, colorPM);
+    }
+    gQuadBatch.addStrip(4, &verts[0][0], &uv[0][0]);
+    gQuadBatch.addFallback(iw, ih);
+    return;
+  }
+  gQuadBatch.flush();
+
   if (mask.getPtr() != NULL)
   {
     if (gTextureMaskedShader->draw(gResW,gResH,gMatrix.data(),gAlpha,4,verts,uv,texture,mask, maskOp) != PX_OK)
@@ -2061,6 +2215,13 @@ static void drawImage92(GLfloat x, GLfloat y, GLfloat w, GLfloat h, GLfloat x1,
     { ou2,ov2 }
   };
 
+  if (pxQuadBatch::canBatch(gMatrix.data()))
+  {
+    gQuadBatch.begin(PROGRAM_TEXTURE_SHADER, texture, NULL, pxConstantsStretch::NONE, pxConstantsStretch::NONE);
+    gQuadBatch.addStrip(22, &verts[0][0], &uv[0][0]);
+    return;
+  }
+  gQuadBatch.flush();
   gTextureShader->draw(gResW,gResH,gMatrix.data(),gAlpha,22,verts,uv,texture,pxConstantsStretch::NONE,pxConstantsStretch::NONE);
 }
 
@@ -2188,6 +2349,7 @@ static void drawImage9Border2(GLfloat x, GLfloat y, GLfloat w, GLfloat h,
   float colorPM[4];
   premultiply(colorPM,color);
 
+  gQuadBatch.flush();
   gTextureBorderShader->draw(gResW,gResH,gMatrix.data(),gAlpha,drawCenter? 28 : 24,verts,uv,texture,pxConstantsStretch::NONE,pxConstantsStretch::NONE, colorPM);
 }
 
@@ -2197,6 +2359,7 @@ bool gContextInit = false;
 
 pxContext::~pxContext()
 {
+  gQuadBatch.flush();
   SAFE_DELETE(gSolidShader);
   SAFE_DELETE(gATextureShader);
   SAFE_DELETE(gTextureShader);
@@ -2213,6 +2376,7 @@ void pxContext::init()
     gContextInit = true;
 #endif
 
+  gQuadBatch.flush();
   glClearColor(0, 0, 0, 0);
 
   SAFE_DELETE(gSolidShader);
@@ -2277,6 +2441,7 @@ void pxContext::term()  // clean up statics
 
 void pxContext::setSize(int w, int h)
 {
+  gQuadBatch.flush();
   glViewport(0, 0, (GLint)w, (GLint)h);
   gResW = w;
   gResH = h;
@@ -2298,6 +2463,7 @@ void pxContext::getSize(int& w, int& h)
 
 void pxContext::clear(int /*w*/, int /*h*/)
 {
+  gQuadBatch.flush();
   glClear(GL_COLOR_BUFFER_BIT);
 }
 
@@ -2305,6 +2471,7 @@ void pxContext::clear(int /*w*/, int /*h*/, float *fillColor )
 {
   float color[4];
 
+  gQuadBatch.flush();
   glGetFloatv( GL_COLOR_CLEAR_VALUE, color );
   glClearColor( fillColor[0], fillColor[1], fillColor[2], fillColor[3] );
   glClear(GL_COLOR_BUFFER_BIT);
@@ -2314,6 +2481,7 @@ void pxContext::clear(int /*w*/, int /*h*/, float *fillColor )
 
 void pxContext::clear(int left, int top, int width, int height)
 {
+  gQuadBatch.flush();
   if (left < 0)
   {
     left = 0;
@@ -2344,6 +2512,7 @@ void pxContext::clear(int left, int top, int width, int height)
 
 void pxContext::enableClipping(bool enable)
 {
+  gQuadBatch.flush();
   if (enable)
   {
     glEnable(GL_SCISSOR_TEST);
@@ -2376,6 +2545,7 @@ float pxContext::getAlpha()
 
 pxContextFramebufferRef pxContext::createFramebuffer(int width, int height, bool antiAliasing, bool alphaOnly)
 {
+  gQuadBatch.flush();
   pxContextFramebuffer* fbo = new pxContextFramebuffer();
   pxFBOTexture* fboTexture = new pxFBOTexture(antiAliasing, alphaOnly);
   pxTextureRef texture = fboTexture;
@@ -2389,6 +2559,7 @@ pxContextFramebufferRef pxContext::createFramebuffer(int width, int height, bool
 
 pxError pxContext::updateFramebuffer(pxContextFramebufferRef fbo, int width, int height)
 {
+  gQuadBatch.flush();
   if (fbo.getPtr() == NULL || fbo->getTexture().getPtr() == NULL)
   {
     return PX_FAIL;
@@ -2404,6 +2575,7 @@ pxContextFramebufferRef pxContext::getCurrentFramebuffer()
 
 pxError pxContext::setFramebuffer(pxContextFramebufferRef fbo)
 {
+  gQuadBatch.flush();
   currentGLProgram = PROGRAM_UNKNOWN;
   if (fbo.getPtr() == NULL || fbo->getTexture().getPtr() == NULL)
   {
@@ -2472,6 +2644,7 @@ pxError pxContext::deleteContextSurface(pxTextureRef texture)
 
 void pxContext::enableDirtyRectangles(bool enable)
 {
+  gQuadBatch.flush();
   currentFramebuffer->enableDirtyRectangles(enable);
   if (enable)
   {
@@ -2656,6 +2829,13 @@ void pxContext::drawTexturedQuads(int numQuads, const void *verts, const void* u
 
   float colorPM[4];
   premultiply(colorPM,color);
+  if (pxQuadBatch::canBatch(gMatrix.data()))
+  {
+    gQuadBatch.begin(PROGRAM_A_TEXTURE_SHADER, t, colorPM);
+    gQuadBatch.addTriangles(6*numQuads, (const float*)verts, (const float*)uvs);
+    return;
+  }
+  gQuadBatch.flush();
   gATextureShader->draw(gResW,gResH,gMatrix.data(),gAlpha,GL_TRIANGLES,6*numQuads,verts,uvs,t,colorPM);
 }
 #endif
@@ -2695,6 +2875,7 @@ void pxContext::drawDiagRect(float x, float y, float w, float h, float* color)
   float colorPM[4];
   premultiply(colorPM,color);
 
+  gQuadBatch.flush();
   gSolidShader->draw(gResW,gResH,gMatrix.data(),gAlpha,GL_LINE_LOOP,verts,4,colorPM);
 }
 
@@ -2726,6 +2907,7 @@ void pxContext::drawDiagLine(float x1, float y1, float x2, float y2, float* colo
   float colorPM[4];
   premultiply(colorPM,color);
 
+  gQuadBatch.flush();
   gSolidShader->draw(gResW,gResH,gMatrix.data(),gAlpha,GL_LINES,verts,2,colorPM);
 }
 
@@ -2753,6 +2935,13 @@ pxTextureRef pxContext::createTexture(float w, float h, float iw, float ih, void
   return alphaTexture;
 }
 
+// Submits any batched geometry, must be called before touching GL directly
+// and at the end of a frame
+void pxContext::flush()
+{
+  gQuadBatch.flush();
+}
+
 void pxContext::pushState()
 {
   pxContextState contextState;
@@ -2774,6 +2963,7 @@ void pxContext::popState()
 
 void pxContext::snapshot(pxOffscreen& o)
 {
+  gQuadBatch.flush();
   o.init(gResW,gResH);
   glReadPixels(0,0,gResW,gResH,GL_RGBA,GL_UNSIGNED_BYTE,(void*)o.base());
 
@@ -2814,30 +3004,35 @@ void pxContext::mapToScreenCoordinates(pxMatrix4f& m, float inX, float inY, int
   }
 }
 
-bool pxContext::isObjectOnScreen(float /*x*/, float /*y*/, float /*width*/, float /*height*/)
+// Conservative test of the transformed rectangle's bounding box against the
+// current render target.  Clipping and snapshots render into framebuffers
+// sized to the object so this also culls against the active clip.
+bool pxContext::isObjectOnScreen(float x, float y, float width, float height)
 {
-#if 1
-  return true;
-#else
-  int outX1, outX2, outY1, outY2;
-  mapToScreenCoordinates(width,height,outX2, outY2);
-  mapToScreenCoordinates(x,y,outX1, outY1);
-  int fboWidth = currentFramebuffer->width();
-  int fboHeight = currentFramebuffer->height();
-  if (currentFramebuffer == defaultFramebuffer)
+  const float cornersX[4] = { x, x + width, x,          x + width  };
+  const float cornersY[4] = { y, y,         y + height, y + height };
+
+  float minX = 0, minY = 0, maxX = 0, maxY = 0;
+  for (int i = 0; i < 4; i++)
   {
-    fboWidth = gResW;
-    fboHeight = gResH;
+    pxVector4f v = gMatrix.multiply(pxVector4f(cornersX[i], cornersY[i], 0, 1));
+    if (v.w() <= 0)
+    {
+      return true; // behind the eye, don't try to reject
+    }
+    float sx = v.x() / v.w();
+    float sy = v.y() / v.w();
+    if (i == 0 || sx < minX) minX = sx;
+    if (i == 0 || sx > maxX) maxX = sx;
+    if (i == 0 || sy < minY) minY = sy;
+    if (i == 0 || sy > maxY) maxY = sy;
   }
-  if ((outX1 < 0 && outX2 < 0) ||
-      (outX1 > fboWidth && outX2 > fboWidth) ||
-      (outY1 < 0 && outY2 < 0) ||
-      (outY1 > fboHeight && outY2 > fboHeight))
+
+  if (maxX < 0 || maxY < 0 || minX > gResW || minY > gResH)
   {
     return false;
   }
   return true;
-#endif
 }
 
 void pxContext::adjustCurrentTextureMemorySize(int64_t changeInBytes, bool allowGarbageCollect)
@@ -2923,6 +3118,8 @@ int64_t pxContext::textureMemoryOverflow(pxTextureRef texture)
 
 int64_t pxContext::ejectTextureMemory(int64_t bytesRequested, bool forceEject)
 {
+  // textures referenced by the pending batch must be drawn before they can go
+  gQuadBatch.flush();
 #ifdef ENABLE_LRU_TEXTURE_EJECTION
   if (!mEnableTextureMemoryMonitoring)
     return 0;
@@ -26,6 +26,7 @@
 
 #include <math.h>
 #include <map>
+#include <algorithm>
 
 using namespace std;
 
@@ -35,23 +36,132 @@ struct GlyphKey
   uint32_t mPixelSize;
   uint32_t mCodePoint;
 
-  // Provide a "<" operator that orders keys.
-  // The way it orders them doesn't matter, all that matters is that
-  // it orders them consistently.
-  bool operator<(GlyphKey const& other) const {
-    if (mFontId < other.mFontId) return true; else
-      if (mFontId == other.mFontId) {
-        if (mPixelSize < other.mPixelSize) return true; else
-          if (mPixelSize == other.mPixelSize) {
-            if (mCodePoint < other.mCodePoint) return true;
-          }
+  bool operator==(GlyphKey const& other) const {
+    return mCodePoint == other.mCodePoint && mPixelSize == other.mPixelSize &&
+           mFontId == other.mFontId;
+  }
+
+  uint32_t hash() const {
+    uint32_t h = mCodePoint*0x9e3779b1u;
+    h ^= (mPixelSize*0x85ebca77u) + (h<<6) + (h>>2);
+    h ^= (mFontId*0xc2b2ae3du) + (h<<6) + (h>>2);
+    h ^= h>>16;
+    return h;
+  }
+};
+
+// Open addressing (linear probing) table from GlyphKey to a value stored
+// inline, so a lookup touches one or two cache lines instead of walking a
+// tree of heap nodes.  Pointers returned by find/insert are only valid until
+// the next insert.
+template <class V>
+class GlyphHashTable
+{
+public:
+  GlyphHashTable(): mSlots(), mSize(0) {}
+
+  V* find(const GlyphKey& key)
+  {
+    if (mSlots.empty())
+      return NULL;
+
+    size_t mask = mSlots.size()-1;
+    for (size_t i = key.hash()&mask; ; i = (i+1)&mask)
+    {
+      slot& s = mSlots[i];
+      if (!s.used)
+        return NULL;
+      if (s.key == key)
+        return &s.value;
+    }
+  }
+
+  V* insert(const GlyphKey& key, const V& value)
+  {
+    V* v = find(key);
+    if (v)
+    {
+      *v = value;
+      return v;
+    }
+
+    // keep the load factor at or below 1/2 so probe runs stay short
+    if ((mSize+1)*2 > mSlots.size())
+      rehash(mSlots.empty()?256:mSlots.size()*2);
+
+    slot& s = probe(key);
+    s.used = true;
+    s.key = key;
+    s.value = value;
+    mSize++;
+    return &s.value;
+  }
+
+  // Removes every entry for which pred(value) is true.  Entries are rare to
+  // remove in bulk so the table is simply rebuilt rather than tombstoned.
+  template <class Pred>
+  void eraseIf(Pred pred)
+  {
+    vector<slot> old;
+    old.swap(mSlots);
+    mSlots.resize(old.size());
+    mSize = 0;
+    for (size_t i = 0; i < old.size(); i++)
+    {
+      if (old[i].used && !pred(old[i].value))
+      {
+        slot& s = probe(old[i].key);
+        s = old[i];
+        mSize++;
       }
-    return false;
+    }
+  }
+
+  void clear()
+  {
+    mSlots.clear();
+    mSize = 0;
+  }
+
+  size_t size() const { return mSize; }
+
+private:
+  struct slot
+  {
+    slot(): used(false) {}
+
+    GlyphKey key;
+    bool used;
+    V value;
+  };
+
+  slot& probe(const GlyphKey& key)
+  {
+    size_t mask = mSlots.size()-1;
+    size_t i = key.hash()&mask;
+    while (mSlots[i].used)
+      i = (i+1)&mask;
+    return mSlots[i];
+  }
+
+  void rehash(size_t capacity)
+  {
+    vector<slot> old;
+    old.swap(mSlots);
+    mSlots.resize(capacity);
+    for (size_t i = 0; i < old.size(); i++)
+    {
+      if (old[i].used)
+        probe(old[i].key) = old[i];
+    }
   }
+
+  vector<slot> mSlots;
+  size_t mSize;
 };
 
-typedef map<GlyphKey,GlyphCacheEntry*> GlyphCache;
-typedef map<GlyphKey,GlyphTextureEntry> GlyphTextureCache;
+typedef GlyphHashTable<GlyphCacheEntry> GlyphCache;
+typedef GlyphHashTable<GlyphTextureEntry> GlyphTextureCache;
 
 GlyphCache gGlyphCache;
 GlyphTextureCache gGlyphTextureCache;
@@ -359,6 +469,15 @@ void pxFont::getMetrics(uint32_t size, float& height, float& ascender, float& de
 
 }
 
+#ifdef PXSCENE_FONT_ATLAS
+struct GlyphOnTexture
+{
+  GlyphOnTexture(const pxTextureRef& t): mTexture(t) {}
+  bool operator()(const GlyphTextureEntry& e) const { return e.t == mTexture; }
+  pxTextureRef mTexture;
+};
+#endif
+
 GlyphTextureEntry pxFont::getGlyphTexture(uint32_t codePoint, float sx, float sy)
 {
   GlyphTextureEntry result;
@@ -389,9 +508,14 @@ GlyphTextureEntry pxFont::getGlyphTexture(uint32_t codePoint, float sx, float sy
   key.mFontId = mFontId; 
   key.mPixelSize = pixelSize; 
   key.mCodePoint = codePoint;
-  GlyphTextureCache::iterator it = gGlyphTextureCache.find(key);
-  if (it != gGlyphTextureCache.end())
-    return it->second;
+  GlyphTextureEntry* cached = gGlyphTextureCache.find(key);
+  if (cached)
+  {
+#ifdef PXSCENE_FONT_ATLAS
+    gFontAtlas.touch(cached->t.getPtr());
+#endif
+    return *cached;
+  }
   else
   {
     // temporarily set pixel size to more optimal size for
@@ -405,7 +529,14 @@ GlyphTextureEntry pxFont::getGlyphTexture(uint32_t codePoint, float sx, float sy
       FT_GlyphSlot g = mFace->glyph;
 
 #ifdef PXSCENE_FONT_ATLAS
-      if (!gFontAtlas.addGlyph(g->bitmap.width, g->bitmap.rows, g->bitmap.buffer, result))
+      pxTextureRef retired;
+      bool inAtlas = gFontAtlas.addGlyph(g->bitmap.width, g->bitmap.rows, g->bitmap.buffer, result, retired);
+      if (retired)
+      {
+        // drop cached glyphs living on the recycled atlas page
+        gGlyphTextureCache.eraseIf(GlyphOnTexture(retired));
+      }
+      if (!inAtlas)
       {
 #endif
         rtLogWarn("Glyph not in atlas");
@@ -421,7 +552,7 @@ GlyphTextureEntry pxFont::getGlyphTexture(uint32_t codePoint, float sx, float sy
       }
 #endif
       
-      gGlyphTextureCache.insert(make_pair(key,result));
+      gGlyphTextureCache.insert(key,result);
 
       // restore current pixelSize
       FT_Set_Pixel_Sizes(mFace, 0, mPixelSize);
@@ -439,9 +570,9 @@ const GlyphCacheEntry* pxFont::getGlyph(uint32_t codePoint)
   key.mFontId = mFontId; 
   key.mPixelSize = mPixelSize; 
   key.mCodePoint = codePoint;
-  GlyphCache::iterator it = gGlyphCache.find(key);
-  if (it != gGlyphCache.end())
-    return it->second;
+  const GlyphCacheEntry* cached = gGlyphCache.find(key);
+  if (cached)
+    return cached;
   else
   {
     // TODO should not need to render here !
@@ -450,20 +581,18 @@ const GlyphCacheEntry* pxFont::getGlyph(uint32_t codePoint)
     else
     {
       rtLogDebug("glyph cache miss");
-      GlyphCacheEntry *entry = new GlyphCacheEntry;
+      GlyphCacheEntry entry;
       FT_GlyphSlot g = mFace->glyph;
       
-      entry->bitmap_left = g->bitmap_left;
-      entry->bitmap_top = g->bitmap_top;
-      entry->bitmapdotwidth = g->bitmap.width;
-      entry->bitmapdotrows = g->bitmap.rows;
-      entry->advancedotx = (int32_t) g->advance.x;
-      entry->advancedoty = (int32_t) g->advance.y;
-      entry->vertAdvance = (int32_t) g->metrics.vertAdvance; // !CLF: Why vertAdvance? SHould only be valid for vert layout of text.
-
-      gGlyphCache.insert(make_pair(key,entry));
-
-      return entry;
+      entry.bitmap_left = g->bitmap_left;
+      entry.bitmap_top = g->bitmap_top;
+      entry.bitmapdotwidth = g->bitmap.width;
+      entry.bitmapdotrows = g->bitmap.rows;
+      entry.advancedotx = (int32_t) g->advance.x;
+      entry.advancedoty = (int32_t) g->advance.y;
+      entry.vertAdvance = (int32_t) g->metrics.vertAdvance; // !CLF: Why vertAdvance? SHould only be valid for vert layout of text.
+
+      return gGlyphCache.insert(key,entry);
     }
   }
   return NULL;
@@ -681,6 +810,31 @@ void pxFont::measureTextChar(u_int32_t codePoint, uint32_t size,  float sx, floa
 }
 
 
+void pxFont::measureTextAdvances(const char* text, uint32_t size, vector<float>& advances, float& h)
+{
+  advances.clear();
+  h = 0;
+  if( !mInitialized) {
+    rtLogWarn("measureTextAdvances called TOO EARLY -- not initialized or font not loaded!\n");
+    return;
+  }
+
+  setPixelSize(size);
+  h = static_cast<float>(mFace->size->metrics.height>>6);
+
+  if (!text)
+    return;
+
+  int i = 0;
+  u_int32_t codePoint;
+  while((codePoint = u8_nextchar((char*)text, &i)) != 0)
+  {
+    const GlyphCacheEntry* entry = getGlyph(codePoint);
+    advances.push_back(entry?static_cast<float>(entry->advancedotx >> 6):0);
+  }
+}
+
+
 /*
 #### getFontMetrics - returns information about the font (font and size).  It does not convey information about the text of the font.  
 * See section 3.a in http://www.freetype.org/freetype2/docs/tutorial/step2.html .  
@@ -830,10 +984,6 @@ void pxFontManager::removeFont(uint32_t fontId)
 
 void pxFontManager::clearAllFonts()
 {
-  for (GlyphCache::iterator it =  gGlyphCache.begin(); it != gGlyphCache.end(); it++)
-    delete it->second;
-
-
   gGlyphCache.clear();
   gGlyphTextureCache.clear();
   mFontIdMap.clear();
@@ -860,78 +1010,254 @@ rtDefineProperty(pxTextSimpleMeasurements, w);
 rtDefineProperty(pxTextSimpleMeasurements, h);
 
 #ifdef PXSCENE_FONT_ATLAS
+#ifndef PXSCENE_FONT_ATLAS_DIM
 #define PXSCENE_FONT_ATLAS_DIM 2048
-pxFontAtlas::pxFontAtlas(): fence(0)
+#endif
+#ifndef PXSCENE_FONT_ATLAS_MAX_PAGES
+#define PXSCENE_FONT_ATLAS_MAX_PAGES 4
+#endif
+// gap left between glyphs so that bilinear filtering does not bleed
+#define PXSCENE_FONT_ATLAS_PADDING 1
+
+pxFontAtlas::pxFontAtlas(uint32_t dim, uint32_t maxPages)
+  : mDim(dim?dim:PXSCENE_FONT_ATLAS_DIM),
+    mMaxPages(maxPages?maxPages:PXSCENE_FONT_ATLAS_MAX_PAGES),
+    mTick(0), mPages(), mPageIndex(), mGlyphsAdded(0), mFallbacks(0), mEvictions(0)
 {
-  mTexture = context.createTexture(PXSCENE_FONT_ATLAS_DIM,PXSCENE_FONT_ATLAS_DIM,PXSCENE_FONT_ATLAS_DIM,PXSCENE_FONT_ATLAS_DIM, NULL);
 }
 
 void pxFontAtlas::clearTexture() 
 {
-  if( mTexture) {
-    mTexture->deleteTexture();
-    mTexture = 0;
+  for (uint32_t i = 0; i < mPages.size(); i++)
+  {
+    if (mPages[i].texture)
+      mPages[i].texture->deleteTexture();
   }
+  mPages.clear();
+  mPageIndex.clear();
 }
-bool pxFontAtlas::addGlyph(uint32_t w, uint32_t h, void* buffer, GlyphTextureEntry& e)
+
+void pxFontAtlas::touch(pxTexture* t)
 {
-  if (!mTexture)
+  std::map<pxTexture*, uint32_t>::iterator it = mPageIndex.find(t);
+  if (it != mPageIndex.end())
+    mPages[it->second].lastUsed = ++mTick;
+}
+
+pxFontAtlasStats pxFontAtlas::stats() const
+{
+  pxFontAtlasStats s;
+  s.pages = static_cast<uint32_t>(mPages.size());
+  for (uint32_t i = 0; i < mPages.size(); i++)
   {
-    mTexture = context.createTexture(PXSCENE_FONT_ATLAS_DIM,PXSCENE_FONT_ATLAS_DIM,PXSCENE_FONT_ATLAS_DIM,PXSCENE_FONT_ATLAS_DIM, NULL);
+    s.glyphs += mPages[i].glyphs;
+    s.usedArea += mPages[i].usedArea;
   }
-  //return false;
-  // bail on biggish glyphs
-  if (h < 128)
+  s.glyphsAdded = mGlyphsAdded;
+  s.fallbacks = mFallbacks;
+  s.evictions = mEvictions;
+  s.capacity = (uint64_t)mMaxPages*mDim*mDim;
+  return s;
+}
+
+bool pxFontAtlas::fits(uint32_t w, uint32_t h) const
+{
+  return (w+PXSCENE_FONT_ATLAS_PADDING <= mDim) && (h+PXSCENE_FONT_ATLAS_PADDING <= mDim);
+}
+
+// Returns the y at which a w x h rect would rest if its left edge sits on
+// skyline node index, or -1 if it does not fit there.
+int32_t pxFontAtlas::skylineFit(const page& p, uint32_t index, uint32_t w, uint32_t h) const
+{
+  uint32_t x = p.skyline[index].x;
+  if (x+w > mDim)
+    return -1;
+
+  uint32_t y = p.skyline[index].y;
+  int32_t widthLeft = w;
+  while (widthLeft > 0)
   {
-    uint32_t h2 = (h+8)&~7;
-    // look for a row that fits
-    uint32_t i;
-    for (i = 0; i < mRows.size(); i++)
+    y = max(y, p.skyline[index].y);
+    if (y+h > mDim)
+      return -1;
+    widthLeft -= p.skyline[index].width;
+    index++;
+  }
+  return y;
+}
+
+bool pxFontAtlas::findPosition(page& p, uint32_t w, uint32_t h,
+                               uint32_t& index, uint32_t& x, uint32_t& y) const
+{
+  uint32_t bestBottom = 0xffffffff;
+  uint32_t bestWidth = 0xffffffff;
+  bool found = false;
+
+  for (uint32_t i = 0; i < p.skyline.size(); i++)
+  {
+    int32_t fy = skylineFit(p, i, w, h);
+    if (fy < 0)
+      continue;
+
+    uint32_t bottom = fy+h;
+    if (bottom < bestBottom || (bottom == bestBottom && p.skyline[i].width < bestWidth))
     {
-      row& r = mRows[i];
-      if ((h2 == r.height) && (r.rFence+w < (uint32_t)mTexture->width()))
-      {
-        e.t = mTexture;
-        e.u1 = (float)r.rFence/(float)mTexture->width();
-        e.u2 = (float)(r.rFence+w)/(float)mTexture->width();
-        e.v1 = (float)r.top/(float)mTexture->height();
-        e.v2 = (float)(r.top+h)/(float)mTexture->height();
-        
-        mTexture->updateTexture(r.rFence,r.top,w,h,buffer);
+      bestBottom = bottom;
+      bestWidth = p.skyline[i].width;
+      index = i;
+      x = p.skyline[i].x;
+      y = fy;
+      found = true;
+    }
+  }
+  return found;
+}
 
-        r.rFence += w+1;
+void pxFontAtlas::addSkylineLevel(page& p, uint32_t index, uint32_t x, uint32_t y,
+                                  uint32_t w, uint32_t h)
+{
+  skylineNode n;
+  n.x = x;
+  n.y = y+h;
+  n.width = w;
+  p.skyline.insert(p.skyline.begin()+index, n);
+
+  // shrink or drop the nodes now covered by the new level
+  for (uint32_t i = index+1; i < p.skyline.size(); i++)
+  {
+    skylineNode& prev = p.skyline[i-1];
+    skylineNode& cur = p.skyline[i];
+    if (cur.x >= prev.x+prev.width)
+      break;
 
-        return true;
-      }
+    uint32_t shrink = prev.x+prev.width-cur.x;
+    if (shrink >= cur.width)
+    {
+      p.skyline.erase(p.skyline.begin()+i);
+      i--;
+    }
+    else
+    {
+      cur.x += shrink;
+      cur.width -= shrink;
+      break;
     }
+  }
 
-    if ((i >= mRows.size()) && (fence+h < (uint32_t)mTexture->height()))
+  // merge neighbouring nodes at the same height
+  for (uint32_t i = 0; i+1 < p.skyline.size(); i++)
+  {
+    if (p.skyline[i].y == p.skyline[i+1].y)
     {
-      // Didn't find a row that matched... try adding another row
-      row nr;
-      nr.top = fence;
-      nr.height = h2;
-      nr.rFence = 0;
-      fence += h2;
+      p.skyline[i].width += p.skyline[i+1].width;
+      p.skyline.erase(p.skyline.begin()+i+1);
+      i--;
+    }
+  }
+}
+
+void pxFontAtlas::resetPage(uint32_t index)
+{
+  page& p = mPages[index];
+  if (!p.texture)
+  {
+    p.texture = context.createTexture(static_cast<float>(mDim),static_cast<float>(mDim),
+                                      static_cast<float>(mDim),static_cast<float>(mDim), NULL);
+    mPageIndex[p.texture.getPtr()] = index;
+  }
+  p.skyline.clear();
+  skylineNode n;
+  n.x = 0;
+  n.y = 0;
+  n.width = mDim;
+  p.skyline.push_back(n);
+  p.usedArea = 0;
+  p.glyphs = 0;
+  p.lastUsed = ++mTick;
+}
 
+bool pxFontAtlas::place(page& p, uint32_t w, uint32_t h, void* buffer, GlyphTextureEntry& e)
+{
+  uint32_t pw = w+PXSCENE_FONT_ATLAS_PADDING;
+  uint32_t ph = h+PXSCENE_FONT_ATLAS_PADDING;
+  uint32_t index = 0, x = 0, y = 0;
 
-      if ((h2 == nr.height) && (nr.rFence+w < (uint32_t)mTexture->width()))
-      {
-        e.t = mTexture;
-        e.u1 = (float)nr.rFence/(float)mTexture->width();
-        e.u2 = (float)(nr.rFence+w)/(float)mTexture->width();
-        e.v1 = (float)nr.top/(float)mTexture->height();
-        e.v2 = (float)(nr.top+h)/(float)mTexture->height(); 
+  if (!findPosition(p, pw, ph, index, x, y))
+    return false;
+
+  addSkylineLevel(p, index, x, y, pw, ph);
+
+  e.t = p.texture;
+  e.u1 = (float)x/(float)mDim;
+  e.u2 = (float)(x+w)/(float)mDim;
+  e.v1 = (float)y/(float)mDim;
+  e.v2 = (float)(y+h)/(float)mDim;
+
+  if (w && h)
+    p.texture->updateTexture(x,y,w,h,buffer);
+
+  p.usedArea += pw*ph;
+  p.glyphs++;
+  p.lastUsed = ++mTick;
+  mGlyphsAdded++;
+  return true;
+}
 
-        mTexture->updateTexture(nr.rFence,nr.top,w,h,buffer);
+bool pxFontAtlas::addGlyph(uint32_t w, uint32_t h, void* buffer, GlyphTextureEntry& e)
+{
+  pxTextureRef retired;
+  return addGlyph(w, h, buffer, e, retired);
+}
+
+bool pxFontAtlas::addGlyph(uint32_t w, uint32_t h, void* buffer, GlyphTextureEntry& e,
+                           pxTextureRef& retired)
+{
+  retired = NULL;
+
+  if (!fits(w,h))
+  {
+    mFallbacks++;
+    return false;
+  }
 
-        nr.rFence += w+1;
+  // fill the existing pages before growing
+  for (uint32_t i = 0; i < mPages.size(); i++)
+  {
+    if (place(mPages[i], w, h, buffer, e))
+      return true;
+  }
 
-        mRows.push_back(nr);
-        return true;
-      }        
+  if (mPages.size() < mMaxPages)
+  {
+    mPages.push_back(page());
+    resetPage(static_cast<uint32_t>(mPages.size()-1));
+    if (place(mPages.back(), w, h, buffer, e))
+      return true;
+  }
+  else
+  {
+    // every page is full; recycle the least recently used one.  Evicting a
+    // whole page rather than individual glyphs keeps the skyline simple and
+    // avoids fragmentation at the cost of re-rasterizing the glyphs it held.
+    uint32_t lru = 0;
+    for (uint32_t i = 1; i < mPages.size(); i++)
+    {
+      if (mPages[i].lastUsed < mPages[lru].lastUsed)
+        lru = i;
     }
+
+    page& p = mPages[lru];
+    retired = p.texture;
+    mPageIndex.erase(retired.getPtr());
+    p.texture = NULL;
+    mEvictions++;
+    rtLogDebug("font atlas evicting page %u (%u glyphs)", lru, p.glyphs);
+    resetPage(lru);
+    if (place(p, w, h, buffer, e))
+      return true;
   }
+
+  mFallbacks++;
   return false;
 }
 
@@ -955,6 +1281,8 @@ void pxTexturedQuads::draw(float x, float y, float* color)
     }
 
     context.drawTexturedQuads(q.verts.size()/12, &verts[0], &q.uvs[0], q.t, color);
+    // pages in use on screen are the last to be recycled
+    gFontAtlas.touch(q.t.getPtr());
   }
 }
 #endif
@@ -67,32 +67,83 @@ struct GlyphTextureEntry
 };
 
 #ifdef PXSCENE_FONT_ATLAS
+struct pxFontAtlasStats
+{
+  pxFontAtlasStats(): pages(0), glyphs(0), glyphsAdded(0), fallbacks(0),
+                      evictions(0), usedArea(0), capacity(0) {}
+
+  uint32_t pages;
+  uint32_t glyphs;
+  uint64_t glyphsAdded;
+  uint64_t fallbacks;
+  uint64_t evictions;
+  uint64_t usedArea;
+  uint64_t capacity;
+};
+
+// Glyphs are packed into a small set of alpha texture pages using a
+// skyline bottom-left packer.  When every page is full the least recently
+// used page is retired as a whole and recycled; glyphs that are already
+// laid out keep a reference to the old texture until they are re-rendered.
 class pxFontAtlas
 {
 public:
 
-
-  struct row
+  struct skylineNode
   {
-    uint32_t top;
-    uint32_t height;
-    uint32_t rFence;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
   };
 
+  struct page
+  {
+    page(): lastUsed(0), usedArea(0), glyphs(0) {}
+
+    pxTextureRef texture;
+    vector<skylineNode> skyline;
+    uint32_t lastUsed;
+    uint32_t usedArea;
+    uint32_t glyphs;
+  };
 
-  pxFontAtlas();
+  pxFontAtlas(uint32_t dim = 0, uint32_t maxPages = 0);
 
+  // Returns false if the glyph can not be placed in any page.  If a page had
+  // to be recycled to make room the texture it held is returned in retired so
+  // that callers can drop cached entries that still point at it.
+  bool addGlyph(uint32_t w, uint32_t h, void* buffer, GlyphTextureEntry& e,
+                pxTextureRef& retired);
   bool addGlyph(uint32_t w, uint32_t h, void* buffer, GlyphTextureEntry& e);
+  // marks the page holding t as used, called when its glyphs are drawn
+  void touch(pxTexture* t);
   void clearTexture();
 
+  pxFontAtlasStats stats() const;
 
   private:
 
-  uint32_t fence;
-  pxTextureRef mTexture;
-  vector<row> mRows;
+  bool fits(uint32_t w, uint32_t h) const;
+  bool findPosition(page& p, uint32_t w, uint32_t h,
+                    uint32_t& index, uint32_t& x, uint32_t& y) const;
+  int32_t skylineFit(const page& p, uint32_t index, uint32_t w, uint32_t h) const;
+  void addSkylineLevel(page& p, uint32_t index, uint32_t x, uint32_t y,
+                       uint32_t w, uint32_t h);
+  void resetPage(uint32_t index);
+  bool place(page& p, uint32_t w, uint32_t h, void* buffer, GlyphTextureEntry& e);
+
+  uint32_t mDim;
+  uint32_t mMaxPages;
+  uint32_t mTick;
+  vector<page> mPages;
+  std::map<pxTexture*, uint32_t> mPageIndex; // page texture to its index in mPages
+  uint64_t mGlyphsAdded;
+  uint64_t mFallbacks;
+  uint64_t mEvictions;
 };
 
+extern pxFontAtlas gFontAtlas;
+
 class pxTexturedQuads
 {
   // limit the size of vectors per quad to prevent memory
@@ -271,6 +322,9 @@ public:
                    float& w, float& h);
   void measureTextChar(u_int32_t codePoint, uint32_t size,  float sx, float sy, 
                          float& w, float& h);
+  // Fills advances with the horizontal advance of every code point in text
+  // (0 for missing glyphs) and h with the line height, in one pass.
+  void measureTextAdvances(const char* text, uint32_t size, vector<float>& advances, float& h);
   #ifndef PXSCENE_FONT_ATLAS
   void renderText(const char *text, uint32_t size, float x, float y, 
                   float sx, float sy, 
@@ -216,6 +216,9 @@ void pxImage::draw() {
   if (!imageLoaded && getImageResource() != NULL && getImageResource()->isDownloadInProgress())
     getImageResource()->raiseDownloadPriority();
 #endif
+  // Visible local images jump the decode queue
+  if (!imageLoaded && getImageResource() != NULL && getImageResource()->isDecodePending())
+    getImageResource()->raiseDownloadPriority();
 }
 void pxImage::resourceReady(rtString readyResolution)
 {
@@ -37,6 +37,12 @@ extern pxContext context;
 
 rtThreadPool textureCreateThreadPool(1);
 
+#ifndef PX_IMAGE_DECODE_THREAD_COUNT
+#define PX_IMAGE_DECODE_THREAD_COUNT 2
+#endif
+
+rtThreadPool imageDecodeThreadPool(PX_IMAGE_DECODE_THREAD_COUNT);
+
 pxResource::~pxResource()
 {
   //rtLogDebug("pxResource::~pxResource()\n");
@@ -102,7 +108,7 @@ void pxResource::addListener(pxResourceListener* pListener)
     return;
 
   bool downloadRequestActive = false;
-  bool isDownloadCanceled = rtFileDownloader::isDownloadRequestCanceled(mDownloadRequest, this);
+  bool isDownloadCanceled = rtFileDownloader::isDownloadRequestCanceled(mDownloadRequest, this) || isLoadCanceled();
 
   mDownloadInProgressMutex.lock();
   downloadRequestActive = mDownloadInProgress;
@@ -210,6 +216,10 @@ void pxResource::removeListener(pxResourceListener* pListener)
   }
   numberOfListeners = mListeners.size();
   mListenersMutex.unlock();
+  if (numberOfListeners <= 0)
+  {
+    cancelPendingLoad();
+  }
   if (numberOfListeners <= 0 && mDownloadRequest != NULL)
   {
     //rtLogDebug("canceling url: %s", mUrl.cString());
@@ -281,7 +291,8 @@ void pxResource::raiseDownloadPriority()
 
 
 rtImageResource::rtImageResource()
-: pxResource(), mTexture(), mDownloadedTexture(), mTextureMutex(), mDownloadComplete(false), init_w(0), init_h(0), init_sx(0.0f), init_sy(0.0f), mData()
+: pxResource(), mTexture(), mDownloadedTexture(), mTextureMutex(), mDownloadComplete(false), init_w(0), init_h(0), init_sx(0.0f), init_sy(0.0f), mData(),
+  mDecodeRequest(NULL), mDecodeCanceled(false)
 {
   // empty
 }
@@ -289,7 +300,7 @@ rtImageResource::rtImageResource()
 rtImageResource::rtImageResource(const char* url, const char* proxy, int32_t iw /* = 0 */,  int32_t ih /* = 0 */,
                                                                        float sx /* = 1.0f*/,  float sy /* = 1.0f*/ )
     : pxResource(), mTexture(), mDownloadedTexture(), mTextureMutex(), mDownloadComplete(false),
-      init_w(iw), init_h(ih), init_sx(sx), init_sy(sy), mData()
+      init_w(iw), init_h(ih), init_sx(sx), init_sy(sy), mData(), mDecodeRequest(NULL), mDecodeCanceled(false)
 {
   setUrl(url, proxy);
 }
@@ -522,6 +533,7 @@ void pxResource::loadResource(rtObjectRef archive)
     mReady = new rtPromise();
   }
   setLoadStatus("statusCode", -1);
+  priorityRaised = false;
   pxArchive* arc = (pxArchive*)archive.getPtr();
   //rtLogDebug("rtImageResource::loadResource statusCode should be -1; is statusCode=%d\n",mLoadStatus.get<int32_t>("statusCode"));
   if (mUrl.beginsWith("http:") || mUrl.beginsWith("https:"))
@@ -583,51 +595,72 @@ void pxResource::onResourceDirtyUI(void* context, void* /*data*/)
 }
 
 
-void rtImageResource::loadResourceFromFile()
+// A local or archive image waiting on (or finished by) the decode pool.
+// The resource holds a reference until onImageDecodedUI runs.
+struct pxImageDecodeRequest
 {
-  pxOffscreen imageOffscreen;
-  rtString status = "resolve";
+  pxImageDecodeRequest(rtImageResource* res)
+    : resource(res), decoded(false), result(RT_FAIL), offscreen(), mCanceled(false), mCanceledMutex() {}
 
-  rtError loadImageSuccess = RT_FAIL;
+  void cancel()
+  {
+    mCanceledMutex.lock();
+    mCanceled = true;
+    mCanceledMutex.unlock();
+  }
 
-  do
+  bool isCanceled()
   {
-    if (mData.length() != 0)
-    {
-      // We have BASE64 or SVG string already...
-      loadImageSuccess = RT_OK;
-      break;
-    }
+    mCanceledMutex.lock();
+    bool canceled = mCanceled;
+    mCanceledMutex.unlock();
+    return canceled;
+  }
 
-    loadImageSuccess = rtLoadFile(mUrl, mData);
-    if (loadImageSuccess == RT_OK)
-      break;
+  rtImageResource* resource;
+  bool decoded;
+  rtError result;
+  pxOffscreen offscreen;
 
-    if (rtIsPathAbsolute(mUrl))
-      break;
+private:
+  bool mCanceled;
+  rtMutex mCanceledMutex;
+};
+
+rtError rtImageResource::readImageFile()
+{
+  if (mData.length() != 0)
+  {
+    // We have BASE64 or SVG string already...
+    return RT_OK;
+  }
+
+  if (rtLoadFile(mUrl, mData) == RT_OK)
+    return RT_OK;
 
+  if (!rtIsPathAbsolute(mUrl))
+  {
     rtModuleDirs *dirs = rtModuleDirs::instance();
 
     for (rtModuleDirs::iter it = dirs->iterator(); it.first != it.second; it.first++)
     {
       if (rtLoadFile(rtConcatenatePath(*it.first, mUrl.cString()).c_str(), mData) == RT_OK)
-      {
-        loadImageSuccess = RT_OK;
-        break;
-      }
+        return RT_OK;
     }
-  } while(0);
-
-  if (loadImageSuccess == RT_OK)
-  {
-    loadImageSuccess = pxLoadImage((const char *) mData.data(), mData.length(), imageOffscreen,
-                                      init_w, init_h, init_sx, init_sy);
-  }
-  else
-  {
-    loadImageSuccess = RT_RESOURCE_NOT_FOUND;
-    rtLogError("Could not load image file %s.", mUrl.cString());
   }
+
+  rtLogError("Could not load image file %s.", mUrl.cString());
+  return RT_RESOURCE_NOT_FOUND;
+}
+
+rtError rtImageResource::decodeImageData(pxOffscreen& imageOffscreen)
+{
+  return pxLoadImage((const char *) mData.data(), mData.length(), imageOffscreen,
+                     init_w, init_h, init_sx, init_sy);
+}
+
+void rtImageResource::completeImageLoad(rtError loadImageSuccess, pxOffscreen& imageOffscreen)
+{
   if ( loadImageSuccess != RT_OK)
   {
     rtLogWarn("image load failed"); // TODO: why?
@@ -675,87 +708,152 @@ void rtImageResource::loadResourceFromFile()
   mTextureMutex.unlock();
 }
 
-void rtImageResource::loadResourceFromArchive(rtObjectRef archiveRef)
+rtString rtImageResource::decodeTaskKey()
 {
-  pxArchive* archive = (pxArchive*)archiveRef.getPtr();
-  pxOffscreen imageOffscreen;
-  rtString status = "resolve";
+  return mName.isEmpty() ? mUrl : mName;
+}
+
+bool rtImageResource::startImageDecode()
+{
+  if (gUIThreadQueue == NULL || PX_IMAGE_DECODE_THREAD_COUNT <= 0)
+    return false;
 
-  rtError loadImageSuccess = RT_FAIL;
+  mDecodeCanceled = false;
+  mDecodeRequest = new pxImageDecodeRequest(this);
+  // a new task starts out at normal priority
+  priorityRaised = false;
 
-  if(mData.length() == 0)
+  mDownloadInProgressMutex.lock();
+  mDownloadInProgress = true;
+  mDownloadInProgressMutex.unlock();
+
+  AddRef(); // released by onImageDecodedUI
+  imageDecodeThreadPool.executeTask(new rtThreadTask(decodeImageTask, mDecodeRequest, decodeTaskKey()));
+  return true;
+}
+
+// Runs on an image decode thread
+void rtImageResource::decodeImageTask(void* data)
+{
+  pxImageDecodeRequest* request = (pxImageDecodeRequest*)data;
+  rtImageResource* res = request->resource;
+
+  if (!request->isCanceled())
   {
-    if ((NULL != archive) && (RT_OK == archive->getFileData(mUrl, mData)))
+    request->result = res->readImageFile();
+    if (request->result == RT_OK)
     {
-      loadImageSuccess = RT_OK;
-    }
-    else
-    {
-      loadImageSuccess = RT_RESOURCE_NOT_FOUND;
-      rtLogError("Could not load image file from archive %s.", mUrl.cString());
+      request->result = res->decodeImageData(request->offscreen);
     }
-  }
-  else
-  {
-    // We have BASE64 or SVG string already...
-    loadImageSuccess = RT_OK;
+    request->decoded = true;
   }
 
-  if (loadImageSuccess == RT_OK)
-  {
-    loadImageSuccess = pxLoadImage((const char *) mData.data(), mData.length(), imageOffscreen,
-                                      init_w, init_h, init_sx, init_sy);
-  }
-  else
-  {
-    loadImageSuccess = RT_RESOURCE_NOT_FOUND;
-    rtLogError("Could not load image file %s.", mUrl.cString());
-  }
-  if ( loadImageSuccess != RT_OK)
+  gUIThreadQueue->addTask(onImageDecodedUI, res, request);
+}
+
+void rtImageResource::onImageDecodedUI(void* context, void* data)
+{
+  rtImageResource* res = (rtImageResource*)context;
+  pxImageDecodeRequest* request = (pxImageDecodeRequest*)data;
+
+  res->finishImageDecode(request);
+  delete request;
+
+  res->Release();
+}
+
+void rtImageResource::finishImageDecode(pxImageDecodeRequest* request)
+{
+  mDecodeRequest = NULL;
+  clearDownloadRequest();
+
+  if (!request->decoded)
   {
-    rtLogWarn("image load failed"); // TODO: why?
-    if (loadImageSuccess == RT_RESOURCE_NOT_FOUND)
+    // Canceled before a decode thread picked it up; any file data already
+    // read stays in mData so a restart only has to decode
+    mListenersMutex.lock();
+    size_t numberOfListeners = mListeners.size();
+    mListenersMutex.unlock();
+    if (numberOfListeners > 0)
     {
-      setLoadStatus("statusCode",PX_RESOURCE_STATUS_FILE_NOT_FOUND);
+      startImageDecode();
     }
     else
     {
-      setLoadStatus("statusCode", PX_RESOURCE_STATUS_DECODE_FAILURE);
+      mDecodeCanceled = true;
     }
+    return;
+  }
 
-    // Since this object can be released before we get a async completion
-    // We need to maintain this object's lifetime
-    // TODO review overall flow and organization
-    AddRef();
+  completeImageLoad(request->result, request->offscreen);
+}
 
-    if (gUIThreadQueue)
+void rtImageResource::cancelPendingLoad()
+{
+  if (mDecodeRequest != NULL)
+  {
+    mDecodeRequest->cancel();
+
+    // Take it out of the decode queue if no thread has picked it up yet and
+    // complete it the way decodeImageTask would have
+    if (imageDecodeThreadPool.cancelTask(decodeTaskKey()) > 0)
     {
-      gUIThreadQueue->addTask(onDownloadCompleteUI, this, (void*)"reject");
+      gUIThreadQueue->addTask(onImageDecodedUI, this, mDecodeRequest);
     }
-    //mTexture->notifyListeners( mTexture, RT_FAIL, errorCode);
   }
-  else
+}
+
+void rtImageResource::raiseDownloadPriority()
+{
+  if (mDecodeRequest == NULL)
   {
-    // create offscreen texture for local image
-    mTexture = context.createTexture(imageOffscreen, (const char *) mData.data(), mData.length());
-    mTexture->setTextureListener(this);
+    pxResource::raiseDownloadPriority();
+  }
+  else if (!priorityRaised)
+  {
+    priorityRaised = true;
+    imageDecodeThreadPool.raisePriority(decodeTaskKey());
+  }
+}
 
-    mData.term(); // Dump the source data...
+void rtImageResource::loadResourceFromFile()
+{
+  if (startImageDecode())
+    return;
 
-    setLoadStatus("statusCode",0);
-    // Since this object can be released before we get a async completion
-    // We need to maintain this object's lifetime
-    // TODO review overall flow and organization
-    AddRef();
-    if (gUIThreadQueue)
+  pxOffscreen imageOffscreen;
+  rtError loadImageSuccess = readImageFile();
+  if (loadImageSuccess == RT_OK)
+  {
+    loadImageSuccess = decodeImageData(imageOffscreen);
+  }
+  completeImageLoad(loadImageSuccess, imageOffscreen);
+}
+
+void rtImageResource::loadResourceFromArchive(rtObjectRef archiveRef)
+{
+  pxArchive* archive = (pxArchive*)archiveRef.getPtr();
+  pxOffscreen imageOffscreen;
+
+  rtError loadImageSuccess = RT_OK;
+
+  // Archive reads stay on the calling thread; only the decode is deferred
+  if(mData.length() == 0)
+  {
+    if ((NULL == archive) || (RT_OK != archive->getFileData(mUrl, mData)))
     {
-      gUIThreadQueue->addTask(onDownloadCompleteUI, this, (void *) "resolve");
+      loadImageSuccess = RT_RESOURCE_NOT_FOUND;
+      rtLogError("Could not load image file from archive %s.", mUrl.cString());
     }
   }
 
-  mTextureMutex.lock();
-  mDownloadComplete = true;
-  mTextureMutex.unlock();
+  if (loadImageSuccess == RT_OK)
+  {
+    if (startImageDecode())
+      return;
+    loadImageSuccess = decodeImageData(imageOffscreen);
+  }
+  completeImageLoad(loadImageSuccess, imageOffscreen);
 }
 
 
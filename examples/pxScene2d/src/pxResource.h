@@ -38,6 +38,7 @@
 #include "rtCORS.h"
 #include <map>
 class rtFileDownloadRequest;
+struct pxImageDecodeRequest;
 
 #define PX_RESOURCE_STATUS_OK             0
 #define PX_RESOURCE_STATUS_DOWNLOADING    1
@@ -114,6 +115,12 @@ public:
   void setCORS(const rtCORSRef& cors) { mCORS = cors; }
   void setName(rtString name) { mName = name; }
 protected:   
+  // Hooks for resources that load outside of rtFileDownloader; a pending
+  // load is canceled once its last listener goes away and restarted by
+  // the next addListener
+  virtual void cancelPendingLoad() {}
+  virtual bool isLoadCanceled() { return false; }
+
   static void onDownloadComplete(rtFileDownloadRequest* downloadRequest);
   static void onDownloadCompleteUI(void* context, void* data);
   static void onDownloadCanceledUI(void* context, void* data);
@@ -187,25 +194,45 @@ public:
   virtual void reloadData();
   virtual uint64_t textureMemoryUsage();
   virtual void textureReady();
+
+  virtual void raiseDownloadPriority();
+  bool isDecodePending() { return mDecodeRequest != NULL; }
   
 protected:
   virtual uint32_t loadResourceData(rtFileDownloadRequest* fileDownloadRequest);
+  virtual void cancelPendingLoad();
+  virtual bool isLoadCanceled() { return mDecodeCanceled; }
 
 private:
 
   void loadResourceFromFile();
   void loadResourceFromArchive(rtObjectRef archiveRef);
 
+  rtError readImageFile();
+  rtError decodeImageData(pxOffscreen& imageOffscreen);
+  void completeImageLoad(rtError loadImageSuccess, pxOffscreen& imageOffscreen);
+
+  // Local and archive images are decoded on the image decode thread pool
+  // and handed back to the UI thread through gUIThreadQueue
+  bool startImageDecode();
+  rtString decodeTaskKey();
+  static void decodeImageTask(void* data);
+  static void onImageDecodedUI(void* context, void* data);
+  void finishImageDecode(pxImageDecodeRequest* request);
+
   pxTextureRef mTexture;
   pxTextureRef mDownloadedTexture;
   rtMutex mTextureMutex;
   bool mDownloadComplete;
 
-  // convey "create-time" dimension & scale preference (SVG only)
+  // convey "create-time" dimension & scale preference (see pxLoadImage)
   int32_t   init_w,  init_h;
   float     init_sx, init_sy;
 
   rtData    mData;
+
+  pxImageDecodeRequest* mDecodeRequest;
+  bool mDecodeCanceled;
 };
 
 class rtImageAResource : public pxResource
@@ -22,6 +22,7 @@
 
 #include <math.h>
 #include <assert.h>
+#include <algorithm>
 
 #include "rtLog.h"
 #include "rtRef.h"
@@ -461,6 +462,7 @@ pxObject::pxObject(pxScene2d* scene): rtObject(), mParent(NULL), mpx(0), mpy(0),
     mSnapshotRef(), mPainting(true), mClip(false), mMask(false), mDraw(true), mHitTest(true), mReady(),
     mFocus(false),mClipSnapshotRef(),mCancelInSet(true),mUseMatrix(false), mRepaint(true)
     , mIsDirty(true), mRenderMatrix(), mScreenCoordinates(), mDirtyRect()
+    , mBoundsX1(0), mBoundsY1(0), mBoundsX2(0), mBoundsY2(0), mBoundsValid(false)
     ,mDrawableSnapshotForMask(), mMaskSnapshot(), mIsDisposed(false), mSceneSuspended(false)
   {
     pxObjectCount++;
@@ -483,6 +485,10 @@ pxObject::~pxObject()
       (*it)->mParent = NULL;  // setParent mutates the mChildren collection
     }
     mChildren.clear();
+    if (mScene && !mAnimations.empty())
+    {
+      mScene->mAnimationEngine.remove(this);
+    }
     pxObjectCount--;
     clearSnapshot(mSnapshotRef);
     clearSnapshot(mClipSnapshotRef);
@@ -509,18 +515,21 @@ void pxObject::dispose(bool pumpJavascript)
     //rtLogInfo(__FUNCTION__);
     mIsDisposed = true;
     rtValue nullValue;
-    vector<animation>::iterator it = mAnimations.begin();
+    vector<animation*>::iterator it = mAnimations.begin();
     for(;it != mAnimations.end();it++)
     {
-      if ((*it).promise)
+      if ((*it)->promise)
       {
-	  (*it).promise.send("reject",nullValue);
+	  (*it)->promise.send("reject",nullValue);
       }
     }
 
     mReady.send("reject",nullValue);
 
-    mAnimations.clear();
+    if (mScene && !mAnimations.empty())
+    {
+      mScene->mAnimationEngine.remove(this);
+    }
     mEmit->clearListeners();
     for(vector<rtRef<pxObject> >::iterator it = mChildren.begin(); it != mChildren.end(); ++it)
     {
@@ -585,6 +594,7 @@ rtError pxObject::Set(const char* name, const rtValue* value)
     repaint();
   }
   repaintParents();
+  invalidateBounds();
   mScene->mDirty = true;
   return rtObject::Set(name, value);
 }
@@ -678,7 +688,10 @@ void pxObject::setParent(rtRef<pxObject>& parent)
     remove();
     mParent = parent;
     if (parent)
+    {
       parent->mChildren.push_back(this);
+      parent->invalidateBounds();
+    }
     if (gDirtyRectsEnabled) {
         mIsDirty = true;
         //mScreenCoordinates = getBoundingRectInScreenCoordinates();
@@ -706,6 +719,7 @@ rtError pxObject::remove()
         mParent = NULL;
         parent->repaint();
         parent->repaintParents();
+        parent->invalidateBounds();
         mScene->mDirty = true;
         return RT_OK;
       }
@@ -723,6 +737,7 @@ rtError pxObject::removeAll()
   mChildren.clear();
   repaint();
   repaintParents();
+  invalidateBounds();
   mScene->mDirty = true;
   return RT_OK;
 }
@@ -768,6 +783,7 @@ rtError pxObject::moveToBack()
   mParent = parent;
   std::vector<rtRef<pxObject> >::iterator it = parent->mChildren.begin();
   parent->mChildren.insert(it, this);
+  parent->invalidateBounds();
 
   parent->repaint();
   parent->repaintParents();
@@ -860,17 +876,25 @@ rtError pxObject::animateTo(const char* prop, double to, double duration,
 // the set* method anyway.
 void pxObject::cancelAnimation(const char* prop, bool fastforward, bool rewind)
 {
-  if (!mCancelInSet)
+  if (!mCancelInSet || mAnimations.empty())
     return;
   bool f = mCancelInSet;
   // Do not reenter
   mCancelInSet = false;
 
-  // If an animation for this property is in progress we cancel it here
-  vector<animation>::iterator it = mAnimations.begin();
-  while (it != mAnimations.end())
+  // If an animation for this property is in progress we cancel it here.
+  // Callbacks may add or remove animations so work on a copy of the list
+  vector<animation*> animations = mAnimations;
+  vector<animation*>::iterator it = animations.begin();
+  while (it != animations.end())
   {
-    animation& a = (*it);
+    if (std::find(mAnimations.begin(), mAnimations.end(), *it) == mAnimations.end())
+    {
+      // removed by a callback of a previous entry
+      ++it;
+      continue;
+    }
+    animation& a = *(*it);
     if (!a.cancelled && a.prop == prop)
     {
       pxAnimate* pAnimateObj = (pxAnimate*) a.animateObj.getPtr();
@@ -912,12 +936,75 @@ void pxObject::cancelAnimation(const char* prop, bool fastforward, bool rewind)
       {
         pAnimateObj->update(prop, &a, pxConstantsAnimation::STATUS_CANCELLED);
       }
+
+      // the engine keeps the record alive until the end of its update
+      // or immediately deletes it, so this has to be the last use
+      mScene->mAnimationEngine.remove(&a);
     }
     ++it;
   }
   mCancelInSet = f;
 }
 
+struct pxAnimationSlot
+{
+  const char* prop;
+  pxAnimationSetter setter;
+};
+
+static const pxAnimationSlot gAnimationSlots[] =
+{
+  { "x",  &pxObject::setX  },
+  { "y",  &pxObject::setY  },
+  { "a",  &pxObject::setA  },
+  { "w",  &pxObject::setW  },
+  { "h",  &pxObject::setH  },
+  { "sx", &pxObject::setSX },
+  { "sy", &pxObject::setSY },
+  { "r",  &pxObject::setR  },
+  { "px", &pxObject::setPX },
+  { "py", &pxObject::setPY },
+  { "cx", &pxObject::setCX },
+  { "cy", &pxObject::setCY },
+#ifdef ANIMATION_ROTATE_XYZ
+  { "rx", &pxObject::setRX },
+  { "ry", &pxObject::setRY },
+  { "rz", &pxObject::setRZ },
+#endif //ANIMATION_ROTATE_XYZ
+};
+
+pxAnimationSetter pxObject::animationSetter(const char* prop)
+{
+  if (!prop)
+    return NULL;
+  for (size_t i = 0; i < sizeof(gAnimationSlots)/sizeof(gAnimationSlots[0]); i++)
+  {
+    if (!strcmp(prop, gAnimationSlots[i].prop))
+      return gAnimationSlots[i].setter;
+  }
+  return NULL;
+}
+
+// Same bookkeeping as pxObject::Set without the property name lookup
+// and rtValue conversion
+void pxObject::setAnimatedValue(const animation& a, float v)
+{
+  if (!a.setter)
+  {
+    set(a.prop, v);
+    return;
+  }
+
+  if (gDirtyRectsEnabled)
+    mIsDirty = true;
+  if (a.repaint)
+    repaint();
+  repaintParents();
+  invalidateBounds();
+  mScene->mDirty = true;
+  (this->*a.setter)(v);
+}
+
 void pxObject::animateToInternal(const char* prop, double to, double duration,
                          pxInterp interp, pxConstantsAnimation::animationOptions options,
                          int32_t count, rtObjectRef promise, rtObjectRef animateObj)
@@ -935,6 +1022,8 @@ void pxObject::animateToInternal(const char* prop, double to, double duration,
   a.start    = -1;
   a.duration = duration;
   a.interpFunc  = interp ? interp : pxInterpLinear;
+  a.setter   = animationSetter(prop);
+  a.repaint  = strcmp(prop, "x") != 0 && strcmp(prop, "y") != 0 && strcmp(prop, "a") != 0;
   a.options     = options;
   a.count    = count;
   a.actualCount = 0;
@@ -942,10 +1031,18 @@ void pxObject::animateToInternal(const char* prop, double to, double duration,
 //  a.ended = onEnd;
   a.promise = promise;
   a.animateObj = animateObj;
-
-  mAnimations.push_back(a);
+  a.object = this;
 
   pxAnimate *animObj = (pxAnimate *)a.animateObj.getPtr();
+  if (NULL != animObj)
+  {
+    a.animateParams = animObj->params(prop);
+  }
+
+  if (mScene)
+  {
+    mScene->mAnimationEngine.add(this, a);
+  }
 
   if (NULL != animObj)
   {
@@ -969,148 +1066,8 @@ void pxObject::update(double t)
   return;
 #endif
 
-  // Update animations
-  vector<animation>::iterator it = mAnimations.begin();
-
-  while (it != mAnimations.end())
-  {
-    animation& a = (*it);
-
-    pxAnimate *animObj = (pxAnimate *)a.animateObj.getPtr();
-
-    if (a.start < 0) a.start = t;
-    double end = a.start + a.duration;
-
-    // if duration has elapsed, increment the count for this animation
-    if( t >=end && a.count != pxConstantsAnimation::COUNT_FOREVER
-        && !(a.options & pxConstantsAnimation::OPTION_OSCILLATE))
-    {
-        a.actualCount++;
-        a.start  = -1;
-    }
-    // if duration has elapsed and count is met, end the animation
-    if (t >= end && a.count != pxConstantsAnimation::COUNT_FOREVER && a.actualCount >= a.count)
-    {
-      // TODO this sort of blows since this triggers another
-      // animation traversal to cancel animations
-#if 0
-      cancelAnimation(a.prop, true, false);
-#else
-      assert(mCancelInSet);
-      mCancelInSet = false;
-      set(a.prop, a.to);
-      mCancelInSet = true;
-
-      if (a.count != pxConstantsAnimation::COUNT_FOREVER && a.actualCount >= a.count )
-      {
-        if (a.ended)
-          a.ended.send(this);
-        if (a.promise)
-        {
-          a.promise.send("resolve",this);
-          if (NULL != animObj)
-          {
-            animObj->setStatus(pxConstantsAnimation::STATUS_ENDED);
-          }
-        }
-        // Erase making sure to push the iterator forward before
-        a.cancelled = true;
-        if (NULL != animObj)
-        {
-          animObj->update(a.prop, &a, pxConstantsAnimation::STATUS_ENDED);
-        }
-        it = mAnimations.erase(it);
-        continue;
-      }
-#endif
-
-    }
-
-    if (a.cancelled)
-    {
-      if (NULL != animObj)
-      {
-        animObj->update(a.prop, &a, pxConstantsAnimation::STATUS_CANCELLED);
-      }
-
-      it = mAnimations.erase(it);  // returns next element
-      continue;
-    }
-
-    double t1 = (t-a.start)/a.duration; // Some of this could be pushed into the end handling
-    double t2 = floor(t1);
-    t1 = t1-t2; // 0-1
-
-    double d = a.interpFunc(t1);
-    float from = a.from;
-    float   to = a.to;
-
-    if (a.options & pxConstantsAnimation::OPTION_OSCILLATE)
-    {
-      bool justReverseChange = false;
-      double toVal = a.to;
-      if( (fmod(t2,2) != 0))  // TODO perf chk ?
-      {
-        if(!a.reversing)
-        {
-          a.reversing = true;
-          justReverseChange = true;
-          a.actualCount++;
-        }
-        from = a.to;
-        to   = a.from;
-      }
-      else if( a.reversing && (fmod(t2,2) == 0))
-      {
-        toVal = a.from;
-        justReverseChange = true;
-        a.reversing = false;
-        a.actualCount++;
-        a.start = -1;
-      }
-      // Prevent one more loop through oscillate
-      if(a.count != pxConstantsAnimation::COUNT_FOREVER && a.actualCount >= a.count )
-      {
-          // if(a.actualCount == a.count)
-          // {
-          //   justReverseChange = false;
-          // }
-
-          if (true == justReverseChange)
-          {
-            mCancelInSet = false;
-            set(a.prop, toVal);
-            mCancelInSet = true;
-          }
-
-        if (NULL != animObj)
-        {
-          animObj->setStatus(pxConstantsAnimation::STATUS_ENDED);
-        }
-        cancelAnimation(a.prop, false, false);
-
-        if (NULL != animObj)
-        {
-          animObj->update(a.prop, &a, pxConstantsAnimation::STATUS_ENDED);
-        }
-
-        it = mAnimations.erase(it);
-        continue;
-      }
-
-    }
-
-    float v = static_cast<float> (from + (to - from) * d);
-    assert(mCancelInSet);
-    mCancelInSet = false;
-    set(a.prop, v);
-    mCancelInSet = true;
-    if (NULL != animObj)
-    {
-      animObj->update(a.prop, &a, pxConstantsAnimation::STATUS_INPROGRESS);
-    }
-    ++it;
-  }
+  // Animations are advanced scene wide by pxAnimationEngine before
+  // the tree is traversed
 
     pxMatrix4f m;
     if (gDirtyRectsEnabled) {
@@ -1171,10 +1128,78 @@ EXITSCENELOCK()
         mRenderMatrix = m;
     }
 
+  updateBounds();
+
   // Send promise
   sendPromise();
 }
 
+// Children bounds must be current, so this runs after they are updated
+void pxObject::updateBounds()
+{
+  float x1, y1, x2, y2;
+  mBoundsValid = drawBounds(x1, y1, x2, y2);
+
+  // clipped and snapshotted objects never draw outside of themselves
+  if (mBoundsValid && !mClip && mPainting)
+  {
+    for(vector<rtRef<pxObject> >::iterator it = mChildren.begin(); it != mChildren.end(); ++it)
+    {
+      pxObject* c = (*it).getPtr();
+      if (!c->mBoundsValid)
+      {
+        mBoundsValid = false;
+        break;
+      }
+
+      pxMatrix4f m;
+      c->applyMatrix(m);
+      const float cx[4] = { c->mBoundsX1, c->mBoundsX2, c->mBoundsX1, c->mBoundsX2 };
+      const float cy[4] = { c->mBoundsY1, c->mBoundsY1, c->mBoundsY2, c->mBoundsY2 };
+      for (int i = 0; i < 4; i++)
+      {
+        pxVector4f v = m.multiply(pxVector4f(cx[i], cy[i], 0, 1));
+        if (v.w() <= 0)
+        {
+          mBoundsValid = false;
+          break;
+        }
+        float px = v.x() / v.w();
+        float py = v.y() / v.w();
+        if (px < x1) x1 = px;
+        if (px > x2) x2 = px;
+        if (py < y1) y1 = py;
+        if (py > y2) y2 = py;
+      }
+      if (!mBoundsValid)
+        break;
+    }
+  }
+
+  mBoundsX1 = x1;
+  mBoundsY1 = y1;
+  mBoundsX2 = x2;
+  mBoundsY2 = y2;
+}
+
+// Changes made after update() must not cull against stale bounds
+void pxObject::invalidateBounds()
+{
+  pxObject* o = this;
+  while (o && o->mBoundsValid)
+  {
+    o->mBoundsValid = false;
+    o = o->mParent;
+  }
+}
+
+bool pxObject::isOnScreen()
+{
+  if (!mBoundsValid)
+    return true;
+  return context.isObjectOnScreen(mBoundsX1, mBoundsY1, mBoundsX2 - mBoundsX1, mBoundsY2 - mBoundsY1);
+}
+
 void pxObject::releaseData(bool sceneSuspended)
 {
   clearSnapshot(mClipSnapshotRef);
@@ -1411,7 +1436,8 @@ void pxObject::drawInternal(bool maskPass)
   context.setMatrix(m);
   context.setAlpha(ma);
 
-  if ((mClip && !context.isObjectOnScreen(0,0,w,h)) || mSceneSuspended)
+  if (mSceneSuspended || (mClip && !context.isObjectOnScreen(0,0,w,h)) ||
+      (!maskPass && !isOnScreen()))
   {
     //rtLogInfo("pxObject::drawInternal returning because object is not on screen mw=%f mh=%f\n", mw, mh);
     return;
@@ -1897,7 +1923,7 @@ pxScene2d::pxScene2d(bool top, pxScriptView* scriptView)
 #ifdef PX_DIRTY_RECTANGLES
     mArchive(),mDirtyRect(), mLastFrameDirtyRect(),
 #endif //PX_DIRTY_RECTANGLES
-    mDirty(true), mTestView(NULL), mDisposed(false), mArchiveSet(false)
+    mDirty(true), mAnimationEngine(), mTestView(NULL), mDisposed(false), mArchiveSet(false)
 {
   mRoot = new pxRoot(this);
   #ifdef ENABLE_PXOBJECT_TRACKING
@@ -2408,6 +2434,41 @@ rtError pxScene2d::textureMemoryUsage(rtValue &v)
   return RT_OK;
 }
 
+// Process wide since texture memory is shared by all scenes
+rtError pxScene2d::textureCacheStats(rtObjectRef& v)
+{
+  pxTextureCacheStats stats = gTextureCache.stats();
+  rtObjectRef o = new rtMapObject;
+  o.set("hits", (uint64_t)stats.hits);
+  o.set("misses", (uint64_t)stats.misses);
+  o.set("uploads", (uint64_t)stats.uploads);
+  o.set("reuploads", (uint64_t)stats.reuploads);
+  o.set("ejections", (uint64_t)stats.ejections);
+  o.set("bytesUploaded", stats.bytesUploaded);
+  o.set("bytesEjected", stats.bytesEjected);
+  o.set("residentBytes", stats.residentBytes);
+  o.set("residentTextures", stats.residentTextures);
+  v = o;
+  return RT_OK;
+}
+
+rtError pxScene2d::fontAtlasStats(rtObjectRef& v)
+{
+  rtObjectRef o = new rtMapObject;
+#ifdef PXSCENE_FONT_ATLAS
+  pxFontAtlasStats stats = gFontAtlas.stats();
+  o.set("pages", stats.pages);
+  o.set("glyphs", stats.glyphs);
+  o.set("glyphsAdded", stats.glyphsAdded);
+  o.set("fallbacks", stats.fallbacks);
+  o.set("evictions", stats.evictions);
+  o.set("usedArea", stats.usedArea);
+  o.set("capacity", stats.capacity);
+#endif
+  v = o;
+  return RT_OK;
+}
+
 rtError pxScene2d::clock(double & time)
 {
   time = pxMilliseconds();
@@ -2668,6 +2729,15 @@ void pxScene2d::onUpdate(double t)
     rtLogDebug("%d fps   pxObjects: %d\n", fps, pxObjectCount);
 #endif //USE_RENDER_STATS
 
+    if (gUIThreadQueue)
+    {
+      rtThreadQueueStats queueStats;
+      gUIThreadQueue->stats(queueStats);
+      rtLogDebug("ui queue depth: %u (max %u)   max drain: %.2f ms\n", queueStats.depth,
+                 queueStats.maxDepth, queueStats.maxDrainSeconds*1000);
+      gUIThreadQueue->resetStats();
+    }
+
     {
 #ifdef ENABLE_RT_NODE
       rtWrapperSceneUnlocker unlocker;
@@ -2721,6 +2791,11 @@ void pxScene2d::onDraw()
 
   draw();
 
+  if (mTop)
+  {
+    context.flush();
+  }
+
 #ifdef USE_RENDER_STATS
   sigma_draw += (pxSeconds() - start_draw); //##
 #endif //USE_RENDER_STATS
@@ -2749,6 +2824,7 @@ void pxScene2d::update(double t)
       }
 
 #ifndef DEBUG_SKIP_UPDATE
+      mAnimationEngine.update(t);
       mRoot->update(t);
 #else
       UNUSED_PARAM(t);
@@ -3717,6 +3793,8 @@ rtDefineMethod(pxScene2d, suspend);
 rtDefineMethod(pxScene2d, resume);
 rtDefineMethod(pxScene2d, suspended);
 rtDefineMethod(pxScene2d, textureMemoryUsage);
+rtDefineMethod(pxScene2d, textureCacheStats);
+rtDefineMethod(pxScene2d, fontAtlasStats);
 //rtDefineMethod(pxScene2d, createWayland);
 rtDefineMethod(pxScene2d, addListener);
 rtDefineMethod(pxScene2d, delListener);
@@ -125,6 +125,7 @@ struct animation
   float from;
   float to;
 
+  // initial start time, the running value is owned by pxAnimationEngine
   double start;
   double duration;
 
@@ -132,12 +133,22 @@ struct animation
   
   pxInterp interpFunc;
 
+  // NULL when the property has no typed slot; falls back to set(prop,...)
+  pxAnimationSetter setter;
+  bool repaint;
+
   int32_t count;
   float actualCount;
 
   rtFunctionRef ended;
   rtObjectRef promise;
   rtObjectRef animateObj;
+  rtObjectRef animateParams;
+
+  // owning object and position in the pxAnimationEngine arrays
+  pxObject* object;
+  uint32_t group;
+  uint32_t index;
 };
 
 struct pxPoint2f 
@@ -417,6 +428,11 @@ public:
 
   void cancelAnimation(const char* prop, bool fastforward = false, bool rewind = false);
 
+  // Returns the typed setter used to animate prop or NULL if the property
+  // must go through rtObject::Set (subclasses whose Set has side effects
+  // for a given property should return NULL for it)
+  virtual pxAnimationSetter animationSetter(const char* prop);
+
   rtError addListener(rtString eventName, const rtFunctionRef& f)
   {
     return mEmit->addListener(eventName, f);
@@ -670,6 +686,15 @@ public:
   virtual float getOnscreenWidth() {  return mw; }
   virtual float getOnscreenHeight() { return mh;  }
 
+  // Local space extent touched by this object's own draw(). Returns false
+  // when it is not known, in which case the object is never culled.
+  virtual bool drawBounds(float& x1, float& y1, float& x2, float& y2)
+  {
+    x1 = 0; y1 = 0;
+    x2 = getOnscreenWidth(); y2 = getOnscreenHeight();
+    return true;
+  }
+
   rtError m11(float& v) const { v = mMatrix.constData(0); return RT_OK; }
   rtError m12(float& v) const { v = mMatrix.constData(1); return RT_OK; }
   rtError m13(float& v) const { v = mMatrix.constData(2); return RT_OK; }
@@ -753,9 +778,17 @@ protected:
   pxRect mScreenCoordinates;
   pxRect mDirtyRect;
   //#endif //PX_DIRTY_RECTANGLES
+  // Local space bounds of this object and its subtree, refreshed in update()
+  // and used by drawInternal to skip subtrees that are off screen
+  float mBoundsX1, mBoundsY1, mBoundsX2, mBoundsY2;
+  bool mBoundsValid;
 
   void createSnapshotOfChildren();
   void clearSnapshot(pxContextFramebufferRef fbo);
+  void setAnimatedValue(const animation& a, float v);
+  void updateBounds();
+  void invalidateBounds();
+  bool isOnScreen();
   //#ifdef PX_DIRTY_RECTANGLES
   void setDirtyRect(pxRect* r);
   pxRect getBoundingRectInScreenCoordinates();
@@ -764,7 +797,8 @@ protected:
 
   pxScene2d* mScene;
 
-  std::vector<animation> mAnimations;  
+  // records are owned by mScene->mAnimationEngine
+  std::vector<animation*> mAnimations;
   pxContextFramebufferRef mDrawableSnapshotForMask;
   pxContextFramebufferRef mMaskSnapshot;
   bool mIsDisposed;
@@ -776,6 +810,8 @@ protected:
     return RT_OK;
   }
   void repaintParents();
+
+  friend class pxAnimationEngine;
 };
 
 class pxRoot: public pxObject
@@ -866,6 +902,22 @@ public:
     return RT_OK; 
   }
 
+  // w and h hide the pxObject setters so they must be animated through Set
+  virtual pxAnimationSetter animationSetter(const char* prop) override
+  {
+    if (!strcmp(prop, "w") || !strcmp(prop, "h"))
+      return NULL;
+    return pxObject::animationSetter(prop);
+  }
+
+  // the hosted view is free to draw outside of w/h unless clipped
+  virtual bool drawBounds(float& x1, float& y1, float& x2, float& y2)
+  {
+    if (!mClip)
+      return false;
+    return pxObject::drawBounds(x1, y1, x2, y2);
+  }
+
   rtError onMouseDown(rtObjectRef o)
   {
     rtLogDebug("pxViewContainer::onMouseDown");
@@ -1362,6 +1414,8 @@ public:
   rtMethod1ArgAndReturn("resume", resume, rtValue, bool);
   rtMethodNoArgAndReturn("suspended", suspended, bool);
   rtMethodNoArgAndReturn("textureMemoryUsage", textureMemoryUsage, rtValue);
+  rtMethodNoArgAndReturn("textureCacheStats", textureCacheStats, rtObjectRef);
+  rtMethodNoArgAndReturn("fontAtlasStats", fontAtlasStats, rtObjectRef);
 /*
   rtMethod1ArgAndReturn("createExternal", createExternal, rtObjectRef,
                         rtObjectRef);
@@ -1416,6 +1470,8 @@ public:
   virtual ~pxScene2d()
   {
      rtLogDebug("***** deleting pxScene2d\n");
+    // objects can outlive the scene so detach them from the engine here
+    mAnimationEngine.clear();
     if (mTestView != NULL)
     {
        //delete mTestView; // HACK: Only used in testing... 'delete' causes unknown crash.
@@ -1510,6 +1566,8 @@ public:
   rtError resume(const rtValue& v, bool& b);
   rtError suspended(bool &b);
   rtError textureMemoryUsage(rtValue &v);
+  rtError textureCacheStats(rtObjectRef& v);
+  rtError fontAtlasStats(rtObjectRef& v);
 
   rtError addListener(rtString eventName, const rtFunctionRef& f)
   {
@@ -1760,6 +1818,7 @@ public:
   pxRect mLastFrameDirtyRect;
   //#endif //PX_DIRTY_RECTANGLES
   bool mDirty;
+  pxAnimationEngine mAnimationEngine;
   testView* mTestView;
   bool mDisposed;
   std::vector<rtFunctionRef> mServiceProviders;
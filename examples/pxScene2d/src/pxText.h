@@ -115,11 +115,26 @@ public:
     return e;
   }
 
+  // sx and sy dirty the text in Set so they can not use the typed slot
+  virtual pxAnimationSetter animationSetter(const char* prop) override
+  {
+    if (!strcmp(prop, "sx") || !strcmp(prop, "sy"))
+      return NULL;
+    return pxObject::animationSetter(prop);
+  }
+
   virtual void resourceReady(rtString readyResolution);
   virtual void resourceDirty();
   virtual void sendPromise();
   virtual float getOnscreenWidth();
   virtual float getOnscreenHeight();
+  // Glyphs are not bounded by w/h unless the text is clipped
+  virtual bool drawBounds(float& x1, float& y1, float& x2, float& y2)
+  {
+    if (!mClip)
+      return false;
+    return pxObject::drawBounds(x1, y1, x2, y2);
+  }
   virtual void createNewPromise();
   virtual void dispose(bool pumpJavascript);
   virtual uint64_t textureMemoryUsage();
@@ -50,6 +50,7 @@ pxTextBox::pxTextBox(pxScene2d* s): pxText(s),
                                     mAlignHorizontal(pxConstantsAlignHorizontal::LEFT),
                                     mXStartPos(0),  mXStopPos(0), mLeading(0), 
                                     mWordWrap(false), mEllipsis(false), mInitialized(false), mNeedsRecalc(true),
+                                    mLayoutKey(), mLayoutValid(false),
                                     lineNumber(0), lastLineNumber(0),
                                     noClipX(0), noClipY(0), noClipW(0), noClipH(0), startY(0)
 {
@@ -128,9 +129,48 @@ void pxTextBox::onInit()
   }
 }
 
+pxTextBox::layoutKey pxTextBox::currentLayoutKey() const
+{
+  layoutKey k;
+  k.text            = mText;
+  k.font            = getFontResource();
+  k.pixelSize       = mPixelSize;
+  k.x               = mx;
+  k.y               = my;
+  k.w               = mw;
+  k.h               = mh;
+  k.xStartPos       = mXStartPos;
+  k.xStopPos        = mXStopPos;
+  k.leading         = mLeading;
+  k.truncation      = mTruncation;
+  k.alignVertical   = mAlignVertical;
+  k.alignHorizontal = mAlignHorizontal;
+  k.wordWrap        = mWordWrap;
+  k.ellipsis        = mEllipsis;
+  k.clip            = mClip;
+  return k;
+}
+
+bool pxTextBox::isLayoutCurrent() const
+{
+  return mLayoutValid && mLayoutKey == currentLayoutKey();
+}
+
 void pxTextBox::recalc()
 {
   if( mNeedsRecalc && mInitialized && mFontLoaded) {
+
+    if (isLayoutCurrent())
+    {
+      // nothing the layout depends on has changed; keep the existing
+      // measurements and quads
+      setNeedsRecalc(false);
+      if(clip()) {
+        pxObject::onTextureReady();
+      }
+      mDirty = false;
+      return;
+    }
     
      clearMeasurements();
     
@@ -155,6 +195,8 @@ void pxTextBox::recalc()
       renderText(true);
       mDirty = false;
 
+      mLayoutKey = currentLayoutKey();
+      mLayoutValid = true;
   }
 }
 void pxTextBox::setNeedsRecalc(bool recalc)
@@ -230,8 +272,11 @@ void pxTextBox::draw()
 #ifdef PXSCENE_FONT_ATLAS
   if (mDirty)
   {
-    mQuadsVector.clear();
-    renderText(true);
+    if (!isLayoutCurrent())
+    {
+      mQuadsVector.clear();
+      renderText(true);
+    }
     mDirty = false;
   
   }
@@ -363,7 +408,7 @@ void pxTextBox::measureTextWithWrapOrNewLine(const char *text, float sx, float s
     u_int32_t charToMeasure;
     float charW=0, charH=0;
 
-    rtString accString = "";
+    std::string accString;
     bool lastLine = false;
     float lineWidth = mw;
 
@@ -396,23 +441,35 @@ void pxTextBox::measureTextWithWrapOrNewLine(const char *text, float sx, float s
         }
     }
     
+    // Look up every glyph advance once up front rather than per character
+    vector<float> advances;
+    float lineH = 0;
+    if (getFontResource() != NULL)
+    {
+      getFontResource()->measureTextAdvances(text, size, advances, lineH);
+    }
+
     // Read char by char to determine full line of text before rendering
     int i = 0;
     int lasti = 0;
     int numbytes = 1;
+    size_t charIndex = 0;
     while((charToMeasure = u8_nextchar((char*)text, &i)) != 0)
     {
       // Determine if the character is multibyte
       numbytes = i-lasti;
         
-      std::string tempChar = std::string (&text[lasti], numbytes);
+      char tempChar[8] = {0};
+      memcpy(tempChar, &text[lasti], numbytes < 7 ? numbytes : 7);
         
       lasti = i;
 
-      if (getFontResource() != NULL)
+      if (charIndex < advances.size())
       {
-        getFontResource()->measureTextChar(charToMeasure, size, sx, sy, charW, charH);
+        charW = advances[charIndex];
+        charH = lineH;
       }
+      charIndex++;
     
       bool isContinuousLine = mWordWrap && !isDelimeter_charsPresent;
       bool isEnd = tempX + charW >= mw;
@@ -425,14 +482,15 @@ void pxTextBox::measureTextWithWrapOrNewLine(const char *text, float sx, float s
         // Render what we had so far in accString; since we are here, it will fit.
         if (mTruncation != pxConstantsTruncation::NONE  && !mWordWrap && tempX + charW > mw)
         {
-            renderTextRowWithTruncation(accString, mw, 0, tempY, sx, sy, size, render);
-            accString = "";
+            rtString row(accString.c_str());
+            renderTextRowWithTruncation(row, mw, 0, tempY, sx, sy, size, render);
+            accString.clear();
         }
         else
         {
-            renderOneLine(accString.cString(), 0, tempY, sx, sy, size, lineWidth, render, std::strcmp(tempChar.c_str(), "\n") == 0 ? true : false);
+            renderOneLine(accString.c_str(), 0, tempY, sx, sy, size, lineWidth, render, std::strcmp(tempChar, "\n") == 0 ? true : false);
 
-            accString = (isContinuousLine && isEnd && !isLast) ? tempChar.c_str() : "";
+            accString = (isContinuousLine && isEnd && !isLast) ? tempChar : "";
         }
         tempY += (mLeading*sy) + charH;
 
@@ -444,7 +502,7 @@ void pxTextBox::measureTextWithWrapOrNewLine(const char *text, float sx, float s
       // Check if text still fits on this line, or if wrap needs to occur
       if( (tempX + charW) <= lineWidth || !mWordWrap || (mWordWrap && !isDelimeter_charsPresent && !isLast))
       {
-        accString.append(tempChar.c_str());
+        accString.append(tempChar);
         tempX += charW;
       }
       else
@@ -455,10 +513,11 @@ void pxTextBox::measureTextWithWrapOrNewLine(const char *text, float sx, float s
         if( lastLine || (mTruncation != pxConstantsTruncation::NONE && (tempY + ((mLeading*sy) + charH) >= this->h())) )
         {
           //rtLogDebug("LastLine: Calling renderTextRowWithTruncation with mx=%f for string \"%s\"\n",mx,accString.cString());
-          renderTextRowWithTruncation(accString, lineWidth, 0, tempY, sx, sy, size, render);
+          rtString row(accString.c_str());
+          renderTextRowWithTruncation(row, lineWidth, 0, tempY, sx, sy, size, render);
           tempY += (mLeading*sy) + charH;
           // Clear accString because we've rendered it
-          accString = "";
+          accString.clear();
           break; // break out of reading mText
 
         }
@@ -470,23 +529,24 @@ void pxTextBox::measureTextWithWrapOrNewLine(const char *text, float sx, float s
             lastLineNumber = lineNumber;
             //rtLogDebug("!!!!CLF: calling renderTextRowWithTruncation! %s\n",accString.cString());
             if( mTruncation != pxConstantsTruncation::NONE) {
-              renderTextRowWithTruncation(accString, mw, mx, tempY, sx, sy, size, render);
+              rtString row(accString.c_str());
+              renderTextRowWithTruncation(row, mw, mx, tempY, sx, sy, size, render);
               tempY += (mLeading*sy) + charH;
-              accString = "";
+              accString.clear();
               //break;
             }
             else
             {
               if( clip() )
               {
-                renderOneLine(accString, 0, tempY, sx, sy, size, mw, render);
+                renderOneLine(accString.c_str(), 0, tempY, sx, sy, size, mw, render);
                 tempY += (mLeading*sy) + charH;
-                accString = "";
+                accString.clear();
                 break;
               }
               else
               {
-                accString.append(tempChar.c_str());
+                accString.append(tempChar);
                 tempX += charW;
                 continue;
               }
@@ -495,8 +555,8 @@ void pxTextBox::measureTextWithWrapOrNewLine(const char *text, float sx, float s
           // End special case when !wordWrap but newline found
 
           // Out of space on the current line; find and wrap at word boundary
-          char *tempStr = strdup(accString.cString()); // Should give a copy
-          int    length = accString.length();
+          char *tempStr = strdup(accString.c_str()); // Should give a copy
+          int    length = u8_strlen(tempStr);
           int         n = length-1;
 
           while(!isWordBoundary(tempStr[n]) && n >= 0)
@@ -514,7 +574,7 @@ void pxTextBox::measureTextWithWrapOrNewLine(const char *text, float sx, float s
             free(tempStr);
 
             // Now reset accString to hold remaining text
-            tempStr = strdup(accString.cString());
+            tempStr = strdup(accString.c_str());
             n++;
 
             if( strlen(tempStr+n) > 0)
@@ -533,14 +593,14 @@ void pxTextBox::measureTextWithWrapOrNewLine(const char *text, float sx, float s
             }
             else
             {
-              accString = "";
+              accString.clear();
             }
 
             if( !isSpaceChar(tempChar[0]) || (isSpaceChar(tempChar[0]) && accString.length() != 0))
             {
               //rtLogDebug("space char check to add to string: \"%s\"\n",accString.cString());
               //rtLogDebug("space char check: \"%s\"\n",tempChar);
-              accString.append(tempChar.c_str());
+              accString.append(tempChar);
             }
             
           }
@@ -554,7 +614,7 @@ void pxTextBox::measureTextWithWrapOrNewLine(const char *text, float sx, float s
 
           if (getFontResource() != NULL)
           {
-            getFontResource()->measureTextInternal(accString.cString(), size, sx, sy, charW, charH);
+            getFontResource()->measureTextInternal(accString.c_str(), size, sx, sy, charW, charH);
           }
 
           tempX += charW;
@@ -577,21 +637,23 @@ void pxTextBox::measureTextWithWrapOrNewLine(const char *text, float sx, float s
       lastLineNumber = lineNumber;
       if( mTruncation == pxConstantsTruncation::NONE && !mWordWrap ) {
         //rtLogDebug("CLF! Sending tempX instead of this->w(): %f\n", tempX);
-        renderOneLine(accString.cString(), 0, tempY, sx, sy, size, lineWidth, render);
+        renderOneLine(accString.c_str(), 0, tempY, sx, sy, size, lineWidth, render);
       } else {
         // check if we need to truncate this last line
         if( !lastLine && mXStopPos != 0 && mAlignHorizontal == pxConstantsAlignHorizontal::LEFT
             && mTruncation != pxConstantsTruncation::NONE && mXStopPos > mXStartPos
             && tempX > mw) {
-          renderTextRowWithTruncation(accString, mXStopPos - mx, mx, tempY, sx, sy, size, render);
+          rtString row(accString.c_str());
+          renderTextRowWithTruncation(row, mXStopPos - mx, mx, tempY, sx, sy, size, render);
         }
         else
         {
             if (mTruncation != pxConstantsTruncation::NONE  && !mWordWrap && tempX + charW > mw)
             {
-                renderTextRowWithTruncation(accString, mw, 0, tempY, sx, sy, size, render);
+                rtString row(accString.c_str());
+                renderTextRowWithTruncation(row, mw, 0, tempY, sx, sy, size, render);
             }
-            else renderOneLine(accString.cString(), 0, tempY, sx, sy, size, this->w(), render);
+            else renderOneLine(accString.c_str(), 0, tempY, sx, sy, size, this->w(), render);
         }
       }
 
@@ -1243,20 +1305,48 @@ void pxTextBox::renderTextRowWithTruncation(rtString & accString, float lineWidt
   }
 
  
-    // TODO this looks pretty inefficient... We should revisit...
+  // Measure every prefix of the row in a single pass so the search below
+  // does not re-measure the whole row for each character it drops.
+  vector<float> advances;
+  vector<float> prefixW(1, 0);
+  vector<int> prefixOffset(1, 0);
+  float lineH = 0;
+  if (getFontResource() != NULL)
+  {
+    getFontResource()->measureTextAdvances(tempStr, pixelSize, advances, lineH);
+
+    int j = 0;
+    size_t k = 0;
+    float lw = 0, w = 0;
+    u_int32_t codePoint;
+    while((codePoint = u8_nextchar(tempStr, &j)) != 0)
+    {
+      if (codePoint != '\n')
+        lw += (k < advances.size()) ? advances[k] : 0;
+      else
+        lw = 0;
+      w = pxMax<float>(w, lw);
+      prefixW.push_back(w);
+      prefixOffset.push_back(j);
+      k++;
+    }
+  }
+
   for(int i = length; i > 0; i--)
   {
     // eliminate a utf8 character to see if new string width fits
-    tempStr[u8_offset(tempStr,i)] = '\0';
     charW = 0;
     charH = 0;
     if (getFontResource() != NULL)
     {
-      getFontResource()->measureTextInternal(tempStr, pixelSize, sx, sy, charW, charH);
+      size_t n = (size_t)i < prefixW.size() ? i : prefixW.size()-1;
+      charW = prefixW[n];
+      charH = lineH;
     }
 	
     if( (tempX + charW + ellipsisW) <= lineWidth)
     {
+      tempStr[(size_t)i < prefixOffset.size() ? prefixOffset[i] : u8_offset(tempStr,i)] = '\0';
       float xPos = tempX;
       if( mTruncation == pxConstantsTruncation::TRUNCATE)
       {
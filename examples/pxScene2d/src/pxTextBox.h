@@ -277,6 +277,13 @@ public:
     return e;
   }
 
+  virtual pxAnimationSetter animationSetter(const char* prop) override
+  {
+    if (!strcmp(prop, "w") || !strcmp(prop, "h"))
+      return NULL;
+    return pxText::animationSetter(prop);
+  }
+
 
  protected:
  
@@ -300,6 +307,37 @@ public:
   std::vector<pxTexturedQuads> mQuadsVector;
   #endif
 
+  // Everything the wrap/truncation layout depends on.  Property setters
+  // request a recalc unconditionally; the layout is only redone when one
+  // of these actually differs from the last completed layout.
+  struct layoutKey
+  {
+    layoutKey(): font(NULL), pixelSize(0), x(0), y(0), w(0), h(0),
+                 xStartPos(0), xStopPos(0), leading(0), truncation(0),
+                 alignVertical(0), alignHorizontal(0), wordWrap(false),
+                 ellipsis(false), clip(false) {}
+
+    bool operator==(const layoutKey& o) const
+    {
+      return font == o.font && pixelSize == o.pixelSize && x == o.x && y == o.y &&
+             w == o.w && h == o.h && xStartPos == o.xStartPos && xStopPos == o.xStopPos &&
+             leading == o.leading && truncation == o.truncation &&
+             alignVertical == o.alignVertical && alignHorizontal == o.alignHorizontal &&
+             wordWrap == o.wordWrap && ellipsis == o.ellipsis && clip == o.clip &&
+             text == o.text.cString();
+    }
+
+    rtString text;
+    pxFont* font;
+    uint32_t pixelSize;
+    float x, y, w, h;
+    float xStartPos, xStopPos, leading;
+    uint32_t truncation, alignVertical, alignHorizontal;
+    bool wordWrap, ellipsis, clip;
+  };
+  layoutKey mLayoutKey;
+  bool mLayoutValid;
+
   rtObjectRef measurements;
   uint32_t lineNumber;
   uint32_t lastLineNumber;
@@ -322,6 +360,8 @@ public:
   void renderOneLine(const char * tempStr, float tempX, float tempY, float sx, float sy,  uint32_t size, float lineWidth, bool render, bool isNewLineCase = false);
   
   void recalc();
+  layoutKey currentLayoutKey() const;
+  bool isLayoutCurrent() const;
   void clearMeasurements();
   void setMeasurementBoundsY(bool start, float yVal);
   void setMeasurementBoundsX(bool start, float xVal);  
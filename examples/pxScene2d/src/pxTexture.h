@@ -23,6 +23,7 @@
 #include "rtRef.h"
 #include "pxOffscreen.h"
 #include "rtAtomic.h"
+#include "rtMutex.h"
 
 enum pxTextureType { 
   PX_TEXTURE_UNKNOWN = 0,
@@ -49,11 +50,13 @@ public:
 
 class pxTexture: public pxTextureNative
 {
+  friend class pxTextureCache;
 public:
   pxTexture() : mRef(0), mTextureType(PX_TEXTURE_UNKNOWN), mPremultipliedAlpha(false), mLastRenderTick(0),
-                mDownscaleSmooth(false)
+                mDownscaleSmooth(false), mCachePrev(NULL), mCacheNext(NULL), mCacheBytes(0),
+                mCacheResident(false), mCacheEjected(false)
   { }
-  virtual ~pxTexture() {}
+  inline virtual ~pxTexture();
 
   virtual unsigned long AddRef()
   {
@@ -87,7 +90,7 @@ public:
   void enablePremultipliedAlpha(bool enable) { mPremultipliedAlpha = enable; }
   virtual void* getSurface() { return NULL; }
   uint32_t lastRenderTick() { return mLastRenderTick; }
-  void setLastRenderTick(uint32_t renderTick) { mLastRenderTick = renderTick; }
+  inline void setLastRenderTick(uint32_t renderTick);
   void setDownscaleSmooth(bool downscaleSmooth) { mDownscaleSmooth = downscaleSmooth; }
   bool downscaleSmooth() { return mDownscaleSmooth; }
   bool initialized() { return true; }
@@ -97,8 +100,209 @@ protected:
   bool mPremultipliedAlpha;
   uint32_t mLastRenderTick;
   bool mDownscaleSmooth;
+private:
+  // owned by pxTextureCache
+  pxTexture* mCachePrev;
+  pxTexture* mCacheNext;
+  int64_t mCacheBytes;
+  bool mCacheResident;
+  bool mCacheEjected;
 };
 
 typedef rtRef<pxTexture> pxTextureRef;
 
+struct pxTextureCacheStats
+{
+  pxTextureCacheStats(): hits(0), misses(0), uploads(0), reuploads(0), ejections(0),
+                         bytesUploaded(0), bytesEjected(0), residentBytes(0), residentTextures(0) {}
+
+  uint64_t hits;      // frames a texture was drawn while resident
+  uint64_t misses;    // frames an ejected texture was drawn before it was reloaded
+  uint64_t uploads;
+  uint64_t reuploads; // uploads of a texture that had been ejected before
+  uint64_t ejections;
+  int64_t bytesUploaded;
+  int64_t bytesEjected;
+  int64_t residentBytes;
+  uint32_t residentTextures;
+};
+
+// Textures that currently hold texture memory, most recently drawn first.
+// The list is intrusive so add, remove and touch are O(1), and eject() walks
+// from the least recently drawn end and stops as soon as enough is released.
+class pxTextureCache
+{
+public:
+  pxTextureCache(): mHead(NULL), mTail(NULL), mMutex(), mStats() {}
+
+  // texture now holds bytes of texture memory
+  void add(pxTexture* texture, int64_t bytes)
+  {
+    if (texture == NULL)
+      return;
+    rtMutexLockGuard lock(mMutex);
+    if (texture->mCacheResident)
+    {
+      unlink(texture);
+    }
+    else
+    {
+      mStats.uploads++;
+      mStats.bytesUploaded += bytes;
+      if (texture->mCacheEjected)
+        mStats.reuploads++;
+    }
+    texture->mCacheEjected = false;
+    texture->mCacheResident = true;
+    texture->mCacheBytes = bytes;
+    linkFront(texture);
+  }
+
+  // texture released its texture memory or is going away
+  void remove(pxTexture* texture)
+  {
+    if (texture == NULL)
+      return;
+    rtMutexLockGuard lock(mMutex);
+    if (texture->mCacheResident)
+    {
+      unlink(texture);
+      texture->mCacheResident = false;
+    }
+  }
+
+  void touch(pxTexture* texture)
+  {
+    rtMutexLockGuard lock(mMutex);
+    if (!texture->mCacheResident && !texture->mCacheEjected)
+      return; // never uploaded or not managed by the cache
+    if (texture->mCacheResident)
+    {
+      mStats.hits++;
+      if (mHead != texture)
+      {
+        unlink(texture);
+        linkFront(texture);
+      }
+    }
+    else
+    {
+      mStats.misses++;
+    }
+  }
+
+  // Unloads textures not drawn in the last maxAge ticks, oldest first, until
+  // bytesNeeded have been released.  Returns the number of bytes released.
+  int64_t eject(int64_t bytesNeeded, uint32_t maxAge, uint32_t renderTick, int& numberEjected)
+  {
+    int64_t released = 0;
+    numberEjected = 0;
+    while (released < bytesNeeded)
+    {
+      pxTextureRef texture;
+      {
+        rtMutexLockGuard lock(mMutex);
+        pxTexture* tail = mTail;
+        if (tail == NULL || (renderTick - tail->mLastRenderTick) < maxAge)
+          break;
+        unlink(tail);
+        tail->mCacheResident = false;
+        // a texture whose last reference is gone is already being destroyed
+        // and unloads itself, so it can't be ejected
+        if (!addRefIfAlive(tail))
+          continue;
+        texture = tail;
+        tail->Release();
+        tail->mCacheEjected = true;
+        released += tail->mCacheBytes;
+        mStats.ejections++;
+        mStats.bytesEjected += tail->mCacheBytes;
+      }
+      // unloading calls back into remove() so it can't hold the lock
+      texture->unloadTextureData();
+      numberEjected++;
+    }
+    return released;
+  }
+
+  pxTextureCacheStats stats()
+  {
+    rtMutexLockGuard lock(mMutex);
+    return mStats;
+  }
+
+  void resetStats()
+  {
+    rtMutexLockGuard lock(mMutex);
+    int64_t residentBytes = mStats.residentBytes;
+    uint32_t residentTextures = mStats.residentTextures;
+    mStats = pxTextureCacheStats();
+    mStats.residentBytes = residentBytes;
+    mStats.residentTextures = residentTextures;
+  }
+
+private:
+  static bool addRefIfAlive(pxTexture* texture)
+  {
+    while (true)
+    {
+      int32_t ref = texture->mRef;
+      if (ref <= 0)
+        return false;
+      if (rtAtomicCompareAndSwap(&texture->mRef, ref, ref + 1))
+        return true;
+    }
+  }
+
+  void linkFront(pxTexture* texture)
+  {
+    texture->mCachePrev = NULL;
+    texture->mCacheNext = mHead;
+    if (mHead)
+      mHead->mCachePrev = texture;
+    mHead = texture;
+    if (mTail == NULL)
+      mTail = texture;
+    mStats.residentBytes += texture->mCacheBytes;
+    mStats.residentTextures++;
+  }
+
+  void unlink(pxTexture* texture)
+  {
+    if (texture->mCachePrev)
+      texture->mCachePrev->mCacheNext = texture->mCacheNext;
+    else
+      mHead = texture->mCacheNext;
+    if (texture->mCacheNext)
+      texture->mCacheNext->mCachePrev = texture->mCachePrev;
+    else
+      mTail = texture->mCachePrev;
+    texture->mCachePrev = NULL;
+    texture->mCacheNext = NULL;
+    mStats.residentBytes -= texture->mCacheBytes;
+    mStats.residentTextures--;
+  }
+
+  pxTexture* mHead;
+  pxTexture* mTail;
+  rtMutex mMutex;
+  pxTextureCacheStats mStats;
+};
+
+extern pxTextureCache gTextureCache;
+
+inline pxTexture::~pxTexture()
+{
+  gTextureCache.remove(this);
+}
+
+inline void pxTexture::setLastRenderTick(uint32_t renderTick)
+{
+  if (mLastRenderTick != renderTick)
+  {
+    mLastRenderTick = renderTick;
+    gTextureCache.touch(this);
+  }
+}
+
 #endif //PX_TEXTURE_H
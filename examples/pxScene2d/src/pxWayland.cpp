@@ -419,6 +419,8 @@ void pxWayland::onDraw()
      context.clear( mWidth, mHeight, mClearColor );
   }
 
+  // westeros renders with its own GL calls
+  context.flush();
   WstCompositorComposeEmbedded( mWCtx,
                                 mX,
                                 mY,
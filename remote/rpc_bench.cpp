@@ -0,0 +1,417 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// Measures round trips through rtRemote for each wire format. A server is
+// forked first, then one client process per format, each configured through
+// its own rtremote.conf, runs the same sequence of calls against it over a
+// unix domain socket.
+//
+// The "20 gets" tests read 20 properties per call: one after the other,
+// pipelined with rtRemoteGetAsync(), and as a single rtRemoteBatch.
+//
+// With -l it measures the latency of small calls instead, one client per
+// transport, and prints percentiles of the round trip. The server takes
+// either transport.
+//
+//   rpcBench [-n calls] [-f json|binary|both] [-t socket|shm|both]
+//   rpcBench -l [-n calls] [-t socket|shm|both]
+
+#include "rtRemote.h"
+#include "rtRemoteBatch.h"
+#include "rtRemoteConfig.h"
+#include "rtRemoteEnvironment.h"
+#include <rtObject.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static char const* objectName = "rt.remote.bench";
+static volatile sig_atomic_t running = 1;
+
+class rtBenchObject : public rtObject
+{
+public:
+  rtDeclareObject(rtBenchObject, rtObject);
+  rtProperty(text, text, setText, rtString);
+  rtProperty(count, count, setCount, int32_t);
+  rtMethod2ArgAndReturn("add", add, int32_t, int32_t, int32_t);
+
+  rtBenchObject()
+    : m_count(0)
+  {
+  }
+
+  rtError text(rtString& s) const { s = m_text; return RT_OK; }
+  rtError setText(rtString const& s) { m_text = s; return RT_OK; }
+
+  rtError count(int32_t& n) const { n = m_count; return RT_OK; }
+  rtError setCount(int32_t n) { m_count = n; return RT_OK; }
+
+  rtError add(int32_t x, int32_t y, int32_t& result)
+  {
+    result = x + y;
+    return RT_OK;
+  }
+
+private:
+  rtString  m_text;
+  int32_t   m_count;
+};
+
+rtDefineObject(rtBenchObject, rtObject);
+rtDefineProperty(rtBenchObject, text);
+rtDefineProperty(rtBenchObject, count);
+rtDefineMethod(rtBenchObject, add);
+
+static void onSignal(int /*signo*/)
+{
+  running = 0;
+}
+
+static rtRemoteEnvironment*
+createEnvironment(char const* format, char const* transport)
+{
+  char path[128];
+  snprintf(path, sizeof(path), "/tmp/rpc_bench.%d.conf", static_cast<int>(getpid()));
+
+  FILE* f = fopen(path, "w");
+  if (!f)
+    return nullptr;
+  fprintf(f, "rt.rpc.stream.wire_format=%s\n", format);
+  fprintf(f, "rt.rpc.stream.transport=%s\n", transport);
+  fclose(f);
+
+  rtRemoteEnvironment* env = rtEnvironmentFromFile(path);
+  unlink(path);
+  return env;
+}
+
+static int
+Bench_Server()
+{
+  signal(SIGTERM, onSignal);
+  signal(SIGINT, onSignal);
+
+  rtRemoteEnvironment* env = createEnvironment("binary", "shm");
+  rtError e = rtRemoteInit(env);
+  RT_ASSERT(e == RT_OK);
+
+  rtObjectRef obj(new rtBenchObject());
+  e = rtRemoteRegisterObject(env, objectName, obj);
+  RT_ASSERT(e == RT_OK);
+
+  while (running)
+    rtRemoteRunUntil(env, 100, false);
+
+  rtRemoteShutdown(env);
+  return 0;
+}
+
+static void
+runTest(rtRemoteEnvironment* env, std::string const& format, char const* name, int count,
+  std::function<rtError (int)> const& call)
+{
+  uint64_t bytes = env->BytesSent + env->BytesReceived;
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < count; ++i)
+  {
+    rtError e = call(i);
+    if (e != RT_OK)
+    {
+      rtLogError("%s failed after %d calls. %s", name, i, rtStrError(e));
+      return;
+    }
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  bytes = (env->BytesSent + env->BytesReceived) - bytes;
+
+  printf("%-16s%-16s%12.0f%12.1f%12.1f\n", format.c_str(), name, count / elapsed.count(),
+    elapsed.count() * 1e6 / count, static_cast<double>(bytes) / count);
+  fflush(stdout);
+}
+
+static rtObjectRef
+locateBenchObject(rtRemoteEnvironment* env)
+{
+  rtError e;
+  rtObjectRef obj;
+  while ((e = rtRemoteLocateObject(env, objectName, obj)) != RT_OK)
+    rtLogInfo("failed to find %s:%s", objectName, rtStrError(e));
+  return obj;
+}
+
+static int
+Latency_Client(char const* transport, int count)
+{
+  rtRemoteEnvironment* env = createEnvironment("binary", transport);
+  rtError e = rtRemoteInit(env);
+  RT_ASSERT(e == RT_OK);
+
+  rtObjectRef obj = locateBenchObject(env);
+
+  for (int i = 0; i < 1000; ++i)
+    obj.set("count", i);
+
+  std::vector<uint32_t> nanos;
+  nanos.reserve(count);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; ++i)
+  {
+    auto before = std::chrono::steady_clock::now();
+
+    rtValue sum;
+    e = obj.sendReturns("add", rtValue(i), rtValue(1), sum);
+    if (e != RT_OK)
+    {
+      rtLogError("call failed after %d calls. %s", i, rtStrError(e));
+      break;
+    }
+
+    auto after = std::chrono::steady_clock::now();
+    nanos.push_back(static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count()));
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  if (!nanos.empty())
+  {
+    std::sort(nanos.begin(), nanos.end());
+    auto percentile = [&nanos](double p)
+    {
+      size_t i = static_cast<size_t>(p * (nanos.size() - 1));
+      return nanos[i] / 1000.0;
+    };
+
+    printf("%-10s%10d%12.1f%10.1f%10.1f%10.1f%10.1f%10.1f\n", transport,
+      static_cast<int>(nanos.size()), elapsed.count() * 1e6 / nanos.size(),
+      percentile(0.0), percentile(0.5), percentile(0.99), percentile(0.999), percentile(1.0));
+    fflush(stdout);
+  }
+
+  obj = nullptr;
+  rtRemoteShutdown(env);
+  return 0;
+}
+
+static int
+Bench_Client(char const* format, char const* transport, int count)
+{
+  rtRemoteEnvironment* env = createEnvironment(format, transport);
+  rtError e = rtRemoteInit(env);
+  RT_ASSERT(e == RT_OK);
+
+  rtObjectRef obj = locateBenchObject(env);
+  std::string const label = std::string(format) + "/" + transport;
+
+  // warm up, and let the session settle on its format
+  for (int i = 0; i < 100; ++i)
+    obj.set("count", i);
+
+  runTest(env, label, "call add", count, [&obj](int i)
+  {
+    rtValue sum;
+    return obj.sendReturns("add", rtValue(i), rtValue(i), sum);
+  });
+
+  runTest(env, label, "set count", count, [&obj](int i)
+  {
+    return obj.set("count", i);
+  });
+
+  runTest(env, label, "get count", count, [&obj](int /*i*/)
+  {
+    int32_t n = 0;
+    return obj.get("count", n);
+  });
+
+  runTest(env, label, "set text", count, [&obj](int i)
+  {
+    char buff[64];
+    snprintf(buff, sizeof(buff), "the quick brown fox %d", i);
+    return obj.set("text", buff);
+  });
+
+  runTest(env, label, "get text", count, [&obj](int /*i*/)
+  {
+    rtString s;
+    return obj.get("text", s);
+  });
+
+  // the round trip tests are 20 times the work, keep them about as long
+  int const kReads = 20;
+  int rounds = std::max(1, count / kReads);
+
+  runTest(env, label, "20 gets seq", rounds, [&obj](int /*i*/)
+  {
+    for (int j = 0; j < kReads; ++j)
+    {
+      int32_t n = 0;
+      rtError e = obj.get("count", n);
+      if (e != RT_OK)
+        return e;
+    }
+    return RT_OK;
+  });
+
+  runTest(env, label, "20 gets pipe", rounds, [&obj](int /*i*/)
+  {
+    rtRemoteFuturePtr futures[kReads];
+    for (int j = 0; j < kReads; ++j)
+      futures[j] = rtRemoteGetAsync(obj, "count");
+    for (int j = 0; j < kReads; ++j)
+    {
+      rtError e = futures[j]->wait();
+      if (e != RT_OK)
+        return e;
+    }
+    return RT_OK;
+  });
+
+  runTest(env, label, "20 gets batch", rounds, [&obj](int /*i*/)
+  {
+    rtRemoteBatch batch;
+    rtRemoteFuturePtr futures[kReads];
+    for (int j = 0; j < kReads; ++j)
+      futures[j] = batch.get(obj, "count");
+
+    rtError e = batch.send();
+    for (int j = 0; e == RT_OK && j < kReads; ++j)
+      e = futures[j]->wait();
+    return e;
+  });
+
+  runTest(env, label, "mixed batch", rounds, [&obj](int i)
+  {
+    rtRemoteBatch batch;
+    rtValue args[] = { rtValue(i), rtValue(1) };
+    batch.set(obj, "count", i);
+    rtRemoteFuturePtr count = batch.get(obj, "count");
+    rtRemoteFuturePtr sum = batch.call(obj, "add", 2, args);
+
+    rtError e = batch.send();
+
+    rtValue v;
+    if (e == RT_OK)
+      e = count->get(v);
+    if (e == RT_OK && v.toInt32() != i)
+      e = RT_FAIL;
+    if (e == RT_OK)
+      e = sum->get(v);
+    if (e == RT_OK && v.toInt32() != i + 1)
+      e = RT_FAIL;
+    return e;
+  });
+
+  obj = nullptr;
+  rtRemoteShutdown(env);
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  int count = 0;
+  bool latency = false;
+  std::vector<std::string> formats = { "json", "binary" };
+  std::vector<std::string> transports;
+
+  int c;
+  while ((c = getopt(argc, argv, "n:f:t:l")) != -1)
+  {
+    switch (c)
+    {
+      case 'n':
+        count = static_cast<int>(strtol(optarg, nullptr, 10));
+        break;
+      case 'f':
+        if (strcmp(optarg, "both") != 0)
+          formats = { optarg };
+        break;
+      case 't':
+        if (strcmp(optarg, "both") != 0)
+          transports = { optarg };
+        else
+          transports = { "socket", "shm" };
+        break;
+      case 'l':
+        latency = true;
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-n calls] [-f json|binary|both] [-t socket|shm|both]\n", argv[0]);
+        fprintf(stderr, "       %s -l [-n calls] [-t socket|shm|both]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  // the latency test is there to compare the two
+  if (transports.empty())
+    transports = latency ? std::vector<std::string>{ "socket", "shm" } : std::vector<std::string>{ "socket" };
+  if (count == 0)
+    count = latency ? 1000000 : 10000;
+
+  pid_t server = fork();
+  if (server == 0)
+    return Bench_Server();
+
+  if (latency)
+  {
+    printf("%-10s%10s%12s%10s%10s%10s%10s%10s\n", "transport", "calls", "usec/call",
+      "min", "p50", "p99", "p99.9", "max");
+    fflush(stdout);
+
+    for (std::string const& transport : transports)
+    {
+      pid_t client = fork();
+      if (client == 0)
+        return Latency_Client(transport.c_str(), count);
+      waitpid(client, nullptr, 0);
+    }
+  }
+  else
+  {
+    printf("%-16s%-16s%12s%12s%12s\n", "format", "test", "calls/sec", "usec/call", "bytes/call");
+    fflush(stdout);
+
+    for (std::string const& transport : transports)
+    {
+      for (std::string const& format : formats)
+      {
+        pid_t client = fork();
+        if (client == 0)
+          return Bench_Client(format.c_str(), transport.c_str(), count);
+        waitpid(client, nullptr, 0);
+      }
+    }
+  }
+
+  kill(server, SIGTERM);
+  waitpid(server, nullptr, 0);
+  return 0;
+}
@@ -21,6 +21,7 @@ limitations under the License.
 #include "rtRemoteClient.h"
 #include "rtRemoteConfig.h"
 #include "rtRemoteMessageHandler.h"
+#include "rtRemoteObject.h"
 #include "rtRemoteObjectCache.h"
 #include "rtRemoteServer.h"
 #include "rtRemoteStream.h"
@@ -144,6 +145,33 @@ rtRemoteUnregisterDisconnectedCallback( rtRemoteEnvironment* env, remoteDisconne
     return env->Server->unregisterDisconnectedCallback( cb, cbdata );
 }
 
+rtRemoteFuturePtr
+rtRemoteGetAsync(rtObjectRef const& obj, char const* name)
+{
+  rtRemoteObject* remote = obj ? dynamic_cast<rtRemoteObject *>(obj.getPtr()) : nullptr;
+  if (remote == nullptr || name == nullptr)
+    return rtRemoteFuture::runLocal(obj, rtRemoteFuture::Kind::Get, name, nullptr, 0, nullptr);
+  return remote->getClient()->sendGetAsync(remote->getId(), name);
+}
+
+rtRemoteFuturePtr
+rtRemoteSetAsync(rtObjectRef const& obj, char const* name, rtValue const& value)
+{
+  rtRemoteObject* remote = obj ? dynamic_cast<rtRemoteObject *>(obj.getPtr()) : nullptr;
+  if (remote == nullptr || name == nullptr)
+    return rtRemoteFuture::runLocal(obj, rtRemoteFuture::Kind::Set, name, &value, 0, nullptr);
+  return remote->getClient()->sendSetAsync(remote->getId(), name, value);
+}
+
+rtRemoteFuturePtr
+rtRemoteCallAsync(rtObjectRef const& obj, char const* name, int argc, rtValue const* argv)
+{
+  rtRemoteObject* remote = obj ? dynamic_cast<rtRemoteObject *>(obj.getPtr()) : nullptr;
+  if (remote == nullptr || name == nullptr)
+    return rtRemoteFuture::runLocal(obj, rtRemoteFuture::Kind::Call, name, nullptr, argc, argv);
+  return remote->getClient()->sendCallAsync(remote->getId(), name, argc, argv);
+}
+
 rtError
 rtRemoteRegisterQueueReadyHandler ( rtRemoteEnvironment* env, rtRemoteQueueReady handler, void* argp)
 {
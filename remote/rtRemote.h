@@ -23,6 +23,8 @@ limitations under the License.
 #include <rtObject.h>
 #include <stdint.h>
 
+#include "rtRemoteFuture.h"
+
 #define RT_REMOTE_TIMEOUT_INFINITE UINT32_MAX
 #define RT_REMOTE_API_VERSION 2.0
 #define RT_REMOTE_OLDSTYLE_API 1
@@ -119,6 +121,38 @@ rtRemoteProcessSingleItem(rtRemoteEnvironment* env);
 rtError
 rtRemoteRun(rtRemoteEnvironment* env, uint32_t timeout, bool wait);
 
+/**
+ * Send a property get without waiting for the response. Any number of
+ * requests may be outstanding on the same connection; use rtRemoteBatch to
+ * send several in one message.
+ * @param obj The object, local objects are read right away
+ * @param name The name of the property
+ * @returns a future that resolves to the value of the property
+ */
+rtRemoteFuturePtr
+rtRemoteGetAsync(rtObjectRef const& obj, char const* name);
+
+/**
+ * Send a property set without waiting for the response.
+ * @param obj The object, local objects are updated right away
+ * @param name The name of the property
+ * @param value The new value
+ * @returns a future that resolves to the status of the set
+ */
+rtRemoteFuturePtr
+rtRemoteSetAsync(rtObjectRef const& obj, char const* name, rtValue const& value);
+
+/**
+ * Call a method without waiting for it to return.
+ * @param obj The object, methods of local objects are called right away
+ * @param name The name of the method
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * @returns a future that resolves to the return value of the method
+ */
+rtRemoteFuturePtr
+rtRemoteCallAsync(rtObjectRef const& obj, char const* name, int argc, rtValue const* argv);
+
 rtError rtRemoteInitNs(rtRemoteEnvironment* env);
 rtError rtRemoteShutdownNs(rtRemoteEnvironment* env);
 
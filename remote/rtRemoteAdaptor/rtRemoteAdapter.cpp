@@ -160,7 +160,7 @@ rtError rtRemoteAdapter::processGetByNameRequest(char *payload, rtRemoteMessageP
  *  @return : rtError.
  */
 rtError rtRemoteAdapter::processMethodCallRequest(char *payload, rtRemoteMessagePtr msg, const char *key, const char *obj_id) {
-    vector<rtValue> argv;        
+    rtValueList<8> argv;
     rtValue res;
     rtFunctionRef func;
     rtError err = RT_FAIL; 
@@ -175,10 +175,10 @@ rtError rtRemoteAdapter::processMethodCallRequest(char *payload, rtRemoteMessage
                 for (auto itr = args_itr->value.Begin(); itr != args_itr->value.End(); ++itr) {
                     rtValue arg;
                     rtRemoteValueReader::read(m_env, arg, *itr, NULL);
-                    argv.push_back(arg);
+                    argv.push_back(std::move(arg));
                 }
                 /* Method Call */
-                if(!argv.empty()) {
+                if(argv.size() > 0) {
                     if (m_obj) {
                         err = m_obj.get<rtFunctionRef>(funcName, func);
                     } else {
@@ -186,7 +186,7 @@ rtError rtRemoteAdapter::processMethodCallRequest(char *payload, rtRemoteMessage
                     }
 
                     if (err == RT_OK && !!func) {
-                        err = func->Send(static_cast<int>(argv.size()), (rtValue const*)&argv[0], &res);
+                        err = func->Send(argv.size(), argv.data(), &res);
                         if(err == RT_OK) {
                             createMethodCallResponse(payload, key, obj_id, funcName, res);
                             return err;
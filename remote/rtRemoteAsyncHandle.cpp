@@ -23,10 +23,13 @@ limitations under the License.
 
 #include <chrono>
 
+#include <string.h>
+
 rtRemoteAsyncHandle::rtRemoteAsyncHandle(rtRemoteEnvironment* env, rtRemoteCorrelationKey k)
   : m_env(env)
   , m_key(k)
   , m_error(RT_ERROR_IN_PROGRESS)
+  , m_is_batch(false)
 {
   RT_ASSERT(m_key != rtGuid::null());
   m_env->registerResponseHandler(&rtRemoteAsyncHandle::onResponseHandler_Dispatch,
@@ -126,6 +129,52 @@ rtRemoteAsyncHandle::complete(rtRemoteMessagePtr const& doc, rtError e)
 {
   m_doc = doc;
   m_error = e;
+
+  if (doc && doc->IsObject())
+  {
+    auto itr = doc->FindMember(kFieldNameMessageType);
+    if (itr != doc->MemberEnd() && itr->value.IsString()
+      && strcmp(itr->value.GetString(), kMessageTypeBatchResponse) == 0)
+    {
+      m_is_batch = true;
+      splitBatch(*doc);
+    }
+  }
+}
+
+void
+rtRemoteAsyncHandle::splitBatch(rapidjson::Document const& batch)
+{
+  auto itr = batch.FindMember(kFieldNameBatchMessages);
+  if (itr == batch.MemberEnd() || !itr->value.IsArray())
+  {
+    rtLogWarn("batch response missing %s field", kFieldNameBatchMessages);
+    return;
+  }
+
+  for (rapidjson::Value::ConstValueIterator m = itr->value.Begin(); m != itr->value.End(); ++m)
+  {
+    // a request without a well formed response of its own is treated as if
+    // it got none
+    if (!m->IsObject())
+    {
+      rtLogWarn("malformed response in batch");
+      continue;
+    }
+
+    auto key = m->FindMember(kFieldNameCorrelationKey);
+    auto status = m->FindMember(kFieldNameStatusCode);
+    if (key == m->MemberEnd() || !key->value.IsString()
+      || status == m->MemberEnd() || !status->value.IsInt())
+    {
+      rtLogWarn("malformed response in batch");
+      continue;
+    }
+
+    rtRemoteMessagePtr part(new rapidjson::Document());
+    part->CopyFrom(*m, part->GetAllocator());
+    m_batch[rtGuid::fromString(key->value.GetString())] = part;
+  }
 }
 
 rtRemoteMessagePtr
@@ -133,3 +182,13 @@ rtRemoteAsyncHandle::response() const
 {
   return m_doc;
 }
+
+rtRemoteMessagePtr
+rtRemoteAsyncHandle::response(rtRemoteCorrelationKey const& k) const
+{
+  if (!m_is_batch)
+    return m_doc;
+
+  auto itr = m_batch.find(k);
+  return itr != m_batch.end() ? itr->second : rtRemoteMessagePtr();
+}
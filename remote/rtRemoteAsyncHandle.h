@@ -20,6 +20,7 @@ limitations under the License.
 #define __RT_REMOTE_ASYNC_HANDLE__
 
 #include <functional>
+#include <map>
 
 #include "rtRemoteCorrelationKey.h"
 #include "rtRemoteEnvironment.h"
@@ -35,11 +36,17 @@ public:
   ~rtRemoteAsyncHandle();
 
   rtRemoteMessagePtr response() const;
+
+  // the response to request k. For a batch that's k's part of it, which has
+  // its own document.
+  rtRemoteMessagePtr response(rtRemoteCorrelationKey const& k) const;
+
   rtError waitUntil(uint32_t timeoutInMilliSeconds, std::function<rtError()> connectionState);
 
 private:
   rtRemoteAsyncHandle(rtRemoteEnvironment* env, rtRemoteCorrelationKey k);
   void complete(rtRemoteMessagePtr const& doc, rtError e);
+  void splitBatch(rapidjson::Document const& batch);
 
   static rtError onResponseHandler_Dispatch(std::shared_ptr<rtRemoteClient>& client,
         rtRemoteMessagePtr const& msg, void* argp)
@@ -53,6 +60,11 @@ private:
   rtRemoteCorrelationKey       m_key;
   rtRemoteMessagePtr            m_doc;
   rtError                 m_error;
+  bool                    m_is_batch;
+
+  // a batch response is split once, as it arrives, rather than by every
+  // future waiting on it
+  std::map<rtRemoteCorrelationKey, rtRemoteMessagePtr> m_batch;
 };
 
 
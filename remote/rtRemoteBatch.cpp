@@ -0,0 +1,102 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+
+#include "rtRemoteBatch.h"
+#include "rtRemoteClient.h"
+#include "rtRemoteObject.h"
+
+#include <rtLog.h>
+
+rtRemoteBatch::rtRemoteBatch()
+{
+}
+
+rtRemoteBatch::~rtRemoteBatch()
+{
+  if (!m_requests.empty())
+    rtLogWarn("discarding %d requests that were never sent", static_cast<int>(m_requests.size()));
+}
+
+rtRemoteFuturePtr
+rtRemoteBatch::get(rtObjectRef const& obj, char const* name)
+{
+  return queue(obj, rtRemoteFuture::Kind::Get, name, nullptr, 0, nullptr);
+}
+
+rtRemoteFuturePtr
+rtRemoteBatch::set(rtObjectRef const& obj, char const* name, rtValue const& value)
+{
+  return queue(obj, rtRemoteFuture::Kind::Set, name, &value, 0, nullptr);
+}
+
+rtRemoteFuturePtr
+rtRemoteBatch::call(rtObjectRef const& obj, char const* name, int argc, rtValue const* argv)
+{
+  return queue(obj, rtRemoteFuture::Kind::Call, name, nullptr, argc, argv);
+}
+
+rtRemoteFuturePtr
+rtRemoteBatch::queue(rtObjectRef const& obj, rtRemoteFuture::Kind kind, char const* name,
+  rtValue const* value, int argc, rtValue const* argv)
+{
+  rtRemoteObject* remote = obj ? dynamic_cast<rtRemoteObject *>(obj.getPtr()) : nullptr;
+  if (remote == nullptr || name == nullptr)
+    return rtRemoteFuture::runLocal(obj, kind, name, value, argc, argv);
+
+  if (!m_client)
+  {
+    m_client = remote->getClient();
+  }
+  else if (m_client != remote->getClient())
+  {
+    rtLogError("%s is on a different connection than the rest of the batch", remote->getId().c_str());
+    return rtRemoteFuture::runLocal(rtObjectRef(), kind, name, value, argc, argv);
+  }
+
+  rtRemoteMessagePtr req;
+  switch (kind)
+  {
+    case rtRemoteFuture::Kind::Get:
+      req = m_client->newGetRequest(remote->getId(), name);
+      break;
+    case rtRemoteFuture::Kind::Set:
+      req = m_client->newSetRequest(remote->getId(), name, *value);
+      break;
+    case rtRemoteFuture::Kind::Call:
+      req = m_client->newCallRequest(remote->getId(), name, argc, argv);
+      break;
+  }
+
+  rtRemoteFuturePtr f = m_client->newFuture(req, kind);
+  m_requests.push_back(req);
+  m_futures.push_back(f);
+  return f;
+}
+
+rtError
+rtRemoteBatch::send()
+{
+  if (m_requests.empty())
+    return RT_OK;
+
+  rtError e = m_client->sendBatch(m_requests, m_futures);
+  m_requests.clear();
+  m_futures.clear();
+  return e;
+}
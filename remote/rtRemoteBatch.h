@@ -0,0 +1,77 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+
+#ifndef __RT_REMOTE_BATCH_H__
+#define __RT_REMOTE_BATCH_H__
+
+#include <rtError.h>
+#include <rtObject.h>
+
+#include <memory>
+#include <vector>
+
+#include "rtRemoteFuture.h"
+#include "rtRemoteMessage.h"
+
+class rtRemoteClient;
+
+// Queues property gets, sets and method calls on remote objects and sends
+// them to the server as a single message. The server runs them in order and
+// answers with a single message, so the whole batch costs one round trip.
+//
+//   rtRemoteBatch batch;
+//   rtRemoteFuturePtr width = batch.get(obj, "width");
+//   rtRemoteFuturePtr height = batch.get(obj, "height");
+//   batch.set(obj, "visible", true);
+//   batch.send();
+//   width->get(w);
+//
+// All objects in a batch must have come from the same connection. Requests
+// on local objects are run as they're queued and their futures are ready
+// right away.
+class rtRemoteBatch
+{
+public:
+  rtRemoteBatch();
+  ~rtRemoteBatch();
+
+  rtRemoteBatch(rtRemoteBatch const&) = delete;
+  rtRemoteBatch& operator = (rtRemoteBatch const&) = delete;
+
+  rtRemoteFuturePtr get(rtObjectRef const& obj, char const* name);
+  rtRemoteFuturePtr set(rtObjectRef const& obj, char const* name, rtValue const& value);
+  rtRemoteFuturePtr call(rtObjectRef const& obj, char const* name, int argc, rtValue const* argv);
+
+  // sends everything queued since the last send
+  rtError send();
+
+  inline size_t size() const
+    { return m_requests.size(); }
+
+private:
+  rtRemoteFuturePtr queue(rtObjectRef const& obj, rtRemoteFuture::Kind kind,
+    char const* name, rtValue const* value, int argc, rtValue const* argv);
+
+private:
+  std::shared_ptr<rtRemoteClient>   m_client;
+  std::vector<rtRemoteMessagePtr>   m_requests;
+  std::vector<rtRemoteFuturePtr>    m_futures;
+};
+
+#endif
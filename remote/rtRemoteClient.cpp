@@ -73,6 +73,20 @@ namespace
       }
     }
   }
+
+  // set by captureResponse() while a request of a batch is being processed
+  struct ResponseCapture
+  {
+    ResponseCapture(rtRemoteClient const* client, rtRemoteCorrelationKey const& k)
+      : Client(client)
+      , Key(k) { }
+
+    rtRemoteClient const*   Client;
+    rtRemoteCorrelationKey  Key;
+    rtRemoteMessagePtr      Response;
+  };
+
+  thread_local ResponseCapture* responseCapture = nullptr;
 }
 
 rtRemoteClient::rtRemoteClient(rtRemoteEnvironment* env, int fd,
@@ -99,9 +113,69 @@ rtRemoteClient::~rtRemoteClient()
   }
 }
 
+void
+rtRemoteClient::setWireFormat(rtRemoteWireFormat format)
+{
+  std::shared_ptr<rtRemoteStream> s = getStream();
+  if (s)
+    s->setWireFormat(format);
+}
+
+rtError
+rtRemoteClient::acceptShm()
+{
+  std::shared_ptr<rtRemoteStream> s = getStream();
+  if (!s)
+    return RT_ERROR_STREAM_CLOSED;
+
+  std::vector<int> fds = s->takeReceivedFds();
+  if (fds.empty())
+    return RT_ERROR_INVALID_ARG;
+
+  // only the last set belongs to this request
+  int const n = std::min(static_cast<int>(fds.size()), rtRemoteShmChannel::kNumFds);
+  for (size_t i = 0; i + n < fds.size(); ++i)
+    ::close(fds[i]);
+
+  rtRemoteShmChannelPtr channel;
+  rtError e = rtRemoteShmChannel::attach(&fds[fds.size() - n], n, channel);
+  if (e == RT_OK && !s->hasShm())
+    e = s->attachShm(channel);
+  return e;
+}
+
+rtError
+rtRemoteClient::switchToShm()
+{
+  std::shared_ptr<rtRemoteStream> s = getStream();
+  if (!s)
+    return RT_ERROR_STREAM_CLOSED;
+  return s->switchToShm();
+}
+
+void
+rtRemoteClient::discardReceivedFds()
+{
+  std::shared_ptr<rtRemoteStream> s = getStream();
+  if (!s)
+    return;
+
+  std::vector<int> fds = s->takeReceivedFds();
+  for (int fd : fds)
+    ::close(fd);
+}
+
 rtError
 rtRemoteClient::send(rtRemoteMessagePtr const& msg)
 {
+  ResponseCapture* capture = responseCapture;
+  if (capture && capture->Client == this && !capture->Response
+    && rtMessage_GetCorrelationKey(*msg) == capture->Key)
+  {
+    capture->Response = msg;
+    return RT_OK;
+  }
+
   std::shared_ptr<rtRemoteStream> s = getStream();
   if (!s)
     return RT_ERROR_STREAM_CLOSED;
@@ -201,7 +275,7 @@ rtRemoteClient::connectRpcEndpoint()
 }
 
 rtError
-rtRemoteClient::startSession(std::string const& objectId, uint32_t timeout)
+rtRemoteClient::startSession(std::string const& objectId, uint32_t timeout, rtRemoteTransport transport)
 {
   rtRemoteCorrelationKey k = rtMessage_GetNextCorrelationKey();
 
@@ -211,20 +285,60 @@ rtRemoteClient::startSession(std::string const& objectId, uint32_t timeout)
   req->AddMember(kFieldNameCorrelationKey, k.toString(), req->GetAllocator());
   req->AddMember(kFieldNameObjectId, objectId, req->GetAllocator());
 
+  // ask for the binary encoding. Servers that don't know about it ignore the
+  // field and we keep talking JSON.
+  rtRemoteWireFormat format = rtRemoteWireFormatFromString(m_env->Config->stream_wire_format());
+  if (format != rtRemoteWireFormat::Json)
+    req->AddMember(kFieldNameWireFormat, std::string(rtRemoteWireFormatToString(format)), req->GetAllocator());
+
   std::shared_ptr<rtRemoteStream> s = getStream();
   if (!s)
     return RT_ERROR_STREAM_CLOSED;
 
-  rtRemoteAsyncHandle handle = s->sendWithWait(req, k);
+  // the shared memory channel is ours to create. Its fds go along with the
+  // request, which means a unix domain socket, and it's attached before the
+  // request goes out since the server switches as soon as it has answered.
+  rtRemoteShmChannelPtr shm;
+  if (transport == rtRemoteTransport::Shm
+    && rtRemoteTransportFromString(m_env->Config->stream_transport()) == rtRemoteTransport::Shm
+    && s->getRemoteEndpoint().ss_family == AF_UNIX
+    && !s->hasShm())
+  {
+    rtError e = rtRemoteShmChannel::create(m_env->Config->stream_shm_ring_size(),
+      m_env->Config->stream_socket_buffer_size(), shm);
+    if (e == RT_OK)
+      e = s->attachShm(shm);
+    if (e == RT_OK)
+      req->AddMember(kFieldNameTransport, std::string(kTransportShm), req->GetAllocator());
+    else
+      shm.reset();
+  }
+
+  rtRemoteAsyncHandle handle = shm
+    ? s->sendWithWait(req, k, shm->fds(), rtRemoteShmChannel::kNumFds)
+    : s->sendWithWait(req, k);
   rtError e = handle.waitUntil(timeout, [this] { return checkStream(); });
   if (e != RT_OK)
     rtLogDebug("e: %s", rtStrError(e));
 
+  bool useShm = false;
   if (e == RT_OK)
   {
     rtRemoteMessagePtr res = handle.response();
+    char const* accepted = res ? rtMessage_GetWireFormat(*res) : nullptr;
+    if (accepted != nullptr)
+      s->setWireFormat(rtRemoteWireFormatFromString(accepted));
+
+    char const* acceptedTransport = res ? rtMessage_GetTransport(*res) : nullptr;
+    useShm = shm && acceptedTransport != nullptr
+      && rtRemoteTransportFromString(acceptedTransport) == rtRemoteTransport::Shm;
   }
 
+  if (useShm)
+    e = s->switchToShm();
+  else if (shm)
+    s->detachShm();
+
   return e;
 }
 
@@ -282,8 +396,8 @@ rtRemoteClient::sendKeepAlive()
   return s->send(msg);
 }
 
-rtError
-rtRemoteClient::sendSet(std::string const& objectId, char const* propertyName, rtValue const& value)
+rtRemoteMessagePtr
+rtRemoteClient::newSetRequest(std::string const& objectId, char const* propertyName, rtValue const& value)
 {
   rtRemoteCorrelationKey k = rtMessage_GetNextCorrelationKey();
 
@@ -294,8 +408,46 @@ rtRemoteClient::sendSet(std::string const& objectId, char const* propertyName, r
   req->AddMember(kFieldNamePropertyName, std::string(propertyName), req->GetAllocator());
   req->AddMember(kFieldNameCorrelationKey, k.toString(), req->GetAllocator());
   addValue(req, m_env, value);
+  return req;
+}
 
-  return sendSet(req, k);
+rtRemoteMessagePtr
+rtRemoteClient::newGetRequest(std::string const& objectId, char const* propertyName)
+{
+  rtRemoteCorrelationKey k = rtMessage_GetNextCorrelationKey();
+
+  rtRemoteMessagePtr req(new rapidjson::Document());
+  req->SetObject();
+  req->AddMember(kFieldNameMessageType, kMessageTypeGetByNameRequest, req->GetAllocator());
+  req->AddMember(kFieldNameObjectId, objectId, req->GetAllocator());
+  req->AddMember(kFieldNamePropertyName, std::string(propertyName), req->GetAllocator());
+  req->AddMember(kFieldNameCorrelationKey, k.toString(), req->GetAllocator());
+  return req;
+}
+
+rtRemoteMessagePtr
+rtRemoteClient::newCallRequest(std::string const& objectId, std::string const& methodName,
+  int argc, rtValue const* argv)
+{
+  rtRemoteCorrelationKey k = rtMessage_GetNextCorrelationKey();
+
+  rtRemoteMessagePtr req(new rapidjson::Document());
+  req->SetObject();
+  req->AddMember(kFieldNameMessageType, kMessageTypeMethodCallRequest, req->GetAllocator());
+  req->AddMember(kFieldNameObjectId, objectId, req->GetAllocator());
+  req->AddMember(kFieldNameCorrelationKey, k.toString(), req->GetAllocator());
+  req->AddMember(kFieldNameFunctionName, methodName, req->GetAllocator());
+  
+  for (int i = 0; i < argc; ++i)
+    addArgument(req, m_env, argv[i]);
+  return req;
+}
+
+rtError
+rtRemoteClient::sendSet(std::string const& objectId, char const* propertyName, rtValue const& value)
+{
+  rtRemoteMessagePtr req = newSetRequest(objectId, propertyName, value);
+  return sendSet(req, rtMessage_GetCorrelationKey(*req));
 }
 
 rtError
@@ -321,36 +473,16 @@ rtRemoteClient::sendSet(rtRemoteMessagePtr const& req, rtRemoteCorrelationKey k)
   if (!s)
     return RT_ERROR_STREAM_CLOSED;
 
+  rtValue unused;
   rtRemoteAsyncHandle handle = s->sendWithWait(req, k);
-
-  rtError e = handle.waitUntil(0, [this] { return checkStream(); });
-  if (e == RT_OK)
-  {
-    rtRemoteMessagePtr res = handle.response();
-    if (!res)
-    {
-      rtLogError("sendSet: no response. RT_ERROR_PROTOCOL_ERROR");
-      return RT_ERROR_PROTOCOL_ERROR;
-    }
-
-    e = rtMessage_GetStatusCode(*res);
-  }
-  return e;
+  return waitForResponse(handle, k, rtRemoteFuture::Kind::Set, 0, unused);
 }
 
 rtError
 rtRemoteClient::sendGet(std::string const& objectId, char const* propertyName, rtValue& result)
 {
-  rtRemoteCorrelationKey k = rtMessage_GetNextCorrelationKey();
-
-  rtRemoteMessagePtr req(new rapidjson::Document());
-  req->SetObject();
-  req->AddMember(kFieldNameMessageType, kMessageTypeGetByNameRequest, req->GetAllocator());
-  req->AddMember(kFieldNameObjectId, objectId, req->GetAllocator());
-  req->AddMember(kFieldNamePropertyName, std::string(propertyName), req->GetAllocator());
-  req->AddMember(kFieldNameCorrelationKey, k.toString(), req->GetAllocator());
-
-  return sendGet(req, k, result);
+  rtRemoteMessagePtr req = newGetRequest(objectId, propertyName);
+  return sendGet(req, rtMessage_GetCorrelationKey(*req), result);
 }
 
 rtError
@@ -376,52 +508,15 @@ rtRemoteClient::sendGet(rtRemoteMessagePtr const& req, rtRemoteCorrelationKey k,
     return RT_ERROR_STREAM_CLOSED;
 
   rtRemoteAsyncHandle handle = s->sendWithWait(req, k);
-
-  rtError e = handle.waitUntil(0, [this] { return checkStream(); });
-  if (e == RT_OK)
-  {
-    rtRemoteMessagePtr res = handle.response();
-    if (!res)
-    {
-      rtLogError("sendGet: no response. RT_ERROR_PROTOCOL_ERROR");
-      return RT_ERROR_PROTOCOL_ERROR;
-    }
-    rtError statusCode = rtMessage_GetStatusCode(*res);
-    if (statusCode != RT_OK)
-    {
-       return statusCode;
-    }
-    auto itr = res->FindMember(kFieldNameValue);
-    if (itr == res->MemberEnd())
-    {
-      rtLogError("sendGet: failed to find member '%s' in response. RT_ERROR_PROTOCOL_ERROR", kFieldNameValue);
-      return RT_ERROR_PROTOCOL_ERROR;
-    }
-
-    e = rtRemoteValueReader::read(m_env, value, itr->value, shared_from_this());
-    if (e == RT_OK)
-      e = rtMessage_GetStatusCode(*res);
-  }
-  return e;
+  return waitForResponse(handle, k, rtRemoteFuture::Kind::Get, 0, value);
 }
 
 rtError
 rtRemoteClient::sendCall(std::string const& objectId, std::string const& methodName,
   int argc, rtValue const* argv, rtValue& result)
 {
-  rtRemoteCorrelationKey k = rtMessage_GetNextCorrelationKey();
-
-  rtRemoteMessagePtr req(new rapidjson::Document());
-  req->SetObject();
-  req->AddMember(kFieldNameMessageType, kMessageTypeMethodCallRequest, req->GetAllocator());
-  req->AddMember(kFieldNameObjectId, objectId, req->GetAllocator());
-  req->AddMember(kFieldNameCorrelationKey, k.toString(), req->GetAllocator());
-  req->AddMember(kFieldNameFunctionName, methodName, req->GetAllocator());
-  
-  for (int i = 0; i < argc; ++i)
-    addArgument(req, m_env, argv[i]);
-  
-  return sendCall(req, k, result);
+  rtRemoteMessagePtr req = newCallRequest(objectId, methodName, argc, argv);
+  return sendCall(req, rtMessage_GetCorrelationKey(*req), result);
 }
 
 rtError
@@ -432,28 +527,182 @@ rtRemoteClient::sendCall(rtRemoteMessagePtr const& req, rtRemoteCorrelationKey k
     return RT_ERROR_STREAM_CLOSED;
 
   rtRemoteAsyncHandle handle = s->sendWithWait(req, k);
+  return waitForResponse(handle, k, rtRemoteFuture::Kind::Call, 0, result);
+}
 
-  rtError e = handle.waitUntil(0, [this] { return checkStream(); });
-  if (e == RT_OK)
+rtRemoteFuturePtr
+rtRemoteClient::sendGetAsync(std::string const& objectId, char const* propertyName)
+{
+  return sendAsync(newGetRequest(objectId, propertyName), rtRemoteFuture::Kind::Get);
+}
+
+rtRemoteFuturePtr
+rtRemoteClient::sendSetAsync(std::string const& objectId, char const* propertyName, rtValue const& value)
+{
+  return sendAsync(newSetRequest(objectId, propertyName, value), rtRemoteFuture::Kind::Set);
+}
+
+rtRemoteFuturePtr
+rtRemoteClient::sendCallAsync(std::string const& objectId, std::string const& methodName,
+  int argc, rtValue const* argv)
+{
+  return sendAsync(newCallRequest(objectId, methodName, argc, argv), rtRemoteFuture::Kind::Call);
+}
+
+rtRemoteFuturePtr
+rtRemoteClient::sendAsync(rtRemoteMessagePtr const& req, rtRemoteFuture::Kind kind)
+{
+  rtRemoteFuturePtr f = newFuture(req, kind);
+
+  std::shared_ptr<rtRemoteStream> s = getStream();
+  if (!s)
+    f->complete(RT_ERROR_STREAM_CLOSED);
+  else
+    f->bind(s->sendAsync(req, f->m_key));
+  return f;
+}
+
+rtRemoteFuturePtr
+rtRemoteClient::newFuture(rtRemoteMessagePtr const& req, rtRemoteFuture::Kind kind)
+{
+  return rtRemoteFuturePtr(new rtRemoteFuture(shared_from_this(),
+    rtMessage_GetCorrelationKey(*req), kind));
+}
+
+rtError
+rtRemoteClient::sendBatch(std::vector<rtRemoteMessagePtr> const& requests,
+  std::vector<rtRemoteFuturePtr> const& futures)
+{
+  RT_ASSERT(requests.size() == futures.size());
+
+  rtRemoteCorrelationKey k = rtMessage_GetNextCorrelationKey();
+
+  rtRemoteMessagePtr batch(new rapidjson::Document());
+  batch->SetObject();
+  batch->AddMember(kFieldNameMessageType, kMessageTypeBatchRequest, batch->GetAllocator());
+  batch->AddMember(kFieldNameCorrelationKey, k.toString(), batch->GetAllocator());
+
+  rapidjson::Value messages(rapidjson::kArrayType);
+  messages.Reserve(static_cast<rapidjson::SizeType>(requests.size()), batch->GetAllocator());
+  for (rtRemoteMessagePtr const& req : requests)
   {
-    rtRemoteMessagePtr res = handle.response();
-    if (!res)
+    rapidjson::Value m;
+    m.CopyFrom(*req, batch->GetAllocator());
+    messages.PushBack(m, batch->GetAllocator());
+  }
+  batch->AddMember(kFieldNameBatchMessages, messages, batch->GetAllocator());
+
+  std::shared_ptr<rtRemoteStream> s = getStream();
+  if (!s)
+  {
+    for (rtRemoteFuturePtr const& f : futures)
+      f->complete(RT_ERROR_STREAM_CLOSED);
+    return RT_ERROR_STREAM_CLOSED;
+  }
+
+  // every future in the batch waits on the one response
+  std::shared_ptr<rtRemoteAsyncHandle> handle = s->sendAsync(batch, k);
+  for (rtRemoteFuturePtr const& f : futures)
+    f->bind(handle);
+
+  return RT_OK;
+}
+
+rtError
+rtRemoteClient::captureResponse(rtRemoteCorrelationKey k, std::function<rtError ()> const& func,
+  rtRemoteMessagePtr& res)
+{
+  ResponseCapture capture(this, k);
+
+  // anything else sent while func runs, a call back into the client for
+  // instance, goes out as usual
+  ResponseCapture* prev = responseCapture;
+  responseCapture = &capture;
+  rtError e = func();
+  responseCapture = prev;
+
+  res = capture.Response;
+  return e;
+}
+
+rtError
+rtRemoteClient::waitForResponse(rtRemoteAsyncHandle& handle, rtRemoteCorrelationKey k,
+  rtRemoteFuture::Kind kind, uint32_t timeout, rtValue& value)
+{
+  rtError e = handle.waitUntil(timeout, [this] { return checkStream(); });
+  if (e != RT_OK)
+    return e;
+
+  // ours alone if it was part of a batch
+  rtRemoteMessagePtr res = handle.response(k);
+  return readResponse(res, kind, value);
+}
+
+rtError
+rtRemoteClient::readResponse(rtRemoteMessagePtr const& res, rtRemoteFuture::Kind kind, rtValue& value)
+{
+  rtError e = RT_OK;
+
+  switch (kind)
+  {
+    case rtRemoteFuture::Kind::Set:
     {
-      rtLogError("sendCall: no response. RT_ERROR_PROTOCOL_ERROR");
-      return RT_ERROR_PROTOCOL_ERROR;
+      if (!res)
+      {
+        rtLogError("sendSet: no response. RT_ERROR_PROTOCOL_ERROR");
+        return RT_ERROR_PROTOCOL_ERROR;
+      }
+      e = rtMessage_GetStatusCode(*res);
     }
+    break;
 
-    auto itr = res->FindMember(kFieldNameFunctionReturn);
-    if (itr == res->MemberEnd())
+    case rtRemoteFuture::Kind::Get:
     {
-      rtLogError("sendCall: failed to find member '%s' in response. RT_ERROR_PROTOCOL_ERROR", kFieldNameFunctionReturn);
-      return RT_ERROR_PROTOCOL_ERROR;
+      if (!res)
+      {
+        rtLogError("sendGet: no response. RT_ERROR_PROTOCOL_ERROR");
+        return RT_ERROR_PROTOCOL_ERROR;
+      }
+      rtError statusCode = rtMessage_GetStatusCode(*res);
+      if (statusCode != RT_OK)
+      {
+         return statusCode;
+      }
+      auto itr = res->FindMember(kFieldNameValue);
+      if (itr == res->MemberEnd())
+      {
+        rtLogError("sendGet: failed to find member '%s' in response. RT_ERROR_PROTOCOL_ERROR", kFieldNameValue);
+        return RT_ERROR_PROTOCOL_ERROR;
+      }
+
+      e = rtRemoteValueReader::read(m_env, value, itr->value, shared_from_this());
+      if (e == RT_OK)
+        e = rtMessage_GetStatusCode(*res);
     }
+    break;
 
-    e = rtRemoteValueReader::read(m_env, result, itr->value, shared_from_this());
-    if (e == RT_OK)
-      e = rtMessage_GetStatusCode(*res);
+    case rtRemoteFuture::Kind::Call:
+    {
+      if (!res)
+      {
+        rtLogError("sendCall: no response. RT_ERROR_PROTOCOL_ERROR");
+        return RT_ERROR_PROTOCOL_ERROR;
+      }
+
+      auto itr = res->FindMember(kFieldNameFunctionReturn);
+      if (itr == res->MemberEnd())
+      {
+        rtLogError("sendCall: failed to find member '%s' in response. RT_ERROR_PROTOCOL_ERROR", kFieldNameFunctionReturn);
+        return RT_ERROR_PROTOCOL_ERROR;
+      }
+
+      e = rtRemoteValueReader::read(m_env, value, itr->value, shared_from_this());
+      if (e == RT_OK)
+        e = rtMessage_GetStatusCode(*res);
+    }
+    break;
   }
+
   return e;
 }
 
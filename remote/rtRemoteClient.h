@@ -30,10 +30,14 @@ limitations under the License.
 #include <rtError.h>
 #include <rtValue.h>
 
+#include <functional>
+#include <vector>
+
 #include <sys/socket.h>
 
 #include "rtRemoteCorrelationKey.h"
 #include "rtRemoteEnvironment.h"
+#include "rtRemoteFuture.h"
 #include "rtRemoteMessage.h"
 #include "rtRemoteSocketUtils.h"
 #include "rtRemoteStream.h"
@@ -59,7 +63,10 @@ public:
   ~rtRemoteClient();
 
   rtError open();
-  rtError startSession(std::string const& objectId, uint32_t timeout = 0);
+  // transport is what the resolver says the server accepts. The shared
+  // memory transport is only asked for when it's also configured here.
+  rtError startSession(std::string const& objectId, uint32_t timeout = 0,
+    rtRemoteTransport transport = rtRemoteTransport::Socket);
 
   rtError sendSet(std::string const& objectId, uint32_t    propertyIdx , rtValue const& value);
   rtError sendSet(std::string const& objectId, char const* propertyName, rtValue const& value);
@@ -68,6 +75,29 @@ public:
   rtError sendCall(std::string const& objectId, std::string const& methodName,
     int argc, rtValue const* argv, rtValue& result);
 
+  // pipelined versions of the above. The request is sent right away and the
+  // future resolves when its response arrives.
+  rtRemoteFuturePtr sendGetAsync(std::string const& objectId, char const* propertyName);
+  rtRemoteFuturePtr sendSetAsync(std::string const& objectId, char const* propertyName, rtValue const& value);
+  rtRemoteFuturePtr sendCallAsync(std::string const& objectId, std::string const& methodName,
+    int argc, rtValue const* argv);
+
+  // batches. Requests built with newXXXRequest() are queued by the caller
+  // along with a future from newFuture(), then sendBatch() sends them all in
+  // one message. The server answers with one message carrying every response.
+  rtRemoteMessagePtr newGetRequest(std::string const& objectId, char const* propertyName);
+  rtRemoteMessagePtr newSetRequest(std::string const& objectId, char const* propertyName, rtValue const& value);
+  rtRemoteMessagePtr newCallRequest(std::string const& objectId, std::string const& methodName,
+    int argc, rtValue const* argv);
+  rtRemoteFuturePtr newFuture(rtRemoteMessagePtr const& req, rtRemoteFuture::Kind kind);
+  rtError sendBatch(std::vector<rtRemoteMessagePtr> const& requests,
+    std::vector<rtRemoteFuturePtr> const& futures);
+
+  // runs func and, instead of sending it, returns the response it sends for
+  // request k from this thread. Used by the server to answer a batch.
+  rtError captureResponse(rtRemoteCorrelationKey k, std::function<rtError ()> const& func,
+    rtRemoteMessagePtr& res);
+
   void registerKeepAliveForObject(std::string const& s);
   rtError setStateChangedHandler(StateChangedHandler handler, void* argp);
 
@@ -77,14 +107,26 @@ public:
     { return m_env; }
 
   rtError send(rtRemoteMessagePtr const& msg);
+  void setWireFormat(rtRemoteWireFormat format);
+
+  // server side of the shared memory handshake. acceptShm() maps the channel
+  // the client sent with its session request, switchToShm() moves our
+  // outgoing frames onto it once the response has gone out.
+  rtError acceptShm();
+  rtError switchToShm();
+  void discardReceivedFds();
 
   sockaddr_storage getRemoteEndpoint() const;
   sockaddr_storage getLocalEndpoint() const;
 
 private:
+  friend class rtRemoteFuture;
+
   rtError sendGet(rtRemoteMessagePtr const& req, rtRemoteCorrelationKey k, rtValue& value);
   rtError sendSet(rtRemoteMessagePtr const& req, rtRemoteCorrelationKey k);
   rtError sendCall(rtRemoteMessagePtr const& req, rtRemoteCorrelationKey k, rtValue& result); 
+  rtRemoteFuturePtr sendAsync(rtRemoteMessagePtr const& req, rtRemoteFuture::Kind kind);
+  rtError readResponse(rtRemoteMessagePtr const& res, rtRemoteFuture::Kind kind, rtValue& value);
 
   // from rtRemoteStream::CallbackHandler
   virtual rtError onMessage(rtRemoteMessagePtr const& msg);
@@ -98,7 +140,8 @@ private:
     { return reinterpret_cast<rtRemoteClient *>(argp)->onSynchronousResponse(client, msg); }
 
   rtError onStartSession(rtRemoteMessagePtr const& doc);
-  rtError waitForResponse(rtRemoteCorrelationKey k, rtRemoteMessagePtr& res, int timeout);
+  rtError waitForResponse(rtRemoteAsyncHandle& handle, rtRemoteCorrelationKey k,
+    rtRemoteFuture::Kind kind, uint32_t timeout, rtValue& value);
   rtError onSynchronousResponse(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& doc);
   // rtError sendSynchronousRequest(rtRemoteMessagePtr const& req, rtRemoteMessagePtr& res, int timeout);
   // bool moreToProcess(rtRemoteCorrelationKey k);
@@ -30,6 +30,8 @@ rtRemoteEnvironment::rtRemoteEnvironment(rtRemoteConfig* config)
   , StreamSelector(nullptr)
   , RefCount(1)
   , Initialized(false)
+  , BytesSent(0)
+  , BytesReceived(0)
   , m_running(false)
   , m_queue_ready_handler(nullptr)
   , m_queue_ready_context(nullptr)
@@ -202,7 +204,19 @@ rtRemoteEnvironment::processSingleWorkItem(std::chrono::milliseconds timeout, bo
   if (!wait && m_queue.empty() && m_specific_workitem_map.empty())
     return RT_ERROR_QUEUE_EMPTY;
 
-  if (!m_queue_cond.wait_until(lock, delay, [this] { return !this->m_queue.empty() || !this->m_specific_workitem_map.empty() || !m_running; }))
+  // only wake for work this caller can take, a response another thread is
+  // waiting on would otherwise have every caller spinning until it's picked up
+  auto ready = [this, specificKey]
+  {
+    if (!m_queue.empty() || !m_running)
+      return true;
+    if (!specificKey)
+      return false;
+    return m_specific_workitem_map.find(*specificKey) != m_specific_workitem_map.end()
+      || m_response_handlers.find(*specificKey) == m_response_handlers.end();
+  };
+
+  if (!m_queue_cond.wait_until(lock, delay, ready))
   {
     e = RT_ERROR_TIMEOUT;
   }
@@ -264,6 +278,11 @@ rtRemoteEnvironment::processSingleWorkItem(std::chrono::milliseconds timeout, bo
       lock.unlock();
       m_queue_cond.notify_all();
     }
+    else if (messageHandler != nullptr)
+    {
+      // the caller waiting on k may be blocked in here too
+      m_queue_cond.notify_all();
+    }
   }
 
   return e;
@@ -281,10 +300,11 @@ rtRemoteEnvironment::enqueueWorkItem(std::shared_ptr<rtRemoteClient> const& clnt
 
 
   // If someone is waiting for this message, then store it to a specific map
-  // Otherwise, put it to a queue
+  // Otherwise, put it to a queue. Dispatch threads only take from the queue
+  // and the waiter doesn't, so with them everything is queued.
   rtRemoteCorrelationKey const k = rtMessage_GetCorrelationKey(*workItem.Message);
   auto itr = m_response_handlers.find(k);
-  if (itr != m_response_handlers.end())
+  if (itr != m_response_handlers.end() && !Config->server_use_dispatch_thread())
   {
     m_specific_workitem_map.insert(WorkItemMap::value_type(k, workItem));
     lock.unlock();
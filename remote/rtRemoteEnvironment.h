@@ -23,6 +23,7 @@ limitations under the License.
 #include "rtRemoteCorrelationKey.h"
 #include "rtRemoteMessageHandler.h"
 
+#include <atomic>
 #include <condition_variable>
 #include <map>
 #include <mutex>
@@ -58,6 +59,10 @@ public:
   uint32_t RefCount;
   bool     Initialized;
 
+  // traffic on rpc streams, including the length prefix of each message
+  std::atomic<uint64_t> BytesSent;
+  std::atomic<uint64_t> BytesReceived;
+
   void registerQueueReadyHandler(rtRemoteQueueReady handler, void* argp);
   void registerResponseHandler(rtRemoteMessageHandler handler, void* argp, rtRemoteCorrelationKey const& k);
   void removeResponseHandler(rtRemoteCorrelationKey const& k);
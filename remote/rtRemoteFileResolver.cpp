@@ -154,6 +154,8 @@ rtRemoteFileResolver::registerObject(std::string const& name, sockaddr_storage c
 
   rapidjson::Pointer("/" + name + "/" + kFieldNameIp).Set(doc, m_rpc_addr);
   rapidjson::Pointer("/" + name + "/" + kFieldNamePort).Set(doc, m_rpc_port);
+  rapidjson::Pointer("/" + name + "/" + kFieldNameTransport).Set(doc,
+    rtRemoteTransportToString(rtRemoteTransportFromString(m_env->Config->stream_transport())));
 
   // write updated json back to file
   buff[0] = '\0';
@@ -169,8 +171,18 @@ rtRemoteFileResolver::registerObject(std::string const& name, sockaddr_storage c
 
 rtError
 rtRemoteFileResolver::locateObject(std::string const& name, sockaddr_storage& endpoint,
-    uint32_t)
+    uint32_t timeout)
 {
+  rtRemoteTransport transport;
+  return locateObject(name, endpoint, timeout, transport);
+}
+
+rtError
+rtRemoteFileResolver::locateObject(std::string const& name, sockaddr_storage& endpoint,
+    uint32_t, rtRemoteTransport& transport)
+{
+  transport = rtRemoteTransport::Socket;
+
   if (m_db_fp == nullptr)
   {
     rtLogError("no database connection");
@@ -198,6 +210,11 @@ rtRemoteFileResolver::locateObject(std::string const& name, sockaddr_storage& en
   rtError err = rtParseAddress(endpoint, ip->GetString(), port->GetInt(), nullptr);
   if (err != RT_OK)
     return err;
+
+  // records written before transports were advertised don't have one
+  rapidjson::Value *advertised = rapidjson::Pointer("/" + name + "/" + kFieldNameTransport).Get(doc);
+  if (advertised && advertised->IsString())
+    transport = rtRemoteTransportFromString(advertised->GetString());
     
   return RT_OK;
 }
@@ -43,6 +43,8 @@ public:
   virtual rtError registerObject(std::string const& name, sockaddr_storage const& endpoint) override;
   virtual rtError locateObject(std::string const& name, sockaddr_storage& endpoint,
     uint32_t timeout) override;
+  virtual rtError locateObject(std::string const& name, sockaddr_storage& endpoint,
+    uint32_t timeout, rtRemoteTransport& transport) override;
   virtual rtError unregisterObject(std::string const& name) override;
 
 private:
@@ -0,0 +1,120 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+
+#include "rtRemoteFuture.h"
+#include "rtRemoteAsyncHandle.h"
+#include "rtRemoteClient.h"
+
+#include <rtLog.h>
+
+rtRemoteFuture::rtRemoteFuture(std::shared_ptr<rtRemoteClient> const& client,
+  rtRemoteCorrelationKey k, Kind kind)
+  : m_client(client)
+  , m_key(k)
+  , m_kind(kind)
+  , m_done(false)
+  , m_error(RT_ERROR_INVALID_OPERATION)
+{
+}
+
+rtRemoteFuture::rtRemoteFuture(Kind kind, rtError e, rtValue const& value)
+  : m_key(kInvalidCorrelationKey)
+  , m_kind(kind)
+  , m_done(true)
+  , m_error(e)
+  , m_value(value)
+{
+}
+
+rtRemoteFuture::~rtRemoteFuture()
+{
+}
+
+std::shared_ptr<rtRemoteFuture>
+rtRemoteFuture::runLocal(rtObjectRef const& obj, Kind kind, char const* name, rtValue const* value,
+  int argc, rtValue const* argv)
+{
+  rtError e = RT_OK;
+  rtValue result;
+
+  if (!obj || name == nullptr)
+  {
+    e = RT_ERROR_INVALID_ARG;
+  }
+  else if (kind == Kind::Get)
+  {
+    e = obj->Get(name, &result);
+  }
+  else if (kind == Kind::Set)
+  {
+    e = value ? obj->Set(name, value) : RT_ERROR_INVALID_ARG;
+  }
+  else
+  {
+    rtFunctionRef func;
+    e = obj.get<rtFunctionRef>(name, func);
+    if (e == RT_OK)
+      e = func ? func->Send(argc, argv, &result) : RT_ERROR_INVALID_ARG;
+  }
+
+  return std::shared_ptr<rtRemoteFuture>(new rtRemoteFuture(kind, e, result));
+}
+
+void
+rtRemoteFuture::bind(std::shared_ptr<rtRemoteAsyncHandle> const& handle)
+{
+  m_handle = handle;
+}
+
+void
+rtRemoteFuture::complete(rtError e)
+{
+  m_done = true;
+  m_error = e;
+  m_handle.reset();
+}
+
+rtError
+rtRemoteFuture::wait(uint32_t timeout)
+{
+  if (m_done)
+    return m_error;
+
+  if (!m_handle)
+  {
+    rtLogError("waiting on a request that hasn't been sent");
+    return RT_ERROR_INVALID_OPERATION;
+  }
+
+  rtError e = m_client->waitForResponse(*m_handle, m_key, m_kind, timeout, m_value);
+
+  // drop the handle, the response handler goes with it once every future
+  // sharing it is done
+  complete(e);
+  return m_error;
+}
+
+rtError
+rtRemoteFuture::get(rtValue& value, uint32_t timeout)
+{
+  rtError e = wait(timeout);
+  if (e == RT_OK)
+    value = m_value;
+  return e;
+}
@@ -0,0 +1,98 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+
+#ifndef __RT_REMOTE_FUTURE_H__
+#define __RT_REMOTE_FUTURE_H__
+
+#include <rtError.h>
+#include <rtObject.h>
+#include <rtValue.h>
+
+#include <memory>
+
+#include "rtRemoteCorrelationKey.h"
+
+class rtRemoteAsyncHandle;
+class rtRemoteClient;
+
+// The pending result of a get, set or method call that was sent without
+// waiting for the response. Any number of them may be outstanding on one
+// connection; each is matched to its response by correlation key. Requests
+// queued in an rtRemoteBatch share one handle and complete together.
+//
+// wait() and get() block until the response arrives or the timeout expires,
+// dispatching other incoming messages in the meantime the same way a
+// synchronous call does. A future must only be waited on by one thread at a
+// time, and futures from the same batch must be waited on from one thread.
+class rtRemoteFuture
+{
+public:
+  enum class Kind
+  {
+    Get,
+    Set,
+    Call
+  };
+
+  ~rtRemoteFuture();
+
+  rtRemoteFuture(rtRemoteFuture const&) = delete;
+  rtRemoteFuture& operator = (rtRemoteFuture const&) = delete;
+
+  // waits for the response and returns the status of the request. A timeout
+  // of zero uses rt.rpc.environment.request_timeout. The result is kept, a
+  // future that timed out doesn't pick up a late response.
+  rtError wait(uint32_t timeout = 0);
+
+  // waits for the response and returns the value of a get or the return
+  // value of a call
+  rtError get(rtValue& value, uint32_t timeout = 0);
+
+  inline Kind kind() const
+    { return m_kind; }
+
+  // runs the request on an object that isn't remote and returns a future
+  // that has already completed. value is the value of a set, argc and argv
+  // the arguments of a call.
+  static std::shared_ptr<rtRemoteFuture> runLocal(rtObjectRef const& obj, Kind kind,
+    char const* name, rtValue const* value, int argc, rtValue const* argv);
+
+private:
+  friend class rtRemoteClient;
+
+  // not waitable until the request is sent and bind() is called
+  rtRemoteFuture(std::shared_ptr<rtRemoteClient> const& client, rtRemoteCorrelationKey k, Kind kind);
+  rtRemoteFuture(Kind kind, rtError e, rtValue const& value);
+
+  void bind(std::shared_ptr<rtRemoteAsyncHandle> const& handle);
+  void complete(rtError e);
+
+private:
+  std::shared_ptr<rtRemoteClient>       m_client;
+  std::shared_ptr<rtRemoteAsyncHandle>  m_handle;
+  rtRemoteCorrelationKey                m_key;
+  Kind                                  m_kind;
+  bool                                  m_done;
+  rtError                               m_error;
+  rtValue                               m_value;
+};
+
+using rtRemoteFuturePtr = std::shared_ptr<rtRemoteFuture>;
+
+#endif
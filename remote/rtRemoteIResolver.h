@@ -25,6 +25,7 @@ limitations under the License.
 #include <sys/socket.h>
 #include <stdint.h>
 
+#include "rtRemoteShmTransport.h"
 #include "rtRemoteTypes.h"
 
 class rtRemoteIResolver
@@ -35,6 +36,15 @@ public:
   virtual rtError close() = 0;
   virtual rtError registerObject(std::string const& name, sockaddr_storage const& endpoint) = 0;
   virtual rtError locateObject(std::string const& name, sockaddr_storage& endpoint, uint32_t timeout) = 0;
+
+  // also reports the transport the object's server advertised. Resolvers
+  // that don't advertise one report the socket.
+  virtual rtError locateObject(std::string const& name, sockaddr_storage& endpoint, uint32_t timeout,
+    rtRemoteTransport& transport)
+  {
+    transport = rtRemoteTransport::Socket;
+    return locateObject(name, endpoint, timeout);
+  }
   virtual rtError unregisterObject(std::string const& name) = 0;
 };
 
@@ -167,6 +167,24 @@ rtMessage_GetStatusMessage(rapidjson::Document const& doc)
     : NULL;
 }
 
+char const*
+rtMessage_GetWireFormat(rapidjson::Document const& doc)
+{
+  rapidjson::Value::ConstMemberIterator itr = doc.FindMember(kFieldNameWireFormat);
+  return itr != doc.MemberEnd() && itr->value.IsString()
+    ? itr->value.GetString()
+    : NULL;
+}
+
+char const*
+rtMessage_GetTransport(rapidjson::Document const& doc)
+{
+  rapidjson::Value::ConstMemberIterator itr = doc.FindMember(kFieldNameTransport);
+  return itr != doc.MemberEnd() && itr->value.IsString()
+    ? itr->value.GetString()
+    : NULL;
+}
+
 rtError
 rtMessage_DumpDocument(rapidjson::Document const& doc, FILE* out)
 {
@@ -49,6 +49,9 @@ limitations under the License.
 #define kFieldNameScheme "scheme"
 #define kFieldNameEndpointType "endpoint.type"
 #define kFieldNameReplyTo "reply-to"
+#define kFieldNameWireFormat "wire.format"
+#define kFieldNameTransport "transport"
+#define kFieldNameBatchMessages "batch.messages"
 #define kEndpointTypeLocal "local.endpoint"
 #define kEndpointTypeRemote "net.endpoint"
 #define kNullObjectId "nil"
@@ -70,6 +73,8 @@ limitations under the License.
 #define kMessageTypeMethodCallRequest "method.call.request"
 #define kMessageTypeKeepAliveRequest "keep_alive.request"
 #define kMessageTypeOpenSessionRequest "session.open.request"
+#define kMessageTypeBatchRequest "batch.request"
+#define kMessageTypeBatchResponse "batch.response"
 
 #define kInvalidPropertyIndex std::numeric_limits<uint32_t>::max()
 
@@ -101,6 +106,8 @@ rtRemoteCorrelationKey  rtMessage_GetCorrelationKey(rtRemoteMessage const& m);
 char const*             rtMessage_GetObjectId(rtRemoteMessage const& m);
 rtError                 rtMessage_GetStatusCode(rtRemoteMessage const& m);
 char const*             rtMessage_GetStatusMessage(rtRemoteMessage const& m);
+char const*             rtMessage_GetWireFormat(rtRemoteMessage const& m);
+char const*             rtMessage_GetTransport(rtRemoteMessage const& m);
 rtError                 rtMessage_Dump(rtRemoteMessage const& m, FILE* out = stdout);
 rtError                 rtMessage_SetStatus(rtRemoteMessage& m, rtError code, char const* fmt, ...) RT_PRINTF_FORMAT(3, 4);
 rtError                 rtMessage_SetStatus(rtRemoteMessage& m, rtError code);
@@ -405,6 +405,13 @@ rtRemoteMulticastResolver::onSearch(rtRemoteMessagePtr const& doc, sockaddr_stor
     doc.AddMember(kFieldNameMessageType, kMessageTypeLocate, doc.GetAllocator());
     doc.AddMember(kFieldNameObjectId, std::string(objectId), doc.GetAllocator());
     doc.AddMember(kFieldNameEndPoint, m_rpc_endpoint->toString(), doc.GetAllocator());
+
+    // peers on this host may skip the socket for shared memory. The fds
+    // for it are passed over the unix domain socket.
+    if (rtRemoteTransportFromString(m_env->Config->stream_transport()) == rtRemoteTransport::Shm
+      && m_rpc_endpoint->scheme() == "unix")
+      doc.AddMember(kFieldNameTransport, std::string(kTransportShm), doc.GetAllocator());
+
     doc.AddMember(kFieldNameSenderId, senderId->value.GetInt(), doc.GetAllocator());
     doc.AddMember(kFieldNameCorrelationKey, key.toString(), doc.GetAllocator());
 
@@ -434,6 +441,16 @@ rtRemoteMulticastResolver::onLocate(rtRemoteMessagePtr const& doc, sockaddr_stor
 rtError
 rtRemoteMulticastResolver::locateObject(std::string const& name, sockaddr_storage& endpoint, uint32_t timeout)
 {
+  rtRemoteTransport transport;
+  return locateObject(name, endpoint, timeout, transport);
+}
+
+rtError
+rtRemoteMulticastResolver::locateObject(std::string const& name, sockaddr_storage& endpoint, uint32_t timeout,
+  rtRemoteTransport& transport)
+{
+  transport = rtRemoteTransport::Socket;
+
   if (m_ucast_fd == -1)
   {
     rtLogError("unicast socket not opened");
@@ -453,6 +470,10 @@ rtRemoteMulticastResolver::locateObject(std::string const& name, sockaddr_storag
     // err = rtParseAddress(endpoint, e.host().c_str(), e.port(), nullptr);
   }
 
+  char const* advertised = rtMessage_GetTransport(*searchResponse);
+  if (advertised != nullptr)
+    transport = rtRemoteTransportFromString(advertised);
+
   return err;
 }
 
@@ -42,6 +42,9 @@ public:
   inline std::string const& getId() const
     { return m_id; }
 
+  inline std::shared_ptr<rtRemoteClient> const& getClient() const
+    { return m_client; }
+
 private:
   rtAtomic                          m_ref_count;
   std::string                       m_id;
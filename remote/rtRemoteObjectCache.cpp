@@ -16,86 +16,390 @@ limitations under the License.
 
 */
 
+
 #include "rtRemoteObjectCache.h"
 #include "rtRemoteConfig.h"
 #include "rtRemoteEnvironment.h"
 
-#include <map>
-#include <mutex>
-#include <iostream>
+#include <atomic>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <string.h>
 
 using std::chrono::steady_clock;
 
 namespace
 {
+  size_t const kShardBits = 5;
+  size_t const kNumShards = 1 << kShardBits;
+  size_t const kInitialBuckets = 64;
+
+  // sixteen slots per second, so that expiring a burst of entries is spread
+  // over a few calls to removeUnused(). Entries due further out than the
+  // wheel reaches are looked at early and go round again.
+  int64_t const kWheelSlots = 256;
+
+  int64_t const kTicksPerSecond = std::chrono::duration_cast<steady_clock::duration>(
+    std::chrono::seconds(1)).count();
+  int64_t const kTicksPerSlot = kTicksPerSecond / 16;
+
   struct Entry
   {
+    std::string              Id;
+    uint32_t                 Hash;
     rtObjectRef              Object;
     rtFunctionRef            Function;
-    steady_clock::time_point LastUsed;
     std::chrono::seconds     MaxIdleTime;
-    bool                     Unevictable;
 
-    bool isActive(const steady_clock::time_point& now) const
+    // steady_clock ticks. touch() and markUnevictable() don't lock.
+    std::atomic<int64_t>     LastUsed;
+    std::atomic<bool>        Unevictable;
+
+    // only used with the shard locked
+    bool                     Removed;
+
+    bool isActive(int64_t now) const
+    {
+      return (now - LastUsed.load(std::memory_order_relaxed)) < MaxIdleTime.count() * kTicksPerSecond;
+    }
+
+    int64_t dueSlot() const
+    {
+      return (LastUsed.load(std::memory_order_relaxed) + MaxIdleTime.count() * kTicksPerSecond
+        + kTicksPerSlot - 1) / kTicksPerSlot;
+    }
+  };
+
+  using EntryPtr = std::shared_ptr<Entry>;
+
+  // Readers walk the bucket chains without a lock. A node's Item and Next
+  // never change once it's reachable, except for Next being pointed past a
+  // removed node, so a reader always sees a well formed chain. Nodes and
+  // tables that have been unlinked are only freed once no reader is inside
+  // the shard.
+  struct Node
+  {
+    std::atomic<Node*>  Next;
+    EntryPtr            Item;
+    // the entry left the cache, as opposed to the node being replaced when
+    // the table grew
+    bool                Unlinked;
+  };
+
+  struct Table
+  {
+    Table(size_t n)
+      : Mask(n - 1)
+      , Buckets(new std::atomic<Node*>[n])
+    {
+      for (size_t i = 0; i < n; ++i)
+        Buckets[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    size_t                                  Mask;
+    std::unique_ptr<std::atomic<Node*>[]>   Buckets;
+  };
+
+  struct Shard
+  {
+    Shard()
+      : Buckets(new Table(kInitialBuckets))
+      , Readers(0)
+      , Count(0)
+      , WheelTick(0)
+    {
+    }
+
+    ~Shard()
+    {
+      Table* t = Buckets.load();
+      for (size_t i = 0; i <= t->Mask; ++i)
+      {
+        Node* node = t->Buckets[i].load();
+        while (node)
+        {
+          Node* next = node->Next.load();
+          delete node;
+          node = next;
+        }
+      }
+      delete t;
+      for (Node* node : RetiredNodes)
+        delete node;
+      for (Table* table : RetiredTables)
+        delete table;
+    }
+
+    std::mutex              Mutex;
+    std::atomic<Table*>     Buckets;
+    std::atomic<uint32_t>   Readers;
+    size_t                  Count;
+    std::vector<Node*>      RetiredNodes;
+    std::vector<Table*>     RetiredTables;
+    std::vector<EntryPtr>   Wheel[kWheelSlots];
+    int64_t                 WheelTick;
+  };
+
+  // what a shard gave up while it was locked. Freed after the lock is
+  // released, dropping the last reference to an object may run arbitrary
+  // code.
+  struct Garbage
+  {
+    ~Garbage()
     {
-      return (now - LastUsed) < MaxIdleTime;
+      for (Node* node : Nodes)
+      {
+        if (node->Unlinked)
+        {
+          node->Item->Object = nullptr;
+          node->Item->Function = nullptr;
+        }
+        delete node;
+      }
+      for (Table* table : Tables)
+        delete table;
     }
 
+    std::vector<Node*>   Nodes;
+    std::vector<Table*>  Tables;
+  };
+
+  class ReadGuard
+  {
+  public:
+    ReadGuard(Shard& s) : m_shard(s)
+      { m_shard.Readers.fetch_add(1); }
+    ~ReadGuard()
+      { m_shard.Readers.fetch_sub(1); }
+  private:
+    Shard& m_shard;
   };
 
-  using refmap = std::map< std::string, Entry >;
+  Shard                 sShards[kNumShards];
+  std::atomic<size_t>   sCount(0);
+  size_t                sHighMark = 10000;
+
+  inline uint32_t hashId(char const* id, size_t n)
+  {
+    return rtAtomHash(id, static_cast<uint32_t>(n));
+  }
+
+  inline Shard& shardFor(uint32_t hash)
+  {
+    return sShards[hash & (kNumShards - 1)];
+  }
+
+  // the low bits picked the shard
+  inline size_t bucketFor(Table const* t, uint32_t hash)
+  {
+    return static_cast<size_t>(hash >> kShardBits) & t->Mask;
+  }
+
+  inline bool sameId(Entry const& e, uint32_t hash, char const* id, size_t n)
+  {
+    return e.Hash == hash && e.Id.size() == n && memcmp(e.Id.data(), id, n) == 0;
+  }
+
+  // safe with or without the shard locked. Without it, the caller must hold
+  // a ReadGuard for as long as it uses the entry.
+  Entry* lookup(Shard& s, uint32_t hash, char const* id, size_t n)
+  {
+    Table* t = s.Buckets.load(std::memory_order_acquire);
+    Node* node = t->Buckets[bucketFor(t, hash)].load(std::memory_order_acquire);
+    while (node)
+    {
+      if (sameId(*node->Item, hash, id, n))
+        return node->Item.get();
+      node = node->Next.load(std::memory_order_acquire);
+    }
+    return nullptr;
+  }
 
-  std::mutex    sMutex;
-  refmap        sRefMap;
-  size_t        sHighMark = 10000;
+  int64_t slotOf(int64_t ticks)
+  {
+    return ticks / kTicksPerSlot;
+  }
+
+  void schedule(Shard& s, EntryPtr const& e, int64_t due)
+  {
+    if (due <= s.WheelTick)
+      due = s.WheelTick + 1;
+    s.Wheel[due % kWheelSlots].push_back(e);
+  }
+
+  void grow(Shard& s)
+  {
+    Table* old = s.Buckets.load(std::memory_order_relaxed);
+    Table* t = new Table((old->Mask + 1) * 2);
+
+    // readers may still be walking the old chains, so they're left alone and
+    // the new table gets nodes of its own
+    for (size_t i = 0; i <= old->Mask; ++i)
+    {
+      for (Node* node = old->Buckets[i].load(std::memory_order_relaxed); node;
+        node = node->Next.load(std::memory_order_relaxed))
+      {
+        std::atomic<Node*>& head = t->Buckets[bucketFor(t, node->Item->Hash)];
+        Node* copy = new Node();
+        copy->Item = node->Item;
+        copy->Unlinked = false;
+        copy->Next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        head.store(copy, std::memory_order_relaxed);
+        s.RetiredNodes.push_back(node);
+      }
+    }
+
+    s.Buckets.store(t, std::memory_order_release);
+    s.RetiredTables.push_back(old);
+  }
+
+  void link(Shard& s, EntryPtr const& e)
+  {
+    Table* t = s.Buckets.load(std::memory_order_relaxed);
+    if (s.Count >= 2 * (t->Mask + 1))
+    {
+      grow(s);
+      t = s.Buckets.load(std::memory_order_relaxed);
+    }
+
+    std::atomic<Node*>& head = t->Buckets[bucketFor(t, e->Hash)];
+    Node* node = new Node();
+    node->Item = e;
+    node->Unlinked = false;
+    node->Next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    head.store(node, std::memory_order_release);
+
+    s.Count++;
+    sCount++;
+  }
+
+  void unlink(Shard& s, Entry* e)
+  {
+    Table* t = s.Buckets.load(std::memory_order_relaxed);
+    std::atomic<Node*>* prev = &t->Buckets[bucketFor(t, e->Hash)];
+    Node* node = prev->load(std::memory_order_relaxed);
+    while (node && node->Item.get() != e)
+    {
+      prev = &node->Next;
+      node = node->Next.load(std::memory_order_relaxed);
+    }
+
+    if (!node)
+      return;
+
+    prev->store(node->Next.load(std::memory_order_relaxed), std::memory_order_release);
+    node->Unlinked = true;
+    s.RetiredNodes.push_back(node);
+
+    e->Removed = true;
+    s.Count--;
+    sCount--;
+  }
+
+  // hands over everything retired if no reader is in the shard. The
+  // exchange, rather than a plain load, makes a reader that comes in after
+  // it see the chains without the retired nodes. Unless told to wait, a
+  // shard with a reader in it keeps its retired nodes, and the objects they
+  // hold, until the next change to the shard.
+  void reclaim(Shard& s, Garbage& g, bool wait = false)
+  {
+    if (s.RetiredNodes.empty() && s.RetiredTables.empty())
+      return;
+
+    uint32_t none = 0;
+    while (!s.Readers.compare_exchange_strong(none, 0))
+    {
+      if (!wait)
+        return;
+
+      // readers don't take the lock and only copy a reference out, they're
+      // gone in no time
+      none = 0;
+      std::this_thread::yield();
+    }
+
+    g.Nodes.swap(s.RetiredNodes);
+    g.Tables.swap(s.RetiredTables);
+  }
+
+  rtError insertEntry(EntryPtr const& e)
+  {
+    int64_t now = steady_clock::now().time_since_epoch().count();
+    e->Hash = hashId(e->Id.data(), e->Id.size());
+    e->LastUsed = now;
+    e->Unevictable = false;
+    e->Removed = false;
+
+    Shard& s = shardFor(e->Hash);
+    Garbage g;
+
+    std::unique_lock<std::mutex> lock(s.Mutex);
+    if (lookup(s, e->Hash, e->Id.data(), e->Id.size()) != nullptr)
+      return RT_ERROR_DUPLICATE_ENTRY;
+
+    if (s.WheelTick == 0)
+      s.WheelTick = slotOf(now);
+
+    link(s, e);
+    schedule(s, e, e->dueSlot());
+    reclaim(s, g);
+
+    return RT_OK;
+  }
 }
 
 rtObjectRef
-rtRemoteObjectCache::findObject(std::string const& id)
+rtRemoteObjectCache::findObject(char const* id)
 {
+  size_t n = strlen(id);
+  uint32_t hash = hashId(id, n);
+  Shard& s = shardFor(hash);
+
   rtObjectRef obj;
-  std::unique_lock<std::mutex> lock(sMutex);
-  auto itr = sRefMap.find(id);
-  if (itr != sRefMap.end())
-    obj = itr->second.Object;
+  ReadGuard guard(s);
+  Entry* e = lookup(s, hash, id, n);
+  if (e)
+    obj = e->Object;
   return obj;
 }
 
 rtFunctionRef
-rtRemoteObjectCache::findFunction(std::string const& id)
+rtRemoteObjectCache::findFunction(char const* id)
 {
-  std::unique_lock<std::mutex> lock(sMutex);
-  auto itr = sRefMap.find(id);
-  return (itr != sRefMap.end()) ? itr->second.Function : rtFunctionRef();
+  size_t n = strlen(id);
+  uint32_t hash = hashId(id, n);
+  Shard& s = shardFor(hash);
+
+  rtFunctionRef func;
+  ReadGuard guard(s);
+  Entry* e = lookup(s, hash, id, n);
+  if (e)
+    func = e->Function;
+  return func;
 }
 
 rtError
 rtRemoteObjectCache::markUnevictable(std::string const& id, bool state)
 {
-  rtError e = RT_OK;
+  uint32_t hash = hashId(id.data(), id.size());
+  Shard& s = shardFor(hash);
 
-  std::unique_lock<std::mutex> lock(sMutex);
-  auto itr = sRefMap.find(id);
-  if (itr != sRefMap.end())
-  {
-    itr->second.Unevictable = state;
-    e = RT_OK;
-  }
-  else
-  {
-    e = RT_ERROR_OBJECT_NOT_FOUND;
-  }
+  ReadGuard guard(s);
+  Entry* e = lookup(s, hash, id.data(), id.size());
+  if (!e)
+    return RT_ERROR_OBJECT_NOT_FOUND;
 
-  return e;
+  e->Unevictable = state;
+  return RT_OK;
 }
 
-
 rtError
 rtRemoteObjectCache::insert(std::string const& id, rtFunctionRef const& ref)
 {
-  rtError e = RT_OK;
-
   if (!ref)
   {
     rtLogError("trying to insert null reference");
@@ -104,25 +408,17 @@ rtRemoteObjectCache::insert(std::string const& id, rtFunctionRef const& ref)
 
   RT_ASSERT(!!ref);
 
-  Entry entry;
-  entry.LastUsed = std::chrono::steady_clock::now();
-  entry.Function = ref;
-  entry.MaxIdleTime = std::chrono::seconds(m_env->Config->cache_max_object_lifetime());
-  entry.Unevictable = false;
+  EntryPtr entry(new Entry());
+  entry->Id = id;
+  entry->Function = ref;
+  entry->MaxIdleTime = std::chrono::seconds(m_env->Config->cache_max_object_lifetime());
 
-  std::unique_lock<std::mutex> lock(sMutex);
-  auto res = sRefMap.insert(refmap::value_type(id, entry));
-  if (!res.second) // entry already exists
-    e = RT_ERROR_DUPLICATE_ENTRY;
-
-  return e;
+  return insertEntry(entry);
 }
 
 rtError
 rtRemoteObjectCache::insert(std::string const& id, rtObjectRef const& ref)
 {
-  rtError e = RT_OK;
-
   if (!ref)
   {
     rtLogError("trying to insert null reference");
@@ -131,38 +427,30 @@ rtRemoteObjectCache::insert(std::string const& id, rtObjectRef const& ref)
 
   RT_ASSERT(!!ref);
 
-  Entry entry;
-  entry.LastUsed = std::chrono::steady_clock::now();
-  entry.Object = ref;
-  entry.MaxIdleTime = std::chrono::seconds(m_env->Config->cache_max_object_lifetime());
-  entry.Unevictable = false;
+  EntryPtr entry(new Entry());
+  entry->Id = id;
+  entry->Object = ref;
+  entry->MaxIdleTime = std::chrono::seconds(m_env->Config->cache_max_object_lifetime());
 
-  std::unique_lock<std::mutex> lock(sMutex);
-  auto res = sRefMap.insert(refmap::value_type(id, entry));
-  if (!res.second) // entry already exists
-    e = RT_ERROR_DUPLICATE_ENTRY;
-
-  return e;
+  return insertEntry(entry);
 }
 
 rtError
-rtRemoteObjectCache::touch(std::string const& id, std::chrono::steady_clock::time_point now)
+rtRemoteObjectCache::touch(char const* id, std::chrono::steady_clock::time_point now)
 {
-  rtError e = RT_OK;
-
-  std::unique_lock<std::mutex> lock(sMutex);
-  auto itr = sRefMap.find(id);
-  if (itr != sRefMap.end())
-  {
-    itr->second.LastUsed = now;
-    e = RT_OK;
-  }
-  else
-  {
-    e = RT_ERROR_OBJECT_NOT_FOUND;
-  }
-
-  return e;
+  size_t n = strlen(id);
+  uint32_t hash = hashId(id, n);
+  Shard& s = shardFor(hash);
+
+  // the entry stays where it is in the time wheel. When its slot comes up
+  // it's moved to wherever the new time puts it.
+  ReadGuard guard(s);
+  Entry* e = lookup(s, hash, id, n);
+  if (!e)
+    return RT_ERROR_OBJECT_NOT_FOUND;
+
+  e->LastUsed.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+  return RT_OK;
 }
 
 rtError
@@ -170,8 +458,23 @@ rtRemoteObjectCache::clear()
 {
   rtLogInfo("clearing object cache");
 
-  std::unique_lock<std::mutex> lock(sMutex);
-  sRefMap.clear();
+  for (Shard& s : sShards)
+  {
+    Garbage g;
+
+    std::unique_lock<std::mutex> lock(s.Mutex);
+    Table* t = s.Buckets.load(std::memory_order_relaxed);
+    for (size_t i = 0; i <= t->Mask; ++i)
+    {
+      while (Node* node = t->Buckets[i].load(std::memory_order_relaxed))
+        unlink(s, node->Item.get());
+    }
+    for (auto& slot : s.Wheel)
+      slot.clear();
+
+    // everything in the cache must be let go of by the time this returns
+    reclaim(s, g, true);
+  }
 
   return RT_OK;
 }
@@ -179,52 +482,75 @@ rtRemoteObjectCache::clear()
 rtError
 rtRemoteObjectCache::erase(std::string const& id)
 {
-  rtError e = RT_OK;
+  uint32_t hash = hashId(id.data(), id.size());
+  Shard& s = shardFor(hash);
+  Garbage g;
 
-  std::unique_lock<std::mutex> lock(sMutex);
-  auto itr = sRefMap.find(id);
-  if (itr != sRefMap.end())
-  {
-    sRefMap.erase(itr);
-    e = RT_OK;
-  }
-  else
-  {
-    e = RT_ERROR_OBJECT_NOT_FOUND;
-  }
+  std::unique_lock<std::mutex> lock(s.Mutex);
+  Entry* e = lookup(s, hash, id.data(), id.size());
+  if (!e)
+    return RT_ERROR_OBJECT_NOT_FOUND;
 
-  return e;
+  unlink(s, e);
+  reclaim(s, g);
+
+  return RT_OK;
 }
 
 rtError
 rtRemoteObjectCache::removeUnused()
 {
-  auto now = std::chrono::steady_clock::now();
+  int64_t const now = steady_clock::now().time_since_epoch().count();
+  int64_t const current = slotOf(now);
 
-  std::unique_lock<std::mutex> lock(sMutex);
-  for (auto itr = sRefMap.begin(); itr != sRefMap.end();)
+  for (Shard& s : sShards)
   {
-    // rtLogInfo("IsActive:%s LifeTime:%lld MaxIdleTime:%lld Unevictable:%d", itr->first.c_str(),
-    //           std::chrono::duration_cast<std::chrono::seconds>(now - itr->second.LastUsed).count(),
-    //           itr->second.MaxIdleTime.count(), itr->second.Unevictable);
-    #if 0
-    if (!itr->second.Unevictable && itr->second.isActive(now))
+    Garbage g;
+
+    std::unique_lock<std::mutex> lock(s.Mutex);
+    if (s.WheelTick == 0)
+      s.WheelTick = current;
+
+    // only the slots that came due since last time, and each at most once
+    int64_t first = s.WheelTick + 1;
+    if (current - first >= kWheelSlots)
+      first = current - kWheelSlots + 1;
+
+    std::vector<EntryPtr> due;
+    for (int64_t tick = first; tick <= current; ++tick)
     {
-      rtLogInfo("not removing:%s, should remove, but it's active",
-        itr->first.c_str());
+      s.WheelTick = tick;
+      due.clear();
+      due.swap(s.Wheel[tick % kWheelSlots]);
+
+      for (EntryPtr const& e : due)
+      {
+        if (e->Removed)
+          continue;
+
+        if (e->Unevictable)
+          schedule(s, e, current + e->MaxIdleTime.count() * (kTicksPerSecond / kTicksPerSlot));
+        else if (e->isActive(now))
+          schedule(s, e, e->dueSlot());
+        else
+          unlink(s, e.get());
+      }
     }
-    #endif
 
-    if (!itr->second.Unevictable && !itr->second.isActive(now))
-      itr = sRefMap.erase(itr);
-    else
-      ++itr;
+    reclaim(s, g);
   }
 
-  if (sRefMap.size() > sHighMark)
+  size_t count = sCount.load();
+  if (count > sHighMark)
   {
-    rtLogWarn("Cache reached high mark, current size=%zu", sRefMap.size());
+    rtLogWarn("Cache reached high mark, current size=%zu", count);
   }
 
   return RT_OK;
 }
+
+size_t
+rtRemoteObjectCache::size() const
+{
+  return sCount.load();
+}
@@ -28,6 +28,11 @@ limitations under the License.
 
 class rtRemoteEnvironment;
 
+// Objects and functions exported to remote peers, by id. The entries are
+// spread over a fixed number of shards by a hash of the id, computed once per
+// call. Lookups (findObject(), findFunction() and touch()) don't take a lock,
+// changes lock only their shard. Expiry is driven by a time wheel per shard
+// so removeUnused() only looks at entries that may be due.
 class rtRemoteObjectCache
 {
 public:
@@ -35,15 +40,22 @@ public:
     : m_env(env)
   { }
 
-  rtObjectRef findObject(std::string const& id);
-  rtFunctionRef findFunction(std::string const& id);
+  rtObjectRef findObject(char const* id);
+  rtObjectRef findObject(std::string const& id)
+    { return findObject(id.c_str()); }
+  rtFunctionRef findFunction(char const* id);
+  rtFunctionRef findFunction(std::string const& id)
+    { return findFunction(id.c_str()); }
   rtError insert(std::string const& id, rtObjectRef const& ref);
   rtError insert(std::string const& id, rtFunctionRef const& ref);
-  rtError touch(std::string const& id, std::chrono::steady_clock::time_point now);
+  rtError touch(char const* id, std::chrono::steady_clock::time_point now);
+  rtError touch(std::string const& id, std::chrono::steady_clock::time_point now)
+    { return touch(id.c_str(), now); }
   rtError erase(std::string const& id);
   rtError markUnevictable(std::string const& id, bool state);
   rtError removeUnused();
   rtError clear();
+  size_t size() const;
 
 private:
   rtRemoteEnvironment* m_env;
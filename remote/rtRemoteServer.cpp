@@ -229,6 +229,9 @@ rtRemoteServer::rtRemoteServer(rtRemoteEnvironment* env)
   m_command_handlers.insert(CommandHandlerMap::value_type(kMessageTypeMethodCallRequest,
     rtRemoteCallback<rtRemoteMessageHandler>(&rtRemoteServer::onMethodCall_Dispatch, this)));
 
+  m_command_handlers.insert(CommandHandlerMap::value_type(kMessageTypeBatchRequest,
+    rtRemoteCallback<rtRemoteMessageHandler>(&rtRemoteServer::onBatch_Dispatch, this)));
+
   m_command_handlers.insert(CommandHandlerMap::value_type(kMessageTypeKeepAliveRequest,
     rtRemoteCallback<rtRemoteMessageHandler>(&rtRemoteServer::onKeepAlive_Dispatch, this)));
 
@@ -403,8 +406,14 @@ rtRemoteServer::doAccept(int fd)
 
   std::shared_ptr<rtRemoteClient> newClient(new rtRemoteClient(m_env, ret, localEndpoint, remoteEndpoint));
   newClient->setStateChangedHandler(&rtRemoteServer::onClientStateChanged_Dispatch, this);
+
+  // add the client before it's opened, once its stream is registered the
+  // selector thread may already be reporting it closed
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_connected_clients.push_back(newClient);
+  }
   newClient->open();
-  m_connected_clients.push_back(newClient);
 }
 
 rtError
@@ -518,7 +527,8 @@ rtRemoteServer::findObject(std::string const& objectId, rtObjectRef& obj, uint32
   if (!obj)
   {
     sockaddr_storage objectEndpoint;
-    err = m_resolver->locateObject(objectId, objectEndpoint, timeout);
+    rtRemoteTransport transport = rtRemoteTransport::Socket;
+    err = m_resolver->locateObject(objectId, objectEndpoint, timeout, transport);
 
     rtLogDebug("object %s found at endpoint: %s", objectId.c_str(),
     rtSocketToString(objectEndpoint).c_str());
@@ -566,7 +576,7 @@ rtRemoteServer::findObject(std::string const& objectId, rtObjectRef& obj, uint32
       if (client)
       {
         rtRemoteObject* remote(new rtRemoteObject(objectId, client));
-        err = client->startSession(objectId);
+        err = client->startSession(objectId, 0, transport);
         if (err == RT_OK)
           obj = remote;
 
@@ -710,7 +720,7 @@ rtRemoteServer::openRpcListener()
     return e;
   }
 
-  ret = listen(m_listen_fd, 2);
+  ret = listen(m_listen_fd, SOMAXCONN);
   if (ret < 0)
   {
     rtError e = rtErrorFromErrno(errno);
@@ -754,7 +764,48 @@ rtRemoteServer::onOpenSession(std::shared_ptr<rtRemoteClient>& client, rtRemoteM
   res->AddMember(kFieldNameMessageType, kMessageTypeOpenSessionResponse, res->GetAllocator());
   res->AddMember(kFieldNameObjectId, std::string(objectId), res->GetAllocator());
   res->AddMember(kFieldNameCorrelationKey, key.toString(), res->GetAllocator());
+
+  // the client asked for the binary encoding. Agree if we're configured for it
+  // too, and switch once the (JSON) response is out; the client switches when
+  // it sees the response.
+  bool useBinary = false;
+  char const* requested = rtMessage_GetWireFormat(*req);
+  if (requested != nullptr
+      && rtRemoteWireFormatFromString(requested) == rtRemoteWireFormat::Binary
+      && rtRemoteWireFormatFromString(m_env->Config->stream_wire_format()) == rtRemoteWireFormat::Binary)
+  {
+    res->AddMember(kFieldNameWireFormat, std::string(kWireFormatBinary), res->GetAllocator());
+    useBinary = true;
+  }
+
+  // the client sent a shared memory channel along with the request. Map it if
+  // we take that transport too, and move to it after the response.
+  bool useShm = false;
+  char const* transport = rtMessage_GetTransport(*req);
+  if (transport != nullptr && rtRemoteTransportFromString(transport) == rtRemoteTransport::Shm)
+  {
+    if (rtRemoteTransportFromString(m_env->Config->stream_transport()) == rtRemoteTransport::Shm)
+    {
+      err = client->acceptShm();
+      if (err == RT_OK)
+        useShm = true;
+      else
+        rtLogWarn("failed to accept shared memory channel. %s", rtStrError(err));
+    }
+    else
+    {
+      client->discardReceivedFds();
+    }
+
+    if (useShm)
+      res->AddMember(kFieldNameTransport, std::string(kTransportShm), res->GetAllocator());
+  }
+
   err = client->send(res);
+  if (err == RT_OK && useBinary)
+    client->setWireFormat(rtRemoteWireFormat::Binary);
+  if (err == RT_OK && useShm)
+    err = client->switchToShm();
 
   return err;
 }
@@ -933,7 +984,7 @@ rtRemoteServer::onMethodCall(std::shared_ptr<rtRemoteClient>& client, rtRemoteMe
     if (err == RT_OK && !!func)
     {
       // virtual rtError Send(int numArgs, const rtValue* args, rtValue* result) = 0;
-      std::vector<rtValue> argv;
+      rtValueList<8> argv;
 
       auto itr = doc->FindMember(kFieldNameFunctionArgs);
       if (itr != doc->MemberEnd())
@@ -944,12 +995,12 @@ rtRemoteServer::onMethodCall(std::shared_ptr<rtRemoteClient>& client, rtRemoteMe
         {
           rtValue arg;
           rtRemoteValueReader::read(m_env, arg, *itr, client);
-          argv.push_back(arg);
+          argv.push_back(std::move(arg));
         }
       }
 
       rtValue return_value;
-      err = func->Send(static_cast<int>(argv.size()), &argv[0], &return_value);
+      err = func->Send(argv.size(), argv.data(), &return_value);
       if (err == RT_OK)
       {
         rapidjson::Value val;
@@ -972,6 +1023,80 @@ rtRemoteServer::onMethodCall(std::shared_ptr<rtRemoteClient>& client, rtRemoteMe
   return RT_OK;
 }
 
+rtError
+rtRemoteServer::onBatch(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& doc)
+{
+  rtRemoteCorrelationKey key = rtMessage_GetCorrelationKey(*doc);
+
+  rtRemoteMessagePtr res(new rapidjson::Document());
+  res->SetObject();
+  res->AddMember(kFieldNameMessageType, kMessageTypeBatchResponse, res->GetAllocator());
+  res->AddMember(kFieldNameCorrelationKey, key.toString(), res->GetAllocator());
+
+  rapidjson::Value responses(rapidjson::kArrayType);
+
+  auto itr = doc->FindMember(kFieldNameBatchMessages);
+  if (itr == doc->MemberEnd() || !itr->value.IsArray())
+  {
+    rtLogWarn("batch request missing %s field", kFieldNameBatchMessages);
+    rtMessage_SetStatus(*res, RT_ERROR_PROTOCOL_ERROR, "malformed batch");
+    res->AddMember(kFieldNameBatchMessages, responses, res->GetAllocator());
+    return client->send(res);
+  }
+
+  rapidjson::Value const& requests = itr->value;
+  responses.Reserve(requests.Size(), res->GetAllocator());
+
+  // requests run in order, each one sees the effects of the ones before it
+  for (rapidjson::Value::ConstValueIterator req_itr = requests.Begin(); req_itr != requests.End(); ++req_itr)
+  {
+    rtRemoteMessagePtr req(new rapidjson::Document());
+    req->CopyFrom(*req_itr, req->GetAllocator());
+
+    char const* type = rtMessage_GetMessageType(*req);
+    rtRemoteCorrelationKey k = rtMessage_GetCorrelationKey(*req);
+
+    rtError e = RT_ERROR_PROTOCOL_ERROR;
+    rtRemoteMessagePtr subres;
+    if (type != nullptr && (
+          strcmp(type, kMessageTypeGetByNameRequest) == 0 ||
+          strcmp(type, kMessageTypeGetByIndexRequest) == 0 ||
+          strcmp(type, kMessageTypeSetByNameRequest) == 0 ||
+          strcmp(type, kMessageTypeSetByIndexRequest) == 0 ||
+          strcmp(type, kMessageTypeMethodCallRequest) == 0))
+    {
+      e = client->captureResponse(k, [&] { return processMessage(client, req); }, subres);
+    }
+    else
+    {
+      rtLogWarn("%s not allowed in a batch", type ? type : "(null)");
+    }
+
+    rapidjson::Value v;
+    if (subres)
+    {
+      v.CopyFrom(*subres, res->GetAllocator());
+    }
+    else
+    {
+      // the handler failed without answering, the caller still gets a
+      // response for every request
+      v.SetObject();
+      v.AddMember(kFieldNameCorrelationKey, k.toString(), res->GetAllocator());
+      v.AddMember(kFieldNameStatusCode, static_cast<int32_t>(e != RT_OK ? e : RT_FAIL), res->GetAllocator());
+    }
+    responses.PushBack(v, res->GetAllocator());
+  }
+
+  res->AddMember(kFieldNameBatchMessages, responses, res->GetAllocator());
+  rtMessage_SetStatus(*res, RT_OK);
+
+  rtError err = client->send(res);
+  if (err != RT_OK)
+    rtLogWarn("failed to send batch response. %s", rtStrError(err));
+  return RT_OK;
+}
+
 rtError
 rtRemoteServer::onKeepAlive(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& req)
 {
@@ -76,6 +76,9 @@ private:
   static rtError onMethodCall_Dispatch(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& doc, void* argp)
     { return reinterpret_cast<rtRemoteServer *>(argp)->onMethodCall(client, doc); }
 
+  static rtError onBatch_Dispatch(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& doc, void* argp)
+    { return reinterpret_cast<rtRemoteServer *>(argp)->onBatch(client, doc); }
+
   static rtError onKeepAlive_Dispatch(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& doc, void* argp)
     { return reinterpret_cast<rtRemoteServer *>(argp)->onKeepAlive(client, doc); }
 
@@ -96,6 +99,7 @@ private:
   rtError onGet(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& doc);
   rtError onSet(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& doc);
   rtError onMethodCall(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& doc);
+  rtError onBatch(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& doc);
   rtError onKeepAlive(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& doc);
   rtError onKeepAliveResponse(std::shared_ptr<rtRemoteClient>& client, rtRemoteMessagePtr const& doc);
   rtError openRpcListener();
@@ -0,0 +1,516 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+
+#include "rtRemoteShmTransport.h"
+
+#include <rtLog.h>
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+namespace
+{
+  uint32_t const kMagic = 0x72746d73; // "rtms"
+  uint32_t const kVersion = 1;
+  uint32_t const kMinRingSize = 4096;
+  uint32_t const kMaxRingSize = 64 * 1024 * 1024;
+
+  // every record starts with a 32 bit word and is padded to 8 bytes. The word
+  // is the length of the payload that follows, or one of these.
+  uint32_t const kRecordAlign = 8;
+  uint32_t const kRecordLarge = 0x80000000;
+  uint32_t const kRecordPad = 0xffffffff;
+
+  // how long a writer sleeps before it checks for a closed channel again
+  long const kWriterWaitNanos = 100 * 1000 * 1000;
+
+  inline size_t roundUp(size_t n, size_t align)
+  {
+    return (n + align - 1) & ~(align - 1);
+  }
+
+  inline uint32_t recordSize(uint32_t n)
+  {
+    return static_cast<uint32_t>(roundUp(sizeof(uint32_t) + n, kRecordAlign));
+  }
+
+  // the region is shared between processes, so no FUTEX_PRIVATE_FLAG
+  inline void futexWait(std::atomic<uint32_t>* addr, uint32_t val, long nanos)
+  {
+    timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = nanos;
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT, val, &ts, nullptr, 0);
+  }
+
+  inline void futexWakeAll(std::atomic<uint32_t>* addr)
+  {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+  }
+}
+
+struct rtRemoteShmChannel::Ring
+{
+  // bytes ever written, only stored by the writer
+  alignas(64) std::atomic<uint64_t> Head;
+
+  // bytes ever consumed, only stored by the reader
+  alignas(64) std::atomic<uint64_t> Tail;
+
+  // futex word a writer waits on for room in the ring or the large slot. The
+  // reader bumps it when it frees either and finds WriterWaiting set.
+  std::atomic<uint32_t> Released;
+  std::atomic<uint32_t> LargeBusy;
+
+  alignas(64) std::atomic<uint32_t> ReaderWaiting;
+  std::atomic<uint32_t> WriterWaiting;
+};
+
+struct rtRemoteShmChannel::Header
+{
+  uint32_t              Magic;
+  uint32_t              Version;
+  uint32_t              RingSize;
+  uint32_t              LargeSize;
+  std::atomic<uint32_t> Closed;
+  Ring                  Rings[2];
+};
+
+rtRemoteTransport
+rtRemoteTransportFromString(std::string const& s)
+{
+  if (s == kTransportShm)
+    return rtRemoteTransport::Shm;
+  if (s != kTransportSocket)
+    rtLogWarn("unknown transport '%s', using %s", s.c_str(), kTransportSocket);
+  return rtRemoteTransport::Socket;
+}
+
+char const*
+rtRemoteTransportToString(rtRemoteTransport transport)
+{
+  return transport == rtRemoteTransport::Shm ? kTransportShm : kTransportSocket;
+}
+
+rtRemoteShmChannel::rtRemoteShmChannel()
+  : m_header(nullptr)
+  , m_length(0)
+  , m_ring_size(0)
+  , m_large_size(0)
+  , m_read_ring(0)
+  , m_write_ring(0)
+{
+  m_data[0] = m_data[1] = nullptr;
+  m_large[0] = m_large[1] = nullptr;
+  for (int i = 0; i < kNumFds; ++i)
+    m_fds[i] = -1;
+}
+
+rtRemoteShmChannel::~rtRemoteShmChannel()
+{
+  if (m_header)
+    munmap(m_header, m_length);
+  for (int i = 0; i < kNumFds; ++i)
+  {
+    if (m_fds[i] != -1)
+      ::close(m_fds[i]);
+  }
+}
+
+rtError
+rtRemoteShmChannel::create(uint32_t ringSize, uint32_t maxMessageSize,
+  std::shared_ptr<rtRemoteShmChannel>& channel)
+{
+  uint32_t size = kMinRingSize;
+  while (size < ringSize && size < kMaxRingSize)
+    size <<= 1;
+
+  std::shared_ptr<rtRemoteShmChannel> c(new rtRemoteShmChannel());
+
+  // memfd_create() only made it into glibc 2.27
+  c->m_fds[0] = static_cast<int>(syscall(SYS_memfd_create, "rtRemoteShm", MFD_CLOEXEC));
+  c->m_fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  c->m_fds[2] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  for (int i = 0; i < kNumFds; ++i)
+  {
+    if (c->m_fds[i] == -1)
+    {
+      rtError e = rtErrorFromErrno(errno);
+      rtLogError("failed to create shared memory channel. %s", rtStrError(e));
+      return e;
+    }
+  }
+
+  c->m_read_ring = 1;
+  c->m_write_ring = 0;
+
+  rtError e = c->map(true, size, maxMessageSize);
+  if (e == RT_OK)
+    channel = c;
+  return e;
+}
+
+rtError
+rtRemoteShmChannel::attach(int const* fds, int nfds, std::shared_ptr<rtRemoteShmChannel>& channel)
+{
+  std::shared_ptr<rtRemoteShmChannel> c(new rtRemoteShmChannel());
+  for (int i = 0; i < nfds; ++i)
+  {
+    if (i < kNumFds)
+      c->m_fds[i] = fds[i];
+    else
+      ::close(fds[i]);
+  }
+
+  if (nfds < kNumFds)
+  {
+    rtLogError("expected %d fds for shared memory channel, got %d", kNumFds, nfds);
+    return RT_ERROR_INVALID_ARG;
+  }
+
+  c->m_read_ring = 0;
+  c->m_write_ring = 1;
+
+  rtError e = c->map(false, 0, 0);
+  if (e == RT_OK)
+    channel = c;
+  return e;
+}
+
+rtError
+rtRemoteShmChannel::map(bool create, uint32_t ringSize, uint32_t maxMessageSize)
+{
+  size_t const headerSize = roundUp(sizeof(Header), 4096);
+
+  if (create)
+  {
+    m_length = roundUp(headerSize + 2 * static_cast<size_t>(ringSize)
+      + 2 * static_cast<size_t>(maxMessageSize), 4096);
+    if (ftruncate(m_fds[0], static_cast<off_t>(m_length)) == -1)
+    {
+      rtError e = rtErrorFromErrno(errno);
+      rtLogError("failed to size shared memory channel. %s", rtStrError(e));
+      return e;
+    }
+  }
+  else
+  {
+    struct stat st;
+    if (fstat(m_fds[0], &st) == -1)
+    {
+      rtError e = rtErrorFromErrno(errno);
+      rtLogError("failed to stat shared memory channel. %s", rtStrError(e));
+      return e;
+    }
+    m_length = static_cast<size_t>(st.st_size);
+    if (m_length < headerSize)
+    {
+      rtLogError("shared memory channel too small: %d", static_cast<int>(m_length));
+      return RT_FAIL;
+    }
+  }
+
+  void* p = mmap(nullptr, m_length, PROT_READ | PROT_WRITE, MAP_SHARED, m_fds[0], 0);
+  if (p == MAP_FAILED)
+  {
+    rtError e = rtErrorFromErrno(errno);
+    rtLogError("failed to map shared memory channel. %s", rtStrError(e));
+    return e;
+  }
+  m_header = reinterpret_cast<Header *>(p);
+
+  if (create)
+  {
+    // a new memfd is all zeroes, which is what the counters start at
+    m_header->Magic = kMagic;
+    m_header->Version = kVersion;
+    m_header->RingSize = ringSize;
+    m_header->LargeSize = maxMessageSize;
+  }
+  else
+  {
+    ringSize = m_header->RingSize;
+    maxMessageSize = m_header->LargeSize;
+    bool valid = m_header->Magic == kMagic
+      && m_header->Version == kVersion
+      && ringSize >= kMinRingSize && ringSize <= kMaxRingSize && (ringSize & (ringSize - 1)) == 0
+      && headerSize + 2 * static_cast<size_t>(ringSize) + 2 * static_cast<size_t>(maxMessageSize) <= m_length;
+    if (!valid)
+    {
+      rtLogError("invalid shared memory channel");
+      return RT_FAIL;
+    }
+  }
+
+  m_ring_size = ringSize;
+  m_large_size = maxMessageSize;
+
+  char* base = reinterpret_cast<char *>(p) + headerSize;
+  for (int i = 0; i < 2; ++i)
+    m_data[i] = base + i * static_cast<size_t>(m_ring_size);
+  base += 2 * static_cast<size_t>(m_ring_size);
+  for (int i = 0; i < 2; ++i)
+    m_large[i] = base + i * static_cast<size_t>(m_large_size);
+
+  return RT_OK;
+}
+
+void
+rtRemoteShmChannel::close()
+{
+  if (!m_header)
+    return;
+
+  m_header->Closed.store(1);
+  for (Ring& ring : m_header->Rings)
+  {
+    ring.Released.fetch_add(1);
+    futexWakeAll(&ring.Released);
+  }
+}
+
+rtError
+rtRemoteShmChannel::waitForRoom(Ring& ring, std::function<bool ()> const& ready, int timeout)
+{
+  auto const deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+  while (!ready())
+  {
+    if (m_header->Closed.load() != 0)
+      return RT_ERROR_STREAM_CLOSED;
+
+    long nanos = kWriterWaitNanos;
+    if (timeout >= 0)
+    {
+      auto const left = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        deadline - std::chrono::steady_clock::now()).count();
+      if (left <= 0)
+      {
+        rtLogError("timed out waiting for room in shared memory channel");
+        return RT_ERROR_TIMEOUT;
+      }
+      if (left < nanos)
+        nanos = static_cast<long>(left);
+    }
+
+    // announce ourselves before the last look, the reader checks the flag
+    // after it frees space
+    ring.WriterWaiting.store(1);
+    uint32_t seq = ring.Released.load();
+    if (ready())
+      break;
+
+    futexWait(&ring.Released, seq, nanos);
+  }
+
+  return RT_OK;
+}
+
+void
+rtRemoteShmChannel::releaseRoom(Ring& ring)
+{
+  if (ring.WriterWaiting.load() != 0 && ring.WriterWaiting.exchange(0) != 0)
+  {
+    ring.Released.fetch_add(1);
+    futexWakeAll(&ring.Released);
+  }
+}
+
+rtError
+rtRemoteShmChannel::write(char const* buff, uint32_t n, int timeout)
+{
+  if (m_header->Closed.load(std::memory_order_relaxed) != 0)
+    return RT_ERROR_STREAM_CLOSED;
+
+  Ring& ring = m_header->Rings[m_write_ring];
+  char* data = m_data[m_write_ring];
+  uint32_t const size = m_ring_size;
+
+  // anything bigger than half the ring goes through the large slot, so a
+  // frame never waits for more than half the ring to drain
+  bool const large = recordSize(n) > size / 2;
+  uint32_t const need = large ? kRecordAlign : recordSize(n);
+
+  if (large)
+  {
+    if (n > m_large_size || n >= kRecordLarge)
+    {
+      rtLogError("message too large for shared memory channel: %u", n);
+      return RT_ERROR_INVALID_ARG;
+    }
+
+    rtError e = waitForRoom(ring, [&ring] { return ring.LargeBusy.load() == 0; }, timeout);
+    if (e != RT_OK)
+      return e;
+
+    memcpy(m_large[m_write_ring], buff, n);
+    ring.LargeBusy.store(1, std::memory_order_relaxed);
+  }
+
+  uint64_t head = ring.Head.load(std::memory_order_relaxed);
+  uint32_t pos = static_cast<uint32_t>(head & (size - 1));
+
+  // records never wrap. If this one won't fit before the end of the ring,
+  // the rest of it is skipped.
+  uint32_t const pad = (size - pos < need) ? size - pos : 0;
+
+  rtError e = waitForRoom(ring, [&ring, head, size, pad, need]
+  {
+    return size - (head - ring.Tail.load()) >= pad + need;
+  }, timeout);
+  if (e != RT_OK)
+    return e;
+
+  if (pad != 0)
+  {
+    memcpy(data + pos, &kRecordPad, sizeof(kRecordPad));
+    head += pad;
+    pos = 0;
+  }
+
+  uint32_t word = large ? (n | kRecordLarge) : n;
+  memcpy(data + pos, &word, sizeof(word));
+  if (!large)
+    memcpy(data + pos + sizeof(word), buff, n);
+
+  ring.Head.store(head + need);
+
+  // the reader arms its flag before it takes a last look at Head, so one of
+  // us sees the other
+  if (ring.ReaderWaiting.load() != 0 && ring.ReaderWaiting.exchange(0) != 0)
+  {
+    uint64_t one = 1;
+    ssize_t ret;
+    do
+    {
+      ret = ::write(m_fds[1 + m_write_ring], &one, sizeof(one));
+    }
+    while (ret == -1 && errno == EINTR);
+  }
+
+  return RT_OK;
+}
+
+rtError
+rtRemoteShmChannel::read(std::function<rtError (char const* buff, int n)> const& func,
+  size_t maxBytes, bool& more)
+{
+  more = false;
+
+  // consume the wakeup, the ring itself says whether there's anything to do
+  uint64_t count;
+  while (::read(eventFd(), &count, sizeof(count)) == -1 && errno == EINTR)
+    ;
+
+  Ring& ring = m_header->Rings[m_read_ring];
+  char const* data = m_data[m_read_ring];
+  uint32_t const size = m_ring_size;
+  uint64_t tail = ring.Tail.load(std::memory_order_relaxed);
+  size_t total = 0;
+
+  while (true)
+  {
+    uint64_t head = ring.Head.load(std::memory_order_acquire);
+    if (head == tail)
+    {
+      ring.ReaderWaiting.store(1);
+      if (ring.Head.load() == tail)
+        return RT_OK;
+      ring.ReaderWaiting.store(0, std::memory_order_relaxed);
+      continue;
+    }
+
+    if (head - tail > size)
+    {
+      rtLogError("corrupt shared memory ring");
+      return RT_FAIL;
+    }
+
+    while (tail != head)
+    {
+      uint32_t pos = static_cast<uint32_t>(tail & (size - 1));
+
+      uint32_t word;
+      memcpy(&word, data + pos, sizeof(word));
+
+      if (word == kRecordPad)
+      {
+        tail += size - pos;
+        ring.Tail.store(tail);
+        releaseRoom(ring);
+        continue;
+      }
+
+      rtError e = RT_OK;
+      uint32_t n = word & ~kRecordLarge;
+      if (word & kRecordLarge)
+      {
+        if (n > m_large_size)
+        {
+          rtLogError("corrupt shared memory record: %u", word);
+          return RT_FAIL;
+        }
+        e = func(m_large[m_read_ring], static_cast<int>(n));
+        ring.LargeBusy.store(0);
+        tail += kRecordAlign;
+      }
+      else
+      {
+        if (recordSize(n) > size - pos)
+        {
+          rtLogError("corrupt shared memory record: %u", word);
+          return RT_FAIL;
+        }
+        e = func(data + pos + sizeof(word), static_cast<int>(n));
+        tail += recordSize(n);
+      }
+
+      // only now may the writer reuse the space
+      ring.Tail.store(tail);
+      releaseRoom(ring);
+
+      if (e != RT_OK)
+        return e;
+
+      total += n;
+      if (total >= maxBytes)
+      {
+        more = true;
+        return RT_OK;
+      }
+    }
+  }
+
+  return RT_OK;
+}
@@ -0,0 +1,122 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+
+#ifndef __RT_REMOTE_SHM_TRANSPORT_H__
+#define __RT_REMOTE_SHM_TRANSPORT_H__
+
+#include <rtError.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+#define kTransportSocket "socket"
+#define kTransportShm "shm"
+
+enum class rtRemoteTransport
+{
+  Socket,
+  Shm
+};
+
+rtRemoteTransport   rtRemoteTransportFromString(std::string const& s);
+char const*         rtRemoteTransportToString(rtRemoteTransport transport);
+
+// A pair of single producer, single consumer rings in one memfd backed
+// mapping, one per direction, that carries the frames of a stream between two
+// processes on the same host. The side that creates the region writes ring 0
+// and reads ring 1, the side that attaches to it does the opposite.
+//
+// Frames are written once by the sender and decoded by the receiver straight
+// out of the mapping; the space isn't handed back until the decoder is done
+// with it. Frames that don't fit in the ring go to a per direction large
+// message slot and only a reference to it travels through the ring.
+//
+// A reader that runs out of frames sets a flag in the ring and goes to sleep
+// on its eventfd, which the writer only signals when it sees the flag. A
+// writer that runs out of room waits on a futex in the ring instead.
+class rtRemoteShmChannel
+{
+public:
+  // memfd, then the eventfds for the readers of ring 0 and ring 1
+  static int const kNumFds = 3;
+
+  ~rtRemoteShmChannel();
+
+  rtRemoteShmChannel(rtRemoteShmChannel const&) = delete;
+  rtRemoteShmChannel& operator = (rtRemoteShmChannel const&) = delete;
+
+  // creates a new region. ringSize is rounded up to a power of two,
+  // maxMessageSize is the size of each large message slot.
+  static rtError create(uint32_t ringSize, uint32_t maxMessageSize,
+    std::shared_ptr<rtRemoteShmChannel>& channel);
+
+  // maps a region made by create() in the peer, taking ownership of the fds
+  static rtError attach(int const* fds, int nfds, std::shared_ptr<rtRemoteShmChannel>& channel);
+
+  // the fds to hand to the peer
+  inline int const* fds() const
+    { return m_fds; }
+
+  // becomes readable when the reader must look at the ring again
+  inline int eventFd() const
+    { return m_fds[1 + m_read_ring]; }
+
+  // copies one frame in, waiting up to timeout milliseconds for room if need
+  // be. A negative timeout waits until the channel is closed.
+  rtError write(char const* buff, uint32_t n, int timeout);
+
+  // hands each available frame to func, in place. Stops after maxBytes and
+  // sets more when there may be frames left. When the ring is empty it arms
+  // the eventfd before returning.
+  rtError read(std::function<rtError (char const* buff, int n)> const& func,
+    size_t maxBytes, bool& more);
+
+  // tells both sides that the connection is going away and releases any
+  // writer waiting on the peer
+  void close();
+
+  struct Header;
+  struct Ring;
+
+private:
+  rtRemoteShmChannel();
+
+  rtError map(bool create, uint32_t ringSize, uint32_t maxMessageSize);
+  rtError waitForRoom(Ring& ring, std::function<bool ()> const& ready, int timeout);
+  void releaseRoom(Ring& ring);
+
+  Header*   m_header;
+  size_t    m_length;
+  // copied out of the header once they've been checked, the peer can
+  // rewrite the header at any time
+  uint32_t  m_ring_size;
+  uint32_t  m_large_size;
+  char*     m_data[2];
+  char*     m_large[2];
+  int       m_fds[kNumFds];
+  int       m_read_ring;
+  int       m_write_ring;
+};
+
+using rtRemoteShmChannelPtr = std::shared_ptr<rtRemoteShmChannel>;
+
+#endif
@@ -17,6 +17,7 @@ limitations under the License.
 */
 
 #include "rtRemoteSocketUtils.h"
+#include "rtRemoteWireFormat.h"
 
 #include <cstdio>
 #include <sstream>
@@ -28,6 +29,7 @@ limitations under the License.
 #include <ifaddrs.h>
 #include <string.h>
 #include <netdb.h>
+#include <poll.h>
 #include <unistd.h>
 
 #include <rtLog.h>
@@ -331,8 +333,26 @@ rtSocketToString(sockaddr_storage const& ss)
   return buff.str();
 }
 
+// waits up to timeout milliseconds for room in the socket's send buffer. A
+// peer that stops reading would otherwise hang the sender forever.
+static rtError
+rtWaitWritable(int fd, int timeout)
+{
+  pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLOUT;
+  pfd.revents = 0;
+
+  int ret = poll(&pfd, 1, timeout);
+  if (ret > 0 || (ret == -1 && errno == EINTR))
+    return RT_OK;
+  if (ret == 0)
+    return RT_ERROR_TIMEOUT;
+  return rtErrorFromErrno(errno);
+}
+
 rtError
-rtSendDocument(rapidjson::Document const& doc, int fd, sockaddr_storage const* dest)
+rtSendDocument(rapidjson::Document const& doc, int fd, sockaddr_storage const* dest, int timeout)
 {
   rapidjson::StringBuffer buff;
   rapidjson::Writer<rapidjson::StringBuffer> writer(buff);
@@ -400,6 +420,18 @@ rtSendDocument(rapidjson::Document const& doc, int fd, sockaddr_storage const* d
     {
       if (errno == EINTR)
         continue;
+
+      // streams are non-blocking once they're registered with the selector,
+      // wait for the peer to drain its end
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        rtError e = rtWaitWritable(fd, timeout);
+        if (e == RT_OK)
+          continue;
+        rtLogError("failed to send message. %s", rtStrError(e));
+        return e;
+      }
+
       rtError e = rtErrorFromErrno(errno);
       rtLogError("failed to send message. %s", rtStrError(e));
       return e;
@@ -410,7 +442,77 @@ rtSendDocument(rapidjson::Document const& doc, int fd, sockaddr_storage const* d
 }
 
 rtError
-rtReadMessage(int fd, rtRemoteSocketBuffer& buff, rtRemoteMessagePtr& doc)
+rtSendFrame(int fd, char const* buff, int n, int timeout, int const* fds, int nfds)
+{
+  int flags = 0;
+  #ifndef __APPLE__
+  flags = MSG_NOSIGNAL;
+  #endif
+
+  std::vector<char> control;
+  if (nfds > 0)
+    control.resize(CMSG_SPACE(sizeof(int) * nfds));
+
+  while (n > 0)
+  {
+    ssize_t ret;
+    if (!control.empty())
+    {
+      iovec iov;
+      iov.iov_base = const_cast<char *>(buff);
+      iov.iov_len = n;
+
+      msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = &control[0];
+      msg.msg_controllen = control.size();
+
+      cmsghdr* c = CMSG_FIRSTHDR(&msg);
+      c->cmsg_level = SOL_SOCKET;
+      c->cmsg_type = SCM_RIGHTS;
+      c->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+      memcpy(CMSG_DATA(c), fds, sizeof(int) * nfds);
+
+      ret = ::sendmsg(fd, &msg, flags);
+      if (ret > 0)
+        control.clear();
+    }
+    else
+    {
+      ret = ::send(fd, buff, n, flags);
+    }
+
+    if (ret < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      // streams are non-blocking once they're registered with the selector,
+      // wait for the peer to drain its end
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        rtError e = rtWaitWritable(fd, timeout);
+        if (e == RT_OK)
+          continue;
+        rtLogError("failed to send message. %s", rtStrError(e));
+        return e;
+      }
+
+      rtError e = rtErrorFromErrno(errno);
+      rtLogError("failed to send message. %s", rtStrError(e));
+      return e;
+    }
+    buff += ret;
+    n -= static_cast<int>(ret);
+  }
+
+  return RT_OK;
+}
+
+rtError
+rtReadMessage(int fd, rtRemoteSocketBuffer& buff, rtRemoteMessagePtr& doc, rtRemoteWireCodec* codec)
 {
   rtError err = RT_OK;
 
@@ -441,6 +543,20 @@ rtReadMessage(int fd, rtRemoteSocketBuffer& buff, rtRemoteMessagePtr& doc)
     return err;
   }
 
+  if (rtRemoteWireFormatIsBinary(&buff[0], n))
+  {
+    #ifdef RT_RPC_DEBUG
+    rtLogDebug("read (%d): binary", n);
+    #endif
+
+    if (!codec)
+    {
+      rtLogWarn("binary message of length %d on a connection without a codec", n);
+      return RT_FAIL;
+    }
+    return codec->decode(&buff[0], n, doc);
+  }
+
   #ifdef RT_RPC_DEBUG
   rtLogDebug("read (%d):\n***IN***\t\"%.*s\"\n", static_cast<int>(buff.size()), static_cast<int>(buff.size()), &buff[0]);
   #endif
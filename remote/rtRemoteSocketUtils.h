@@ -35,8 +35,11 @@ limitations under the License.
 #define UNIX_PATH_MAX    108
 #endif
 
+class rtRemoteWireCodec;
+
 #define kInvalidSocket (-1)
 #define kUnixSocketTemplateRoot "/tmp/rt_remote_soc"
+#define kDefaultSendTimeout (3000)
 
 rtError rtParseAddress(sockaddr_storage& ss, char const* addr, uint16_t port, uint32_t* index);
 rtError rtParseAddress(sockaddr_storage& ss, char const* s);
@@ -46,12 +49,18 @@ rtError rtGetInetAddr(sockaddr_storage const& ss, void** addr);
 rtError rtGetPort(sockaddr_storage const& ss, uint16_t* port);
 rtError rtPushFd(fd_set* fds, int fd, int* maxFd);
 rtError rtReadUntil(int fd, char* buff, int n);
-rtError rtReadMessage(int fd, rtRemoteSocketBuffer& buff, rtRemoteMessagePtr& doc);
+rtError rtReadMessage(int fd, rtRemoteSocketBuffer& buff, rtRemoteMessagePtr& doc,
+  rtRemoteWireCodec* codec = nullptr);
 rtError rtParseMessage(char const* buff, int n, rtRemoteMessagePtr& doc);
 std::string rtSocketToString(sockaddr_storage const& ss);
 
 // this really doesn't belong here, but putting it here for now
-rtError rtSendDocument(rtRemoteMessage const& m, int fd, sockaddr_storage const* dest);
+rtError rtSendDocument(rtRemoteMessage const& m, int fd, sockaddr_storage const* dest,
+  int timeout = kDefaultSendTimeout);
+// writes a complete, already length prefixed frame to a stream socket. fds,
+// if any, go along with the first byte and need a unix domain socket. Gives
+// up with RT_ERROR_TIMEOUT if the peer makes no room for timeout milliseconds.
+rtError rtSendFrame(int fd, char const* buff, int n, int timeout, int const* fds = nullptr, int nfds = 0);
 rtError rtGetPeerName(int fd, sockaddr_storage& endpoint);
 rtError rtGetSockName(int fd, sockaddr_storage& endpoint);
 rtError	rtCloseSocket(int& fd);
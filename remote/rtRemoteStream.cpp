@@ -29,13 +29,23 @@ limitations under the License.
 
 #include <unistd.h>
 #include <errno.h>
+#include <sys/socket.h>
 #include <fcntl.h>
+#include <arpa/inet.h>
+#include <string.h>
 #include <rtLog.h>
 
 rtRemoteStream::rtRemoteStream(rtRemoteEnvironment* env, int fd, sockaddr_storage const& local_endpoint,
   sockaddr_storage const& remote_endpoint)
   : m_fd(fd)
   , m_env(env)
+  , m_wire_format(rtRemoteWireFormat::Json)
+  , m_recv_begin(0)
+  , m_recv_end(0)
+  , m_recv_length(-1)
+  , m_selector_id(0)
+  , m_shm_send(false)
+  , m_shm_event_fd(-1)
 {
   memcpy(&m_remote_endpoint, &remote_endpoint, sizeof(m_remote_endpoint));
   memcpy(&m_local_endpoint, &local_endpoint, sizeof(m_local_endpoint));
@@ -44,6 +54,8 @@ rtRemoteStream::rtRemoteStream(rtRemoteEnvironment* env, int fd, sockaddr_storag
 rtRemoteStream::~rtRemoteStream()
 {
   this->close();
+  for (int fd : m_received_fds)
+    ::close(fd);
 }
 
 rtError
@@ -57,6 +69,19 @@ rtRemoteStream::open()
 rtError
 rtRemoteStream::close()
 {
+  // stop watching the fd before it's closed and its number reused
+  if (m_selector_id != 0 && m_env->StreamSelector)
+    m_env->StreamSelector->unregisterStream(this);
+
+  // lets a writer stuck waiting for the peer to make room give up
+  rtRemoteShmChannelPtr shm;
+  {
+    std::unique_lock<std::mutex> lock(m_shm_mutex);
+    shm = m_shm;
+  }
+  if (shm)
+    shm->close();
+
   if (m_fd != kInvalidSocket)
   {
     // rtRemoteStreamSelector will remove dead streams on its own
@@ -123,22 +148,200 @@ rtRemoteStream::connectTo(sockaddr_storage const& endpoint)
   return RT_OK;
 }
 
+void
+rtRemoteStream::setWireFormat(rtRemoteWireFormat format)
+{
+  std::unique_lock<std::mutex> lock(m_send_mutex);
+  if (m_wire_format != format)
+  {
+    rtLogInfo("switching connection (%d) to %s messages", m_fd, rtRemoteWireFormatToString(format));
+    m_wire_format = format;
+  }
+}
+
+rtRemoteWireFormat
+rtRemoteStream::getWireFormat() const
+{
+  std::unique_lock<std::mutex> lock(m_send_mutex);
+  return m_wire_format;
+}
+
+rtError
+rtRemoteStream::attachShm(rtRemoteShmChannelPtr const& channel)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_shm_mutex);
+    if (m_shm)
+      return RT_ERROR_INVALID_ARG;
+    m_shm = channel;
+  }
+
+  rtError e = m_env->StreamSelector->watchShm(this, channel->eventFd());
+  if (e != RT_OK)
+  {
+    std::unique_lock<std::mutex> lock(m_shm_mutex);
+    m_shm.reset();
+  }
+  return e;
+}
+
+void
+rtRemoteStream::detachShm()
+{
+  m_env->StreamSelector->unwatchShm(this);
+
+  std::unique_lock<std::mutex> lock(m_shm_mutex);
+  if (!m_shm_send)
+    m_shm.reset();
+}
+
+rtError
+rtRemoteStream::switchToShm()
+{
+  std::unique_lock<std::mutex> lock(m_send_mutex);
+  if (m_shm_send)
+    return RT_OK;
+
+  {
+    std::unique_lock<std::mutex> shmLock(m_shm_mutex);
+    if (!m_shm)
+      return RT_ERROR_INVALID_ARG;
+  }
+
+  // an empty frame tells the peer that everything after it is in the channel
+  uint32_t n = 0;
+  rtError e = rtSendFrame(m_fd, reinterpret_cast<char const *>(&n), sizeof(n),
+    m_env->Config->stream_send_timeout());
+  if (e != RT_OK)
+    return e;
+
+  rtLogInfo("switching connection (%d) to shared memory", m_fd);
+
+  std::unique_lock<std::mutex> shmLock(m_shm_mutex);
+  m_shm_send = true;
+  return RT_OK;
+}
+
+bool
+rtRemoteStream::hasShm() const
+{
+  std::unique_lock<std::mutex> lock(m_shm_mutex);
+  return m_shm != nullptr;
+}
+
+std::vector<int>
+rtRemoteStream::takeReceivedFds()
+{
+  std::vector<int> fds;
+  std::unique_lock<std::mutex> lock(m_received_fds_mutex);
+  fds.swap(m_received_fds);
+  return fds;
+}
+
+rtError
+rtRemoteStream::sendMessage(rtRemoteMessage const& msg, int const* fds, int nfds)
+{
+  // the codec's intern table must see messages in the order they hit the
+  // socket, so encoding and sending happen under one lock
+  std::unique_lock<std::mutex> lock(m_send_mutex);
+
+  m_send_buffer.resize(sizeof(uint32_t));
+  rtError e = m_codec.encode(msg, m_wire_format, m_send_buffer);
+  if (e != RT_OK)
+  {
+    rtLogError("failed to encode message. %s", rtStrError(e));
+    return e;
+  }
+
+  uint32_t n = htonl(static_cast<uint32_t>(m_send_buffer.size() - sizeof(uint32_t)));
+  memcpy(&m_send_buffer[0], &n, sizeof(n));
+
+  #ifdef RT_RPC_DEBUG
+  if (m_wire_format == rtRemoteWireFormat::Binary)
+  {
+    rtLogDebug("send [%d/%s] (%d): binary", m_fd, rtSocketToString(m_remote_endpoint).c_str(),
+      static_cast<int>(m_send_buffer.size() - sizeof(uint32_t)));
+  }
+  else
+  {
+    rtLogDebug("send [%d/%s] (%d):\n***OUT***\t\"%.*s\"\n", m_fd, rtSocketToString(m_remote_endpoint).c_str(),
+      static_cast<int>(m_send_buffer.size() - sizeof(uint32_t)),
+      static_cast<int>(m_send_buffer.size() - sizeof(uint32_t)),
+      &m_send_buffer[sizeof(uint32_t)]);
+  }
+  #endif
+
+  rtRemoteShmChannelPtr shm;
+  if (m_shm_send)
+  {
+    std::unique_lock<std::mutex> shmLock(m_shm_mutex);
+    shm = m_shm;
+  }
+
+  if (shm)
+  {
+    e = shm->write(&m_send_buffer[sizeof(uint32_t)],
+      static_cast<uint32_t>(m_send_buffer.size() - sizeof(uint32_t)),
+      m_env->Config->stream_send_timeout());
+
+    // the peer stopped reading. Same as a stuck socket, give up on the
+    // connection rather than hold the send lock forever.
+    if (e == RT_ERROR_TIMEOUT)
+    {
+      shm->close();
+      ::shutdown(m_fd, SHUT_RDWR);
+    }
+  }
+  else
+  {
+    e = rtSendFrame(m_fd, &m_send_buffer[0], static_cast<int>(m_send_buffer.size()),
+      m_env->Config->stream_send_timeout(), fds, nfds);
+
+    // part of the frame may have gone out, so nothing sent after it would
+    // line up. Drop the connection, the selector cleans up the stream.
+    if (e == RT_ERROR_TIMEOUT)
+      ::shutdown(m_fd, SHUT_RDWR);
+  }
+
+  if (e == RT_OK)
+    m_env->BytesSent += m_send_buffer.size();
+
+  // don't hang on to the odd huge message
+  if (m_send_buffer.capacity() > static_cast<size_t>(m_env->Config->stream_socket_buffer_size()))
+    rtRemoteSocketBuffer().swap(m_send_buffer);
+
+  return e;
+}
+
 rtError
 rtRemoteStream::send(rtRemoteMessagePtr const& msg)
 {
-  return rtSendDocument(*msg, m_fd, nullptr);
+  return sendMessage(*msg);
 }
 
 rtRemoteAsyncHandle
-rtRemoteStream::sendWithWait(rtRemoteMessagePtr const& msg, rtRemoteCorrelationKey k)
+rtRemoteStream::sendWithWait(rtRemoteMessagePtr const& msg, rtRemoteCorrelationKey k,
+  int const* fds, int nfds)
 {
   rtRemoteAsyncHandle asyncHandle(m_env, k);
-  rtError e = rtSendDocument(*msg, m_fd, nullptr);
+  rtError e = sendMessage(*msg, fds, nfds);
   if (e != RT_OK)
     asyncHandle.complete(rtRemoteMessagePtr(), e);
   return asyncHandle;
 }
 
+std::shared_ptr<rtRemoteAsyncHandle>
+rtRemoteStream::sendAsync(rtRemoteMessagePtr const& msg, rtRemoteCorrelationKey k)
+{
+  // the registered response handler points at the handle, it can't move
+  // while the request is outstanding
+  std::shared_ptr<rtRemoteAsyncHandle> handle(new rtRemoteAsyncHandle(m_env, k));
+  rtError e = sendMessage(*msg);
+  if (e != RT_OK)
+    handle->complete(rtRemoteMessagePtr(), e);
+  return handle;
+}
+
 rtError
 rtRemoteStream::onInactivity()
 {
@@ -155,29 +358,246 @@ rtRemoteStream::onInactivity()
 
 
 rtError
-rtRemoteStream::onIncomingMessage(rtRemoteSocketBuffer& buff)
+rtRemoteStream::onClosed()
 {
   std::shared_ptr<CallbackHandler> handler = m_callback_handler.lock();
+  if (handler)
+  {
+    auto self = shared_from_this();
+    rtError err = handler->onStateChanged(self, State::Closed);
+    if (err != RT_OK)
+      rtLogWarn("failed to invoke state changed handler. %s", rtStrError(err));
+  }
 
-  rtRemoteMessagePtr doc = nullptr;
-  rtError e = rtReadMessage(m_fd, buff, doc);
-  if (e != RT_OK)
+  // return an error back to the caller so they know that that stream is dead
+  return rtErrorFromErrno(ENOTCONN);
+}
+
+ssize_t
+rtRemoteStream::receive(void* buff, size_t n)
+{
+  // a peer asking for the shared memory transport sends its fds along with
+  // the request
+  union
   {
-    if (e == rtErrorFromErrno(ENOTCONN) && handler)
-    { 
-      auto self = shared_from_this();
-      rtError err = handler->onStateChanged(self, State::Closed);
-      if (err != RT_OK)
-        rtLogWarn("failed to invoke state changed handler. %s", rtStrError(err));
+    char buff[CMSG_SPACE(sizeof(int) * rtRemoteShmChannel::kNumFds)];
+    cmsghdr align;
+  } control;
+
+  iovec iov;
+  iov.iov_base = buff;
+  iov.iov_len = n;
+
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buff;
+  msg.msg_controllen = sizeof(control.buff);
+
+  ssize_t ret = ::recvmsg(m_fd, &msg, MSG_CMSG_CLOEXEC);
+  if (ret <= 0 || msg.msg_controllen == 0)
+    return ret;
+
+  for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c != nullptr; c = CMSG_NXTHDR(&msg, c))
+  {
+    if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+      continue;
+
+    int const* fds = reinterpret_cast<int const *>(CMSG_DATA(c));
+    size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
 
-      // return the error back to the caller so they know that that stream is dead
+    // fds only come with a session open, and only the last set is used.
+    // Close older ones so a peer can't pile descriptors up on us.
+    std::unique_lock<std::mutex> lock(m_received_fds_mutex);
+    m_received_fds.insert(m_received_fds.end(), fds, fds + count);
+
+    size_t const keep = static_cast<size_t>(rtRemoteShmChannel::kNumFds);
+    if (m_received_fds.size() > keep)
+    {
+      size_t const drop = m_received_fds.size() - keep;
+      rtLogWarn("closing %d unclaimed fds from connection (%d)", static_cast<int>(drop), m_fd);
+      for (size_t i = 0; i < drop; ++i)
+        ::close(m_received_fds[i]);
+      m_received_fds.erase(m_received_fds.begin(), m_received_fds.begin() + drop);
+    }
+  }
+
+  return ret;
+}
+
+rtError
+rtRemoteStream::dispatchFrame(std::shared_ptr<CallbackHandler> const& handler, char const* payload, int length)
+{
+  m_env->BytesReceived += sizeof(uint32_t) + length;
+
+  #ifdef RT_RPC_DEBUG
+  if (rtRemoteWireFormatIsBinary(payload, length))
+    rtLogDebug("read (%d): binary", length);
+  else
+    rtLogDebug("read (%d):\n***IN***\t\"%.*s\"\n", length, length, payload);
+  #endif
+
+  rtRemoteMessagePtr doc;
+  rtError e = m_codec.decode(payload, length, doc);
+  if (e != RT_OK)
+  {
+    // a binary frame we can't decode may have interned keys, after which
+    // the peer's table and ours no longer agree. A bad json message is
+    // just dropped.
+    if (rtRemoteWireFormatIsBinary(payload, length))
+    {
+      rtLogError("failed to decode binary message on fd %d. %s", m_fd, rtStrError(e));
       return e;
     }
     rtLogDebug("failed to read message. %s", rtStrError(e));
   }
+  else if (handler)
+  {
+    handler->onMessage(doc);
+  }
+
+  return RT_OK;
+}
+
+rtError
+rtRemoteStream::onReadable(bool& more, bool readable)
+{
+  static size_t const kMinRead = 4096;
+  static size_t const kMaxReadPerWakeup = 256 * 1024;
+  static size_t const kMaxIdleBufferSize = 64 * 1024;
 
-  if (e == RT_OK && handler)
-    e = handler->onMessage(doc);
+  more = false;
+  if (m_fd == kInvalidSocket)
+    return rtErrorFromErrno(ENOTCONN);
+
+  std::shared_ptr<CallbackHandler> handler = m_callback_handler.lock();
+  int64_t const maxMessageSize = m_env->Config->stream_socket_buffer_size();
+  size_t total = 0;
+
+  while (readable)
+  {
+    // make room for the rest of the current message, or at least kMinRead
+    if (m_recv_begin == m_recv_end)
+    {
+      m_recv_begin = m_recv_end = 0;
+    }
+    else if (m_recv_begin > 0)
+    {
+      memmove(&m_recv_buffer[0], &m_recv_buffer[m_recv_begin], m_recv_end - m_recv_begin);
+      m_recv_end -= m_recv_begin;
+      m_recv_begin = 0;
+    }
+
+    size_t want = kMinRead;
+    if (m_recv_length > 0 && static_cast<size_t>(m_recv_length) > m_recv_end + want)
+      want = static_cast<size_t>(m_recv_length) - m_recv_end;
+    if (m_recv_buffer.size() - m_recv_end < want)
+      m_recv_buffer.resize(m_recv_end + want);
+
+    ssize_t n = receive(&m_recv_buffer[m_recv_end], m_recv_buffer.size() - m_recv_end);
+    if (n == 0)
+      return onClosed();
+
+    if (n == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+
+      rtError e = rtErrorFromErrno(errno);
+      rtLogWarn("failed to read from fd %d. %s", m_fd, rtStrError(e));
+      onClosed();
+      return e;
+    }
+
+    m_recv_end += n;
+    total += n;
+
+    // dispatch every complete message
+    while (true)
+    {
+      size_t available = m_recv_end - m_recv_begin;
+      if (m_recv_length < 0)
+      {
+        uint32_t length;
+        if (available < sizeof(length))
+          break;
+
+        memcpy(&length, &m_recv_buffer[m_recv_begin], sizeof(length));
+        m_recv_length = ntohl(length);
+        m_recv_begin += sizeof(length);
+        available -= sizeof(length);
+
+        // the peer moved to the shared memory channel
+        if (m_recv_length == 0 && !m_shm_recv)
+        {
+          std::unique_lock<std::mutex> lock(m_shm_mutex);
+          m_shm_recv = m_shm;
+          lock.unlock();
+
+          if (m_shm_recv)
+          {
+            m_recv_length = -1;
+            continue;
+          }
+        }
+
+        if (m_recv_length == 0 || m_recv_length > maxMessageSize)
+        {
+          rtLogWarn("invalid message size %d on fd %d", static_cast<int>(m_recv_length), m_fd);
+          onClosed();
+          return RT_FAIL;
+        }
+      }
+
+      if (available < static_cast<size_t>(m_recv_length))
+        break;
+
+      char const* payload = &m_recv_buffer[m_recv_begin];
+      int length = static_cast<int>(m_recv_length);
+      m_recv_begin += length;
+      m_recv_length = -1;
+
+      rtError e = dispatchFrame(handler, payload, length);
+      if (e != RT_OK)
+      {
+        onClosed();
+        return e;
+      }
+    }
+
+    if (total >= kMaxReadPerWakeup)
+    {
+      more = true;
+      break;
+    }
+  }
+
+  if (m_recv_begin == m_recv_end && m_recv_buffer.size() > kMaxIdleBufferSize)
+  {
+    rtRemoteSocketBuffer().swap(m_recv_buffer);
+    m_recv_begin = m_recv_end = 0;
+  }
+
+  // frames in the channel are decoded where they are
+  if (m_shm_recv)
+  {
+    bool moreShm = false;
+    rtError e = m_shm_recv->read([this, &handler](char const* payload, int length)
+    {
+      return dispatchFrame(handler, payload, length);
+    }, kMaxReadPerWakeup, moreShm);
+
+    if (e != RT_OK)
+    {
+      rtLogWarn("failed to read from shared memory on fd %d. %s", m_fd, rtStrError(e));
+      onClosed();
+      return e;
+    }
+    more = more || moreShm;
+  }
 
   return RT_OK;
 }
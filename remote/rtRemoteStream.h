@@ -23,12 +23,16 @@ limitations under the License.
 #include "rtRemoteSocketUtils.h"
 #include "rtRemoteAsyncHandle.h"
 #include "rtRemoteCallback.h"
+#include "rtRemoteShmTransport.h"
+#include "rtRemoteWireFormat.h"
 
+#include <atomic>
 #include <deque>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 class rtRemoteStreamSelector;
 
@@ -66,10 +70,30 @@ public:
   rtError connect();
   rtError connectTo(sockaddr_storage const& endpoint);
   rtError send(rtRemoteMessagePtr const& msg);
-  rtRemoteAsyncHandle sendWithWait(rtRemoteMessagePtr const& msg, rtRemoteCorrelationKey k);
+  rtRemoteAsyncHandle sendWithWait(rtRemoteMessagePtr const& msg, rtRemoteCorrelationKey k,
+    int const* fds = nullptr, int nfds = 0);
+  std::shared_ptr<rtRemoteAsyncHandle> sendAsync(rtRemoteMessagePtr const& msg, rtRemoteCorrelationKey k);
 
   rtError setCallbackHandler(std::shared_ptr<CallbackHandler> const& callbackHandler);
 
+  // format used for outgoing messages. Incoming messages are accepted in
+  // either format, so the two ends may switch independently.
+  void setWireFormat(rtRemoteWireFormat format);
+  rtRemoteWireFormat getWireFormat() const;
+
+  // shared memory transport. The channel is attached first so the stream can
+  // read from it as soon as the peer switches over, which the peer announces
+  // with an empty frame on the socket. After switchToShm() every frame this
+  // side sends goes through the channel; the socket stays open to notice the
+  // peer going away.
+  rtError attachShm(rtRemoteShmChannelPtr const& channel);
+  void detachShm();
+  rtError switchToShm();
+  bool hasShm() const;
+
+  // fds passed by the peer over a unix domain socket, in the order they came
+  std::vector<int> takeReceivedFds();
+
   inline bool isOpen() const
     { return m_fd != kInvalidSocket; }
 
@@ -80,8 +104,15 @@ public:
     { return m_remote_endpoint; }
 
 private:
-  rtError onIncomingMessage(rtRemoteSocketBuffer& buff);
+  // reads everything available on the socket and dispatches each complete
+  // message. Sets more when it stopped early to let other streams run.
+  // readable is false when only the shared memory channel woke us up.
+  rtError onReadable(bool& more, bool readable = true);
+  rtError onClosed();
   rtError onInactivity();
+  rtError sendMessage(rtRemoteMessage const& msg, int const* fds = nullptr, int nfds = 0);
+  rtError dispatchFrame(std::shared_ptr<CallbackHandler> const& handler, char const* payload, int length);
+  ssize_t receive(void* buff, size_t n);
 
 private:
   int                                   m_fd;
@@ -89,6 +120,28 @@ private:
   sockaddr_storage                      m_local_endpoint;
   sockaddr_storage                      m_remote_endpoint;
   rtRemoteEnvironment*                  m_env;
+  rtRemoteWireFormat                    m_wire_format;
+  rtRemoteWireCodec                     m_codec;
+  rtRemoteSocketBuffer                  m_send_buffer;
+  std::mutex mutable                    m_send_mutex;
+
+  // owned by the selector thread. Bytes [m_recv_begin, m_recv_end) have been
+  // read but not dispatched yet; m_recv_length is the length of the message
+  // at m_recv_begin once its prefix has been read, -1 before that.
+  rtRemoteSocketBuffer                  m_recv_buffer;
+  size_t                                m_recv_begin;
+  size_t                                m_recv_end;
+  int64_t                               m_recv_length;
+  std::atomic<uint64_t>                 m_selector_id;
+
+  rtRemoteShmChannelPtr                 m_shm;
+  bool                                  m_shm_send;
+  std::mutex mutable                    m_shm_mutex;
+  std::atomic<int>                      m_shm_event_fd;
+  // owned by the selector thread, set once the peer has switched
+  rtRemoteShmChannelPtr                 m_shm_recv;
+  std::vector<int>                      m_received_fds;
+  std::mutex                            m_received_fds_mutex;
 };
 
 #endif
@@ -18,26 +18,81 @@ limitations under the License.
 
 #include "rtRemoteStreamSelector.h"
 #include "rtRemoteConfig.h"
+#include "rtRemoteEnvironment.h"
 #include "rtRemoteStream.h"
 #include "rtRemoteSocketUtils.h"
 #include "rtError.h"
 #include "rtLog.h"
 
 #include <algorithm>
-#include <chrono>
 #include <unistd.h>
 #include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+namespace
+{
+  // epoll_event.data for the two fds that aren't streams. Stream ids start
+  // after these.
+  uint64_t const kShutdownId = 0;
+  uint64_t const kTimerId = 1;
+  uint64_t const kFirstStreamId = 2;
+
+  // set in the id of a stream's shared memory eventfd
+  uint64_t const kShmEventBit = 1ull << 63;
+
+  int const kMaxEvents = 256;
+}
 
 rtRemoteStreamSelector::rtRemoteStreamSelector(rtRemoteEnvironment* env)
-  : m_env(env)
+  : m_next_id(kFirstStreamId)
+  , m_epoll_fd(-1)
+  , m_timer_fd(-1)
+  , m_env(env)
   , m_running(false)
 {
   int ret = pipe2(m_shutdown_pipe, O_CLOEXEC);
   if (ret == -1)
   {
-    rtError e = rtErrorFromErrno(ret);
+    rtError e = rtErrorFromErrno(errno);
     rtLogError("failed to create pipe. %s", rtStrError(e));
   }
+
+  m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (m_epoll_fd == -1)
+  {
+    rtError e = rtErrorFromErrno(errno);
+    rtLogError("failed to create epoll set. %s", rtStrError(e));
+  }
+
+  m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (m_timer_fd == -1)
+  {
+    rtError e = rtErrorFromErrno(errno);
+    rtLogError("failed to create keep alive timer. %s", rtStrError(e));
+  }
+
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u64 = kShutdownId;
+  epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_shutdown_pipe[0], &ev);
+
+  if (m_timer_fd != -1)
+  {
+    ev.events = EPOLLIN;
+    ev.data.u64 = kTimerId;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_timer_fd, &ev);
+  }
+}
+
+rtRemoteStreamSelector::~rtRemoteStreamSelector()
+{
+  if (m_timer_fd != -1)
+    ::close(m_timer_fd);
+  if (m_epoll_fd != -1)
+    ::close(m_epoll_fd);
 }
 
 void*
@@ -53,6 +108,20 @@ rtRemoteStreamSelector::pollFds(void* argp)
 rtError
 rtRemoteStreamSelector::start()
 {
+  int interval = m_env->Config->stream_keep_alive_interval();
+  if (m_timer_fd != -1 && interval > 0)
+  {
+    itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_sec = interval;
+    spec.it_value.tv_sec = interval;
+    if (timerfd_settime(m_timer_fd, 0, &spec, nullptr) == -1)
+    {
+      rtError e = rtErrorFromErrno(errno);
+      rtLogError("failed to start keep alive timer. %s", rtStrError(e));
+    }
+  }
+
   m_running = true;
   rtLogInfo("starting StreamSelector");
   pthread_create(&m_thread, nullptr, &rtRemoteStreamSelector::pollFds, this);
@@ -61,10 +130,102 @@ rtRemoteStreamSelector::start()
 
 rtError
 rtRemoteStreamSelector::registerStream(std::shared_ptr<rtRemoteStream> const& s)
+{
+  // edge triggered, the stream reads until the socket would block
+  int flags = fcntl(s->m_fd, F_GETFL);
+  if (flags == -1 || fcntl(s->m_fd, F_SETFL, flags | O_NONBLOCK) == -1)
+  {
+    rtError e = rtErrorFromErrno(errno);
+    rtLogError("failed to make fd %d non-blocking. %s", s->m_fd, rtStrError(e));
+    return e;
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  uint64_t id = m_next_id++;
+
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+  ev.data.u64 = id;
+
+  // the stream has to be in the map before the first event can arrive
+  s->m_selector_id = id;
+  m_streams.insert(StreamMap::value_type(id, s));
+
+  if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, s->m_fd, &ev) == -1)
+  {
+    rtError e = rtErrorFromErrno(errno);
+    rtLogError("failed to add fd %d to epoll set. %s", s->m_fd, rtStrError(e));
+    m_streams.erase(id);
+    s->m_selector_id = 0;
+    return e;
+  }
+
+  return RT_OK;
+}
+
+rtError
+rtRemoteStreamSelector::unregisterStream(rtRemoteStream* s)
+{
+  std::shared_ptr<rtRemoteStream> removed;
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  uint64_t id = s->m_selector_id.exchange(0);
+  if (id == 0)
+    return RT_OK;
+
+  if (s->m_fd != kInvalidSocket)
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, s->m_fd, nullptr);
+
+  int eventFd = s->m_shm_event_fd.exchange(-1);
+  if (eventFd != -1)
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, eventFd, nullptr);
+
+  auto itr = m_streams.find(id);
+  if (itr != m_streams.end())
+  {
+    // the last reference may be ours, let it go once the lock is released
+    removed = std::move(itr->second);
+    m_streams.erase(itr);
+  }
+  lock.unlock();
+
+  return RT_OK;
+}
+
+rtError
+rtRemoteStreamSelector::watchShm(rtRemoteStream* s, int eventFd)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  uint64_t id = s->m_selector_id;
+  if (id == 0)
+    return RT_ERROR_INVALID_ARG;
+
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.u64 = id | kShmEventBit;
+
+  if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, eventFd, &ev) == -1)
+  {
+    rtError e = rtErrorFromErrno(errno);
+    rtLogError("failed to add eventfd %d to epoll set. %s", eventFd, rtStrError(e));
+    return e;
+  }
+
+  s->m_shm_event_fd = eventFd;
+  return RT_OK;
+}
+
+rtError
+rtRemoteStreamSelector::unwatchShm(rtRemoteStream* s)
 {
   std::unique_lock<std::mutex> lock(m_mutex);
-  m_streams.push_back(s);
-  m_streams_cond.notify_all();
+  int eventFd = s->m_shm_event_fd.exchange(-1);
+  if (eventFd != -1)
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, eventFd, nullptr);
   return RT_OK;
 }
 
@@ -76,10 +237,8 @@ rtRemoteStreamSelector::shutdown()
   {
     std::unique_lock<std::mutex> lock(m_mutex);
     m_running = false;
-    m_streams_cond.notify_all();
   }
 
-
   rtLogInfo("sending shutdown signal");
   ssize_t n = write(m_shutdown_pipe[1], buff, sizeof(buff));
   if (n == -1)
@@ -94,119 +253,134 @@ rtRemoteStreamSelector::shutdown()
   ::close(m_shutdown_pipe[0]);
   ::close(m_shutdown_pipe[1]);
 
+  // streams outliving the selector must not try to unregister
+  StreamMap streams;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    streams.swap(m_streams);
+  }
+  for (auto& itr : streams)
+    itr.second->m_selector_id = 0;
+  streams.clear();
+
   return RT_OK;
 }
 
-rtError
-rtRemoteStreamSelector::doPollFds()
+void
+rtRemoteStreamSelector::onKeepAliveTimer()
 {
-  rtRemoteSocketBuffer buff;
-  buff.reserve(m_env->Config->stream_socket_buffer_size());
+  uint64_t expirations = 0;
+  while (read(m_timer_fd, &expirations, sizeof(expirations)) == -1 && errno == EINTR)
+    ;
 
-  const auto keepAliveInterval = std::chrono::seconds(m_env->Config->stream_keep_alive_interval());
-  auto lastKeepAliveSent = std::chrono::steady_clock::now();
-
-  while (true)
+  std::vector< std::shared_ptr<rtRemoteStream> > streams;
   {
-    int maxFd = 0;
-
-    fd_set readFds;
-    fd_set errFds;
-
-    FD_ZERO(&readFds);
-    FD_ZERO(&errFds);
-
-    {
     std::unique_lock<std::mutex> lock(m_mutex);
-    m_streams_cond.wait(lock, [&]() {return !m_streams.empty() || !m_running;});
-
-    if (!m_running)
-      return RT_OK;
-
-    // remove dead streams
+    streams.reserve(m_streams.size());
+    for (auto itr = m_streams.begin(); itr != m_streams.end(); )
     {
-      auto itr = std::remove_if(m_streams.begin(), m_streams.end(),
-          [](std::shared_ptr<rtRemoteStream> const& s)
-          {
-            return !s->isOpen();
-          });
-
-      if (itr != m_streams.end())
-        m_streams.erase(itr);
+      // streams closed without being unregistered
+      if (!itr->second->isOpen())
+      {
+        itr->second->m_selector_id = 0;
+        itr = m_streams.erase(itr);
+      }
+      else
+      {
+        streams.push_back(itr->second);
+        ++itr;
+      }
     }
+  }
 
-    for (auto const& s : m_streams)
-    {
-      rtPushFd(&readFds, s->m_fd, &maxFd);
-      rtPushFd(&errFds, s->m_fd, &maxFd);
-    }
-    }
-    rtPushFd(&readFds, m_shutdown_pipe[0], &maxFd);
+  for (auto const& s : streams)
+  {
+    // This really isn't inactivity, it's more like a timer event
+    rtError e = s->onInactivity();
+    if (e != RT_OK)
+      rtLogWarn("error sending keep alive. %s", rtStrError(e));
+  }
+}
 
-    timeval timeout;
-    timeout.tv_sec = m_env->Config->stream_select_interval();
-    timeout.tv_usec = 0;
+rtError
+rtRemoteStreamSelector::doPollFds()
+{
+  epoll_event events[kMaxEvents];
+
+  // streams that stopped reading to give others a turn. With edge triggered
+  // events nothing will wake us up for them, so they go first next time.
+  std::vector< std::shared_ptr<rtRemoteStream> > pending;
 
-    int ret = select(maxFd + 1, &readFds, NULL, &errFds, &timeout);
-    if (ret == -1)
+  // and whether the socket, as opposed to just the shared memory channel,
+  // has something for them
+  std::vector< std::pair<std::shared_ptr<rtRemoteStream>, bool> > ready;
+
+  while (true)
+  {
+    int n = epoll_wait(m_epoll_fd, events, kMaxEvents, pending.empty() ? -1 : 0);
+    if (n == -1)
     {
+      if (errno == EINTR)
+        continue;
       rtError e = rtErrorFromErrno(errno);
-      rtLogWarn("select failed: %s", rtStrError(e));
-      continue;
+      rtLogWarn("epoll_wait failed: %s", rtStrError(e));
+      return e;
     }
 
-    if (FD_ISSET(m_shutdown_pipe[0], &readFds))
-    {
-      rtLogInfo("got shutdown signal");
-      return RT_OK;
-    }
+    bool keepAlive = false;
 
-    auto now = std::chrono::steady_clock::now();
-    bool sentKeepAlive = false;
+    for (auto& s : pending)
+      ready.push_back(std::make_pair(s, true));
+    pending.clear();
 
-    std::unique_lock<std::mutex> lock(m_mutex);
-    for (int i = 0, n = static_cast<int>(m_streams.size()); i < n; ++i)
     {
-      rtError e = RT_OK;
-      std::shared_ptr<rtRemoteStream> s = m_streams[i];
-      if (FD_ISSET(s->m_fd, &readFds))
+      std::unique_lock<std::mutex> lock(m_mutex);
+      if (!m_running)
+        return RT_OK;
+
+      for (int i = 0; i < n; ++i)
       {
-        e = s->onIncomingMessage(buff);
-        if (e != RT_OK)
+        uint64_t id = events[i].data.u64;
+        if (id == kShutdownId)
         {
-          rtLogWarn("error dispatching message. %s", rtStrError(e));
-          m_streams[i].reset();
-          s.reset();
+          rtLogInfo("got shutdown signal");
+          return RT_OK;
         }
-      }
-      else if (FD_ISSET(s->m_fd, &errFds))
-      {
-        // TODO
-        rtLogError("error on fd: %d", s->m_fd);
-      }
 
-      if (s && s->isOpen() && (now - lastKeepAliveSent) > keepAliveInterval)
-      {
-        sentKeepAlive = true;
+        if (id == kTimerId)
+        {
+          keepAlive = true;
+          continue;
+        }
 
-        // This really isn't inactivity, it's more like a timer enve
-        e = s->onInactivity();
-        if (e != RT_OK)
-          rtLogWarn("error sending keep alive. %s", rtStrError(e));
+        auto itr = m_streams.find(id & ~kShmEventBit);
+        if (itr != m_streams.end())
+          ready.push_back(std::make_pair(itr->second, (id & kShmEventBit) == 0));
       }
     }
 
-    if (sentKeepAlive)
+    // dispatch without holding the lock, handlers are free to open or close
+    // streams
+    for (auto& r : ready)
     {
-      lastKeepAliveSent = now;
+      std::shared_ptr<rtRemoteStream> const& s = r.first;
+      bool more = false;
+      rtError e = s->onReadable(more, r.second);
+      if (e != RT_OK)
+      {
+        rtLogDebug("error dispatching message. %s", rtStrError(e));
+        unregisterStream(s.get());
+      }
+      else if (more)
+      {
+        if (std::find(pending.begin(), pending.end(), s) == pending.end())
+          pending.push_back(s);
+      }
     }
+    ready.clear();
 
-    // remove all dead streams
-    auto end = std::remove_if(m_streams.begin(), m_streams.end(),
-        [](std::shared_ptr<rtRemoteStream> const& s) { return s == nullptr; });
-    m_streams.erase(end, m_streams.end());
-    // rtLogDebug("streams size:%d", (int) m_streams.size());
-    lock.unlock();
+    if (keepAlive)
+      onKeepAliveTimer();
   }
 
   return RT_OK;
@@ -23,32 +23,47 @@ limitations under the License.
 
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <thread>
-#include <condition_variable>
 
 class rtRemoteStream;
 class rtRemoteEnvironment;
 
+// Waits for input on every open rtRemoteStream with one edge triggered epoll
+// set and hands readable streams to rtRemoteStream::onReadable(). A timerfd
+// in the same set drives keep-alives, so there's no polling interval and no
+// limit on the number of streams other than the process' fd limit. Streams on
+// the shared memory transport are also woken by their channel's eventfd.
 class rtRemoteStreamSelector
 {
 public:
   rtRemoteStreamSelector(rtRemoteEnvironment* env);
+  ~rtRemoteStreamSelector();
 
   rtError start();
   rtError registerStream(std::shared_ptr<rtRemoteStream> const& s);
+  rtError unregisterStream(rtRemoteStream* s);
+
+  // also wakes the stream when its shared memory channel has frames
+  rtError watchShm(rtRemoteStream* s, int eventFd);
+  rtError unwatchShm(rtRemoteStream* s);
   rtError shutdown();
 
 private:
   static void* pollFds(void* argp);
   rtError doPollFds();
+  void onKeepAliveTimer();
 
 private:
-  // TODO: should this be std::weak_ptr
-  std::vector< std::shared_ptr<rtRemoteStream> >  m_streams;
+  using StreamMap = std::unordered_map< uint64_t, std::shared_ptr<rtRemoteStream> >;
+
+  StreamMap                                       m_streams;
+  uint64_t                                        m_next_id;
   pthread_t                                       m_thread;
   std::mutex                                      m_mutex;
-  std::condition_variable                         m_streams_cond;
+  int                                             m_epoll_fd;
+  int                                             m_timer_fd;
   int                                             m_shutdown_pipe[2];
   rtRemoteEnvironment*                            m_env;
   bool                                            m_running;
@@ -0,0 +1,674 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "rtRemoteWireFormat.h"
+#include "rtRemoteSocketUtils.h"
+
+#include <rtLog.h>
+#include <rtObject.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include <rapidjson/writer.h>
+
+namespace
+{
+  enum Tag : uint8_t
+  {
+    kTagNull = 0x00,
+    kTagFalse,
+    kTagTrue,
+    kTagInt,            // zigzag varint, negative numbers only
+    kTagUInt,           // varint
+    kTagDouble,         // 8 bytes, little endian
+    kTagString,         // varint length, bytes
+    kTagStringDefine,   // same as kTagString, and assigns the next intern id
+    kTagStringRef,      // varint intern id
+    kTagGuid,           // 16 bytes, lower case canonical form when decoded
+    kTagObject,         // varint member count, (string, value)*
+    kTagArray,          // varint element count, value*
+    kTagTypedValue,     // rtValue type, value
+    kTagTypedVoid       // rtValue type
+  };
+
+  // Strings both ends of a connection know up front. The ids are part of the
+  // protocol, so new entries may only be appended. Values of the members
+  // named by the first kInternedValueKeys entries are interned too.
+  char const* const kStaticStrings[] =
+  {
+    kFieldNameMessageType,
+    kFieldNameObjectId,
+    kFieldNamePropertyName,
+    kFieldNameFunctionName,
+    kFieldNameCorrelationKey,
+    kFieldNamePropertyIndex,
+    kFieldNameStatusCode,
+    kFieldNameStatusMessage,
+    kFieldNameFunctionIndex,
+    kFieldNameFunctionArgs,
+    kFieldNameFunctionReturn,
+    kFieldNameValue,
+    kFieldNameValueType,
+    kFieldNameSenderId,
+    kFieldNameKeepAliveIds,
+    kFieldNameWireFormat,
+    kNullObjectId,
+    "global",
+    kMessageTypeInvalidResponse,
+    kMessageTypeSetByNameRequest,
+    kMessageTypeSetByNameResponse,
+    kMessageTypeSetByIndexRequest,
+    kMessageTypeSetByIndexResponse,
+    kMessageTypeGetByNameRequest,
+    kMessageTypeGetByNameResponse,
+    kMessageTypeGetByIndexRequest,
+    kMessageTypeGetByIndexResponse,
+    kMessageTypeOpenSessionResponse,
+    kMessageTypeMethodCallResponse,
+    kMessageTypeKeepAliveResponse,
+    kMessageTypeMethodCallRequest,
+    kMessageTypeKeepAliveRequest,
+    kMessageTypeOpenSessionRequest,
+    kWireFormatBinary
+  };
+
+  uint32_t const kStaticStringCount = sizeof(kStaticStrings) / sizeof(kStaticStrings[0]);
+  uint32_t const kInternedValueKeys = 4;
+  uint32_t const kMaxInternedStrings = 4096;
+  uint32_t const kMaxInternedLength = 128;
+  uint32_t const kNotInterned = UINT32_MAX;
+  int const kMaxDepth = 32;
+
+  rtRemoteWireCodec::InternMap const& staticStrings()
+  {
+    static rtRemoteWireCodec::InternMap const m = []
+    {
+      rtRemoteWireCodec::InternMap m;
+      for (uint32_t i = 0; i < kStaticStringCount; ++i)
+      {
+        rtRemoteWireCodec::Key k = { kStaticStrings[i], static_cast<uint32_t>(strlen(kStaticStrings[i])) };
+        m.insert(rtRemoteWireCodec::InternMap::value_type(k, i));
+      }
+      return m;
+    }();
+    return m;
+  }
+
+  struct rtRemoteSocketBufferStream
+  {
+    using Ch = char;
+
+    rtRemoteSocketBufferStream(rtRemoteSocketBuffer& buff)
+      : Buffer(buff) { }
+
+    void Put(char c)
+      { Buffer.push_back(c); }
+    void Flush()
+      { }
+
+    rtRemoteSocketBuffer& Buffer;
+  };
+
+  inline void putByte(rtRemoteSocketBuffer& buff, uint8_t b)
+  {
+    buff.push_back(static_cast<char>(b));
+  }
+
+  inline void putVarint(rtRemoteSocketBuffer& buff, uint64_t n)
+  {
+    while (n >= 0x80)
+    {
+      buff.push_back(static_cast<char>((n & 0x7f) | 0x80));
+      n >>= 7;
+    }
+    buff.push_back(static_cast<char>(n));
+  }
+
+  inline void putBytes(rtRemoteSocketBuffer& buff, void const* p, size_t n)
+  {
+    char const* c = reinterpret_cast<char const *>(p);
+    buff.insert(buff.end(), c, c + n);
+  }
+
+  inline int hexValue(char c)
+  {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    return -1;
+  }
+
+  // correlation keys and generated object ids are lower case guids
+  bool parseGuid(char const* s, uint32_t n, uint8_t* out)
+  {
+    if (n != 36)
+      return false;
+    int j = 0;
+    for (uint32_t i = 0; i < n; )
+    {
+      if (i == 8 || i == 13 || i == 18 || i == 23)
+      {
+        if (s[i++] != '-')
+          return false;
+        continue;
+      }
+      int hi = hexValue(s[i]);
+      int lo = hexValue(s[i + 1]);
+      if (hi < 0 || lo < 0)
+        return false;
+      out[j++] = static_cast<uint8_t>((hi << 4) | lo);
+      i += 2;
+    }
+    return true;
+  }
+
+  void formatGuid(uint8_t const* in, char* s)
+  {
+    static char const digits[] = "0123456789abcdef";
+    int j = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+      if (i == 4 || i == 6 || i == 8 || i == 10)
+        s[j++] = '-';
+      s[j++] = digits[in[i] >> 4];
+      s[j++] = digits[in[i] & 0x0f];
+    }
+  }
+}
+
+class rtRemoteWireCodec::Reader
+{
+public:
+  Reader(char const* buff, int n)
+    : m_p(reinterpret_cast<uint8_t const *>(buff))
+    , m_end(reinterpret_cast<uint8_t const *>(buff) + n) { }
+
+  bool getByte(uint8_t& b)
+  {
+    if (m_p >= m_end)
+      return false;
+    b = *m_p++;
+    return true;
+  }
+
+  bool getVarint(uint64_t& n)
+  {
+    n = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+      uint8_t b;
+      if (!getByte(b))
+        return false;
+      n |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if (!(b & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool getBytes(void const*& p, size_t n)
+  {
+    if (static_cast<size_t>(m_end - m_p) < n)
+      return false;
+    p = m_p;
+    m_p += n;
+    return true;
+  }
+
+  bool atEnd() const
+    { return m_p == m_end; }
+
+private:
+  uint8_t const* m_p;
+  uint8_t const* m_end;
+};
+
+size_t
+rtRemoteWireCodec::KeyHash::operator()(Key const& k) const
+{
+  return rtAtomHash(k.s, k.n);
+}
+
+bool
+rtRemoteWireCodec::KeyEqual::operator()(Key const& lhs, Key const& rhs) const
+{
+  return lhs.n == rhs.n && memcmp(lhs.s, rhs.s, lhs.n) == 0;
+}
+
+rtRemoteWireFormat
+rtRemoteWireFormatFromString(std::string const& s)
+{
+  if (strcasecmp(s.c_str(), kWireFormatBinary) == 0)
+    return rtRemoteWireFormat::Binary;
+  if (strcasecmp(s.c_str(), kWireFormatJson) != 0)
+    rtLogWarn("unknown wire format '%s', using %s", s.c_str(), kWireFormatJson);
+  return rtRemoteWireFormat::Json;
+}
+
+char const*
+rtRemoteWireFormatToString(rtRemoteWireFormat format)
+{
+  return format == rtRemoteWireFormat::Binary ? kWireFormatBinary : kWireFormatJson;
+}
+
+bool
+rtRemoteWireFormatIsBinary(char const* buff, int n)
+{
+  return n > 0 && static_cast<uint8_t>(buff[0]) == kWireFormatBinaryMagic;
+}
+
+rtRemoteWireCodec::rtRemoteWireCodec()
+{
+}
+
+rtRemoteWireCodec::~rtRemoteWireCodec()
+{
+}
+
+rtError
+rtRemoteWireCodec::encode(rtRemoteMessage const& m, rtRemoteWireFormat format, rtRemoteSocketBuffer& buff)
+{
+  if (format == rtRemoteWireFormat::Json)
+  {
+    rtRemoteSocketBufferStream out(buff);
+    rapidjson::Writer<rtRemoteSocketBufferStream> writer(out);
+    if (!m.Accept(writer))
+      return RT_FAIL;
+    return RT_OK;
+  }
+
+  putByte(buff, kWireFormatBinaryMagic);
+  encodeValue(m, buff, false);
+  return RT_OK;
+}
+
+uint32_t
+rtRemoteWireCodec::encodeString(char const* s, uint32_t n, rtRemoteSocketBuffer& buff, bool intern)
+{
+  uint8_t guid[16];
+  if (parseGuid(s, n, guid))
+  {
+    putByte(buff, kTagGuid);
+    putBytes(buff, guid, sizeof(guid));
+    return kNotInterned;
+  }
+
+  if (intern && n <= kMaxInternedLength)
+  {
+    Key k = { s, n };
+
+    uint32_t id = kNotInterned;
+    auto known = staticStrings().find(k);
+    if (known != staticStrings().end())
+    {
+      id = known->second;
+    }
+    else
+    {
+      auto itr = m_out.find(k);
+      if (itr != m_out.end())
+        id = itr->second;
+    }
+
+    if (id != kNotInterned)
+    {
+      putByte(buff, kTagStringRef);
+      putVarint(buff, id);
+      return id;
+    }
+
+    if (m_out_strings.size() < kMaxInternedStrings)
+    {
+      // the key points into m_out_strings, a deque never moves its elements
+      m_out_strings.push_back(std::string(s, n));
+      Key stored = { m_out_strings.back().c_str(), n };
+      id = kStaticStringCount + static_cast<uint32_t>(m_out_strings.size() - 1);
+      m_out.insert(InternMap::value_type(stored, id));
+
+      putByte(buff, kTagStringDefine);
+      putVarint(buff, n);
+      putBytes(buff, s, n);
+      return id;
+    }
+  }
+
+  putByte(buff, kTagString);
+  putVarint(buff, n);
+  putBytes(buff, s, n);
+  return kNotInterned;
+}
+
+bool
+rtRemoteWireCodec::encodeTypedValue(rapidjson::Value const& v, rtRemoteSocketBuffer& buff)
+{
+  // { "type": <rtValue type>, "value": ... } as written by rtRemoteValueWriter
+  rapidjson::SizeType n = v.MemberCount();
+  if (n == 0 || n > 2)
+    return false;
+
+  auto itr = v.MemberBegin();
+  if (strcmp(itr->name.GetString(), kFieldNameValueType) != 0 || !itr->value.IsUint())
+    return false;
+  uint32_t type = itr->value.GetUint();
+  if (type > 0xff)
+    return false;
+
+  if (n == 1)
+  {
+    putByte(buff, kTagTypedVoid);
+    putByte(buff, static_cast<uint8_t>(type));
+    return true;
+  }
+
+  ++itr;
+  if (strcmp(itr->name.GetString(), kFieldNameValueValue) != 0)
+    return false;
+
+  putByte(buff, kTagTypedValue);
+  putByte(buff, static_cast<uint8_t>(type));
+  encodeValue(itr->value, buff, false);
+  return true;
+}
+
+void
+rtRemoteWireCodec::encodeValue(rapidjson::Value const& v, rtRemoteSocketBuffer& buff, bool intern)
+{
+  switch (v.GetType())
+  {
+    case rapidjson::kNullType:
+      putByte(buff, kTagNull);
+      break;
+
+    case rapidjson::kFalseType:
+      putByte(buff, kTagFalse);
+      break;
+
+    case rapidjson::kTrueType:
+      putByte(buff, kTagTrue);
+      break;
+
+    case rapidjson::kNumberType:
+      if (v.IsDouble())
+      {
+        double d = v.GetDouble();
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        putByte(buff, kTagDouble);
+        for (int i = 0; i < 8; ++i)
+          putByte(buff, static_cast<uint8_t>(bits >> (i * 8)));
+      }
+      else if (v.IsUint64())
+      {
+        putByte(buff, kTagUInt);
+        putVarint(buff, v.GetUint64());
+      }
+      else
+      {
+        int64_t i = v.GetInt64();
+        putByte(buff, kTagInt);
+        putVarint(buff, (static_cast<uint64_t>(i) << 1) ^ static_cast<uint64_t>(i >> 63));
+      }
+      break;
+
+    case rapidjson::kStringType:
+      encodeString(v.GetString(), v.GetStringLength(), buff, intern);
+      break;
+
+    case rapidjson::kArrayType:
+      putByte(buff, kTagArray);
+      putVarint(buff, v.Size());
+      for (auto itr = v.Begin(); itr != v.End(); ++itr)
+        encodeValue(*itr, buff, false);
+      break;
+
+    case rapidjson::kObjectType:
+      if (encodeTypedValue(v, buff))
+        break;
+
+      putByte(buff, kTagObject);
+      putVarint(buff, v.MemberCount());
+      for (auto itr = v.MemberBegin(); itr != v.MemberEnd(); ++itr)
+      {
+        uint32_t id = encodeString(itr->name.GetString(), itr->name.GetStringLength(), buff, true);
+        encodeValue(itr->value, buff, id < kInternedValueKeys);
+      }
+      break;
+  }
+}
+
+rtError
+rtRemoteWireCodec::decode(char const* buff, int n, rtRemoteMessagePtr& doc)
+{
+  if (!rtRemoteWireFormatIsBinary(buff, n))
+    return rtParseMessage(buff, n, doc);
+
+  doc.reset(new rapidjson::Document());
+
+  Reader r(buff + 1, n - 1);
+  rtError e = decodeValue(r, *doc, doc->GetAllocator(), 0);
+  if (e == RT_OK && !r.atEnd())
+    e = RT_FAIL;
+  if (e == RT_OK && !doc->IsObject())
+    e = RT_FAIL;
+
+  if (e != RT_OK)
+  {
+    rtLogWarn("failed to decode binary message of length %d", n);
+    doc.reset();
+  }
+  return e;
+}
+
+rtError
+rtRemoteWireCodec::decodeString(Reader& r, uint8_t tag, rapidjson::Value& v,
+  rapidjson::Document::AllocatorType& alloc)
+{
+  if (tag == kTagStringRef)
+  {
+    uint64_t id;
+    if (!r.getVarint(id))
+      return RT_FAIL;
+    if (id < kStaticStringCount)
+    {
+      // static strings outlive any document
+      v.SetString(rapidjson::StringRef(kStaticStrings[id]));
+      return RT_OK;
+    }
+    id -= kStaticStringCount;
+    if (id >= m_in_strings.size())
+    {
+      rtLogWarn("reference to unknown interned string %d", static_cast<int>(id));
+      return RT_FAIL;
+    }
+    std::string const& s = m_in_strings[id];
+    v.SetString(s.c_str(), static_cast<rapidjson::SizeType>(s.size()), alloc);
+    return RT_OK;
+  }
+
+  if (tag == kTagGuid)
+  {
+    void const* p;
+    if (!r.getBytes(p, 16))
+      return RT_FAIL;
+    char s[36];
+    formatGuid(reinterpret_cast<uint8_t const *>(p), s);
+    v.SetString(s, sizeof(s), alloc);
+    return RT_OK;
+  }
+
+  if (tag != kTagString && tag != kTagStringDefine)
+    return RT_FAIL;
+
+  uint64_t n;
+  void const* p;
+  if (!r.getVarint(n) || !r.getBytes(p, n))
+    return RT_FAIL;
+
+  char const* s = reinterpret_cast<char const *>(p);
+  v.SetString(s, static_cast<rapidjson::SizeType>(n), alloc);
+
+  if (tag == kTagStringDefine)
+  {
+    if (m_in_strings.size() >= kMaxInternedStrings)
+    {
+      rtLogWarn("too many interned strings");
+      return RT_FAIL;
+    }
+    m_in_strings.push_back(std::string(s, n));
+  }
+  return RT_OK;
+}
+
+rtError
+rtRemoteWireCodec::decodeValue(Reader& r, rapidjson::Value& v, rapidjson::Document::AllocatorType& alloc,
+  int depth)
+{
+  if (depth > kMaxDepth)
+  {
+    rtLogWarn("binary message nested too deep");
+    return RT_FAIL;
+  }
+
+  uint8_t tag;
+  if (!r.getByte(tag))
+    return RT_FAIL;
+
+  switch (tag)
+  {
+    case kTagNull:
+      v.SetNull();
+      break;
+
+    case kTagFalse:
+      v.SetBool(false);
+      break;
+
+    case kTagTrue:
+      v.SetBool(true);
+      break;
+
+    case kTagInt:
+    {
+      uint64_t n;
+      if (!r.getVarint(n))
+        return RT_FAIL;
+      v.SetInt64(static_cast<int64_t>((n >> 1) ^ (~(n & 1) + 1)));
+    }
+    break;
+
+    case kTagUInt:
+    {
+      uint64_t n;
+      if (!r.getVarint(n))
+        return RT_FAIL;
+      v.SetUint64(n);
+    }
+    break;
+
+    case kTagDouble:
+    {
+      void const* p;
+      if (!r.getBytes(p, 8))
+        return RT_FAIL;
+      uint8_t const* b = reinterpret_cast<uint8_t const *>(p);
+      uint64_t bits = 0;
+      for (int i = 0; i < 8; ++i)
+        bits |= static_cast<uint64_t>(b[i]) << (i * 8);
+      double d;
+      memcpy(&d, &bits, sizeof(d));
+      v.SetDouble(d);
+    }
+    break;
+
+    case kTagString:
+    case kTagStringDefine:
+    case kTagStringRef:
+    case kTagGuid:
+      return decodeString(r, tag, v, alloc);
+
+    case kTagArray:
+    {
+      uint64_t n;
+      if (!r.getVarint(n))
+        return RT_FAIL;
+      v.SetArray();
+      for (uint64_t i = 0; i < n; ++i)
+      {
+        rapidjson::Value item;
+        rtError e = decodeValue(r, item, alloc, depth + 1);
+        if (e != RT_OK)
+          return e;
+        v.PushBack(item, alloc);
+      }
+    }
+    break;
+
+    case kTagObject:
+    {
+      uint64_t n;
+      if (!r.getVarint(n))
+        return RT_FAIL;
+      v.SetObject();
+      for (uint64_t i = 0; i < n; ++i)
+      {
+        uint8_t keyTag;
+        if (!r.getByte(keyTag))
+          return RT_FAIL;
+
+        rapidjson::Value name;
+        rtError e = decodeString(r, keyTag, name, alloc);
+        if (e != RT_OK)
+          return e;
+
+        rapidjson::Value value;
+        e = decodeValue(r, value, alloc, depth + 1);
+        if (e != RT_OK)
+          return e;
+        v.AddMember(name, value, alloc);
+      }
+    }
+    break;
+
+    case kTagTypedValue:
+    case kTagTypedVoid:
+    {
+      uint8_t type;
+      if (!r.getByte(type))
+        return RT_FAIL;
+      v.SetObject();
+      v.AddMember(rapidjson::StringRef(kFieldNameValueType), static_cast<int>(type), alloc);
+      if (tag == kTagTypedValue)
+      {
+        rapidjson::Value value;
+        rtError e = decodeValue(r, value, alloc, depth + 1);
+        if (e != RT_OK)
+          return e;
+        v.AddMember(rapidjson::StringRef(kFieldNameValueValue), value, alloc);
+      }
+    }
+    break;
+
+    default:
+      rtLogWarn("unknown tag %d in binary message", static_cast<int>(tag));
+      return RT_FAIL;
+  }
+
+  return RT_OK;
+}
@@ -0,0 +1,106 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef __RT_REMOTE_WIRE_FORMAT_H__
+#define __RT_REMOTE_WIRE_FORMAT_H__
+
+#include <rtError.h>
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rtRemoteMessage.h"
+#include "rtRemoteSocketBuffer.h"
+
+#define kWireFormatJson "json"
+#define kWireFormatBinary "binary"
+
+// first byte of every binary payload. JSON payloads always start with '{',
+// so a reader can tell the two apart frame by frame.
+#define kWireFormatBinaryMagic 0xb1
+
+enum class rtRemoteWireFormat
+{
+  Json,
+  Binary
+};
+
+rtRemoteWireFormat  rtRemoteWireFormatFromString(std::string const& s);
+char const*         rtRemoteWireFormatToString(rtRemoteWireFormat format);
+bool                rtRemoteWireFormatIsBinary(char const* buff, int n);
+
+// Encodes and decodes the payload of one stream. The binary encoding tags
+// every value with its type, writes numbers as varints, folds the
+// { "type":..., "value":... } objects written by rtRemoteValueWriter into a
+// single tagged value and sends guids as 16 raw bytes. Member names and a few
+// well known fields (message type, object id, property and function names)
+// are interned: the first time a string is sent it's assigned the next id in
+// the connection's table and after that only the id goes over the wire.
+// The tables rely on the stream delivering frames in order, so a codec must
+// not be shared between streams. encode() and decode() keep separate state
+// and may be called from different threads, but each must be serialized.
+class rtRemoteWireCodec
+{
+public:
+  rtRemoteWireCodec();
+  ~rtRemoteWireCodec();
+
+  rtRemoteWireCodec(rtRemoteWireCodec const&) = delete;
+  rtRemoteWireCodec& operator = (rtRemoteWireCodec const&) = delete;
+
+  // appends the encoded message to buff
+  rtError encode(rtRemoteMessage const& m, rtRemoteWireFormat format, rtRemoteSocketBuffer& buff);
+  rtError decode(char const* buff, int n, rtRemoteMessagePtr& doc);
+
+  struct Key
+  {
+    char const* s;
+    uint32_t    n;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(Key const& k) const;
+  };
+
+  struct KeyEqual
+  {
+    bool operator()(Key const& lhs, Key const& rhs) const;
+  };
+
+  using InternMap = std::unordered_map<Key, uint32_t, KeyHash, KeyEqual>;
+
+private:
+  class Reader;
+
+  void encodeValue(rapidjson::Value const& v, rtRemoteSocketBuffer& buff, bool intern);
+  // returns the intern id of the string, or UINT32_MAX if it went out as a literal
+  uint32_t encodeString(char const* s, uint32_t n, rtRemoteSocketBuffer& buff, bool intern);
+  bool encodeTypedValue(rapidjson::Value const& v, rtRemoteSocketBuffer& buff);
+
+  rtError decodeValue(Reader& r, rapidjson::Value& v, rapidjson::Document::AllocatorType& alloc, int depth);
+  rtError decodeString(Reader& r, uint8_t tag, rapidjson::Value& v, rapidjson::Document::AllocatorType& alloc);
+
+  InternMap                 m_out;
+  std::deque<std::string>   m_out_strings;
+  std::vector<std::string>  m_in_strings;
+};
+
+#endif
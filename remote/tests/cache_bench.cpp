@@ -0,0 +1,238 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+
+// Hammers rtRemoteObjectCache from several threads the way a busy server
+// does: lookups of long lived (registered) objects, keep alive touches,
+// short lived objects being inserted as they're passed to peers, and a
+// sweeper expiring them. Runs once per thread count and prints the total
+// operation rate and the longest single removeUnused() call.
+//
+//   cache_bench [-n objects] [-t max threads] [-d seconds per run]
+
+#include <rtRemote.h>
+#include <rtRemoteEnvironment.h>
+#include <rtRemoteObjectCache.h>
+#include <rtLog.h>
+#include <rtObject.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+class rtCacheBenchObject : public rtObject
+{
+public:
+  rtDeclareObject(rtCacheBenchObject, rtObject);
+};
+
+rtDefineObject(rtCacheBenchObject, rtObject);
+
+static rtRemoteEnvironment*
+createEnvironment()
+{
+  char path[128];
+  snprintf(path, sizeof(path), "/tmp/cache_bench.%d.conf", static_cast<int>(getpid()));
+
+  FILE* f = fopen(path, "w");
+  if (!f)
+    return nullptr;
+  // short lived entries should actually expire while we run
+  fprintf(f, "rt.rpc.cache.max_object_lifetime=1\n");
+  fclose(f);
+
+  rtRemoteEnvironment* env = rtEnvironmentFromFile(path);
+  unlink(path);
+  return env;
+}
+
+static std::string
+objectId(int i)
+{
+  char buff[64];
+  snprintf(buff, sizeof(buff), "global://%08x-4b1d-4c2e-9f00-%012d", i * 2654435761u, i);
+  return std::string(buff);
+}
+
+struct Counters
+{
+  std::atomic<uint64_t> Finds;
+  std::atomic<uint64_t> Touches;
+  std::atomic<uint64_t> Inserts;
+  std::atomic<uint64_t> Misses;
+};
+
+static void
+runWorker(rtRemoteObjectCache* cache, std::vector<std::string> const& ids, int worker,
+  std::atomic<bool> const& running, Counters& counters)
+{
+  std::mt19937 rng(worker + 1);
+  std::uniform_int_distribution<size_t> pick(0, ids.size() - 1);
+  std::uniform_int_distribution<int> op(0, 99);
+
+  rtObjectRef transient(new rtCacheBenchObject());
+  uint64_t finds = 0, touches = 0, inserts = 0, misses = 0;
+  int next = 0;
+
+  while (running.load(std::memory_order_relaxed))
+  {
+    // a few hundred operations between checks of the flag
+    for (int i = 0; i < 256; ++i)
+    {
+      int n = op(rng);
+      if (n < 80)
+      {
+        rtObjectRef obj = cache->findObject(ids[pick(rng)]);
+        if (!obj)
+          ++misses;
+        ++finds;
+      }
+      else if (n < 95)
+      {
+        cache->touch(ids[pick(rng)], std::chrono::steady_clock::now());
+        ++touches;
+      }
+      else
+      {
+        char buff[64];
+        snprintf(buff, sizeof(buff), "transient.%d.%d", worker, next++);
+        cache->insert(buff, transient);
+        ++inserts;
+      }
+    }
+  }
+
+  counters.Finds += finds;
+  counters.Touches += touches;
+  counters.Inserts += inserts;
+  counters.Misses += misses;
+}
+
+int main(int argc, char* argv[])
+{
+  int numObjects = 10000;
+  int maxThreads = 8;
+  int seconds = 3;
+
+  int c;
+  while ((c = getopt(argc, argv, "n:t:d:")) != -1)
+  {
+    switch (c)
+    {
+      case 'n':
+        numObjects = static_cast<int>(strtol(optarg, nullptr, 10));
+        break;
+      case 't':
+        maxThreads = static_cast<int>(strtol(optarg, nullptr, 10));
+        break;
+      case 'd':
+        seconds = static_cast<int>(strtol(optarg, nullptr, 10));
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-n objects] [-t max threads] [-d seconds per run]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  // the transient entries keep the cache over its high mark on purpose
+  rtLogSetLevel(RT_LOG_ERROR);
+
+  rtRemoteEnvironment* env = createEnvironment();
+  if (!env)
+    return 1;
+
+  rtRemoteObjectCache* cache = env->ObjectCache;
+
+  // the registered objects, these must survive every sweep
+  std::vector<std::string> ids;
+  for (int i = 0; i < numObjects; ++i)
+  {
+    ids.push_back(objectId(i));
+    cache->insert(ids.back(), rtObjectRef(new rtCacheBenchObject()));
+    cache->markUnevictable(ids.back(), true);
+  }
+
+  printf("%-10s%14s%14s%14s%12s%12s\n", "threads", "ops/sec", "inserts/sec", "size", "misses", "sweep ms");
+  fflush(stdout);
+
+  int failures = 0;
+  for (int threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    Counters counters;
+    counters.Finds = counters.Touches = counters.Inserts = counters.Misses = 0;
+    std::atomic<bool> running(true);
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i)
+      workers.push_back(std::thread(runWorker, cache, std::cref(ids), threads * 100 + i,
+        std::cref(running), std::ref(counters)));
+
+    // a keep alive interval far shorter than any real one
+    double longestSweep = 0;
+    std::thread sweeper([cache, &running, &longestSweep]
+    {
+      while (running.load())
+      {
+        auto before = std::chrono::steady_clock::now();
+        cache->removeUnused();
+        std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - before;
+        longestSweep = std::max(longestSweep, took.count());
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    for (auto& t : workers)
+      t.join();
+    sweeper.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    uint64_t ops = counters.Finds + counters.Touches + counters.Inserts;
+    printf("%-10d%14.0f%14.0f%14zu%12llu%12.2f\n", threads, ops / elapsed.count(),
+      counters.Inserts / elapsed.count(), cache->size(),
+      static_cast<unsigned long long>(counters.Misses), longestSweep);
+    fflush(stdout);
+
+    if (counters.Misses != 0)
+      ++failures;
+  }
+
+  // the transient entries expire, the registered ones don't
+  std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+  cache->removeUnused();
+  if (cache->size() != ids.size())
+  {
+    printf("expected %zu entries after expiry, found %zu\n", ids.size(), cache->size());
+    ++failures;
+  }
+
+  cache->clear();
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// Opens many local connections against a single rtRemoteServer. A server is
+// forked, then the client opens one rtRemoteClient (and therefore one socket)
+// per connection and runs set/get rounds across all of them from a few
+// threads.
+//
+//   load_test [-n connections] [-r rounds] [-t threads]
+
+#include <rtRemote.h>
+#include <rtRemoteClient.h>
+#include <rtRemoteConfig.h>
+#include <rtRemoteEnvironment.h>
+#include <rtRemoteSocketUtils.h>
+#include <rtLog.h>
+#include <rtObject.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static char const* objectName = "rt.remote.load";
+static volatile sig_atomic_t running = 1;
+
+class rtLoadObject : public rtObject
+{
+public:
+  rtDeclareObject(rtLoadObject, rtObject);
+  rtProperty(count, count, setCount, int32_t);
+
+  rtLoadObject()
+    : m_count(0)
+  {
+  }
+
+  rtError count(int32_t& n) const { n = m_count; return RT_OK; }
+  rtError setCount(int32_t n) { m_count = n; return RT_OK; }
+
+private:
+  std::atomic<int32_t> m_count;
+};
+
+rtDefineObject(rtLoadObject, rtObject);
+rtDefineProperty(rtLoadObject, count);
+
+static void onSignal(int /*signo*/)
+{
+  running = 0;
+}
+
+static void
+raiseFileLimit(int connections)
+{
+  rlimit lim;
+  if (getrlimit(RLIMIT_NOFILE, &lim) != 0)
+    return;
+
+  rlim_t want = static_cast<rlim_t>(connections) + 64;
+  if (lim.rlim_cur >= want)
+    return;
+
+  lim.rlim_cur = lim.rlim_max == RLIM_INFINITY ? want : std::min(want, lim.rlim_max);
+  if (setrlimit(RLIMIT_NOFILE, &lim) != 0 || lim.rlim_cur < want)
+    rtLogWarn("file limit %d is too low for %d connections", static_cast<int>(lim.rlim_cur), connections);
+}
+
+static int
+Load_Server()
+{
+  signal(SIGTERM, onSignal);
+  signal(SIGINT, onSignal);
+
+  rtRemoteEnvironment* env = rtEnvironmentGetGlobal();
+  rtError e = rtRemoteInit(env);
+  RT_ASSERT(e == RT_OK);
+
+  rtObjectRef obj(new rtLoadObject());
+  e = rtRemoteRegisterObject(env, objectName, obj);
+  RT_ASSERT(e == RT_OK);
+
+  while (running)
+    rtRemoteRunUntil(env, 100, false);
+
+  rtRemoteShutdown(env);
+  return 0;
+}
+
+static int
+Load_Client(pid_t server, int connections, int rounds, int threads)
+{
+  rtRemoteEnvironment* env = rtEnvironmentGetGlobal();
+  rtError e = rtRemoteInit(env);
+  RT_ASSERT(e == RT_OK);
+
+  // wait for the server to come up and register its object
+  rtObjectRef obj;
+  while ((e = rtRemoteLocateObject(env, objectName, obj)) != RT_OK)
+    rtLogInfo("failed to find %s:%s", objectName, rtStrError(e));
+  obj = nullptr;
+
+  char path[UNIX_PATH_MAX];
+  rtCreateUnixSocketName(server, path, sizeof(path));
+
+  sockaddr_storage endpoint;
+  memset(&endpoint, 0, sizeof(endpoint));
+  e = rtParseAddress(endpoint, path, 0, nullptr);
+  RT_ASSERT(e == RT_OK);
+
+  std::vector< std::shared_ptr<rtRemoteClient> > clients;
+  clients.reserve(connections);
+
+  int failures = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < connections; ++i)
+  {
+    auto client = std::make_shared<rtRemoteClient>(env, endpoint);
+    e = client->open();
+    if (e == RT_OK)
+      e = client->startSession(objectName);
+    if (e != RT_OK)
+    {
+      rtLogError("connection %d failed. %s", i, rtStrError(e));
+      failures++;
+      continue;
+    }
+    clients.push_back(client);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  printf("connections:  %d open, %d failed in %.2fs\n", static_cast<int>(clients.size()),
+    failures, elapsed.count());
+  fflush(stdout);
+
+  std::atomic<int> requests(0);
+  std::atomic<int> errors(0);
+  start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t)
+  {
+    workers.push_back(std::thread([&, t]
+    {
+      for (int r = 0; r < rounds; ++r)
+      {
+        for (size_t i = t; i < clients.size(); i += threads)
+        {
+          rtValue value;
+          if (clients[i]->sendSet(objectName, "count", rtValue(static_cast<int32_t>(i))) != RT_OK)
+            errors++;
+          if (clients[i]->sendGet(objectName, "count", value) != RT_OK)
+            errors++;
+          requests += 2;
+        }
+      }
+    }));
+  }
+  for (std::thread& t : workers)
+    t.join();
+  elapsed = std::chrono::steady_clock::now() - start;
+
+  printf("requests:     %d in %.2fs, %.0f/sec, %d errors\n", requests.load(), elapsed.count(),
+    requests / elapsed.count(), errors.load());
+  fflush(stdout);
+
+  clients.clear();
+  rtRemoteShutdown(env);
+  return (failures == 0 && errors == 0) ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+  int connections = 2000;
+  int rounds = 5;
+  int threads = 4;
+
+  int c;
+  while ((c = getopt(argc, argv, "n:r:t:")) != -1)
+  {
+    switch (c)
+    {
+      case 'n':
+        connections = static_cast<int>(strtol(optarg, nullptr, 10));
+        break;
+      case 'r':
+        rounds = static_cast<int>(strtol(optarg, nullptr, 10));
+        break;
+      case 't':
+        threads = static_cast<int>(strtol(optarg, nullptr, 10));
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-n connections] [-r rounds] [-t threads]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (threads < 1)
+    threads = 1;
+
+  raiseFileLimit(connections);
+
+  pid_t server = fork();
+  if (server == 0)
+    return Load_Server();
+
+  int ret = Load_Client(server, connections, rounds, threads);
+
+  kill(server, SIGTERM);
+  waitpid(server, nullptr, 0);
+  return ret;
+}
@@ -24,9 +24,26 @@ limitations under the License.
 
 #include<gtest/gtest.h>
 #include "../rtRemote.h"
+#include "../rtRemoteBatch.h"
+#include "../rtRemoteEnvironment.h"
+#include "../rtRemoteMessage.h"
+#include "../rtRemoteObjectCache.h"
+#include "../rtRemoteShmTransport.h"
+#include "../rtRemoteValueWriter.h"
+#include "../rtRemoteWireFormat.h"
 #include "rtTestCommon.h"
+#include <atomic>
+#include <chrono>
 #include <limits.h>
 #include <memory>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 static char const* objectName = "com.xfinity.xsmart.SimpleServer/Comcast";
 class RemoteSettingsTest : public ::testing::Test {
@@ -463,7 +480,815 @@ TEST(RemoteSettingsTest,rtLCDPropertyTest)
   rtRemoteShutdown();
 }
 
+static rtError testFunction(int, rtValue const*, rtValue*, void*)
+{
+  return RT_OK;
+}
+
+// a set request carrying the given value, as rtRemoteObject would send it
+static rtRemoteMessagePtr makeSetRequest(rtRemoteEnvironment* env, char const* name, rtValue const& value)
+{
+  rtRemoteMessagePtr m(new rapidjson::Document());
+  m->SetObject();
+  m->AddMember(kFieldNameMessageType, kMessageTypeSetByNameRequest, m->GetAllocator());
+  m->AddMember(kFieldNameObjectId, "some.object", m->GetAllocator());
+  m->AddMember(kFieldNamePropertyName, std::string(name), m->GetAllocator());
+  rapidjson::Value v;
+  EXPECT_EQ(RT_OK, rtRemoteValueWriter::write(env, value, v, *m));
+  m->AddMember(kFieldNameValue, v, m->GetAllocator());
+  return m;
+}
+
+static void encodeMessage(rtRemoteWireCodec& codec, rtRemoteMessage const& m, std::vector<char>& out)
+{
+  rtRemoteSocketBuffer buff;
+  EXPECT_EQ(RT_OK, codec.encode(m, rtRemoteWireFormat::Binary, buff));
+  out.assign(buff.begin(), buff.end());
+}
+
+// decodes from a copy that ends exactly where the frame does, so reading
+// past it shows up under the address sanitizer
+static rtError decodeExact(rtRemoteWireCodec& codec, std::vector<char> const& frame, size_t n,
+  rtRemoteMessagePtr& doc)
+{
+  std::unique_ptr<char[]> copy(new char[n]);
+  memcpy(copy.get(), frame.data(), n);
+  return codec.decode(copy.get(), static_cast<int>(n), doc);
+}
+
+TEST(RemoteWireCodecTest, allValueTypesTest)
+{
+  EXPECT_EQ(RT_OK, rtRemoteInit());
+  rtRemoteEnvironment* env = rtEnvironmentGetGlobal();
+
+  std::vector<rtValue> values;
+  values.push_back(rtValue());
+  values.push_back(rtValue(true));
+  values.push_back(rtValue(false));
+  rtValue v;
+  v.setInt8(-12); values.push_back(v);
+  v.setUInt8(250); values.push_back(v);
+  v.setInt32(INT_MIN); values.push_back(v);
+  v.setUInt32(UINT_MAX); values.push_back(v);
+  v.setInt64(INT64_MIN); values.push_back(v);
+  v.setUInt64(UINT64_MAX); values.push_back(v);
+  v.setFloat(1.5f); values.push_back(v);
+  v.setDouble(-3.141592653589793); values.push_back(v);
+  values.push_back(rtValue(""));
+  values.push_back(rtValue("a string that isn't interned \xe2\x82\xac"));
+  values.push_back(rtValue(rtString(std::string(300, 'x').c_str())));
+  v.setVoidPtr(&values); values.push_back(v);
+  values.push_back(rtValue(rtObjectRef()));
+  values.push_back(rtValue(rtObjectRef(new rtLcd())));
+  values.push_back(rtValue(rtFunctionRef()));
+  values.push_back(rtValue(rtFunctionRef(new rtFunctionCallback(testFunction))));
+
+  rtRemoteWireCodec sender;
+  rtRemoteWireCodec receiver;
+  for (size_t i = 0; i < values.size(); ++i)
+  {
+    rtRemoteMessagePtr m = makeSetRequest(env, "prop", values[i]);
+    std::vector<char> frame;
+    encodeMessage(sender, *m, frame);
+    EXPECT_TRUE(rtRemoteWireFormatIsBinary(frame.data(), static_cast<int>(frame.size())));
+
+    rtRemoteMessagePtr doc;
+    EXPECT_EQ(RT_OK, decodeExact(receiver, frame, frame.size(), doc));
+    EXPECT_TRUE(doc && *doc == *m) << "value " << i << " of type " << values[i].getType();
+  }
+
+  // the codec passes json through
+  rtRemoteMessagePtr m = makeSetRequest(env, "prop", rtValue(42));
+  rtRemoteSocketBuffer json;
+  EXPECT_EQ(RT_OK, sender.encode(*m, rtRemoteWireFormat::Json, json));
+  EXPECT_FALSE(rtRemoteWireFormatIsBinary(&json[0], static_cast<int>(json.size())));
+  rtRemoteMessagePtr doc;
+  EXPECT_EQ(RT_OK, receiver.decode(&json[0], static_cast<int>(json.size()), doc));
+  EXPECT_TRUE(doc && *doc == *m);
+
+  rtRemoteShutdown();
+}
+
+TEST(RemoteWireCodecTest, internedKeyReuseTest)
+{
+  rtRemoteWireCodec sender;
+  rtRemoteWireCodec receiver;
+
+  rtRemoteMessagePtr m = makeSetRequest(nullptr, "interned.property", rtValue(7));
+  std::vector<char> first, second;
+  encodeMessage(sender, *m, first);
+  encodeMessage(sender, *m, second);
+
+  // the second time only the ids go out
+  EXPECT_LT(second.size() + strlen("interned.property"), first.size());
+
+  rtRemoteMessagePtr doc;
+  EXPECT_EQ(RT_OK, decodeExact(receiver, first, first.size(), doc));
+  EXPECT_TRUE(doc && *doc == *m);
+  EXPECT_EQ(RT_OK, decodeExact(receiver, second, second.size(), doc));
+  EXPECT_TRUE(doc && *doc == *m);
+
+  // a codec that missed the first message can't resolve the ids
+  rtRemoteWireCodec late;
+  EXPECT_NE(RT_OK, decodeExact(late, second, second.size(), doc));
+  EXPECT_TRUE(doc == nullptr);
+}
+
+TEST(RemoteWireCodecTest, malformedInputTest)
+{
+  rtRemoteWireCodec sender;
+  rtRemoteMessagePtr m = makeSetRequest(nullptr, "prop", rtValue("some string value"));
+  std::vector<char> frame;
+  encodeMessage(sender, *m, frame);
+
+  // every truncation fails
+  for (size_t n = 1; n < frame.size(); ++n)
+  {
+    rtRemoteWireCodec receiver;
+    rtRemoteMessagePtr doc;
+    EXPECT_NE(RT_OK, decodeExact(receiver, frame, n, doc)) << "truncated to " << n;
+    EXPECT_TRUE(doc == nullptr);
+  }
+
+  // corrupting any byte must not read outside the frame. The result may or
+  // may not decode.
+  for (size_t i = 1; i < frame.size(); ++i)
+  {
+    std::vector<char> corrupt(frame);
+    corrupt[i] = static_cast<char>(corrupt[i] ^ 0xff);
+    rtRemoteWireCodec receiver;
+    rtRemoteMessagePtr doc;
+    if (decodeExact(receiver, corrupt, corrupt.size(), doc) != RT_OK)
+    {
+      EXPECT_TRUE(doc == nullptr);
+    }
+  }
+
+  // { <interned string 5000>: null }, an id nobody defined
+  char const unknownId[] = { static_cast<char>(kWireFormatBinaryMagic), 0x0a, 0x01, 0x08,
+    static_cast<char>(0x88), 0x27, 0x00 };
+  std::vector<char> bad(unknownId, unknownId + sizeof(unknownId));
+  rtRemoteWireCodec receiver;
+  rtRemoteMessagePtr doc;
+  EXPECT_NE(RT_OK, decodeExact(receiver, bad, bad.size(), doc));
+
+  // a string claiming to be longer than the frame
+  char const longString[] = { static_cast<char>(kWireFormatBinaryMagic), 0x0a, 0x01, 0x06,
+    static_cast<char>(0xff), static_cast<char>(0xff), 0x7f, 'a' };
+  bad.assign(longString, longString + sizeof(longString));
+  EXPECT_NE(RT_OK, decodeExact(receiver, bad, bad.size(), doc));
+
+  // an array claiming more elements than there are bytes
+  char const longArray[] = { static_cast<char>(kWireFormatBinaryMagic), 0x0b,
+    static_cast<char>(0xff), static_cast<char>(0xff), static_cast<char>(0xff), 0x0f, 0x00 };
+  bad.assign(longArray, longArray + sizeof(longArray));
+  EXPECT_NE(RT_OK, decodeExact(receiver, bad, bad.size(), doc));
+}
+
+// attaches a second channel to the region, as the peer process would
+static rtError attachPeer(rtRemoteShmChannelPtr const& channel, rtRemoteShmChannelPtr& peer)
+{
+  int fds[rtRemoteShmChannel::kNumFds];
+  for (int i = 0; i < rtRemoteShmChannel::kNumFds; ++i)
+    fds[i] = dup(channel->fds()[i]);
+  return rtRemoteShmChannel::attach(fds, rtRemoteShmChannel::kNumFds, peer);
+}
+
+static void fillFrame(std::vector<char>& frame, uint32_t n, uint32_t seq)
+{
+  frame.resize(n);
+  for (uint32_t i = 0; i < n; ++i)
+    frame[i] = static_cast<char>(seq * 31 + i);
+}
+
+// reads every frame that's ready into frames
+static rtError readFrames(rtRemoteShmChannelPtr const& channel, std::vector<std::vector<char>>& frames)
+{
+  bool more = true;
+  while (more)
+  {
+    more = false;
+    rtError e = channel->read([&frames](char const* buff, int n)
+    {
+      frames.push_back(std::vector<char>(buff, buff + n));
+      return RT_OK;
+    }, 1024 * 1024, more);
+    if (e != RT_OK)
+      return e;
+  }
+  return RT_OK;
+}
+
+TEST(RemoteShmTest, largeFrameTest)
+{
+  rtRemoteShmChannelPtr writer;
+  rtRemoteShmChannelPtr reader;
+  ASSERT_EQ(RT_OK, rtRemoteShmChannel::create(4096, 64 * 1024, writer));
+  ASSERT_EQ(RT_OK, attachPeer(writer, reader));
+
+  // more than half the ring goes through the large slot
+  std::vector<char> frame;
+  fillFrame(frame, 3000, 1);
+  EXPECT_EQ(RT_OK, writer->write(&frame[0], static_cast<uint32_t>(frame.size()), 1000));
+
+  // the slot stays busy until the reader is done with it
+  std::vector<char> second;
+  fillFrame(second, 64 * 1024, 2);
+  EXPECT_EQ(RT_ERROR_TIMEOUT, writer->write(&second[0], static_cast<uint32_t>(second.size()), 50));
+
+  std::vector<std::vector<char>> frames;
+  EXPECT_EQ(RT_OK, readFrames(reader, frames));
+  ASSERT_EQ(1u, frames.size());
+  EXPECT_TRUE(frames[0] == frame);
+
+  EXPECT_EQ(RT_OK, writer->write(&second[0], static_cast<uint32_t>(second.size()), 1000));
+  frames.clear();
+  EXPECT_EQ(RT_OK, readFrames(reader, frames));
+  ASSERT_EQ(1u, frames.size());
+  EXPECT_TRUE(frames[0] == second);
+
+  // and bigger than the slot doesn't go at all
+  second.resize(64 * 1024 + 1);
+  EXPECT_EQ(RT_ERROR_INVALID_ARG, writer->write(&second[0], static_cast<uint32_t>(second.size()), 1000));
+
+  // the other direction has its own ring and slot
+  EXPECT_EQ(RT_OK, reader->write(&frame[0], static_cast<uint32_t>(frame.size()), 1000));
+  frames.clear();
+  EXPECT_EQ(RT_OK, readFrames(writer, frames));
+  ASSERT_EQ(1u, frames.size());
+  EXPECT_TRUE(frames[0] == frame);
+}
+
+TEST(RemoteShmTest, ringWrapTest)
+{
+  rtRemoteShmChannelPtr writer;
+  rtRemoteShmChannelPtr reader;
+  ASSERT_EQ(RT_OK, rtRemoteShmChannel::create(4096, 64 * 1024, writer));
+  ASSERT_EQ(RT_OK, attachPeer(writer, reader));
+
+  // odd sizes so records land all over the ring and often don't fit before
+  // its end, with the odd one through the large slot
+  uint32_t const sizes[] = { 1, 7, 100, 333, 1021, 1500, 0, 2000, 3000, 64 };
+  uint32_t const numSizes = sizeof(sizes) / sizeof(sizes[0]);
+  uint32_t const count = 500;
+
+  std::vector<std::vector<char>> frames;
+  std::thread drain([&reader, &frames, count]
+  {
+    while (frames.size() < count)
+    {
+      if (readFrames(reader, frames) != RT_OK)
+        break;
+      usleep(100);
+    }
+  });
+
+  std::vector<char> frame;
+  for (uint32_t seq = 0; seq < count; ++seq)
+  {
+    fillFrame(frame, sizes[seq % numSizes], seq);
+    EXPECT_EQ(RT_OK, writer->write(frame.empty() ? "" : &frame[0], static_cast<uint32_t>(frame.size()), 3000));
+  }
+  drain.join();
+
+  ASSERT_EQ(count, frames.size());
+  for (uint32_t seq = 0; seq < count; ++seq)
+  {
+    fillFrame(frame, sizes[seq % numSizes], seq);
+    EXPECT_TRUE(frames[seq] == frame) << "frame " << seq;
+  }
+
+  // with nobody reading, the writer gives up once the ring is full
+  fillFrame(frame, 1000, 0);
+  rtError e = RT_OK;
+  for (int i = 0; i < 8 && e == RT_OK; ++i)
+    e = writer->write(&frame[0], static_cast<uint32_t>(frame.size()), 50);
+  EXPECT_EQ(RT_ERROR_TIMEOUT, e);
+
+  // closing releases a waiting writer right away
+  writer->close();
+  EXPECT_EQ(RT_ERROR_STREAM_CLOSED, writer->write(&frame[0], static_cast<uint32_t>(frame.size()), -1));
+}
+
+TEST(RemoteShmTest, badHeaderTest)
+{
+  rtRemoteShmChannelPtr channel;
+  ASSERT_EQ(RT_OK, rtRemoteShmChannel::create(4096, 4096, channel));
+
+  // the header starts with Magic, Version, RingSize and LargeSize, rewrite
+  // them the way a misbehaving peer could
+  void* p = mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, channel->fds()[0], 0);
+  ASSERT_NE(MAP_FAILED, p);
+  uint32_t* header = reinterpret_cast<uint32_t *>(p);
+  uint32_t const ringSize = header[2];
+  uint32_t const largeSize = header[3];
+
+  rtRemoteShmChannelPtr peer;
+  EXPECT_EQ(RT_OK, attachPeer(channel, peer));
+
+  uint32_t const badRingSizes[] = { 0, 4095, 6000, 1024, 128 * 1024 * 1024, 0x80000000 };
+  for (uint32_t n : badRingSizes)
+  {
+    header[2] = n;
+    peer.reset();
+    EXPECT_NE(RT_OK, attachPeer(channel, peer)) << "RingSize " << n;
+    EXPECT_TRUE(peer == nullptr);
+  }
+  header[2] = ringSize;
+
+  // slots that run past the end of the mapping
+  uint32_t const badLargeSizes[] = { largeSize + 4096, 0x7fffffff, 0xffffffff };
+  for (uint32_t n : badLargeSizes)
+  {
+    header[3] = n;
+    peer.reset();
+    EXPECT_NE(RT_OK, attachPeer(channel, peer)) << "LargeSize " << n;
+    EXPECT_TRUE(peer == nullptr);
+  }
+  header[3] = largeSize;
+
+  header[0] = ~header[0];
+  EXPECT_NE(RT_OK, attachPeer(channel, peer));
+  header[0] = ~header[0];
+
+  EXPECT_EQ(RT_OK, attachPeer(channel, peer));
+  munmap(p, 4096);
+
+  // too few fds
+  int fd = dup(channel->fds()[0]);
+  peer.reset();
+  EXPECT_NE(RT_OK, rtRemoteShmChannel::attach(&fd, 1, peer));
+}
+
+static rtRemoteEnvironment* createEnvironment(char const* name, char const* value)
+{
+  char path[128];
+  snprintf(path, sizeof(path), "/tmp/rtRpcTest.%d.conf", static_cast<int>(getpid()));
+
+  FILE* f = fopen(path, "w");
+  if (!f)
+    return nullptr;
+  fprintf(f, "%s=%s\n", name, value);
+  fclose(f);
+
+  rtRemoteEnvironment* env = rtEnvironmentFromFile(path);
+  unlink(path);
+  return env;
+}
+
+static void sleepFor(int millis)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+}
+
+class rtTestTarget : public rtObject
+{
+public:
+  rtDeclareObject(rtTestTarget, rtObject);
+  rtProperty(count, count, setCount, int32_t);
+  rtProperty(text, text, setText, rtString);
+  rtMethod1ArgAndReturn("echo", echo, int32_t, int32_t);
+  rtMethod1ArgAndNoReturn("sleep", sleep, int32_t);
+  rtMethodNoArgAndNoReturn("fail", fail);
+
+  rtTestTarget() : m_count(0) { }
+
+  rtError count(int32_t& n) const { n = m_count; return RT_OK; }
+  rtError setCount(int32_t n) { m_count = n; return RT_OK; }
+
+  rtError text(rtString& s) const { s = m_text; return RT_OK; }
+  rtError setText(rtString const& s) { m_text = s; return RT_OK; }
+
+  rtError echo(int32_t n, int32_t& result) { result = n; return RT_OK; }
+  rtError sleep(int32_t millis) { sleepFor(millis); return RT_OK; }
+  rtError fail() { return RT_ERROR_INVALID_ARG; }
+
+private:
+  int32_t   m_count;
+  rtString  m_text;
+};
+
+rtDefineObject(rtTestTarget, rtObject);
+rtDefineProperty(rtTestTarget, count);
+rtDefineProperty(rtTestTarget, text);
+rtDefineMethod(rtTestTarget, echo);
+rtDefineMethod(rtTestTarget, sleep);
+rtDefineMethod(rtTestTarget, fail);
+
+static char const* kTestTargetName = "rt.remote.test.target";
+static volatile sig_atomic_t serving = 1;
+
+static void onServerSignal(int /*signo*/)
+{
+  serving = 0;
+}
+
+// rtRpcTest --serve <transport>, the far end for the tests below. Every
+// environment in a process shares the object cache, so a server in the test
+// process would hand the client its local object.
+static int runTestServer(char const* transport)
+{
+  signal(SIGTERM, onServerSignal);
+
+  rtRemoteEnvironment* env = createEnvironment("rt.rpc.stream.transport", transport);
+  if (!env || rtRemoteInit(env) != RT_OK)
+    return 1;
+  if (rtRemoteRegisterObject(env, kTestTargetName, rtObjectRef(new rtTestTarget())) != RT_OK)
+    return 1;
+
+  while (serving)
+    rtRemoteRunUntil(env, 100, false);
+
+  rtRemoteUnregisterObject(env, kTestTargetName);
+  rtRemoteShutdown(env);
+  return 0;
+}
+
+// runs a test server for as long as it's in scope
+class rtTestServer
+{
+public:
+  rtTestServer(char const* transport)
+  {
+    m_pid = fork();
+    if (m_pid == 0)
+    {
+      execl("/proc/self/exe", "rtRpcTest", "--serve", transport, static_cast<char *>(nullptr));
+      _exit(1);
+    }
+  }
+
+  ~rtTestServer()
+  {
+    if (m_pid > 0)
+    {
+      kill(m_pid, SIGTERM);
+      waitpid(m_pid, nullptr, 0);
+    }
+  }
+
+  rtError locate(rtRemoteEnvironment* env, rtObjectRef& obj)
+  {
+    // give it a few seconds to come up
+    rtError e = RT_FAIL;
+    for (int i = 0; i < 10 && e != RT_OK; ++i)
+      e = rtRemoteLocateObject(env, kTestTargetName, obj, 500);
+    return e;
+  }
+
+private:
+  pid_t m_pid;
+};
+
+TEST(RemoteShmTest, socketOnlyServerTest)
+{
+  rtTestServer server(kTransportSocket);
+  rtRemoteEnvironment* env = createEnvironment("rt.rpc.stream.transport", kTransportShm);
+  ASSERT_TRUE(env != nullptr);
+  ASSERT_EQ(RT_OK, rtRemoteInit(env));
+
+  // the client asks for shm, gets turned down and carries on over the socket
+  {
+    rtObjectRef remote;
+    ASSERT_EQ(RT_OK, server.locate(env, remote));
+
+    EXPECT_EQ(RT_OK, remote.set("count", 320));
+    EXPECT_EQ(320, remote.get<int32_t>("count"));
+
+    // bigger than the shm ring, which would be split up if the two sides
+    // disagreed on the transport
+    std::string big(200 * 1024, 'x');
+    EXPECT_EQ(RT_OK, remote.set("text", rtString(big.c_str())));
+    EXPECT_EQ(big, std::string(remote.get<rtString>("text").cString()));
+  }
+
+  rtRemoteShutdown(env);
+}
+
+TEST(RemoteShmTest, shmServerTest)
+{
+  rtTestServer server(kTransportShm);
+  rtRemoteEnvironment* env = createEnvironment("rt.rpc.stream.transport", kTransportShm);
+  ASSERT_TRUE(env != nullptr);
+  ASSERT_EQ(RT_OK, rtRemoteInit(env));
+
+  {
+    rtObjectRef remote;
+    ASSERT_EQ(RT_OK, server.locate(env, remote));
+
+    // well past the ring size in small frames, so both rings wrap
+    for (int i = 0; i < 2000; ++i)
+      EXPECT_EQ(RT_OK, remote.set("count", i));
+    EXPECT_EQ(1999, remote.get<int32_t>("count"));
+
+    // through the large slot both ways
+    std::string big(200 * 1024, 'y');
+    EXPECT_EQ(RT_OK, remote.set("text", rtString(big.c_str())));
+    EXPECT_EQ(big, std::string(remote.get<rtString>("text").cString()));
+  }
+
+  rtRemoteShutdown(env);
+}
+
+// counts live instances, so a test can tell when the cache let go
+class rtCacheProbe : public rtObject
+{
+public:
+  rtDeclareObject(rtCacheProbe, rtObject);
+
+  rtCacheProbe(std::atomic<int>& live) : m_live(live)
+    { m_live++; }
+  ~rtCacheProbe()
+    { m_live--; }
+
+private:
+  std::atomic<int>& m_live;
+};
+
+rtDefineObject(rtCacheProbe, rtObject);
+
+class RemoteObjectCacheTest : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    m_live = 0;
+    m_env = createEnvironment("rt.rpc.cache.max_object_lifetime", "1");
+    ASSERT_TRUE(m_env != nullptr);
+    m_cache = m_env->ObjectCache;
+  }
+
+  virtual void TearDown()
+  {
+    rtRemoteShutdown(m_env);
+    EXPECT_EQ(0, m_live.load());
+  }
+
+  rtError insertProbe(std::string const& id)
+  {
+    return m_cache->insert(id, rtObjectRef(new rtCacheProbe(m_live)));
+  }
+
+  std::atomic<int>      m_live;
+  rtRemoteEnvironment*  m_env;
+  rtRemoteObjectCache*  m_cache;
+};
+
+TEST_F(RemoteObjectCacheTest, expiryTest)
+{
+  EXPECT_EQ(RT_OK, insertProbe("expiry"));
+  EXPECT_EQ(RT_OK, m_cache->removeUnused());
+  EXPECT_TRUE(!!m_cache->findObject("expiry"));
+
+  sleepFor(1200);
+  EXPECT_EQ(RT_OK, m_cache->removeUnused());
+  EXPECT_FALSE(!!m_cache->findObject("expiry"));
+  EXPECT_EQ(0, m_live.load());
+  EXPECT_EQ(RT_ERROR_OBJECT_NOT_FOUND, m_cache->touch("expiry", std::chrono::steady_clock::now()));
+}
+
+TEST_F(RemoteObjectCacheTest, touchTest)
+{
+  EXPECT_EQ(RT_OK, insertProbe("touch"));
+
+  sleepFor(700);
+  EXPECT_EQ(RT_OK, m_cache->touch("touch", std::chrono::steady_clock::now()));
+  sleepFor(600);
+
+  // past its first due time, but it was used since
+  EXPECT_EQ(RT_OK, m_cache->removeUnused());
+  EXPECT_TRUE(!!m_cache->findObject("touch"));
+
+  sleepFor(600);
+  EXPECT_EQ(RT_OK, m_cache->removeUnused());
+  EXPECT_FALSE(!!m_cache->findObject("touch"));
+  EXPECT_EQ(0, m_live.load());
+}
+
+TEST_F(RemoteObjectCacheTest, unevictableTest)
+{
+  EXPECT_EQ(RT_ERROR_OBJECT_NOT_FOUND, m_cache->markUnevictable("pinned", true));
+  EXPECT_EQ(RT_OK, insertProbe("pinned"));
+  EXPECT_EQ(RT_OK, m_cache->markUnevictable("pinned", true));
+
+  sleepFor(1200);
+  EXPECT_EQ(RT_OK, m_cache->removeUnused());
+  EXPECT_TRUE(!!m_cache->findObject("pinned"));
+
+  // idle all along, so it goes the next time its slot comes up
+  EXPECT_EQ(RT_OK, m_cache->markUnevictable("pinned", false));
+  sleepFor(1200);
+  EXPECT_EQ(RT_OK, m_cache->removeUnused());
+  EXPECT_FALSE(!!m_cache->findObject("pinned"));
+  EXPECT_EQ(0, m_live.load());
+}
+
+TEST_F(RemoteObjectCacheTest, duplicateTest)
+{
+  EXPECT_EQ(RT_OK, insertProbe("dup"));
+  EXPECT_EQ(RT_ERROR_DUPLICATE_ENTRY, insertProbe("dup"));
+  EXPECT_EQ(RT_ERROR_DUPLICATE_ENTRY, m_cache->insert("dup", rtFunctionRef(new rtFunctionCallback(testFunction))));
+  EXPECT_EQ(1, m_live.load());
+  EXPECT_FALSE(!!m_cache->findFunction("dup"));
+
+  EXPECT_EQ(RT_ERROR_INVALID_ARG, m_cache->insert("null", rtObjectRef()));
+  EXPECT_EQ(RT_ERROR_INVALID_ARG, m_cache->insert("null", rtFunctionRef()));
+}
+
+TEST_F(RemoteObjectCacheTest, eraseTest)
+{
+  EXPECT_EQ(RT_OK, insertProbe("erase"));
+  EXPECT_EQ(RT_OK, m_cache->erase("erase"));
+  EXPECT_EQ(0, m_live.load());
+  EXPECT_FALSE(!!m_cache->findObject("erase"));
+  EXPECT_EQ(RT_ERROR_OBJECT_NOT_FOUND, m_cache->erase("erase"));
+
+  // the old entry is still in the time wheel, it mustn't take the new one
+  // with it when its slot comes up
+  sleepFor(500);
+  EXPECT_EQ(RT_OK, insertProbe("erase"));
+  sleepFor(700);
+  EXPECT_EQ(RT_OK, m_cache->removeUnused());
+  EXPECT_TRUE(!!m_cache->findObject("erase"));
+
+  sleepFor(600);
+  EXPECT_EQ(RT_OK, m_cache->removeUnused());
+  EXPECT_FALSE(!!m_cache->findObject("erase"));
+  EXPECT_EQ(0, m_live.load());
+}
+
+TEST_F(RemoteObjectCacheTest, longLifetimeTest)
+{
+  rtRemoteShutdown(m_env);
+
+  // due further out than the wheel reaches, so its slot comes up a second
+  // after it's added
+  m_env = createEnvironment("rt.rpc.cache.max_object_lifetime", "17");
+  ASSERT_TRUE(m_env != nullptr);
+  m_cache = m_env->ObjectCache;
+
+  EXPECT_EQ(RT_OK, insertProbe("long"));
+  for (int i = 0; i < 3; ++i)
+  {
+    sleepFor(600);
+    EXPECT_EQ(RT_OK, m_cache->removeUnused());
+    EXPECT_TRUE(!!m_cache->findObject("long"));
+  }
+}
+
+TEST_F(RemoteObjectCacheTest, concurrentGrowTest)
+{
+  int const numFixed = 64;
+  int const numAdded = 20000;
+
+  for (int i = 0; i < numFixed; ++i)
+    EXPECT_EQ(RT_OK, insertProbe("fixed." + std::to_string(i)));
+
+  // readers keep finding the entries that were there all along while the
+  // shards grow under them
+  std::atomic<bool> done(false);
+  std::atomic<int> misses(0);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t)
+  {
+    readers.push_back(std::thread([this, &done, &misses, t, numFixed]
+    {
+      for (int i = t; !done.load(); ++i)
+      {
+        std::string id = "fixed." + std::to_string(i % numFixed);
+        if (!m_cache->findObject(id))
+          misses++;
+        m_cache->touch(id, std::chrono::steady_clock::now());
+      }
+    }));
+  }
+
+  for (int i = 0; i < numAdded; ++i)
+    EXPECT_EQ(RT_OK, insertProbe("added." + std::to_string(i)));
+  for (int i = 0; i < numAdded; i += 2)
+    EXPECT_EQ(RT_OK, m_cache->erase("added." + std::to_string(i)));
+
+  EXPECT_EQ(0, misses.load());
+
+  // clear() lets go of everything even with readers in the shards
+  EXPECT_EQ(RT_OK, m_cache->clear());
+  EXPECT_EQ(0, m_live.load());
+  EXPECT_EQ(0u, m_cache->size());
+
+  done = true;
+  for (std::thread& t : readers)
+    t.join();
+}
+
+class RemoteFutureTest : public ::testing::Test
+{
+protected:
+  RemoteFutureTest()
+    : m_server(kTransportSocket)
+    , m_env(nullptr)
+  {
+  }
+
+  virtual void SetUp()
+  {
+    m_env = createEnvironment("rt.rpc.stream.transport", kTransportSocket);
+    ASSERT_TRUE(m_env != nullptr);
+    ASSERT_EQ(RT_OK, rtRemoteInit(m_env));
+    ASSERT_EQ(RT_OK, m_server.locate(m_env, m_obj));
+  }
+
+  virtual void TearDown()
+  {
+    m_obj = nullptr;
+    if (m_env)
+      rtRemoteShutdown(m_env);
+  }
+
+  rtTestServer          m_server;
+  rtRemoteEnvironment*  m_env;
+  rtObjectRef           m_obj;
+};
+
+TEST_F(RemoteFutureTest, orderingTest)
+{
+  int const count = 100;
+  std::vector<rtRemoteFuturePtr> sets;
+  std::vector<rtRemoteFuturePtr> gets;
+  for (int i = 0; i < count; ++i)
+  {
+    sets.push_back(rtRemoteSetAsync(m_obj, "count", rtValue(i)));
+    gets.push_back(rtRemoteGetAsync(m_obj, "count"));
+  }
+
+  // the server runs them in the order they were sent, whatever order the
+  // responses are waited for in
+  for (int i = count - 1; i >= 0; --i)
+  {
+    rtValue v;
+    EXPECT_EQ(RT_OK, gets[i]->get(v));
+    EXPECT_EQ(i, v.toInt32());
+    EXPECT_EQ(RT_OK, sets[i]->wait());
+  }
+}
+
+TEST_F(RemoteFutureTest, timeoutTest)
+{
+  rtValue millis(500);
+  rtRemoteFuturePtr slow = rtRemoteCallAsync(m_obj, "sleep", 1, &millis);
+  EXPECT_EQ(RT_ERROR_TIMEOUT, slow->wait(100));
+
+  // queued behind the slow call
+  EXPECT_EQ(RT_OK, rtRemoteSetAsync(m_obj, "count", rtValue(5))->wait(3000));
+
+  // the late response to the slow call has come and gone by now, the
+  // future keeps its result
+  EXPECT_EQ(RT_ERROR_TIMEOUT, slow->wait(100));
+
+  int32_t n = 0;
+  EXPECT_EQ(RT_OK, m_obj.get<int32_t>("count", n));
+  EXPECT_EQ(5, n);
+}
+
+TEST_F(RemoteFutureTest, mixedBatchTest)
+{
+  rtRemoteBatch batch;
+  rtValue arg(21);
+  rtRemoteFuturePtr set = batch.set(m_obj, "count", rtValue(7));
+  rtRemoteFuturePtr failed = batch.call(m_obj, "fail", 0, nullptr);
+  rtRemoteFuturePtr get = batch.get(m_obj, "count");
+  rtRemoteFuturePtr missing = batch.call(m_obj, "noSuchMethod", 0, nullptr);
+  rtRemoteFuturePtr echo = batch.call(m_obj, "echo", 1, &arg);
+  rtRemoteFuturePtr after = batch.set(m_obj, "count", rtValue(8));
+  EXPECT_EQ(6u, batch.size());
+  EXPECT_EQ(RT_OK, batch.send());
+  EXPECT_EQ(0u, batch.size());
+
+  // each picks its own response out of the one for the batch, in any order
+  rtValue v;
+  EXPECT_EQ(RT_OK, echo->get(v));
+  EXPECT_EQ(21, v.toInt32());
+  EXPECT_NE(RT_OK, missing->wait());
+  EXPECT_EQ(RT_OK, get->get(v));
+  EXPECT_EQ(7, v.toInt32());
+  // a call that fails comes back without a return value, which a
+  // synchronous call reports the same way
+  EXPECT_NE(RT_OK, failed->wait());
+  EXPECT_EQ(RT_OK, set->wait());
+  EXPECT_EQ(RT_OK, after->wait());
+
+  // and keep it
+  EXPECT_EQ(RT_OK, echo->get(v));
+  EXPECT_EQ(21, v.toInt32());
+
+  int32_t n = 0;
+  EXPECT_EQ(RT_OK, m_obj.get<int32_t>("count", n));
+  EXPECT_EQ(8, n);
+}
+
 int main(int argc,char **argv) {
+    if (argc == 3 && strcmp(argv[1], "--serve") == 0)
+      return runTestServer(argv[2]);
+
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
@@ -17,11 +17,11 @@ limitations under the License.
 */
 
 #include <limits.h>
-#include "../../rtObject.h"
-#include "../../rtError.h"
-#include "../../rtValue.h"
-#include "../../rtString.h"
-#include "../../rtObjectMacros.h"
+#include "rtObject.h"
+#include "rtError.h"
+#include "rtValue.h"
+#include "rtString.h"
+#include "rtObjectMacros.h"
 #include <map>
 //#include <rapidjson/stringbuffer.h>
 #include <functional>
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <math.h>
 #include <png.h>
 
 #include "rtLog.h"
@@ -89,20 +90,20 @@ rtError pxLoadImage(const char *imageData, size_t imageDataSize,  pxOffscreen &o
   {
     case PX_IMAGE_PNG:
          {
-           retVal = pxLoadPNGImage(imageData, imageDataSize, o);
+           retVal = pxLoadPNGImage(imageData, imageDataSize, o, w, h, sx, sy);
          }
          break;
 
     case PX_IMAGE_JPG:
          {
 #ifdef ENABLE_LIBJPEG_TURBO
-           retVal = pxLoadJPGImageTurbo(imageData, imageDataSize, o);
+           retVal = pxLoadJPGImageTurbo(imageData, imageDataSize, o, w, h, sx, sy);
            if (retVal != RT_OK)
            {
-             retVal = pxLoadJPGImage(imageData, imageDataSize, o);
+             retVal = pxLoadJPGImage(imageData, imageDataSize, o, w, h, sx, sy);
            }
 #else
-        retVal = pxLoadJPGImage(imageData, imageDataSize, o);
+        retVal = pxLoadJPGImage(imageData, imageDataSize, o, w, h, sx, sy);
 #endif //ENABLE_LIBJPEG_TURBO
          }
          break;
@@ -174,7 +175,7 @@ rtError pxLoadImage(const char *filename, pxOffscreen &b,
   rtData d;
   rtError e = rtLoadFile(filename, d);
   if (e == RT_OK)
-    return pxLoadImage((const char *)d.data(), d.length(), b);
+    return pxLoadImage((const char *)d.data(), d.length(), b, w, h, sx, sy);
   else
   {
     e = RT_RESOURCE_NOT_FOUND;
@@ -183,6 +184,37 @@ rtError pxLoadImage(const char *filename, pxOffscreen &b,
   return e;
 }
 
+int32_t pxImageDecodeFactor(int32_t srcW, int32_t srcH, int32_t w, int32_t h,
+                            float sx, float sy, int32_t maxFactor)
+{
+  if (srcW <= 0 || srcH <= 0)
+    return 1;
+
+  // an explicit size wins over scale; only ever reduce
+  int32_t tw = srcW, th = srcH;
+  if (w > 0 || h > 0)
+  {
+    tw = w > 0 ? w : 0;
+    th = h > 0 ? h : 0;
+  }
+  else
+  {
+    if (sx > 0 && sx < 1.0f)
+      tw = (int32_t)ceilf(srcW*sx);
+    if (sy > 0 && sy < 1.0f)
+      th = (int32_t)ceilf(srcH*sy);
+  }
+
+  int32_t factor = 1;
+  for (int32_t f = 2; f <= maxFactor; f++)
+  {
+    if (srcW/f < tw || srcH/f < th)
+      break;
+    factor = f;
+  }
+  return factor;
+}
+
 rtError pxStoreImage(const char *filename, pxOffscreen &b)
 {
   return pxStorePNGImage(filename, b);
@@ -759,12 +791,24 @@ rtError pxLoadJPGImage(const char *filename, pxOffscreen &o)
   return e;
 }
 
+// libjpeg can only scale by 1/2, 1/4 and 1/8 while decoding the DCT blocks
+static int32_t pxJPGScaleDenom(int32_t srcW, int32_t srcH, int32_t w, int32_t h, float sx, float sy)
+{
+  int32_t factor = pxImageDecodeFactor(srcW, srcH, w, h, sx, sy, 8);
+  int32_t denom = 8;
+  while (denom > factor)
+    denom /= 2;
+  return denom;
+}
+
 #ifdef ENABLE_LIBJPEG_TURBO
 extern "C" {
 #include <turbojpeg.h>
 }
 
-rtError pxLoadJPGImageTurbo(const char *buf, size_t buflen, pxOffscreen &o)
+rtError pxLoadJPGImageTurbo(const char *buf, size_t buflen, pxOffscreen &o,
+                            int32_t w /* = 0 */, int32_t h /* = 0 */,
+                            float sx /* = 1.0f */, float sy /* = 1.0f */)
 {
   rtLogDebug("using pxLoadJPGImageTurbo");
   if (!buf)
@@ -788,6 +832,15 @@ rtError pxLoadJPGImageTurbo(const char *buf, size_t buflen, pxOffscreen &o)
     return RT_FAIL;// TODO : add grayscale support for libjpeg turbo.  falling back to libjpeg for now
   }
 
+  // decode straight to the reduced size when a smaller display size was hinted
+  int32_t denom = pxJPGScaleDenom(width, height, w, h, sx, sy);
+  if (denom > 1)
+  {
+    tjscalingfactor sf = { 1, denom };
+    width = TJSCALED(width, sf);
+    height = TJSCALED(height, sf);
+  }
+
   // limit memory usage to resolution 4096x4096
   if (((size_t)width * height) > ((size_t)4096 * 4096))
   {
@@ -848,7 +901,9 @@ rtError pxLoadJPGImageTurbo(const char *buf, size_t buflen, pxOffscreen &o)
 }
 #endif //ENABLE_LIBJPEG_TURBO
 
-rtError pxLoadJPGImage(const char *buf, size_t buflen, pxOffscreen &o)
+rtError pxLoadJPGImage(const char *buf, size_t buflen, pxOffscreen &o,
+                       int32_t w /* = 0 */, int32_t h /* = 0 */,
+                       float sx /* = 1.0f */, float sy /* = 1.0f */)
 {
   if (!buf)
   {
@@ -911,9 +966,11 @@ rtError pxLoadJPGImage(const char *buf, size_t buflen, pxOffscreen &o)
 
   /* Step 4: set parameters for decompression */
 
-  /* In this example, we don't need to change any of the defaults set by
-   * jpeg_read_header(), so we do nothing here.
+  /* Let the IDCT produce a reduced image when a smaller display size was
+   * hinted; this is much cheaper than decoding at full size and scaling.
    */
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = pxJPGScaleDenom(cinfo.image_width, cinfo.image_height, w, h, sx, sy);
 
   /* Step 5: Start decompressor */
 
@@ -1118,8 +1175,65 @@ void readPngData(png_structp pngPtr, png_bytep data, png_size_t length)
   pngStruct->readPosition += length;
 }
 
+// Box filters rows of RGBA pixels into o, factor x factor source pixels per
+// destination pixel.  Color is weighted by alpha so transparent pixels do not
+// darken the edges of what they surround.
+class pxPNGBoxFilter
+{
+public:
+  pxPNGBoxFilter(pxOffscreen& o, int32_t srcW, int32_t srcH, int32_t factor)
+    : mOffscreen(o), mSrcW(srcW), mSrcH(srcH), mFactor(factor),
+      mDstW((srcW+factor-1)/factor), mRow(srcW*4), mSums(mDstW*4, 0)
+  {
+    mOffscreen.init(mDstW, (srcH+factor-1)/factor);
+  }
+
+  png_byte* row() { return &mRow[0]; }
+
+  // adds source row y, which has been read into row()
+  void addRow(int32_t y)
+  {
+    const png_byte* row = &mRow[0];
+    uint64_t* s = &mSums[0];
+    for (int32_t x = 0; x < mSrcW; x++)
+    {
+      const png_byte* p = row + x*4;
+      uint64_t* d = s + (x/mFactor)*4;
+      d[0] += p[0]*p[3];
+      d[1] += p[1]*p[3];
+      d[2] += p[2]*p[3];
+      d[3] += p[3];
+    }
+
+    if ((y+1) % mFactor == 0 || y+1 == mSrcH)
+    {
+      int32_t rows = (y % mFactor)+1;
+      png_byte* out = (png_byte*)mOffscreen.scanline(y/mFactor);
+      for (int32_t dx = 0; dx < mDstW; dx++)
+      {
+        int32_t cols = (dx+1)*mFactor <= mSrcW ? mFactor : mSrcW-dx*mFactor;
+        uint64_t* d = s + dx*4;
+        uint64_t a = d[3];
+        out[0] = a ? (png_byte)(d[0]/a) : 0;
+        out[1] = a ? (png_byte)(d[1]/a) : 0;
+        out[2] = a ? (png_byte)(d[2]/a) : 0;
+        out[3] = (png_byte)(a/(uint64_t)(rows*cols));
+        out += 4;
+      }
+      memset(s, 0, mSums.size()*sizeof(uint64_t));
+    }
+  }
+
+private:
+  pxOffscreen& mOffscreen;
+  int32_t mSrcW, mSrcH, mFactor, mDstW;
+  std::vector<png_byte> mRow;
+  std::vector<uint64_t> mSums;
+};
+
 rtError pxLoadPNGImage(const char *imageData, size_t imageDataSize,
-                       pxOffscreen &o)
+                       pxOffscreen &o, int32_t w /* = 0 */, int32_t h /* = 0 */,
+                       float sx /* = 1.0f */, float sy /* = 1.0f */)
 {
   rtError e = RT_FAIL;
 
@@ -1211,11 +1325,47 @@ rtError pxLoadPNGImage(const char *imageData, size_t imageDataSize,
     //png_set_bgr(png_ptr);
     png_set_add_alpha(png_ptr, 0xff, PNG_FILLER_AFTER);
 
-    o.init(width, height);
+    // Interlaced images need every pass before a row is final, so only
+    // progressive images are reduced while decoding.
+    int32_t factor = 1;
+    if (png_get_interlace_type(png_ptr, info_ptr) == PNG_INTERLACE_NONE)
+    {
+      factor = pxImageDecodeFactor(width, height, w, h, sx, sy, 64);
+    }
 
     //	    number_of_passes = png_set_interlace_handling(png_ptr);
     png_read_update_info(png_ptr, info_ptr);
 
+    if (factor > 1)
+    {
+      // read a row at a time into a box filter; the full size image is
+      // never held in memory
+      pxPNGBoxFilter filter(o, width, height, factor);
+      if (!setjmp(png_jmpbuf(png_ptr)))
+      {
+        for (int y = 0; y < height; y++)
+        {
+          png_read_row(png_ptr, filter.row(), NULL);
+          filter.addRow(y);
+        }
+        e = RT_OK;
+      }
+      else
+      {
+        e = RT_FAIL;
+      }
+
+      if (e == RT_OK)
+      {
+        o.mPixelFormat = RT_PIX_RGBA;
+      }
+
+      png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+      return e;
+    }
+
+    o.init(width, height);
+
     // read file
     if (!setjmp(png_jmpbuf(png_ptr)))
     {
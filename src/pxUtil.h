@@ -111,6 +111,9 @@ pxImageType;
 pxImageType getImageType(const uint8_t* data, size_t len);
 rtString imageType2str(pxImageType t);
 
+// w, h, sx and sy are a rasterization size for SVG.  For PNG and JPG they are
+// a display size hint: the image is decoded reduced by an integer factor as
+// long as the result stays at least that large.
 rtError pxLoadImage( const char* imageData, size_t imageDataSize, pxOffscreen& o, int32_t w = 0, int32_t h = 0, float sx = 1.0f, float sy = 1.0f);
 rtError pxLoadImage( const char* filename,                        pxOffscreen& b, int32_t w = 0, int32_t h = 0, float sx = 1.0f, float sy = 1.0f);
 rtError pxStoreImage(const char* filename, pxOffscreen& b);
@@ -123,8 +126,15 @@ rtError pxLoadAImage(const char* imageData, size_t imageDataSize,
 rtError pxLoadAPNGImage(const char *imageData, size_t imageDataSize,
   pxTimedOffscreenSequence &s);
 
+// Largest reduction factor, no greater than maxFactor, that keeps a srcW x srcH
+// image at least as large as the w x h (or sx, sy scaled) hint.  Returns 1 when
+// there is no hint or no reduction is possible.
+int32_t pxImageDecodeFactor(int32_t srcW, int32_t srcH, int32_t w, int32_t h,
+                            float sx, float sy, int32_t maxFactor);
+
 rtError pxLoadPNGImage(const char* imageData, size_t imageDataSize, 
-                       pxOffscreen& o);
+                       pxOffscreen& o, int32_t w = 0, int32_t h = 0,
+                       float sx = 1.0f, float sy = 1.0f);
 rtError pxLoadPNGImage(const char* filename, pxOffscreen& o);
 rtError pxStorePNGImage(const char* filename, pxOffscreen& b,
                         bool grayscale = false, bool alpha=true);
@@ -137,10 +147,12 @@ rtError pxStoreJPGImage(const char* filename, pxBuffer& b);
 #endif
 
 #ifdef ENABLE_LIBJPEG_TURBO
-rtError pxLoadJPGImageTurbo(const char* buf, size_t buflen, pxOffscreen& o);
+rtError pxLoadJPGImageTurbo(const char* buf, size_t buflen, pxOffscreen& o,
+                            int32_t w = 0, int32_t h = 0, float sx = 1.0f, float sy = 1.0f);
 #endif //ENABLE_LIBJPEG_TURBO
 
-rtError pxLoadJPGImage(const char* imageData, size_t imageDataSize, pxOffscreen& o);
+rtError pxLoadJPGImage(const char* imageData, size_t imageDataSize, pxOffscreen& o,
+                       int32_t w = 0, int32_t h = 0, float sx = 1.0f, float sy = 1.0f);
 rtError pxLoadJPGImage(const char* filename, pxOffscreen& o);
 
 
@@ -26,10 +26,12 @@
 #define rtAtomic          volatile int32_t
 #define rtAtomicInc(ptr)  (InterlockedIncrement((volatile unsigned int *)ptr))
 #define rtAtomicDec(ptr)  (InterlockedDecrement((volatile unsigned int *)ptr))
+#define rtAtomicCompareAndSwap(ptr, oldval, newval) (InterlockedCompareExchange((volatile LONG *)ptr, newval, oldval) == (oldval))
 #else
 #define rtAtomic          volatile int32_t
 #define rtAtomicInc(ptr)  (__sync_add_and_fetch(ptr, 1))
 #define rtAtomicDec(ptr)  (__sync_sub_and_fetch(ptr, 1))
+#define rtAtomicCompareAndSwap(ptr, oldval, newval) (__sync_bool_compare_and_swap(ptr, oldval, newval))
 #endif
 
 #endif
@@ -29,12 +29,73 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 #include "rtSettings.h"
 
+#include <algorithm>
+#include <vector>
+
 #define DEFAULT_MAX_CACHE_SIZE 20971520
+#define DEFAULT_MAX_HOT_CACHE_SIZE 4194304
+
+// entries up to this size are kept in memory while they are being used
+#define MAX_HOT_ENTRY_SIZE 65536
+
+// the index is rewritten by the writer thread at most this often (seconds)
+#define INDEX_SAVE_INTERVAL 5
+
+#define INDEX_FILE_NAME "cache.index"
+#define INDEX_MAGIC 0x43465452 // "RTFC"
+#define INDEX_VERSION 2
 
 using namespace std;
 
+// Index file layout, native byte order:
+//   uint32 magic, uint32 version, uint32 entry count
+// then per entry, least recently used first:
+//   uint64 url hash, int64 size, int64 last access
+// Freshness comes from the header stored in the cache file itself.
+struct rtFileCacheIndexHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+};
+
+struct rtFileCacheIndexRecord
+{
+  uint64_t key;
+  int64_t size;
+  int64_t lastAccess;
+};
+
+static const size_t kIndexRecordSize = 8 + 8 + 8;
+
+static void appendIndexBytes(string& index, const void* bytes, size_t length)
+{
+  index.append((const char*)bytes, length);
+}
+
+// hands out cache data held in memory as the FILE* rtHttpCacheData reads
+static FILE* openMemoryFile(rtData& data)
+{
+#ifdef RT_PLATFORM_WINDOWS
+  FILE* fp = tmpfile();
+#else
+  // one more byte than the data for the terminator fmemopen writes
+  FILE* fp = fmemopen(NULL, data.length() + 1, "w+");
+#endif
+  if (NULL == fp)
+    return NULL;
+  if (fwrite(data.data(), 1, data.length(), fp) != data.length())
+  {
+    fclose(fp);
+    return NULL;
+  }
+  rewind(fp);
+  return fp;
+}
+
 rtFileCache* rtFileCache::instance()
 {
   if (NULL == mCache)
@@ -54,7 +115,9 @@ void rtFileCache::destroy()
 }
 
 rtFileCache* rtFileCache::mCache = NULL;
-rtFileCache::rtFileCache():mMaxSize(DEFAULT_MAX_CACHE_SIZE),mCurrentSize(0),mDirectory("/tmp/cache"),mCacheMutex()
+rtFileCache::rtFileCache():mMaxSize(DEFAULT_MAX_CACHE_SIZE),mCurrentSize(0),mMaxHotSize(DEFAULT_MAX_HOT_CACHE_SIZE),mHotSize(0),
+  mDirectory("/tmp/cache"),mEntries(),mLruList(),mHotList(),mWrites(),mNextGeneration(0),mIndexDirty(false),mIndexSaveRequested(false),
+  mLastIndexSave(0),mWriterThread(NULL),mWriterRunning(false),mWriterBusy(false),mCacheMutex()
 {
   char const *s = getenv("SPARK_CACHE_DIRECTORY");
   if (s)
@@ -71,18 +134,19 @@ rtFileCache::rtFileCache():mMaxSize(DEFAULT_MAX_CACHE_SIZE),mCurrentSize(0),mDir
     mDirectory = cacheDirectory.toString();
   }
   rtLogInfo("The cache directory is set to %s", mDirectory.cString());
-  mFileSizeMap.clear();
-  mFileTimeMap.clear();
   initCache();
+  startWriter();
 }
 
 rtFileCache::~rtFileCache()
 {
+  stopWriter();
+  saveIndex();
+  mCacheMutex.lock();
+  resetIndex();
   mMaxSize = 0;
-  mCurrentSize = 0;
   mDirectory = "";
-  mFileSizeMap.clear();
-  mFileTimeMap.clear();
+  mCacheMutex.unlock();
 }
 
 void  rtFileCache::initCache()
@@ -95,48 +159,353 @@ void  rtFileCache::initCache()
 #endif
   if (0 != retVal)
     rtLogWarn("creation of cache directory %s failed: %d", mDirectory.cString(), retVal);
-  populateExistingFiles();
+  if (!loadIndex())
+    populateExistingFiles();
 }
 
 void rtFileCache::populateExistingFiles()
 {
-  mFileTimeMap.clear();
-  mFileSizeMap.clear();
   DIR *directory;
   struct dirent *direntry;
   struct stat buf;
   int exists = 0;
+
+  mCacheMutex.lock();
+  resetIndex();
+  mCacheMutex.unlock();
+
   directory = opendir(mDirectory.cString());
 
   if (NULL == directory) {
     return;
   }
 
+  vector<pair<time_t, rtFileCacheIndexRecord> > files;
   for (direntry = readdir(directory); direntry != NULL; direntry = readdir(directory))
   {
-    if ((strcmp(direntry->d_name,".") !=0 ) && (strcmp(direntry->d_name,"..") != 0))
+    uint64_t key;
+    if (!fileNameKey(direntry->d_name, key))
+      continue;
+
+    rtString filename = mDirectory;
+    filename.append("/");
+    filename.append(direntry->d_name);
+    exists = stat(filename.cString(), &buf);
+    if (exists < 0)
     {
-      rtString filename = mDirectory;
-      filename.append("/");
-      filename.append(direntry->d_name);
-      exists = stat(filename.cString(), &buf);
-      if (exists < 0)
-      {
-        rtLogWarn("Reading the cache directory is failed for file(%s)",filename.cString());
-        continue;
-      }
+      rtLogWarn("Reading the cache directory is failed for file(%s)",filename.cString());
+      continue;
+    }
+    rtFileCacheIndexRecord record;
+    record.key = key;
+    record.size = buf.st_size;
 #if defined(PX_PLATFORM_MAC)
-       mFileTimeMap.insert(make_pair(buf.st_atimespec.tv_sec,direntry->d_name));
-#elif !(defined(WIN32) || defined(_WIN32) || defined (WINDOWS) || defined (_WINDOWS))
-       mFileTimeMap.insert(make_pair(buf.st_atim.tv_sec,direntry->d_name));
+    record.lastAccess = buf.st_atimespec.tv_sec;
 #else
-       rtLogWarn("Platform not supported. Cache will not get cleared after cache limit is reached");
+    record.lastAccess = buf.st_atime;
 #endif
-      mFileSizeMap[direntry->d_name] = buf.st_size;
-      mCurrentSize += buf.st_size;
-    }
+    files.push_back(make_pair((time_t)record.lastAccess, record));
   }
   closedir(directory);
+
+  // the access times only give the initial order; from here on it's exact
+  sort(files.begin(), files.end(),
+    [](const pair<time_t, rtFileCacheIndexRecord>& a, const pair<time_t, rtFileCacheIndexRecord>& b) { return a.first < b.first; });
+
+  mCacheMutex.lock();
+  for (size_t i = 0; i < files.size(); i++)
+  {
+    rtFileCacheEntry& entry = insertEntry(files[i].second.key);
+    entry.size = files[i].second.size;
+    entry.lastAccess = files[i].first;
+    mCurrentSize += entry.size;
+  }
+  mIndexDirty = true;
+  mCacheMutex.unlock();
+  rtLogInfo("rebuilt the cache index from %d files in %s", (int)files.size(), mDirectory.cString());
+}
+
+bool rtFileCache::loadIndex()
+{
+  rtString indexPath = absPath(INDEX_FILE_NAME);
+  rtData index;
+  if (RT_OK != rtLoadFile(indexPath.cString(), index))
+    return false;
+
+  const uint8_t* p = index.data();
+  const uint8_t* end = p + index.length();
+  rtFileCacheIndexHeader header;
+  if ((size_t)(end - p) < sizeof(header))
+    return false;
+  memcpy(&header, p, sizeof(header));
+  p += sizeof(header);
+  if ((header.magic != INDEX_MAGIC) || (header.version != INDEX_VERSION))
+  {
+    rtLogWarn("ignoring cache index %s with unknown format", indexPath.cString());
+    return false;
+  }
+
+  mCacheMutex.lock();
+  resetIndex();
+  bool valid = true;
+  for (uint32_t i = 0; i < header.count; i++)
+  {
+    rtFileCacheIndexRecord record;
+    if ((size_t)(end - p) < kIndexRecordSize)
+    {
+      valid = false;
+      break;
+    }
+    memcpy(&record.key, p, 8);
+    memcpy(&record.size, p + 8, 8);
+    memcpy(&record.lastAccess, p + 16, 8);
+    p += kIndexRecordSize;
+    if (mEntries.find(record.key) != mEntries.end())
+    {
+      valid = false;
+      break;
+    }
+    rtFileCacheEntry& entry = insertEntry(record.key);
+    entry.size = record.size;
+    entry.lastAccess = (time_t)record.lastAccess;
+    mCurrentSize += entry.size;
+  }
+  if (!valid)
+  {
+    rtLogWarn("cache index %s is truncated", indexPath.cString());
+    resetIndex();
+  }
+  mLastIndexSave = time(NULL);
+  mCacheMutex.unlock();
+  return valid;
+}
+
+void rtFileCache::serializeIndex(rtData& data)
+{
+  string index;
+  index.reserve(sizeof(rtFileCacheIndexHeader) + mEntries.size() * kIndexRecordSize);
+  rtFileCacheIndexHeader header;
+  header.magic = INDEX_MAGIC;
+  header.version = INDEX_VERSION;
+  header.count = (uint32_t)mEntries.size();
+  appendIndexBytes(index, &header, sizeof(header));
+  for (list<uint64_t>::iterator it = mLruList.begin(); it != mLruList.end(); ++it)
+  {
+    const rtFileCacheEntry& entry = mEntries[*it];
+    int64_t lastAccess = entry.lastAccess;
+    appendIndexBytes(index, &(*it), 8);
+    appendIndexBytes(index, &entry.size, 8);
+    appendIndexBytes(index, &lastAccess, 8);
+  }
+  data.init((const uint8_t*)index.data(), index.length());
+}
+
+void rtFileCache::saveIndex()
+{
+  rtData index;
+  mCacheMutex.lock();
+  if (mDirectory.isEmpty())
+  {
+    mCacheMutex.unlock();
+    return;
+  }
+  serializeIndex(index);
+  rtString indexPath = absPath(INDEX_FILE_NAME);
+  mIndexDirty = false;
+  mIndexSaveRequested = false;
+  mLastIndexSave = time(NULL);
+  mCacheMutex.unlock();
+
+  // write a new file and rename it so a crash never leaves a partial index
+  rtString tempPath = indexPath;
+  tempPath.append(".tmp");
+  if ((RT_OK != rtStoreFile(tempPath.cString(), index)) || (0 != rename(tempPath.cString(), indexPath.cString())))
+    rtLogWarn("writing the cache index %s failed", indexPath.cString());
+}
+
+void rtFileCache::resetIndex()
+{
+  mEntries.clear();
+  mLruList.clear();
+  mHotList.clear();
+  mCurrentSize = 0;
+  mHotSize = 0;
+  mIndexDirty = false;
+}
+
+rtFileCache::rtFileCacheEntry& rtFileCache::insertEntry(uint64_t key)
+{
+  rtFileCacheEntryMap::iterator it = mEntries.find(key);
+  if (it != mEntries.end())
+    return it->second;
+  rtFileCacheEntry& entry = mEntries[key];
+  entry.generation = ++mNextGeneration;
+  entry.lruPosition = mLruList.insert(mLruList.end(), key);
+  return entry;
+}
+
+void rtFileCache::eraseEntry(rtFileCacheEntryMap::iterator it, bool removeFile)
+{
+  rtFileCacheEntry& entry = it->second;
+  if (entry.hot)
+  {
+    mHotList.erase(entry.hotPosition);
+    mHotSize -= entry.size;
+  }
+  mLruList.erase(entry.lruPosition);
+  mCurrentSize -= entry.size;
+  if (removeFile)
+    queueWrite(it->first, 0, absPath(keyFileName(it->first)), shared_ptr<rtData>());
+  mEntries.erase(it);
+  mIndexDirty = true;
+}
+
+void rtFileCache::touchEntry(rtFileCacheEntry& entry)
+{
+  mLruList.splice(mLruList.end(), mLruList, entry.lruPosition);
+  if (entry.hot)
+    mHotList.splice(mHotList.end(), mHotList, entry.hotPosition);
+  entry.lastAccess = time(NULL);
+  mIndexDirty = true;
+}
+
+void rtFileCache::makeHot(uint64_t key, rtFileCacheEntry& entry)
+{
+  if (entry.hot || (entry.size > MAX_HOT_ENTRY_SIZE) || !entry.data)
+    return;
+  entry.hot = true;
+  entry.hotPosition = mHotList.insert(mHotList.end(), key);
+  mHotSize += entry.size;
+  while ((mHotSize > mMaxHotSize) && !mHotList.empty())
+    makeCold(mEntries[mHotList.front()]);
+}
+
+void rtFileCache::makeCold(rtFileCacheEntry& entry)
+{
+  if (!entry.hot)
+    return;
+  mHotList.erase(entry.hotPosition);
+  mHotSize -= entry.size;
+  entry.hot = false;
+  // a pending write still needs the data, and serves reads until it's done
+  if (!entry.pendingWrite)
+    entry.data.reset();
+}
+
+void rtFileCache::queueWrite(uint64_t key, uint64_t generation, const rtString& path, const shared_ptr<rtData>& data)
+{
+  rtFileCacheWrite write;
+  write.key = key;
+  write.generation = generation;
+  write.path = path;
+  write.data = data;
+  mWrites.push_back(write);
+  mWriterCondition.signal();
+}
+
+void rtFileCache::requestIndexSave()
+{
+  if (mIndexDirty && !mIndexSaveRequested && (time(NULL) - mLastIndexSave >= INDEX_SAVE_INTERVAL))
+  {
+    mIndexSaveRequested = true;
+    mWriterCondition.signal();
+  }
+}
+
+void rtFileCache::startWriter()
+{
+  mCacheMutex.lock();
+  if (NULL == mWriterThread)
+  {
+    mWriterRunning = true;
+    mWriterThread = new std::thread(&rtFileCache::runWriter, this);
+  }
+  mCacheMutex.unlock();
+}
+
+void rtFileCache::stopWriter()
+{
+  mCacheMutex.lock();
+  std::thread* writerThread = mWriterThread;
+  mWriterRunning = false;
+  mWriterThread = NULL;
+  mWriterCondition.signal();
+  mCacheMutex.unlock();
+  if (NULL != writerThread)
+  {
+    writerThread->join();
+    delete writerThread;
+  }
+}
+
+void rtFileCache::runWriter()
+{
+  mCacheMutex.lock();
+  while (true)
+  {
+    while (mWrites.empty() && !mIndexSaveRequested && mWriterRunning)
+      mWriterCondition.wait(mCacheMutex.getNativeMutexDescription());
+
+    if (!mWrites.empty())
+    {
+      rtFileCacheWrite write = mWrites.front();
+      mWrites.pop_front();
+      // files evicted or rewritten before we got to them aren't written
+      rtFileCacheEntryMap::iterator it = mEntries.find(write.key);
+      if (!write.data || ((it != mEntries.end()) && (it->second.generation == write.generation)))
+      {
+        mWriterBusy = true;
+        mCacheMutex.unlock();
+
+        bool ret = write.data ? writeFile(write.path, *write.data) : deleteFile(write.path);
+
+        mCacheMutex.lock();
+        mWriterBusy = false;
+        it = mEntries.find(write.key);
+        if (write.data && (it != mEntries.end()) && (it->second.generation == write.generation))
+        {
+          if (!ret)
+          {
+            rtLogWarn("writing the cache file %s failed", write.path.cString());
+            eraseEntry(it, false);
+          }
+          else
+          {
+            it->second.pendingWrite = false;
+            if (!it->second.hot)
+              it->second.data.reset();
+          }
+        }
+      }
+      if (!mWrites.empty())
+        continue;
+    }
+    else if (!mWriterRunning)
+    {
+      break;
+    }
+
+    if (mIndexSaveRequested || (mIndexDirty && (time(NULL) - mLastIndexSave >= INDEX_SAVE_INTERVAL)))
+    {
+      mWriterBusy = true;
+      mCacheMutex.unlock();
+      saveIndex();
+      mCacheMutex.lock();
+      mWriterBusy = false;
+    }
+    if (mWrites.empty())
+      mWriterIdleCondition.broadcast();
+  }
+  mWriterIdleCondition.broadcast();
+  mCacheMutex.unlock();
+}
+
+void rtFileCache::waitForWrites()
+{
+  mCacheMutex.lock();
+  while ((!mWrites.empty() || mWriterBusy) && (NULL != mWriterThread))
+    mWriterIdleCondition.wait(mCacheMutex.getNativeMutexDescription());
+  mCacheMutex.unlock();
 }
 
 rtError rtFileCache::setMaxCacheSize(int64_t bytes)
@@ -152,6 +521,7 @@ int64_t rtFileCache::maxCacheSize()
 
 int64_t rtFileCache::cacheSize()
 {
+  rtMutexLockGuard lock(mCacheMutex);
   return mCurrentSize;
 }
 
@@ -161,7 +531,13 @@ rtError rtFileCache::setCacheDirectory(const char* directory)
   {
     return RT_ERROR;
   }
+  // pending writes go to the old directory, then its index is brought up to date
+  waitForWrites();
+  saveIndex();
+
+  mCacheMutex.lock();
   mDirectory = directory;
+  mCacheMutex.unlock();
 
   int retVal = -1;
 #ifdef RT_PLATFORM_WINDOWS
@@ -171,7 +547,8 @@ rtError rtFileCache::setCacheDirectory(const char* directory)
 #endif //RT_PLATFORM_WINDOWS
   if (0 != retVal)
     rtLogWarn("creation of cache directory(%s) failed", mDirectory.cString());
-  populateExistingFiles();
+  if (!loadIndex())
+    populateExistingFiles();
   return RT_OK;
 }
 
@@ -183,52 +560,35 @@ rtError rtFileCache::cacheDirectory(rtString& dir)
   return RT_OK;
 }
 
-void rtFileCache::eraseData(rtString& filename)
-{
-  if (! filename.isEmpty())
-  {
-    mCacheMutex.lock();
-    mCurrentSize = mCurrentSize - mFileSizeMap[filename];
-    mFileSizeMap.erase(filename);
-    multimap<time_t,rtString>::iterator iter = mFileTimeMap.begin();
-    while (iter != mFileTimeMap.end())
-    {
-      if (iter->second == filename.cString())
-      {
-        break;
-      }
-      iter++;
-    }
-    if (iter != mFileTimeMap.end())
-      mFileTimeMap.erase(iter);
-    mCacheMutex.unlock();
-  }
-}
-
 rtError rtFileCache::removeData(const char* url)
 {
   if (NULL == url)
     return RT_ERROR;
 
   rtString urlToRemove = url;
-  rtString filename = hashedFileName(urlToRemove);
-  if (! filename.isEmpty())
-  {
-    if (false == deleteFile(filename))
-    {
-      rtLogWarn("!!! deletion of cache failed for url(%s)",url);
-      return RT_ERROR;
-    }
-    eraseData(filename);
-  }
-  else
-  {
-    rtLogWarn("!!! Got wrong filehash for url during removal of data (%s)",url);
-    return RT_ERROR;
-  }
+  uint64_t key = urlKey(urlToRemove);
+  mCacheMutex.lock();
+  rtFileCacheEntryMap::iterator it = mEntries.find(key);
+  if (it != mEntries.end())
+    eraseEntry(it, true);
+  mCacheMutex.unlock();
   return RT_OK;
 }
 
+void rtFileCache::serializeCacheData(const rtHttpCacheData& constCacheData, rtData& data)
+{
+  rtHttpCacheData* cacheData = const_cast<rtHttpCacheData*>(&constCacheData);
+  stringstream stream;
+  stream << cacheData->expirationDateUnix();
+  string date = stream.str().c_str();
+  data.init(cacheData->headerData().length() + date.length() + 1 + cacheData->contentsData().length() + 1);
+  memcpy(data.data(),cacheData->headerData().data(),cacheData->headerData().length());
+  memset(data.data()+cacheData->headerData().length(),'|',1);
+  memcpy(data.data()+cacheData->headerData().length()+1,date.c_str(), date.length());
+  memset(data.data()+cacheData->headerData().length() + date.length() + 1,'|',1);
+  memcpy(data.data()+cacheData->headerData().length()+1+ date.length() + 1,cacheData->contentsData().data(),cacheData->contentsData().length());
+}
+
 rtError rtFileCache::addToCache(const rtHttpCacheData& data)
 {
   rtString url;
@@ -245,29 +605,34 @@ rtError rtFileCache::addToCache(const rtHttpCacheData& data)
     rtLogWarn("Problem in getting hash from the url(%s) while adding to cache ",url.cString());
     return RT_ERROR;
   }
-  else
+
+  // the write itself happens later, so catch a missing directory now
+  if (0 != access(mDirectory.cString(), W_OK))
   {
-    // If the file was already cached and got deleted manually, then we should clean up the corresponding data.
-    if(mFileSizeMap[filename])
-    {
-      if ( !mFileTimeMap.empty() )
-      {
-        eraseData(filename);
-      }
-    }
+    rtLogWarn("cache directory(%s) is not writable, not caching url(%s)", mDirectory.cString(), url.cString());
+    return RT_ERROR;
   }
 
-  bool ret = writeFile(filename,data);
-  if (true != ret)
-     return RT_ERROR;
-  setFileSizeAndTime(filename);
-
+  shared_ptr<rtData> fileData(new rtData());
+  serializeCacheData(data, *fileData);
 
   mCacheMutex.lock();
-  mCurrentSize += mFileSizeMap[filename];
-  int64_t size = cleanup();
+  uint64_t key = urlKey(url);
+  rtFileCacheEntry& entry = insertEntry(key);
+  makeCold(entry);
+  touchEntry(entry);
+  mCurrentSize += (int64_t)fileData->length() - entry.size;
+  entry.size = fileData->length();
+  entry.generation = ++mNextGeneration;
+  entry.pendingWrite = true;
+  entry.data = fileData;
+  makeHot(key, entry);
+  queueWrite(key, entry.generation, absPath(filename), fileData);
+  int64_t entrySize = entry.size;
+  int64_t size = cleanupLocked();
+  requestIndexSave();
   mCacheMutex.unlock();
-  rtLogInfo("addToCache url(%s) filename(%s) size(%ld) Cache expiration(%s) total cache size (%ld)", url.cString(), filename.cString(), (long) mFileSizeMap[filename], data.expirationDate().cString(), (long) size);
+  rtLogInfo("addToCache url(%s) filename(%s) size(%ld) Cache expiration(%s) total cache size (%ld)", url.cString(), filename.cString(), (long) entrySize, data.expirationDate().cString(), (long) size);
   return RT_OK;
 }
 
@@ -280,8 +645,62 @@ rtError rtFileCache::httpCacheData(const char* url, rtHttpCacheData& cacheData)
     rtLogWarn("Problem in getting hash from the url(%s) while read from cache",url);
     return RT_ERROR;
   }
-  if (false == readFileHeader(filename,cacheData))
+
+  // misses are answered from the index without touching the disk
+  uint64_t key = urlKey(urlToQuery);
+  mCacheMutex.lock();
+  rtFileCacheEntryMap::iterator it = mEntries.find(key);
+  if (it == mEntries.end())
+  {
+    mCacheMutex.unlock();
     return RT_ERROR;
+  }
+  touchEntry(it->second);
+  shared_ptr<rtData> fileData = it->second.data;
+  uint64_t generation = it->second.generation;
+  int64_t entrySize = it->second.size;
+  requestIndexSave();
+  mCacheMutex.unlock();
+
+  if (!fileData && (entrySize <= MAX_HOT_ENTRY_SIZE))
+  {
+    // small files are read whole and kept for the next request
+    shared_ptr<rtData> loadedData(new rtData());
+    if (RT_OK == rtLoadFile(absPath(filename).cString(), *loadedData))
+    {
+      fileData = loadedData;
+      mCacheMutex.lock();
+      it = mEntries.find(key);
+      if ((it != mEntries.end()) && (it->second.generation == generation) && !it->second.data)
+      {
+        it->second.data = fileData;
+        makeHot(key, it->second);
+      }
+      mCacheMutex.unlock();
+    }
+  }
+
+  bool ret = false;
+  if (fileData)
+  {
+    FILE* fp = openMemoryFile(*fileData);
+    ret = (NULL != fp) && readHeader(fp, filename, cacheData);
+  }
+  else
+  {
+    ret = readFileHeader(filename, cacheData);
+  }
+
+  if (!ret)
+  {
+    // the file went away behind our back
+    mCacheMutex.lock();
+    it = mEntries.find(key);
+    if ((it != mEntries.end()) && (it->second.generation == generation))
+      eraseEntry(it, false);
+    mCacheMutex.unlock();
+    return RT_ERROR;
+  }
   return RT_OK;
 }
 
@@ -289,112 +708,104 @@ void rtFileCache::clearCache()
 {
   if (! mDirectory.isEmpty())
   {
-    rtString buff("rm -rf ");
-    buff.append(mDirectory.cString());
-    buff.append("/*");
-    int retVal = system(buff.cString());
+    // files the index lost track of, e.g. when the process exited before
+    // the index was saved, go too
+    vector<uint64_t> files;
+    listCacheFiles(files);
 
-    if(retVal == -1)
+    mCacheMutex.lock();
+    // pending writes are dropped, deletes already queued still have to happen
+    for (list<rtFileCacheWrite>::iterator it = mWrites.begin(); it != mWrites.end(); )
     {
-      // The system method failed
+      if (it->data)
+        it = mWrites.erase(it);
+      else
+        ++it;
     }
-
-    mFileSizeMap.clear();
-    mCacheMutex.lock();
-    mCurrentSize = 0;
+    unordered_set<uint64_t> keys(files.begin(), files.end());
+    keys.insert(mLruList.begin(), mLruList.end());
+    // the writer thread unlinks the files, same as for evictions
+    for (unordered_set<uint64_t>::iterator it = keys.begin(); it != keys.end(); ++it)
+      queueWrite(*it, 0, absPath(keyFileName(*it)), shared_ptr<rtData>());
+    resetIndex();
+    mIndexDirty = true;
+    mIndexSaveRequested = true;
+    mWriterCondition.signal();
     mCacheMutex.unlock();
   }
 }
 
 int64_t rtFileCache::cleanup()
 {
-  if ( (mCurrentSize > mMaxSize) && !(mFileTimeMap.empty()))
-  {
-    multimap<time_t,rtString>::iterator iter = mFileTimeMap.begin();
-    vector <multimap<time_t,rtString>::iterator> timeMapIters;
-    do
-    {
-      rtString filename = iter->second;
-      if (! filename.isEmpty())
-      {
-          rtLogInfo("Storage capacity exceeded" );
-          if(false == deleteFile(filename))
-          {
-            rtLogWarn("!!! deletion of cache failed during cleanup for file(%s)",filename.cString());
-          }
-          else
-          {
-            mCurrentSize = mCurrentSize - mFileSizeMap[filename];
-            timeMapIters.push_back(iter);
-            mFileSizeMap.erase(filename);
-          }
-      }
-      iter++;
-    } while ((mCurrentSize > mMaxSize) && (iter != mFileTimeMap.end()));
+  rtMutexLockGuard lock(mCacheMutex);
+  return cleanupLocked();
+}
 
-    for (unsigned int count =0; count < timeMapIters.size(); count++)
-      mFileTimeMap.erase(timeMapIters[count]);
-    timeMapIters.clear();
+int64_t rtFileCache::cleanupLocked()
+{
+  if ((mCurrentSize > mMaxSize) && !mLruList.empty())
+  {
+    rtLogInfo("Storage capacity exceeded" );
+    while ((mCurrentSize > mMaxSize) && !mLruList.empty())
+      eraseEntry(mEntries.find(mLruList.front()), true);
   }
   return mCurrentSize;
 }
 
 rtString rtFileCache::hashedFileName(const rtString& url)
 {
-  long int hash = hashFn(url.cString());
+  return keyFileName(urlKey(url));
+}
+
+uint64_t rtFileCache::urlKey(const rtString& url)
+{
+  return (uint64_t)hashFn(url.cString());
+}
+
+rtString rtFileCache::keyFileName(uint64_t key)
+{
+  long int hash = (long int)(size_t)key;
   stringstream stream;
   stream << hash;
   return stream.str().c_str();
 }
 
-void rtFileCache::setFileSizeAndTime(rtString& filename)
+bool rtFileCache::fileNameKey(const char* name, uint64_t& key)
 {
-  if (!mDirectory.isEmpty())
+  // only files named after a url hash belong to the cache
+  char* end = NULL;
+  long int hash = strtol(name, &end, 10);
+  if ((end == name) || (*end != '\0'))
+    return false;
+  key = (uint64_t)(size_t)hash;
+  return keyFileName(key) == name;
+}
+
+void rtFileCache::listCacheFiles(vector<uint64_t>& keys)
+{
+  DIR* directory = opendir(mDirectory.cString());
+  if (NULL == directory)
+    return;
+  for (struct dirent* direntry = readdir(directory); direntry != NULL; direntry = readdir(directory))
   {
-    struct stat statbuf;
-    rtString absPathString  = absPath(filename);
-    if (stat(absPathString.cString(), &statbuf) == 0)
-    {
-      mCacheMutex.lock();
-      mFileSizeMap[filename] = statbuf.st_size;
-#if defined(PX_PLATFORM_MAC)
-      mFileTimeMap.insert(make_pair(statbuf.st_atimespec.tv_sec,filename));
-#elif !(defined(WIN32) || defined(_WIN32) || defined (WINDOWS) || defined (_WINDOWS))
-      mFileTimeMap.insert(make_pair(statbuf.st_atim.tv_sec,filename));
-#else
-       rtLogWarn("Platform not supported. Cache will not get cleared after cache limit is reached");
-#endif
-      mCacheMutex.unlock();
-    }
+    uint64_t key;
+    if (fileNameKey(direntry->d_name, key))
+      keys.push_back(key);
   }
+  closedir(directory);
 }
 
-bool rtFileCache::writeFile(rtString& filename,const rtHttpCacheData& constCacheData)
+bool rtFileCache::writeFile(const rtString& path, rtData& data)
 {
-  rtHttpCacheData* cacheData = const_cast<rtHttpCacheData*>(&constCacheData);
-  rtData data;
-  stringstream stream;
-  stream << cacheData->expirationDateUnix();
-  string date = stream.str().c_str();
-  data.init(cacheData->headerData().length() + date.length() + 1 + cacheData->contentsData().length() + 1);
-  memcpy(data.data(),cacheData->headerData().data(),cacheData->headerData().length());
-  memset(data.data()+cacheData->headerData().length(),'|',1);
-  memcpy(data.data()+cacheData->headerData().length()+1,date.c_str(), date.length());
-  memset(data.data()+cacheData->headerData().length() + date.length() + 1,'|',1);
-  memcpy(data.data()+cacheData->headerData().length()+1+ date.length() + 1,cacheData->contentsData().data(),cacheData->contentsData().length());
-  rtString absPathString  = absPath(filename);
-  if (RT_OK != rtStoreFile(absPathString.cString(),data))
+  if (RT_OK != rtStoreFile(path.cString(),data))
     return false;
   return true;
 }
 
-bool rtFileCache::deleteFile(rtString& filename)
+bool rtFileCache::deleteFile(const rtString& path)
 {
-  rtString cmd = "rm -rf ";
-  rtString absPathString  = absPath(filename);
-  cmd.append(absPathString);
-  rtLogInfo("Deleting the file (%s)", absPathString.cString());
-  if (0 != system(cmd.cString()))
+  rtLogInfo("Deleting the file (%s)", path.cString());
+  if ((0 != unlink(path.cString())) && (ENOENT != errno))
   {
     rtLogWarn("removal of file failed");
     return false;
@@ -412,7 +823,11 @@ bool rtFileCache::readFileHeader(rtString& filename,rtHttpCacheData& cacheData)
     rtLogDebug("Reading the cache file \"%s\" Failed - does not EXIST or OPEN already", filename.cString());
     return false;
   }
+  return readHeader(fp, filename, cacheData);
+}
 
+bool rtFileCache::readHeader(FILE* fp, rtString& filename, rtHttpCacheData& cacheData)
+{
   bool reachedHeaderEnd = false;
   int buffer;
   string headerData;
@@ -444,7 +859,7 @@ bool rtFileCache::readFileHeader(rtString& filename,rtHttpCacheData& cacheData)
   return true;
 }
 
-rtString rtFileCache::absPath(rtString& filename)
+rtString rtFileCache::absPath(const rtString& filename)
 {
   rtString absPathString = mDirectory;
   absPathString.append("/");
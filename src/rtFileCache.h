@@ -28,9 +28,15 @@
 #include "rtHttpCache.h"
 #include "rtMutex.h"
 
+#include <list>
 #include <map>
+#include <memory>
 // TODO elimate std::string from headers and impl
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 class rtFileCache
 {
@@ -53,7 +59,7 @@ class rtFileCache
     /* removes the data from the cache for the url. Returns RT_OK on success and RT_ERROR on failure */
     rtError removeData(const char* url);
 
-    /* add the header,image data corresponding to a url to file cache. Returns RT_OK on success and RT_ERROR on failure */
+    /* add the header,image data corresponding to a url to file cache. The file is written in the background. Returns RT_OK on success and RT_ERROR on failure */
     rtError addToCache(const rtHttpCacheData& data); 
 
     /* get the header,image data corresponding to a url from file cache. Returns RT_OK on success and RT_ERROR on failure */
@@ -66,6 +72,32 @@ class rtFileCache
  
     static void destroy();
   private:
+    /* what the index knows about a cached file */
+    struct rtFileCacheEntry
+    {
+      rtFileCacheEntry() : size(0), lastAccess(0), generation(0), pendingWrite(false), hot(false), data() {}
+
+      int64_t size;
+      time_t lastAccess;
+      uint64_t generation; // from mNextGeneration
+      bool pendingWrite;
+      bool hot;
+      std::shared_ptr<rtData> data; // the file contents while the write is pending or the entry is hot
+      std::list<uint64_t>::iterator lruPosition;
+      std::list<uint64_t>::iterator hotPosition;
+    };
+
+    /* a file write, or a delete when data is NULL, for the writer thread */
+    struct rtFileCacheWrite
+    {
+      uint64_t key;
+      uint64_t generation;
+      rtString path;
+      std::shared_ptr<rtData> data;
+    };
+
+    typedef std::unordered_map<uint64_t, rtFileCacheEntry> rtFileCacheEntryMap;
+
     /* private functions */
     rtFileCache();
     ~rtFileCache();
@@ -76,38 +108,87 @@ class rtFileCache
     /* cleans the cache till the size is more than cache data size and return the new size */
     int64_t cleanup(); 
 
-    /* set the file size and time associated with the file */
-    void setFileSizeAndTime(rtString& filename);
+    /* same as cleanup, with mCacheMutex held */
+    int64_t cleanupLocked();
 
     /* calculates and returns the hash value of the url */
     rtString hashedFileName(const rtString& url);
 
+    /* the index key for a url, and the name of its file in the cache directory */
+    uint64_t urlKey(const rtString& url);
+    rtString keyFileName(uint64_t key);
+    bool fileNameKey(const char* name, uint64_t& key);
+
+    /* the keys of the cache files in the cache directory */
+    void listCacheFiles(std::vector<uint64_t>& keys);
+
+    /* serialize the cache data in the cache file format */
+    void serializeCacheData(const rtHttpCacheData& cacheData, rtData& data);
+
     /* write the cache data to a file. Returns true on success and false on failure */
-    bool writeFile(rtString& filename, const rtHttpCacheData& cacheData);
+    bool writeFile(const rtString& path, rtData& data);
 
     /* delete the file from cache */
-    bool deleteFile(rtString& filename);
+    bool deleteFile(const rtString& path);
 
     /* read the file and populate the header data only */
     bool readFileHeader(rtString& filename,rtHttpCacheData& cacheData);
 
+    /* read the header data from an opened cache file; closes fp on failure */
+    bool readHeader(FILE* fp, rtString& filename, rtHttpCacheData& cacheData);
+
     /* returns the filename in absolute path format */
-    rtString absPath(rtString& filename);
+    rtString absPath(const rtString& filename);
 
-    /* populate the existing files in cache along with size in mFileSizeMap */
+    /* populate the index by scanning the files in the cache directory; only used when there's no index file */
     void populateExistingFiles();
 
-    /* erase the map data of the cached file */
-    void eraseData(rtString& filename);
+    /* load the index file with a single read. Returns false if it is missing or damaged */
+    bool loadIndex();
+
+    /* write the index file */
+    void saveIndex();
+
+    /* serialize the index, least recently used entry first. Needs mCacheMutex */
+    void serializeIndex(rtData& data);
+
+    /* the following need mCacheMutex */
+    void resetIndex();
+    rtFileCacheEntry& insertEntry(uint64_t key);
+    void eraseEntry(rtFileCacheEntryMap::iterator it, bool removeFile);
+    void touchEntry(rtFileCacheEntry& entry);
+    void makeHot(uint64_t key, rtFileCacheEntry& entry);
+    void makeCold(rtFileCacheEntry& entry);
+    void queueWrite(uint64_t key, uint64_t generation, const rtString& path, const std::shared_ptr<rtData>& data);
+    void requestIndexSave();
+
+    /* background writer */
+    void startWriter();
+    void stopWriter();
+    void runWriter();
+    void waitForWrites();
 
     /* member variables */
     int64_t mMaxSize;
     int64_t mCurrentSize;
+    int64_t mMaxHotSize;
+    int64_t mHotSize;
     rtString mDirectory;
     std::hash<std::string> hashFn;
-    std::multimap<time_t,rtString> mFileTimeMap;
-    std::map<rtString,int64_t> mFileSizeMap;
+    rtFileCacheEntryMap mEntries;
+    std::list<uint64_t> mLruList;
+    std::list<uint64_t> mHotList;
+    std::list<rtFileCacheWrite> mWrites;
+    uint64_t mNextGeneration; // never reused, so a write queued for an erased entry can't match a new one
+    bool mIndexDirty;
+    bool mIndexSaveRequested;
+    time_t mLastIndexSave;
+    std::thread* mWriterThread;
+    bool mWriterRunning;
+    bool mWriterBusy;
     rtMutex mCacheMutex;
+    rtThreadCondition mWriterCondition;
+    rtThreadCondition mWriterIdleCondition;
     static rtFileCache* mCache;
 };
 #endif
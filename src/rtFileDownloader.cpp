@@ -26,8 +26,10 @@
 #include "rtThreadPool.h"
 #include "pxTimer.h"
 #include "rtLog.h"
+#include <ctype.h>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include <thread>
 #ifndef WIN32
 #include <signal.h>
@@ -42,6 +44,14 @@ const int kMaxDownloadHandles = 6;
 #endif //PX_REUSE_DOWNLOAD_HANDLES
 const double kDefaultDownloadHandleExpiresTime = 5 * 60;
 const int kDownloadHandleTimerIntervalInMilliSeconds = 30 * 1000;
+const unsigned int kMaxDownloads = 256;
+const unsigned int kMaxDownloadsPerHost = 6;
+const size_t kMaxIdleTransferHandles = 32;
+const int kDownloadPollTimeoutInMilliSeconds = 100;
+// libcurl before 7.68 has no curl_multi_wakeup, so new requests wait for the
+// download thread's next pass
+const int kDownloadWaitTimeoutInMilliSeconds = 10;
+const double kCanceledTransferCheckIntervalInSeconds = 0.1;
 
 std::thread* downloadHandleExpiresCheckThread = NULL;
 bool continueDownloadHandleCheck = true;
@@ -53,11 +63,15 @@ struct MemoryStruct
 {
     MemoryStruct()
         : headerSize(0)
+        , headerCapacity(1)
         , headerBuffer(NULL)
         , contentsSize(0)
+        , contentsCapacity(1)
         , contentsBuffer(NULL)
         , downloadRequest(NULL)
         , readSize(0)
+        , contentLength(-1)
+        , sinkStarted(false)
     {
         headerBuffer = (char*)malloc(1);
         contentsBuffer = (char*)malloc(1);
@@ -78,20 +92,56 @@ struct MemoryStruct
     }
 
   size_t headerSize;
+  size_t headerCapacity;
   char* headerBuffer;
   size_t contentsSize;
+  size_t contentsCapacity;
   char* contentsBuffer;
   rtFileDownloadRequest *downloadRequest;
   size_t readSize;
+  int64_t contentLength; // of the response being received, -1 if unknown
+  bool sinkStarted;
 };
 
+const size_t kMinHeaderBufferSize = 1024;
+const size_t kMinContentsBufferSize = CURL_MAX_WRITE_SIZE;
+// a Content-Length above this isn't trusted with an allocation up front
+const int64_t kMaxPreallocatedContentLength = 64 * 1024 * 1024;
+
+// Makes room for size bytes plus the terminating zero.  Buffers double so
+// a download of n bytes is copied O(n) times in total rather than once per
+// chunk curl delivers.
+static bool reserveDownloadBuffer(char*& buffer, size_t& capacity, size_t size, size_t minimumSize)
+{
+  if (size + 1 <= capacity)
+    return true;
+
+  size_t newCapacity = std::max(std::max(capacity * 2, size + 1), minimumSize);
+  char* newBuffer = (char*)realloc(buffer, newCapacity);
+  if (newBuffer == NULL)
+    return false;
+  buffer = newBuffer;
+  capacity = newCapacity;
+  return true;
+}
+
+// name is lower case and includes the colon
+static bool hasHeaderName(const char* line, const char* name, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    if (tolower((unsigned char)line[i]) != name[i])
+      return false;
+  }
+  return true;
+}
+
 static size_t HeaderCallback(void *contents, size_t size, size_t nmemb, void *userp)
 {
   size_t downloadSize = size * nmemb;
   struct MemoryStruct *mem = (struct MemoryStruct *)userp;
 
-  mem->headerBuffer = (char*)realloc(mem->headerBuffer, mem->headerSize + downloadSize + 1);
-  if(mem->headerBuffer == NULL) {
+  if (!reserveDownloadBuffer(mem->headerBuffer, mem->headerCapacity, mem->headerSize + downloadSize, kMinHeaderBufferSize)) {
     /* out of memory! */
     cout << "out of memory when downloading image\n";
     return 0;
@@ -101,6 +151,24 @@ static size_t HeaderCallback(void *contents, size_t size, size_t nmemb, void *us
   mem->headerSize += downloadSize;
   mem->headerBuffer[mem->headerSize] = 0;
 
+  // every response in a redirect chain starts with a status line
+  const char* line = (const char*)contents;
+  if (downloadSize > 5 && strncmp(line, "HTTP/", 5) == 0)
+  {
+    mem->contentLength = -1;
+  }
+  else if (downloadSize > 15 && hasHeaderName(line, "content-length:", 15))
+  {
+    mem->contentLength = strtoll(std::string(line + 15, downloadSize - 15).c_str(), NULL, 10);
+    bool keepData = mem->downloadRequest != NULL && mem->downloadRequest->keepsDownloadedData();
+    if (keepData && mem->contentLength > 0 && mem->contentLength <= kMaxPreallocatedContentLength &&
+        !reserveDownloadBuffer(mem->contentsBuffer, mem->contentsCapacity, (size_t)mem->contentLength, 0))
+    {
+      cout << "out of memory when downloading image\n";
+      return 0;
+    }
+  }
+
   return downloadSize;
 }
 
@@ -109,21 +177,38 @@ static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, voi
   size_t downloadSize = size * nmemb;
   size_t downloadCallbackSize = 0;
   struct MemoryStruct *mem = (struct MemoryStruct *)userp;
+  rtFileDownloadRequest* downloadRequest = mem->downloadRequest;
 
-  downloadCallbackSize = mem->downloadRequest->executeDownloadProgressCallback(contents, size, nmemb );
+  downloadCallbackSize = downloadRequest->executeDownloadProgressCallback(contents, size, nmemb );
 
-  mem->contentsBuffer = (char*)realloc(mem->contentsBuffer, mem->contentsSize + downloadSize + 1);
-  if(mem->contentsBuffer == NULL) {
-    /* out of memory! */
-    cout << "out of memory when downloading image\n";
-    return 0;
+  rtFileDownloadSink* sink = downloadRequest->downloadSink();
+  if (sink != NULL)
+  {
+    if (!mem->sinkStarted)
+    {
+      mem->sinkStarted = true;
+      sink->onDownloadStart(downloadRequest, mem->contentLength);
+    }
+    if (!sink->onDownloadData(downloadRequest, (const char*)contents, downloadSize))
+    {
+      return 0;
+    }
   }
 
-  memcpy(&(mem->contentsBuffer[mem->contentsSize]), contents, downloadSize);
+  if (downloadRequest->keepsDownloadedData())
+  {
+    if (!reserveDownloadBuffer(mem->contentsBuffer, mem->contentsCapacity, mem->contentsSize + downloadSize, kMinContentsBufferSize)) {
+      /* out of memory! */
+      cout << "out of memory when downloading image\n";
+      return 0;
+    }
+
+    memcpy(&(mem->contentsBuffer[mem->contentsSize]), contents, downloadSize);
+    mem->contentsBuffer[mem->contentsSize + downloadSize] = 0;
+  }
   mem->contentsSize += downloadSize;
-  mem->contentsBuffer[mem->contentsSize] = 0;
 
-  if (mem->downloadRequest->useCallbackDataSize() == true)
+  if (downloadRequest->useCallbackDataSize() == true)
   {
      return downloadCallbackSize;
   }
@@ -151,6 +236,315 @@ static size_t ReadMemoryCallback(void *contents, size_t size, size_t nmemb, void
   return 0;
 }
 
+// Sets up an easy handle for the request, for curl_easy_perform or the
+// multi handle alike
+static void prepareDownloadHandle(CURL* curl_handle, rtFileDownloadRequest* downloadRequest, MemoryStruct& chunk,
+                                  char* errorBuffer, struct curl_slist*& list)
+{
+    bool useProxy = !downloadRequest->proxy().isEmpty();
+    rtString proxyServer = downloadRequest->proxy();
+    bool headerOnly = downloadRequest->headerOnly();
+
+    rtString method = downloadRequest->method();
+    size_t readDataSize = downloadRequest->readDataSize();
+
+    curl_easy_reset(curl_handle);
+    /* specify URL to get */
+    curl_easy_setopt(curl_handle, CURLOPT_URL, downloadRequest->fileUrl().cString());
+    curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1); //when redirected, follow the redirections
+    curl_easy_setopt(curl_handle, CURLOPT_HEADERFUNCTION, HeaderCallback);
+    curl_easy_setopt(curl_handle, CURLOPT_HEADERDATA, (void *)&chunk);
+    if (false == headerOnly)
+    {
+      chunk.downloadRequest = downloadRequest;
+      curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+      curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)&chunk);
+    }
+
+    if(downloadRequest->isCurlDefaultTimeoutSet() == false)
+    {
+    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, kCurlTimeoutInSeconds);
+    }
+    curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
+
+    if(downloadRequest->isProgressMeterSwitchOff())
+        curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1);
+
+    if(downloadRequest->isHTTPFailOnError())
+    {
+        memset(errorBuffer, 0, CURL_ERROR_SIZE);
+        curl_easy_setopt(curl_handle, CURLOPT_FAILONERROR, 1);
+        curl_easy_setopt(curl_handle, CURLOPT_VERBOSE, 1);
+        curl_easy_setopt(curl_handle, CURLOPT_ERRORBUFFER, errorBuffer);
+    }
+#if !defined(PX_PLATFORM_GENERIC_DFB) && !defined(PX_PLATFORM_DFB_NON_X11)
+    curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPALIVE, 1);
+    curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPIDLE, 60);
+    curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPINTVL, 30);
+#endif //!PX_PLATFORM_GENERIC_DFB && !PX_PLATFORM_DFB_NON_X11
+
+    vector<rtString>& additionalHttpHeaders = downloadRequest->additionalHttpHeaders();
+    list = NULL;
+    for (unsigned int headerOption = 0;headerOption < additionalHttpHeaders.size();headerOption++)
+    {
+      list = curl_slist_append(list, additionalHttpHeaders[headerOption].cString());
+    }
+    if (downloadRequest->cors() != NULL)
+      downloadRequest->cors()->updateRequestForAccessControl(&list);
+    if (readDataSize > 0)
+    {
+      list = curl_slist_append(list, "Expect:");
+    }
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, list);
+    //CA certificates
+    // !CLF: Use system CA Cert rather than CA_CERTIFICATE fo now.  Revisit!
+    //curl_easy_setopt(curl_handle,CURLOPT_CAINFO,mCaCertFile.cString());
+    curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 2);
+    curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, true);
+
+    /* some servers don't like requests that are made without a user-agent
+     field, so we provide one */
+    curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+
+    if (useProxy)
+
+    {
+        curl_easy_setopt(curl_handle, CURLOPT_PROXY, proxyServer.cString());
+        curl_easy_setopt(curl_handle, CURLOPT_PROXYTYPE, CURLPROXY_HTTP);
+    }
+    else
+    {
+      curl_easy_setopt(curl_handle, CURLOPT_PROXY, "");
+    }
+
+    if (true == headerOnly)
+    {
+      curl_easy_setopt(curl_handle, CURLOPT_NOBODY, 1);
+    }
+
+    if (!method.isEmpty() && method.compare("GET") != 0)
+    {
+      if (method.compare("POST") == 0)
+        curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
+      else if (method.compare("PUT") == 0)
+        curl_easy_setopt(curl_handle, CURLOPT_UPLOAD, 1L);
+      else
+        curl_easy_setopt(curl_handle, CURLOPT_CUSTOMREQUEST, method.cString());
+    }
+
+    if (readDataSize > 0)
+    {
+      chunk.downloadRequest = downloadRequest;
+      curl_easy_setopt(curl_handle, CURLOPT_READFUNCTION, ReadMemoryCallback);
+      curl_easy_setopt(curl_handle, CURLOPT_READDATA, (void *)&chunk);
+      curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, readDataSize);
+    }
+}
+
+// Hands the downloaded header and contents over to the request
+static bool finishNetworkDownload(CURL* curl_handle, rtFileDownloadRequest* downloadRequest, CURLcode res,
+                                  MemoryStruct& chunk, char* errorBuffer)
+{
+    downloadRequest->setDownloadStatusCode(res);
+    if(downloadRequest->isHTTPFailOnError())
+        downloadRequest->setHTTPError(errorBuffer);
+
+    /* check for errors */
+    if (res != CURLE_OK)
+    {
+        rtString proxyMessage("Using proxy:"); 
+        if (!downloadRequest->proxy().isEmpty())
+        {
+          proxyMessage.append("true - ");
+          proxyMessage.append(downloadRequest->proxy().cString());
+        }
+        else
+        {
+          proxyMessage.append("false ");
+        }
+        char errorMessage[MAX_URL_SIZE+400];
+        memset(errorMessage, 0, sizeof(errorMessage));
+        snprintf(errorMessage, sizeof(errorMessage), "Download error for:%s. Error code:%d. %s",downloadRequest->fileUrl().cString(), res, proxyMessage.cString());
+        downloadRequest->setErrorString(errorMessage);
+
+        //clean up contents on error
+        if (chunk.contentsBuffer != NULL)
+        {
+            free(chunk.contentsBuffer);
+            chunk.contentsBuffer = NULL;
+        }
+
+        if (chunk.headerBuffer != NULL)
+        {
+            free(chunk.headerBuffer);
+            chunk.headerBuffer = NULL;
+        }
+        downloadRequest->setDownloadedData(NULL, 0);
+        return false;
+    }
+
+    long httpCode = -1;
+    if (curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &httpCode) == CURLE_OK)
+    {
+        downloadRequest->setHttpStatusCode(httpCode);
+    }
+
+    //todo read the header information before closing
+    if (chunk.headerBuffer != NULL)
+    {
+        downloadRequest->setHeaderData(chunk.headerBuffer, chunk.headerSize);
+    }
+
+    //don't free the downloaded data (contentsBuffer) because it will be used later
+    if (false == downloadRequest->headerOnly() && downloadRequest->keepsDownloadedData())
+    {
+      // give back what geometric growth overshot; a preallocated buffer is already exact
+      if (chunk.contentsCapacity > chunk.contentsSize + 1 + chunk.contentsSize / 4)
+      {
+        char* trimmed = (char*)realloc(chunk.contentsBuffer, chunk.contentsSize + 1);
+        if (trimmed != NULL)
+          chunk.contentsBuffer = trimmed;
+      }
+      downloadRequest->setDownloadedData(chunk.contentsBuffer, chunk.contentsSize);
+    }
+    else
+    {
+        if (chunk.contentsBuffer != NULL)
+        {
+            free(chunk.contentsBuffer);
+            chunk.contentsBuffer = NULL;
+        }
+        // a streamed body went to the sink; report how much of it there was
+        if (false == downloadRequest->headerOnly())
+        {
+          downloadRequest->setDownloadedData(NULL, chunk.contentsSize);
+        }
+    }
+    chunk.headerBuffer = NULL;
+    chunk.contentsBuffer = NULL;
+    if (downloadRequest->cors() != NULL)
+      downloadRequest->cors()->updateResponseForAccessControl(downloadRequest);
+    return true;
+}
+
+static char* copyDownloadBuffer(const char* data, size_t size)
+{
+  if (data == NULL)
+    return NULL;
+  char* copy = (char*)malloc(size + 1);
+  memcpy(copy, data, size);
+  copy[size] = 0;
+  return copy;
+}
+
+// Gives a request that rode along on another request's transfer its own
+// copy of the result
+static void copyDownloadResult(rtFileDownloadRequest* from, rtFileDownloadRequest* to)
+{
+  to->setDownloadStatusCode(from->downloadStatusCode());
+  to->setHttpStatusCode(from->httpStatusCode());
+  to->setErrorString(from->errorString().cString());
+  to->setHeaderData(copyDownloadBuffer(from->headerData(), from->headerDataSize()), from->headerDataSize());
+  to->setDownloadedData(copyDownloadBuffer(from->downloadedData(), from->downloadedDataSize()), from->downloadedDataSize());
+  if (to->cors() != NULL && from->downloadStatusCode() == CURLE_OK)
+    to->cors()->updateResponseForAccessControl(to);
+}
+
+// host[:port] part of a url, used for the per host connection limit
+static std::string downloadHost(const rtString& url)
+{
+  const char* start = strstr(url.cString(), "://");
+  start = (start != NULL) ? start + 3 : url.cString();
+  return std::string(start, strcspn(start, "/?#"));
+}
+
+// Requests with the same key can share one transfer.  Anything that sends
+// a body, extra headers or streams the data to a callback gets its own.
+static std::string downloadKey(rtFileDownloadRequest* downloadRequest)
+{
+  rtString method = downloadRequest->method();
+  if ((!method.isEmpty() && method.compare("GET") != 0) ||
+      downloadRequest->readDataSize() > 0 ||
+      !downloadRequest->additionalHttpHeaders().empty() ||
+      downloadRequest->hasDownloadProgressCallback() ||
+      downloadRequest->downloadSink() != NULL ||
+      downloadRequest->useCallbackDataSize())
+  {
+    return std::string();
+  }
+
+  std::string key = downloadRequest->fileUrl().cString();
+  key += '\n';
+  key += downloadRequest->proxy().cString();
+  key += '\n';
+  if (downloadRequest->cors() != NULL)
+  {
+    rtString origin;
+    downloadRequest->cors()->origin(origin);
+    key += origin.cString();
+  }
+  key += '\n';
+  key += downloadRequest->headerOnly() ? 'h' : '-';
+  key += downloadRequest->isHTTPFailOnError() ? 'f' : '-';
+  key += downloadRequest->isCurlDefaultTimeoutSet() ? 't' : '-';
+  key += downloadRequest->isProgressMeterSwitchOff() ? 'p' : '-';
+  return key;
+}
+
+struct rtFileDownloadTransfer
+{
+  rtFileDownloadTransfer(rtFileDownloadRequest* request, const std::string& urlKey)
+    : downloadRequest(request), sharedRequests(), key(urlKey), host(downloadHost(request->fileUrl()))
+    , curlHandle(NULL), headers(NULL), chunk()
+  {
+    memset(errorBuffer, 0, sizeof(errorBuffer));
+  }
+
+  // sharedRequests changes under the download queue lock until the transfer
+  // is retired
+  bool hasRequest(rtFileDownloadRequest* request) const
+  {
+    return request == downloadRequest ||
+      std::find(sharedRequests.begin(), sharedRequests.end(), request) != sharedRequests.end();
+  }
+
+  bool isCanceled() const
+  {
+    if (!downloadRequest->isCanceled())
+      return false;
+    for (vector<rtFileDownloadRequest*>::const_iterator it = sharedRequests.begin(); it != sharedRequests.end(); ++it)
+    {
+      if (!(*it)->isCanceled())
+        return false;
+    }
+    return true;
+  }
+
+  rtFileDownloadRequest* downloadRequest; // drives the transfer
+  std::vector<rtFileDownloadRequest*> sharedRequests; // get a copy of the result
+  std::string key; // empty if the transfer can't be shared
+  std::string host;
+  CURL* curlHandle;
+  struct curl_slist* headers;
+  MemoryStruct chunk;
+  char errorBuffer[CURL_ERROR_SIZE];
+};
+
+// First transfer in the list whose host has a free connection
+static list<rtFileDownloadTransfer*>::iterator findStartableTransfer(list<rtFileDownloadTransfer*>& transfers,
+                                                                      const map<std::string, unsigned int>& hostCounts,
+                                                                      unsigned int maxPerHost)
+{
+  list<rtFileDownloadTransfer*>::iterator it = transfers.begin();
+  for (; it != transfers.end(); ++it)
+  {
+    map<std::string, unsigned int>::const_iterator count = hostCounts.find((*it)->host);
+    if (count == hostCounts.end() || count->second < maxPerHost)
+      break;
+  }
+  return it;
+}
+
 
 void startFileDownloadInBackground(void* data)
 {
@@ -190,6 +584,8 @@ rtFileDownloadRequest::rtFileDownloadRequest(const char* imageUrl, void* callbac
     , mMethod()
     , mReadData(NULL)
     , mReadDataSize(0)
+    , mDownloadSink(NULL)
+    , mKeepDownloadedData(true)
 {
   mAdditionalHttpHeaders.clear();
 #ifdef ENABLE_HTTP_CACHE
@@ -287,6 +683,27 @@ size_t rtFileDownloadRequest::executeDownloadProgressCallback(void * ptr, size_t
   return 0;
 }
 
+bool rtFileDownloadRequest::hasDownloadProgressCallback() const
+{
+  return mDownloadProgressCallbackFunction != NULL;
+}
+
+void rtFileDownloadRequest::setDownloadSink(rtFileDownloadSink* sink, bool keepDownloadedData)
+{
+  mDownloadSink = sink;
+  mKeepDownloadedData = (sink == NULL) || keepDownloadedData;
+}
+
+rtFileDownloadSink* rtFileDownloadRequest::downloadSink() const
+{
+  return mDownloadSink;
+}
+
+bool rtFileDownloadRequest::keepsDownloadedData() const
+{
+  return mKeepDownloadedData;
+}
+
 void rtFileDownloadRequest::setDownloadedData(char* data, size_t size)
 {
   mDownloadedData = data;
@@ -541,7 +958,10 @@ size_t rtFileDownloadRequest::readDataSize() const
 }
 
 rtFileDownloader::rtFileDownloader()
-    : mNumberOfCurrentDownloads(0), mDefaultCallbackFunction(NULL), mDownloadHandles(), mReuseDownloadHandles(false),
+    : mPriorityDownloads(), mPendingDownloads(), mDownloadsByUrl(), mActiveDownloads(), mHostDownloadCounts(),
+      mNumberOfCurrentDownloads(0), mMaxDownloads(kMaxDownloads), mMaxDownloadsPerHost(kMaxDownloadsPerHost),
+      mDownloadQueueMutex(), mMultiHandle(NULL), mIdleTransferHandles(), mDownloadThread(NULL),
+      mDownloadThreadRunning(false), mDefaultCallbackFunction(NULL), mDownloadHandles(), mReuseDownloadHandles(false),
       mCaCertFile(CA_CERTIFICATE), mFileCacheMutex()
 {
   CURLcode rv = curl_global_init(CURL_GLOBAL_ALL);
@@ -568,6 +988,7 @@ rtFileDownloader::rtFileDownloader()
 
 rtFileDownloader::~rtFileDownloader()
 {
+  stopDownloadThread();
 #ifdef PX_REUSE_DOWNLOAD_HANDLES
   downloadHandleMutex.lock();
   for (vector<rtFileDownloadHandle>::iterator it = mDownloadHandles.begin(); it != mDownloadHandles.end(); )
@@ -627,28 +1048,59 @@ void rtFileDownloader::deleteInstance()
 bool rtFileDownloader::addToDownloadQueue(rtFileDownloadRequest* downloadRequest)
 {
     bool submitted = false;
-    //todo: check the download queue before starting download
     submitted = true;
     addFileDownloadRequest(downloadRequest);
     downloadFileInBackground(downloadRequest);
-    //startNextDownloadInBackground();
     return submitted;
 }
 
+// Wakes the download thread so it starts whatever pending transfers fit
+// under the connection limits
 void rtFileDownloader::startNextDownloadInBackground()
 {
-    //todo
-}
+#if LIBCURL_VERSION_NUM >= 0x074400
+  // stopDownloadThread() cleans the multi handle up under the same lock
+  mDownloadQueueMutex.lock();
+  if (mMultiHandle != NULL)
+  {
+    curl_multi_wakeup(mMultiHandle);
+  }
+  mDownloadQueueMutex.unlock();
+#endif
+}
 
 void rtFileDownloader::raiseDownloadPriority(rtFileDownloadRequest* downloadRequest)
 {
   if (downloadRequest != NULL)
   {
+    // still waiting on the cache lookup
     rtThreadPool *mainThreadPool = rtThreadPool::globalInstance();
     mainThreadPool->raisePriority(downloadRequest->fileUrl());
+
+    mDownloadQueueMutex.lock();
+    for (list<rtFileDownloadTransfer*>::iterator it = mPendingDownloads.begin(); it != mPendingDownloads.end(); ++it)
+    {
+      rtFileDownloadTransfer* transfer = *it;
+      if (transfer->hasRequest(downloadRequest))
+      {
+        mPendingDownloads.erase(it);
+        mPriorityDownloads.push_back(transfer);
+        break;
+      }
+    }
+    mDownloadQueueMutex.unlock();
   }
 }
 
+void rtFileDownloader::setMaxConnections(unsigned int maxDownloads, unsigned int maxDownloadsPerHost)
+{
+  mDownloadQueueMutex.lock();
+  mMaxDownloads = maxDownloads > 0 ? maxDownloads : 1;
+  mMaxDownloadsPerHost = maxDownloadsPerHost > 0 ? maxDownloadsPerHost : 1;
+  mDownloadQueueMutex.unlock();
+  startNextDownloadInBackground();
+}
+
 void rtFileDownloader::removeDownloadRequest(rtFileDownloadRequest* downloadRequest)
 {
     (void)downloadRequest;
@@ -665,79 +1117,38 @@ void rtFileDownloader::downloadFile(rtFileDownloadRequest* downloadRequest)
   bool isRequestCanceled = downloadRequest->isCanceled();
   if (isRequestCanceled)
   {
-    downloadRequest->setDownloadStatusCode(HTTP_DOWNLOAD_CANCELED);
-    downloadRequest->setDownloadedData(NULL, 0);
-    downloadRequest->setDownloadStatusCode(-1);
-    downloadRequest->setErrorString("canceled request");
-    if (!downloadRequest->executeCallback(downloadRequest->downloadStatusCode()))
-    {
-      if (mDefaultCallbackFunction != NULL)
-      {
-        (*mDefaultCallbackFunction)(downloadRequest);
-      }
-    }
-    clearFileDownloadRequest(downloadRequest);
+    completeCanceledDownload(downloadRequest);
     return;
   }
 
 #ifdef ENABLE_HTTP_CACHE
-    bool isDataInCache = false;
+  if (downloadFromCache(downloadRequest))
+  {
+    return;
+  }
 #endif
-    bool nwDownloadSuccess = false;
+  bool nwDownloadSuccess = downloadFromNetwork(downloadRequest);
+  completeDownload(downloadRequest, nwDownloadSuccess);
+}
 
-#ifdef ENABLE_HTTP_CACHE
-    rtHttpCacheData cachedData(downloadRequest->fileUrl().cString());
-    if (true == downloadRequest->cacheEnabled())
+void rtFileDownloader::completeCanceledDownload(rtFileDownloadRequest* downloadRequest)
+{
+  downloadRequest->setDownloadStatusCode(HTTP_DOWNLOAD_CANCELED);
+  downloadRequest->setDownloadedData(NULL, 0);
+  downloadRequest->setDownloadStatusCode(-1);
+  downloadRequest->setErrorString("canceled request");
+  if (!downloadRequest->executeCallback(downloadRequest->downloadStatusCode()))
+  {
+    if (mDefaultCallbackFunction != NULL)
     {
-      if (true == checkAndDownloadFromCache(downloadRequest,cachedData))
-      {
-        isDataInCache = true;
-        downloadRequest->setDataIsCached(true);
-      }
+      (*mDefaultCallbackFunction)(downloadRequest);
     }
+  }
+  clearFileDownloadRequest(downloadRequest);
+}
 
-    if (isDataInCache)
-    {
-        if(downloadRequest->deferCacheRead())
-        {
-            mFileCacheMutex.lock();
-            FILE *fp = downloadRequest->cacheFilePointer();
-
-            if(fp != NULL)
-            {
-                char* buffer = new char[downloadRequest->getCachedFileReadSize()];
-                size_t bytesCount = 0;
-                size_t dataSize = 0;                
-				char invalidData[8] = "Invalid";
-
-                // The cahced file has expiration value ends with | delimeter.
-                while ( !feof(fp) )
-                {
-                    dataSize++;
-                    if (fgetc(fp) == '|')
-                        break;
-                }
-                while (!feof(fp))
-                {
-                    memset(buffer, 0, downloadRequest->getCachedFileReadSize());
-                    bytesCount = fread(buffer, 1, downloadRequest->getCachedFileReadSize(), fp);
-                    dataSize += bytesCount;
-                    downloadRequest->executeDownloadProgressCallback((unsigned char*)buffer, bytesCount, 1 );
-                }
-                // For deferCacheRead, the user requires the downloadedDataSize but not the data.
-                downloadRequest->setDownloadedData( invalidData, dataSize);
-                delete [] buffer;
-                fclose(fp);
-            }
-            mFileCacheMutex.unlock();
-        }
-    }
-    else
-#endif
-    {
-      nwDownloadSuccess = downloadFromNetwork(downloadRequest);
-    }    
-    
+void rtFileDownloader::completeDownload(rtFileDownloadRequest* downloadRequest, bool nwDownloadSuccess)
+{
     if (!downloadRequest->executeCallback(downloadRequest->downloadStatusCode()))
     {
       if (mDefaultCallbackFunction != NULL)
@@ -750,6 +1161,7 @@ void rtFileDownloader::downloadFile(rtFileDownloadRequest* downloadRequest)
     // Store the network data in cache
     if ((true == nwDownloadSuccess) &&
         (true == downloadRequest->cacheEnabled())  &&
+        (downloadRequest->downloadedData() != NULL) &&
         (downloadRequest->httpStatusCode() != 206) &&
         (downloadRequest->httpStatusCode() != 302) &&
         (downloadRequest->httpStatusCode() != 307))
@@ -771,9 +1183,86 @@ void rtFileDownloader::downloadFile(rtFileDownloadRequest* downloadRequest)
         mFileCacheMutex.unlock();
       }
     }
+#else
+    (void)nwDownloadSuccess;
+#endif
+    clearFileDownloadRequest(downloadRequest);
+}
+
+// Runs on the thread pool so callbacks don't hold up the download thread
+void rtFileDownloader::completeDownloadInBackground(void* data)
+{
+  rtFileDownloadRequest* downloadRequest = (rtFileDownloadRequest*)data;
+  rtFileDownloader::instance()->completeDownload(downloadRequest, downloadRequest->downloadStatusCode() == CURLE_OK);
+}
+
+// Same for the requests that shared a transfer; only the request that
+// drove it stores the result in the cache
+void rtFileDownloader::completeSharedDownloadInBackground(void* data)
+{
+  rtFileDownloadRequest* downloadRequest = (rtFileDownloadRequest*)data;
+  rtFileDownloader::instance()->completeDownload(downloadRequest, false);
+}
+
+#ifdef ENABLE_HTTP_CACHE
+bool rtFileDownloader::downloadFromCache(rtFileDownloadRequest* downloadRequest)
+{
+    if (false == downloadRequest->cacheEnabled())
+    {
+      return false;
+    }
+
+    rtHttpCacheData cachedData(downloadRequest->fileUrl().cString());
+    if (false == checkAndDownloadFromCache(downloadRequest,cachedData))
+    {
+      return false;
+    }
+    downloadRequest->setDataIsCached(true);
+
+    if(downloadRequest->deferCacheRead())
+    {
+        mFileCacheMutex.lock();
+        FILE *fp = downloadRequest->cacheFilePointer();
+
+        if(fp != NULL)
+        {
+            char* buffer = new char[downloadRequest->getCachedFileReadSize()];
+            size_t bytesCount = 0;
+            size_t dataSize = 0;                
+				char invalidData[8] = "Invalid";
+
+            // The cahced file has expiration value ends with | delimeter.
+            while ( !feof(fp) )
+            {
+                dataSize++;
+                if (fgetc(fp) == '|')
+                    break;
+            }
+            while (!feof(fp))
+            {
+                memset(buffer, 0, downloadRequest->getCachedFileReadSize());
+                bytesCount = fread(buffer, 1, downloadRequest->getCachedFileReadSize(), fp);
+                dataSize += bytesCount;
+                downloadRequest->executeDownloadProgressCallback((unsigned char*)buffer, bytesCount, 1 );
+            }
+            // For deferCacheRead, the user requires the downloadedDataSize but not the data.
+            downloadRequest->setDownloadedData( invalidData, dataSize);
+            delete [] buffer;
+            fclose(fp);
+        }
+        mFileCacheMutex.unlock();
+    }
+
+    if (!downloadRequest->executeCallback(downloadRequest->downloadStatusCode()))
+    {
+      if (mDefaultCallbackFunction != NULL)
+      {
+        (*mDefaultCallbackFunction)(downloadRequest);
+      }
+    }
 
     // Store the updated data in cache
-    if ((true == isDataInCache) && (cachedData.isUpdated()))
+    if (cachedData.isUpdated())
     {
       rtString url;
       cachedData.url(url);
@@ -794,245 +1283,440 @@ void rtFileDownloader::downloadFile(rtFileDownloadRequest* downloadRequest)
       }
     }
 
-    if (true == isDataInCache)
-    {
-      downloadRequest->setHeaderData(NULL,0);
-      downloadRequest->setDownloadedData(NULL,0);
-    }
-#endif
+    downloadRequest->setHeaderData(NULL,0);
+    downloadRequest->setDownloadedData(NULL,0);
     clearFileDownloadRequest(downloadRequest);
+    return true;
 }
 
+// The cache lookup reads from disk so it stays on the thread pool; misses
+// go on to the download thread
+void rtFileDownloader::downloadFromCacheInBackground(void* data)
+{
+  rtFileDownloadRequest* downloadRequest = (rtFileDownloadRequest*)data;
+  rtFileDownloader* downloader = rtFileDownloader::instance();
+  if (downloadRequest->isCanceled())
+  {
+    downloader->completeCanceledDownload(downloadRequest);
+  }
+  else if (!downloader->downloadFromCache(downloadRequest))
+  {
+    downloader->queueNetworkDownload(downloadRequest);
+  }
+}
+#endif
+
 bool rtFileDownloader::downloadFromNetwork(rtFileDownloadRequest* downloadRequest)
 {
     CURL *curl_handle = NULL;
     CURLcode res = CURLE_OK;
     char errorBuffer[CURL_ERROR_SIZE];
-
-    bool useProxy = !downloadRequest->proxy().isEmpty();
-    rtString proxyServer = downloadRequest->proxy();
-    bool headerOnly = downloadRequest->headerOnly();
     MemoryStruct chunk;
+    struct curl_slist *list = NULL;
 
-    rtString method = downloadRequest->method();
-    size_t readDataSize = downloadRequest->readDataSize();
+    double downloadHandleExpiresTime = downloadRequest->downloadHandleExpiresTime();
 
     curl_handle = rtFileDownloader::instance()->retrieveDownloadHandle();
-    curl_easy_reset(curl_handle);
-    /* specify URL to get */
-    curl_easy_setopt(curl_handle, CURLOPT_URL, downloadRequest->fileUrl().cString());
-    curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1); //when redirected, follow the redirections
-    curl_easy_setopt(curl_handle, CURLOPT_HEADERFUNCTION, HeaderCallback);
-    curl_easy_setopt(curl_handle, CURLOPT_HEADERDATA, (void *)&chunk);
-    if (false == headerOnly)
-    {
-      chunk.downloadRequest = downloadRequest;
-      curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-      curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *)&chunk);
-    }
+    prepareDownloadHandle(curl_handle, downloadRequest, chunk, errorBuffer, list);
 
-    if(downloadRequest->isCurlDefaultTimeoutSet() == false)
-    {
-    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, kCurlTimeoutInSeconds);
-    }
-    curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
+    /* get it! */
+    res = curl_easy_perform(curl_handle);
+    curl_slist_free_all(list);
 
-    if(downloadRequest->isProgressMeterSwitchOff())
-        curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1);
+    bool nwDownloadSuccess = finishNetworkDownload(curl_handle, downloadRequest, res, chunk, errorBuffer);
+    rtFileDownloader::instance()->releaseDownloadHandle(curl_handle, downloadHandleExpiresTime);
+    return nwDownloadSuccess;
+}
 
-    if(downloadRequest->isHTTPFailOnError())
+#ifdef ENABLE_HTTP_CACHE
+bool rtFileDownloader::checkAndDownloadFromCache(rtFileDownloadRequest* downloadRequest,rtHttpCacheData& cachedData)
+{
+  rtError err;
+  rtData data;
+  mFileCacheMutex.lock();
+  if ((NULL != rtFileCache::instance()) && (RT_OK == rtFileCache::instance()->httpCacheData(downloadRequest->fileUrl(),cachedData)))
+  {
+    if(downloadRequest->deferCacheRead())
+      err = cachedData.deferCacheRead(data);
+    else
+      err = cachedData.data(data);
+    if (RT_OK !=  err)
     {
-        memset(errorBuffer, 0, sizeof(errorBuffer));
-        curl_easy_setopt(curl_handle, CURLOPT_FAILONERROR, 1);
-        curl_easy_setopt(curl_handle, CURLOPT_VERBOSE, 1);
-        curl_easy_setopt(curl_handle, CURLOPT_ERRORBUFFER, errorBuffer);
+      mFileCacheMutex.unlock();
+      return false;
     }
-#if !defined(PX_PLATFORM_GENERIC_DFB) && !defined(PX_PLATFORM_DFB_NON_X11)
-    curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPALIVE, 1);
-    curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPIDLE, 60);
-    curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPINTVL, 30);
-#endif //!PX_PLATFORM_GENERIC_DFB && !PX_PLATFORM_DFB_NON_X11
 
-    double downloadHandleExpiresTime = downloadRequest->downloadHandleExpiresTime();
+    downloadRequest->setHeaderData((char *)cachedData.headerData().data(),cachedData.headerData().length());
+    downloadRequest->setDownloadedData((char *)cachedData.contentsData().data(),cachedData.contentsData().length());
+    downloadRequest->setDownloadStatusCode(0);
+    downloadRequest->setHttpStatusCode(200);
+    mFileCacheMutex.unlock();
+    return true;
+  }
+  mFileCacheMutex.unlock();
+  return false;
+}
+#endif
 
-    vector<rtString>& additionalHttpHeaders = downloadRequest->additionalHttpHeaders();
-    struct curl_slist *list = NULL;
-    for (unsigned int headerOption = 0;headerOption < additionalHttpHeaders.size();headerOption++)
+void rtFileDownloader::downloadFileInBackground(rtFileDownloadRequest* downloadRequest)
+{
+    if (downloadRequest->downloadHandleExpiresTime() < -1)
     {
-      list = curl_slist_append(list, additionalHttpHeaders[headerOption].cString());
+      downloadRequest->setDownloadHandleExpiresTime(kDefaultDownloadHandleExpiresTime);
     }
-    if (downloadRequest->cors() != NULL)
-      downloadRequest->cors()->updateRequestForAccessControl(&list);
-    if (readDataSize > 0)
+
+#ifdef ENABLE_HTTP_CACHE
+    if (downloadRequest->cacheEnabled())
     {
-      list = curl_slist_append(list, "Expect:");
+      rtThreadPool* mainThreadPool = rtThreadPool::globalInstance();
+      rtThreadTask* task = new rtThreadTask(downloadFromCacheInBackground, (void*)downloadRequest, downloadRequest->fileUrl());
+      mainThreadPool->executeTask(task);
+      return;
     }
-    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, list);
-    //CA certificates
-    // !CLF: Use system CA Cert rather than CA_CERTIFICATE fo now.  Revisit!
-    //curl_easy_setopt(curl_handle,CURLOPT_CAINFO,mCaCertFile.cString());
-    curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 2);
-    curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, true);
-
-    /* some servers don't like requests that are made without a user-agent
-     field, so we provide one */
-    curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+#endif
+    queueNetworkDownload(downloadRequest);
+}
 
-    if (useProxy)
+// Queues the request for the download thread.  A request for a url that is
+// already queued or downloading with the same options joins that transfer
+// instead of starting another one.
+void rtFileDownloader::queueNetworkDownload(rtFileDownloadRequest* downloadRequest)
+{
+    std::string key = downloadKey(downloadRequest);
 
+    mDownloadQueueMutex.lock();
+    if (!key.empty())
     {
-        curl_easy_setopt(curl_handle, CURLOPT_PROXY, proxyServer.cString());
-        curl_easy_setopt(curl_handle, CURLOPT_PROXYTYPE, CURLPROXY_HTTP);
+      map<std::string, rtFileDownloadTransfer*>::iterator it = mDownloadsByUrl.find(key);
+      if (it != mDownloadsByUrl.end())
+      {
+        it->second->sharedRequests.push_back(downloadRequest);
+        mDownloadQueueMutex.unlock();
+        return;
+      }
     }
-    else
+
+    rtFileDownloadTransfer* transfer = new rtFileDownloadTransfer(downloadRequest, key);
+    if (!key.empty())
     {
-      curl_easy_setopt(curl_handle, CURLOPT_PROXY, "");
+      mDownloadsByUrl[key] = transfer;
     }
+    mPendingDownloads.push_back(transfer);
 
-    if (true == headerOnly)
+    if (mDownloadThread == NULL)
     {
-      curl_easy_setopt(curl_handle, CURLOPT_NOBODY, 1);
+      mMultiHandle = curl_multi_init();
+      curl_multi_setopt(mMultiHandle, CURLMOPT_MAXCONNECTS, (long)mMaxDownloads);
+#ifdef CURLPIPE_MULTIPLEX
+      curl_multi_setopt(mMultiHandle, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+      mDownloadThreadRunning = true;
+      mDownloadThread = new std::thread(&rtFileDownloader::runDownloadThread, this);
     }
+    mDownloadQueueMutex.unlock();
 
-    if (!method.isEmpty() && method.compare("GET") != 0)
+    startNextDownloadInBackground();
+}
+
+rtFileDownloadRequest* rtFileDownloader::nextDownloadRequest()
+{
+    rtFileDownloadRequest* downloadRequest = NULL;
+    mDownloadQueueMutex.lock();
+    if (mNumberOfCurrentDownloads < mMaxDownloads)
     {
-      if (method.compare("POST") == 0)
-        curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
-      else if (method.compare("PUT") == 0)
-        curl_easy_setopt(curl_handle, CURLOPT_UPLOAD, 1L);
+      list<rtFileDownloadTransfer*>::iterator it =
+        findStartableTransfer(mPriorityDownloads, mHostDownloadCounts, mMaxDownloadsPerHost);
+      if (it != mPriorityDownloads.end())
+      {
+        downloadRequest = (*it)->downloadRequest;
+      }
       else
-        curl_easy_setopt(curl_handle, CURLOPT_CUSTOMREQUEST, method.cString());
+      {
+        it = findStartableTransfer(mPendingDownloads, mHostDownloadCounts, mMaxDownloadsPerHost);
+        if (it != mPendingDownloads.end())
+        {
+          downloadRequest = (*it)->downloadRequest;
+        }
+      }
     }
+    mDownloadQueueMutex.unlock();
+    return downloadRequest;
+}
 
-    if (readDataSize > 0)
+// Called with mDownloadQueueMutex held
+rtFileDownloadTransfer* rtFileDownloader::takeNextTransfer()
+{
+    if (mNumberOfCurrentDownloads >= mMaxDownloads)
     {
-      chunk.downloadRequest = downloadRequest;
-      curl_easy_setopt(curl_handle, CURLOPT_READFUNCTION, ReadMemoryCallback);
-      curl_easy_setopt(curl_handle, CURLOPT_READDATA, (void *)&chunk);
-      curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, readDataSize);
+      return NULL;
     }
 
-    /* get it! */
-    res = curl_easy_perform(curl_handle);
-    curl_slist_free_all(list);
+    list<rtFileDownloadTransfer*>* transfers = &mPriorityDownloads;
+    list<rtFileDownloadTransfer*>::iterator it = findStartableTransfer(*transfers, mHostDownloadCounts, mMaxDownloadsPerHost);
+    if (it == transfers->end())
+    {
+      transfers = &mPendingDownloads;
+      it = findStartableTransfer(*transfers, mHostDownloadCounts, mMaxDownloadsPerHost);
+      if (it == transfers->end())
+      {
+        return NULL;
+      }
+    }
 
-    downloadRequest->setDownloadStatusCode(res);
-    if(downloadRequest->isHTTPFailOnError())
-        downloadRequest->setHTTPError(errorBuffer);
+    rtFileDownloadTransfer* transfer = *it;
+    transfers->erase(it);
+    mHostDownloadCounts[transfer->host]++;
+    mNumberOfCurrentDownloads++;
+    mActiveDownloads.push_back(transfer);
+    return transfer;
+}
 
-    /* check for errors */
-    if (res != CURLE_OK)
+// Takes a finished or aborted transfer out of the bookkeeping.  Once this
+// returns no more requests can join it.
+void rtFileDownloader::retireTransfer(rtFileDownloadTransfer* transfer)
+{
+    mDownloadQueueMutex.lock();
+    if (!transfer->key.empty())
     {
-        rtString proxyMessage("Using proxy:"); 
-        if (useProxy)
-        {
-          proxyMessage.append("true - ");
-          proxyMessage.append(proxyServer.cString());
-        }
-        else
-        {
-          proxyMessage.append("false ");
-        }
-        char errorMessage[MAX_URL_SIZE+400];
-        memset(errorMessage, 0, sizeof(errorMessage));
-        sprintf(errorMessage, "Download error for:%s. Error code:%d. %s",downloadRequest->fileUrl().cString(), res, proxyMessage.cString());
-        downloadRequest->setErrorString(errorMessage);
-        rtFileDownloader::instance()->releaseDownloadHandle(curl_handle, downloadHandleExpiresTime);
+      map<std::string, rtFileDownloadTransfer*>::iterator it = mDownloadsByUrl.find(transfer->key);
+      if (it != mDownloadsByUrl.end() && it->second == transfer)
+      {
+        mDownloadsByUrl.erase(it);
+      }
+    }
+    vector<rtFileDownloadTransfer*>::iterator active = std::find(mActiveDownloads.begin(), mActiveDownloads.end(), transfer);
+    if (active != mActiveDownloads.end())
+    {
+      mActiveDownloads.erase(active);
+      map<std::string, unsigned int>::iterator count = mHostDownloadCounts.find(transfer->host);
+      if (count != mHostDownloadCounts.end() && --count->second == 0)
+      {
+        mHostDownloadCounts.erase(count);
+      }
+      mNumberOfCurrentDownloads--;
+    }
+    mDownloadQueueMutex.unlock();
+}
 
-        //clean up contents on error
-        if (chunk.contentsBuffer != NULL)
+// Download thread: every transfer runs on one curl multi handle, which also
+// keeps the connections alive between transfers to the same host
+void rtFileDownloader::runDownloadThread()
+{
+    double lastCancelCheck = pxSeconds();
+    while (true)
+    {
+      vector<rtFileDownloadTransfer*> startedTransfers;
+      mDownloadQueueMutex.lock();
+      bool running = mDownloadThreadRunning;
+      if (running)
+      {
+        rtFileDownloadTransfer* transfer = NULL;
+        while ((transfer = takeNextTransfer()) != NULL)
         {
-            free(chunk.contentsBuffer);
-            chunk.contentsBuffer = NULL;
+          startedTransfers.push_back(transfer);
         }
+      }
+      mDownloadQueueMutex.unlock();
+      if (!running)
+      {
+        break;
+      }
 
-        if (chunk.headerBuffer != NULL)
+      for (vector<rtFileDownloadTransfer*>::iterator it = startedTransfers.begin(); it != startedTransfers.end(); ++it)
+      {
+        startTransfer(*it);
+      }
+
+      int runningTransfers = 0;
+      curl_multi_perform(mMultiHandle, &runningTransfers);
+
+      CURLMsg* message = NULL;
+      int messagesLeft = 0;
+      bool finishedTransfers = false;
+      while ((message = curl_multi_info_read(mMultiHandle, &messagesLeft)) != NULL)
+      {
+        if (message->msg == CURLMSG_DONE)
         {
-            free(chunk.headerBuffer);
-            chunk.headerBuffer = NULL;
+          rtFileDownloadTransfer* transfer = NULL;
+          CURLcode res = message->data.result;
+          curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char**)&transfer);
+          finishTransfer(transfer, res);
+          finishedTransfers = true;
         }
-        downloadRequest->setDownloadedData(NULL, 0);
-        return false;
+      }
+
+      if (pxSeconds() - lastCancelCheck >= kCanceledTransferCheckIntervalInSeconds)
+      {
+        abortCanceledTransfers();
+        lastCancelCheck = pxSeconds();
+      }
+
+      // finished transfers free up connections for the pending ones
+      if (finishedTransfers)
+      {
+        continue;
+      }
+#if LIBCURL_VERSION_NUM >= 0x074400
+      curl_multi_poll(mMultiHandle, NULL, 0, kDownloadPollTimeoutInMilliSeconds, NULL);
+#else
+      curl_multi_wait(mMultiHandle, NULL, 0, kDownloadWaitTimeoutInMilliSeconds, NULL);
+#endif
     }
+}
 
-    long httpCode = -1;
-    if (curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &httpCode) == CURLE_OK)
+void rtFileDownloader::startTransfer(rtFileDownloadTransfer* transfer)
+{
+    mDownloadQueueMutex.lock();
+    bool isCanceled = transfer->isCanceled();
+    mDownloadQueueMutex.unlock();
+    if (isCanceled)
     {
-        downloadRequest->setHttpStatusCode(httpCode);
+      dropCanceledTransfer(transfer);
+      return;
     }
-    rtFileDownloader::instance()->releaseDownloadHandle(curl_handle, downloadHandleExpiresTime);
 
-    //todo read the header information before closing
-    if (chunk.headerBuffer != NULL)
+    rtFileDownloadRequest* downloadRequest = transfer->downloadRequest;
+    if (!mIdleTransferHandles.empty())
     {
-        downloadRequest->setHeaderData(chunk.headerBuffer, chunk.headerSize);
+      transfer->curlHandle = mIdleTransferHandles.back();
+      mIdleTransferHandles.pop_back();
     }
-
-    //don't free the downloaded data (contentsBuffer) because it will be used later
-    if (false == headerOnly)
+    else
     {
-      downloadRequest->setDownloadedData(chunk.contentsBuffer, chunk.contentsSize);
+      transfer->curlHandle = curl_easy_init();
     }
-    else if (chunk.contentsBuffer != NULL)
+    prepareDownloadHandle(transfer->curlHandle, downloadRequest, transfer->chunk, transfer->errorBuffer, transfer->headers);
+    curl_easy_setopt(transfer->curlHandle, CURLOPT_PRIVATE, (void*)transfer);
+    if (downloadRequest->downloadHandleExpiresTime() == 0)
     {
-        free(chunk.contentsBuffer);
-        chunk.contentsBuffer = NULL;
+      curl_easy_setopt(transfer->curlHandle, CURLOPT_FORBID_REUSE, 1L);
     }
-    chunk.headerBuffer = NULL;
-    chunk.contentsBuffer = NULL;
-    if (downloadRequest->cors() != NULL)
-      downloadRequest->cors()->updateResponseForAccessControl(downloadRequest);
-    return true;
+    curl_multi_add_handle(mMultiHandle, transfer->curlHandle);
 }
 
-#ifdef ENABLE_HTTP_CACHE
-bool rtFileDownloader::checkAndDownloadFromCache(rtFileDownloadRequest* downloadRequest,rtHttpCacheData& cachedData)
+void rtFileDownloader::dropCanceledTransfer(rtFileDownloadTransfer* transfer)
 {
-  rtError err;
-  rtData data;
-  mFileCacheMutex.lock();
-  if ((NULL != rtFileCache::instance()) && (RT_OK == rtFileCache::instance()->httpCacheData(downloadRequest->fileUrl(),cachedData)))
-  {
-    if(downloadRequest->deferCacheRead())
-      err = cachedData.deferCacheRead(data);
-    else
-      err = cachedData.data(data);
-    if (RT_OK !=  err)
+    retireTransfer(transfer);
+    vector<rtFileDownloadRequest*> requests(transfer->sharedRequests);
+    requests.insert(requests.begin(), transfer->downloadRequest);
+    for (vector<rtFileDownloadRequest*>::iterator it = requests.begin(); it != requests.end(); ++it)
     {
-      mFileCacheMutex.unlock();
-      return false;
+      // downloadFile reports the cancel; anything that joined after the
+      // check goes back in the queue
+      if ((*it)->isCanceled())
+        rtThreadPool::globalInstance()->executeTask(new rtThreadTask(startFileDownloadInBackground, *it, (*it)->fileUrl()));
+      else
+        queueNetworkDownload(*it);
     }
+    delete transfer;
+}
 
-    downloadRequest->setHeaderData((char *)cachedData.headerData().data(),cachedData.headerData().length());
-    downloadRequest->setDownloadedData((char *)cachedData.contentsData().data(),cachedData.contentsData().length());
-    downloadRequest->setDownloadStatusCode(0);
-    downloadRequest->setHttpStatusCode(200);
-    mFileCacheMutex.unlock();
-    return true;
-  }
-  mFileCacheMutex.unlock();
-  return false;
+void rtFileDownloader::recycleTransferHandle(rtFileDownloadTransfer* transfer)
+{
+    curl_multi_remove_handle(mMultiHandle, transfer->curlHandle);
+    curl_slist_free_all(transfer->headers);
+    transfer->headers = NULL;
+    if (mIdleTransferHandles.size() < kMaxIdleTransferHandles)
+    {
+      mIdleTransferHandles.push_back(transfer->curlHandle);
+    }
+    else
+    {
+      curl_easy_cleanup(transfer->curlHandle);
+    }
+    transfer->curlHandle = NULL;
 }
-#endif
 
-void rtFileDownloader::downloadFileInBackground(rtFileDownloadRequest* downloadRequest)
+void rtFileDownloader::finishTransfer(rtFileDownloadTransfer* transfer, CURLcode res)
 {
-    rtThreadPool* mainThreadPool = rtThreadPool::globalInstance();
+    rtFileDownloadRequest* downloadRequest = transfer->downloadRequest;
+    finishNetworkDownload(transfer->curlHandle, downloadRequest, res, transfer->chunk, transfer->errorBuffer);
+    recycleTransferHandle(transfer);
+    retireTransfer(transfer);
 
-    if (downloadRequest->downloadHandleExpiresTime() < -1)
+    rtThreadPool* mainThreadPool = rtThreadPool::globalInstance();
+    for (size_t i = 0; i < transfer->sharedRequests.size(); i++)
     {
-      downloadRequest->setDownloadHandleExpiresTime(kDefaultDownloadHandleExpiresTime);
+      rtFileDownloadRequest* sharedRequest = transfer->sharedRequests[i];
+      copyDownloadResult(downloadRequest, sharedRequest);
+      mainThreadPool->executeTask(new rtThreadTask(completeSharedDownloadInBackground, sharedRequest, sharedRequest->fileUrl()));
     }
+    mainThreadPool->executeTask(new rtThreadTask(completeDownloadInBackground, downloadRequest, downloadRequest->fileUrl()));
+    delete transfer;
+}
 
-    rtThreadTask* task = new rtThreadTask(startFileDownloadInBackground, (void*)downloadRequest, downloadRequest->fileUrl());
+// Drops active transfers that every request has given up on
+void rtFileDownloader::abortCanceledTransfers()
+{
+    vector<rtFileDownloadTransfer*> canceledTransfers;
+    mDownloadQueueMutex.lock();
+    for (vector<rtFileDownloadTransfer*>::iterator it = mActiveDownloads.begin(); it != mActiveDownloads.end(); ++it)
+    {
+      if ((*it)->curlHandle != NULL && (*it)->isCanceled())
+        canceledTransfers.push_back(*it);
+    }
+    mDownloadQueueMutex.unlock();
 
-    mainThreadPool->executeTask(task);
+    for (vector<rtFileDownloadTransfer*>::iterator it = canceledTransfers.begin(); it != canceledTransfers.end(); ++it)
+    {
+      recycleTransferHandle(*it);
+      dropCanceledTransfer(*it);
+    }
 }
 
-rtFileDownloadRequest* rtFileDownloader::nextDownloadRequest()
+void rtFileDownloader::stopDownloadThread()
 {
-    //todo
-    return NULL;
+    mDownloadQueueMutex.lock();
+    std::thread* downloadThread = mDownloadThread;
+    mDownloadThreadRunning = false;
+    mDownloadQueueMutex.unlock();
+    if (downloadThread == NULL)
+    {
+      return;
+    }
+
+    startNextDownloadInBackground();
+    downloadThread->join();
+    delete downloadThread;
+
+    // fail whatever didn't get to finish
+    vector<rtFileDownloadTransfer*> transfers = mActiveDownloads;
+    transfers.insert(transfers.end(), mPriorityDownloads.begin(), mPriorityDownloads.end());
+    transfers.insert(transfers.end(), mPendingDownloads.begin(), mPendingDownloads.end());
+    for (vector<rtFileDownloadTransfer*>::iterator it = transfers.begin(); it != transfers.end(); ++it)
+    {
+      rtFileDownloadTransfer* transfer = *it;
+      if (transfer->curlHandle != NULL)
+      {
+        recycleTransferHandle(transfer);
+      }
+      vector<rtFileDownloadRequest*> requests(transfer->sharedRequests);
+      requests.insert(requests.begin(), transfer->downloadRequest);
+      for (vector<rtFileDownloadRequest*>::iterator request = requests.begin(); request != requests.end(); ++request)
+      {
+        (*request)->cancelRequest();
+        completeCanceledDownload(*request);
+      }
+      delete transfer;
+    }
+    mActiveDownloads.clear();
+    mPriorityDownloads.clear();
+    mPendingDownloads.clear();
+    mDownloadsByUrl.clear();
+    mHostDownloadCounts.clear();
+    mNumberOfCurrentDownloads = 0;
+
+    for (vector<CURL*>::iterator it = mIdleTransferHandles.begin(); it != mIdleTransferHandles.end(); ++it)
+    {
+      curl_easy_cleanup(*it);
+    }
+    mIdleTransferHandles.clear();
+
+    mDownloadQueueMutex.lock();
+    curl_multi_cleanup(mMultiHandle);
+    mMultiHandle = NULL;
+    mDownloadThread = NULL;
+    mDownloadQueueMutex.unlock();
 }
 
 void rtFileDownloader::setDefaultCallbackFunction(void (*callbackFunction)(rtFileDownloadRequest*))
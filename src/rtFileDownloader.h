@@ -30,6 +30,10 @@
 
 // TODO Eliminate std::string
 #include <string.h>
+#include <list>
+#include <map>
+#include <string>
+#include <thread>
 #include <vector>
 
 #if !defined(WIN32) && !defined(ENABLE_DFB)
@@ -43,6 +47,26 @@
 #pragma GCC diagnostic pop
 #endif
 
+class rtFileDownloadRequest;
+
+// Receives the body of a download as it arrives instead of after the
+// download completes.  Called on the thread doing the download.
+class rtFileDownloadSink
+{
+public:
+  virtual ~rtFileDownloadSink() {}
+
+  // Before the first data; contentLength is -1 if the server didn't send one
+  virtual void onDownloadStart(rtFileDownloadRequest* request, int64_t contentLength)
+  {
+    (void)request;
+    (void)contentLength;
+  }
+
+  // Return false to abort the download
+  virtual bool onDownloadData(rtFileDownloadRequest* request, const char* data, size_t size) = 0;
+};
+
 class rtFileDownloadRequest
 {
 public:
@@ -62,6 +86,12 @@ public:
   void setHttpStatusCode(long statusCode);
   bool executeCallback(int statusCode);
   size_t executeDownloadProgressCallback(void *ptr, size_t size, size_t nmemb);
+  bool hasDownloadProgressCallback() const;
+  // With keepDownloadedData false the body only goes to the sink;
+  // downloadedData() is then NULL and downloadedDataSize() the bytes streamed
+  void setDownloadSink(rtFileDownloadSink* sink, bool keepDownloadedData = true);
+  rtFileDownloadSink* downloadSink() const;
+  bool keepsDownloadedData() const;
   void setDownloadedData(char* data, size_t size);
   void downloadedData(char*& data, size_t& size);
   char* downloadedData();
@@ -145,6 +175,8 @@ private:
   rtString mMethod;
   const uint8_t* mReadData;
   size_t mReadDataSize;
+  rtFileDownloadSink* mDownloadSink;
+  bool mKeepDownloadedData;
 };
 
 struct rtFileDownloadHandle
@@ -155,6 +187,8 @@ struct rtFileDownloadHandle
   double expiresTime;
 };
 
+struct rtFileDownloadTransfer;
+
 class rtFileDownloader
 {
 public:
@@ -174,27 +208,56 @@ public:
     void setDefaultCallbackFunction(void (*callbackFunction)(rtFileDownloadRequest*));
     bool downloadFromNetwork(rtFileDownloadRequest* downloadRequest);
     void checkForExpiredHandles();
+    void setMaxConnections(unsigned int maxDownloads, unsigned int maxDownloadsPerHost);
 
 private:
     rtFileDownloader();
     ~rtFileDownloader();
 
-    void startNextDownload(rtFileDownloadRequest* downloadRequest);
     rtFileDownloadRequest* nextDownloadRequest();
     void startNextDownloadInBackground();
     void downloadFileInBackground(rtFileDownloadRequest* downloadRequest);
+    void queueNetworkDownload(rtFileDownloadRequest* downloadRequest);
+    void completeDownload(rtFileDownloadRequest* downloadRequest, bool nwDownloadSuccess);
+    void completeCanceledDownload(rtFileDownloadRequest* downloadRequest);
+    static void completeDownloadInBackground(void* data);
+    static void completeSharedDownloadInBackground(void* data);
 #ifdef ENABLE_HTTP_CACHE
     bool checkAndDownloadFromCache(rtFileDownloadRequest* downloadRequest,rtHttpCacheData& cachedData);
+    bool downloadFromCache(rtFileDownloadRequest* downloadRequest);
+    static void downloadFromCacheInBackground(void* data);
 #endif
     CURL* retrieveDownloadHandle();
     void releaseDownloadHandle(CURL* curlHandle, double expiresTime);
     static void addFileDownloadRequest(rtFileDownloadRequest* downloadRequest);
     static void clearFileDownloadRequest(rtFileDownloadRequest* downloadRequest);
-    //todo: hash mPendingDownloadRequests;
-    //todo: string list mPendingDownloadOrderList;
-    //todo: list mActiveDownloads;
+
+    // multi handle download thread
+    void runDownloadThread();
+    rtFileDownloadTransfer* takeNextTransfer();
+    void startTransfer(rtFileDownloadTransfer* transfer);
+    void finishTransfer(rtFileDownloadTransfer* transfer, CURLcode res);
+    void retireTransfer(rtFileDownloadTransfer* transfer);
+    void dropCanceledTransfer(rtFileDownloadTransfer* transfer);
+    void recycleTransferHandle(rtFileDownloadTransfer* transfer);
+    void abortCanceledTransfers();
+    void stopDownloadThread();
+
+    // pending transfers, raised ones first; coalescable transfers are also
+    // indexed by url so duplicate requests ride along with them
+    std::list<rtFileDownloadTransfer*> mPriorityDownloads;
+    std::list<rtFileDownloadTransfer*> mPendingDownloads;
+    std::map<std::string, rtFileDownloadTransfer*> mDownloadsByUrl;
+    std::vector<rtFileDownloadTransfer*> mActiveDownloads;
+    std::map<std::string, unsigned int> mHostDownloadCounts;
     unsigned int mNumberOfCurrentDownloads;
-    //todo: hash m_priorityDownloads;
+    unsigned int mMaxDownloads;
+    unsigned int mMaxDownloadsPerHost;
+    rtMutex mDownloadQueueMutex;
+    CURLM* mMultiHandle;
+    std::vector<CURL*> mIdleTransferHandles;
+    std::thread* mDownloadThread;
+    bool mDownloadThreadRunning;
     void (*mDefaultCallbackFunction)(rtFileDownloadRequest*);
     std::vector<rtFileDownloadHandle> mDownloadHandles;
     bool mReuseDownloadHandles;
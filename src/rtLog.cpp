@@ -36,6 +36,11 @@
 #include <inttypes.h>
 #include <rtThreadTask.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 
 struct LogLevelSetter
 {
@@ -57,6 +62,9 @@ struct LogLevelSetter
       }
       rtLogSetLevel(level);
     }
+    s = getenv("RT_LOG_ASYNC");
+    if (s && strcmp(s, "1") == 0)
+      rtLogSetAsync(true);
   }
 };
 
@@ -123,6 +131,260 @@ void rtLogSetLevel(rtLogLevel level)
   sLevel = level;
 }
 
+// a line longer than this is cut short, as it is for log handlers
+#define RT_LOG_LINE_SIZE 1024
+#define RT_LOG_RING_SIZE 1024 // lines, a power of two
+#define RT_LOG_BATCH_SIZE 65536
+#define RT_LOG_FLUSH_INTERVAL 10 // ms
+
+struct rtLogSlot
+{
+  std::atomic<uint32_t> sequence;
+  uint32_t length;
+  char text[RT_LOG_LINE_SIZE];
+};
+
+// Bounded multi-producer ring: a producer claims a slot by advancing
+// mEnqueuePos and publishes it by setting the slot's sequence; the flusher
+// (or rtLogFlush, one at a time) consumes slots in order.
+class rtLogRing
+{
+public:
+  rtLogRing() : mEnqueuePos(0), mDequeuePos(0), mDropped(0), mFlusherWaiting(false), mRunning(false), mFlusher(NULL)
+  {
+    for (uint32_t i = 0; i < RT_LOG_RING_SIZE; i++)
+      mSlots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  rtLogSlot* claim()
+  {
+    uint32_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+      rtLogSlot* slot = &mSlots[pos & (RT_LOG_RING_SIZE - 1)];
+      int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - pos);
+      if (diff == 0)
+      {
+        if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          return slot;
+      }
+      else if (diff < 0)
+      {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+      }
+      else
+      {
+        pos = mEnqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void publish(rtLogSlot* slot)
+  {
+    uint32_t pos = slot->sequence.load(std::memory_order_relaxed);
+    // seq_cst here and in run() so that either the flusher sees this line
+    // before it sleeps or we see that it's sleeping
+    slot->sequence.store(pos + 1, std::memory_order_seq_cst);
+    // also hurry the flusher along when the ring is half full
+    if (mFlusherWaiting.load(std::memory_order_seq_cst) ||
+        (pos + 1 - mDequeuePos.load(std::memory_order_relaxed) == RT_LOG_RING_SIZE/2))
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mCondition.notify_one();
+    }
+  }
+
+  bool hasLines()
+  {
+    uint32_t pos = mDequeuePos.load(std::memory_order_relaxed);
+    return mSlots[pos & (RT_LOG_RING_SIZE - 1)].sequence.load(std::memory_order_seq_cst) == pos + 1;
+  }
+
+  // writes out every published line, RT_LOG_BATCH_SIZE bytes per write
+  void drain()
+  {
+    std::lock_guard<std::mutex> lock(mDrainMutex);
+    size_t length = 0;
+    while (true)
+    {
+      uint32_t pos = mDequeuePos.load(std::memory_order_relaxed);
+      rtLogSlot* slot = &mSlots[pos & (RT_LOG_RING_SIZE - 1)];
+      bool ready = slot->sequence.load(std::memory_order_acquire) == pos + 1;
+      if (!ready || length + slot->length > sizeof(mBatch))
+      {
+        if (length > 0)
+          writeBatch(length);
+        length = 0;
+        if (!ready)
+          break;
+      }
+      memcpy(mBatch + length, slot->text, slot->length);
+      length += slot->length;
+      slot->sequence.store(pos + RT_LOG_RING_SIZE, std::memory_order_release);
+      mDequeuePos.store(pos + 1, std::memory_order_relaxed);
+    }
+  }
+
+  void start()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mRunning)
+      return;
+    mRunning = true;
+    mFlusher = new std::thread(&rtLogRing::run, this);
+  }
+
+  void stop()
+  {
+    std::thread* flusher = NULL;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mRunning = false;
+      flusher = mFlusher;
+      mFlusher = NULL;
+      mCondition.notify_one();
+    }
+    if (flusher != NULL)
+    {
+      flusher->join();
+      delete flusher;
+    }
+    drain();
+  }
+
+  uint64_t dropped()
+  {
+    return mDropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  void run()
+  {
+    bool idle = false;
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (idle)
+        {
+          // nothing came in for a whole interval: sleep until a line does
+          mFlusherWaiting.store(true, std::memory_order_seq_cst);
+          while (mRunning && !hasLines())
+            mCondition.wait(lock);
+          mFlusherWaiting.store(false, std::memory_order_relaxed);
+        }
+        else if (mRunning)
+        {
+          // while lines keep coming they're picked up every interval
+          // rather than each one waking us
+          mCondition.wait_for(lock, std::chrono::milliseconds(RT_LOG_FLUSH_INTERVAL));
+        }
+        if (!mRunning)
+          break;
+      }
+      idle = !hasLines();
+      drain();
+    }
+  }
+
+  void writeBatch(size_t length)
+  {
+#ifndef WIN32
+    const char* p = mBatch;
+    while (length > 0)
+    {
+      ssize_t n = write(STDOUT_FILENO, p, length);
+      if (n <= 0)
+        break;
+      p += n;
+      length -= n;
+    }
+#else
+    fwrite(mBatch, 1, length, stdout);
+    fflush(stdout);
+#endif
+  }
+
+  rtLogSlot mSlots[RT_LOG_RING_SIZE];
+  std::atomic<uint32_t> mEnqueuePos;
+  std::atomic<uint32_t> mDequeuePos;
+  std::atomic<uint64_t> mDropped;
+  std::atomic<bool> mFlusherWaiting;
+  bool mRunning;
+  std::thread* mFlusher;
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::mutex mDrainMutex;
+  char mBatch[RT_LOG_BATCH_SIZE];
+};
+
+// never destroyed: lines may be logged from other threads during exit
+static rtLogRing* sLogRing = NULL;
+static std::atomic<bool> sLogAsync(false);
+
+static void rtLogFlushAtExit()
+{
+  rtLogFlush();
+}
+
+void rtLogSetAsync(bool async)
+{
+  static std::mutex asyncMutex;
+  std::lock_guard<std::mutex> lock(asyncMutex);
+  if (async == sLogAsync.load())
+    return;
+  if (async)
+  {
+    if (sLogRing == NULL)
+    {
+      sLogRing = new rtLogRing();
+      atexit(rtLogFlushAtExit);
+    }
+    // lines already in stdio's buffer go out first
+    fflush(stdout);
+    sLogRing->start();
+    sLogAsync = true;
+  }
+  else
+  {
+    sLogAsync = false;
+    sLogRing->stop();
+  }
+}
+
+void rtLogFlush()
+{
+  if (sLogRing != NULL)
+    sLogRing->drain();
+  fflush(stdout);
+}
+
+uint64_t rtLogDroppedCount()
+{
+  return sLogRing != NULL ? sLogRing->dropped() : 0;
+}
+
+// Formats the whole line, newline included, so that it's written with one
+// call.  Returns the length of the complete line; if that doesn't fit it is
+// cut short to size - 1 bytes.
+static size_t rtLogFormatLine(char* buff, size_t size, const char* logLevel, const char* path, int line,
+  rtThreadId threadId, const char* format, va_list args)
+{
+  int prefix = snprintf(buff, size, RT_LOGPREFIX "%5s %s:%d -- Thread-%" RT_THREADID_FMT ": ", logLevel, path, line, threadId);
+  if (prefix < 0)
+    prefix = 0;
+  size_t offset = (size_t)prefix < size - 2 ? prefix : size - 2;
+  int message = vsnprintf(buff + offset, size - offset - 1, format, args);
+  if (message < 0)
+    message = 0;
+  size_t length = prefix + message + 1;
+  size_t end = length < size ? length : size - 1;
+  buff[end - 1] = '\n';
+  buff[end] = '\0';
+  return length;
+}
+
 void rtLogPrintf(rtLogLevel level, const char* file, int line, const char* format, ...)
 {
   if (level < sLevel)
@@ -135,13 +397,41 @@ void rtLogPrintf(rtLogLevel level, const char* file, int line, const char* forma
 
   if (sLogHandler == NULL)
   {
-    printf(RT_LOGPREFIX "%5s %s:%d -- Thread-%" RT_THREADID_FMT ": ", logLevel, path, line, threadId);
     va_list ptr;
     va_start(ptr, format);
-    vprintf(format, ptr);
+    if (sLogAsync.load(std::memory_order_relaxed))
+    {
+      rtLogSlot* slot = sLogRing->claim();
+      if (slot != NULL)
+      {
+        size_t length = rtLogFormatLine(slot->text, sizeof(slot->text), logLevel, path, line, threadId, format, ptr);
+        slot->length = length < sizeof(slot->text) ? length : sizeof(slot->text) - 1;
+        sLogRing->publish(slot);
+      }
+    }
+    else
+    {
+      char buff[RT_LOG_LINE_SIZE];
+      va_list copy;
+      va_copy(copy, ptr);
+      size_t length = rtLogFormatLine(buff, sizeof(buff), logLevel, path, line, threadId, format, ptr);
+      if (length < sizeof(buff))
+      {
+        fwrite(buff, 1, length, stdout);
+      }
+      else
+      {
+        char* longBuff = (char*)malloc(length + 1);
+        if (longBuff != NULL)
+        {
+          rtLogFormatLine(longBuff, length + 1, logLevel, path, line, threadId, format, copy);
+          fwrite(longBuff, 1, length, stdout);
+          free(longBuff);
+        }
+      }
+      va_end(copy);
+    }
     va_end(ptr);
-
-    printf("\n");
   }
   else
   {
@@ -160,7 +450,10 @@ void rtLogPrintf(rtLogLevel level, const char* file, int line, const char* forma
   }
   
   if (level == RT_LOG_FATAL)
+  {
+    rtLogFlush();
     abort();
+  }
 }
 
 rtThreadId rtThreadGetCurrentId()
@@ -172,6 +465,10 @@ rtThreadId rtThreadGetCurrentId()
 #elif WIN32
   return GetCurrentThreadId();
 #else
-  return syscall(__NR_gettid);
+  // the syscall is only made once per thread
+  static thread_local rtThreadId threadId = 0;
+  if (threadId == 0)
+    threadId = syscall(__NR_gettid);
+  return threadId;
 #endif
 }
@@ -55,6 +55,14 @@ typedef void (*rtLogHandler)(rtLogLevel level, const char* file, int line, int t
 
 void rtLogSetLevel(rtLogLevel l);
 void rtLogSetLogHandler(rtLogHandler logHandler);
+
+// Asynchronous logging: lines are formatted into a preallocated ring buffer
+// and written out in batches by a background thread.  Lines logged while the
+// buffer is full are dropped and counted.  Also enabled by RT_LOG_ASYNC=1.
+// Has no effect on lines that go to a log handler.
+void rtLogSetAsync(bool async);
+void rtLogFlush();
+uint64_t rtLogDroppedCount();
 const char* rtLogLevelToString(rtLogLevel level);
 rtLogLevel  rtLogLevelFromString(const char* s);
 
@@ -70,7 +78,13 @@ rtThreadId rtThreadGetCurrentId();
 // TODO would like this for to be hidden/private... something from Igor broke... 
 void rtLogPrintf(rtLogLevel level, const char* file, int line, const char* format, ...) RT_PRINTF_FORMAT(4, 5);
 
-#define rtLog(LEVEL, FORMAT, ...) do { rtLogPrintf(LEVEL, __FILE__, __LINE__, FORMAT, ## __VA_ARGS__); } while (0)
+// Calls below this level are compiled out, arguments included.  Release
+// builds can define it to e.g. RT_LOG_INFO to drop all rtLogDebug calls.
+#ifndef RT_LOG_COMPILE_LEVEL
+#define RT_LOG_COMPILE_LEVEL RT_LOG_DEBUG
+#endif
+
+#define rtLog(LEVEL, FORMAT, ...) do { if ((LEVEL) >= RT_LOG_COMPILE_LEVEL) rtLogPrintf(LEVEL, __FILE__, __LINE__, FORMAT, ## __VA_ARGS__); } while (0)
 #define rtLogDebug(FORMAT, ...) rtLog(RT_LOG_DEBUG, FORMAT, ## __VA_ARGS__)
 #define rtLogInfo(FORMAT, ...) rtLog(RT_LOG_INFO, FORMAT, ## __VA_ARGS__)
 #define rtLogWarn(FORMAT, ...) rtLog(RT_LOG_WARN, FORMAT, ## __VA_ARGS__)
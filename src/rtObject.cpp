@@ -21,9 +21,20 @@
 #include "rtObject.h"
 #include <errno.h>
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+
 using namespace std;
 
 // rtEmit
+rtEmit::~rtEmit()
+{
+  for (vector<_rtEmitEvent*>::iterator it = mEvents.begin(); it != mEvents.end(); it++)
+    delete *it;
+}
+
 unsigned long rtEmit::AddRef() 
 {
   return rtAtomicInc(&mRefCount);
@@ -35,29 +46,84 @@ unsigned long rtEmit::Release() {
   return l;
 }
 
+rtEmit::_rtEmitEvent* rtEmit::findEvent(const char* eventName) const
+{
+  if (!eventName || mEvents.empty())
+    return NULL;
+
+  uint32_t h = rtAtomHash(eventName);
+  uint32_t mask = static_cast<uint32_t>(mEvents.size()) - 1;
+  for (uint32_t i = h & mask; mEvents[i]; i = (i + 1) & mask)
+  {
+    _rtEmitEvent* ev = mEvents[i];
+    if (ev->n->hash == h && !strcmp(ev->n->name, eventName))
+      return ev;
+  }
+  return NULL;
+}
+
+rtEmit::_rtEmitEvent* rtEmit::addEvent(const char* eventName)
+{
+  _rtEmitEvent* ev = findEvent(eventName);
+  if (ev)
+    return ev;
+
+  // keep the table at most half full
+  if ((mEventCount + 1) * 2 > mEvents.size())
+  {
+    vector<_rtEmitEvent*> events(mEvents.empty() ? 8 : mEvents.size() * 2, NULL);
+    uint32_t mask = static_cast<uint32_t>(events.size()) - 1;
+    for (vector<_rtEmitEvent*>::iterator it = mEvents.begin(); it != mEvents.end(); it++)
+    {
+      if (!*it)
+        continue;
+      uint32_t i = (*it)->n->hash & mask;
+      while (events[i])
+        i = (i + 1) & mask;
+      events[i] = *it;
+    }
+    mEvents.swap(events);
+  }
+
+  ev = new _rtEmitEvent;
+  ev->n = rtAtomIntern(eventName);
+  uint32_t mask = static_cast<uint32_t>(mEvents.size()) - 1;
+  uint32_t i = ev->n->hash & mask;
+  while (mEvents[i])
+    i = (i + 1) & mask;
+  mEvents[i] = ev;
+  mEventCount++;
+  return ev;
+}
+
 rtError rtEmit::setListener(const char* eventName, rtIFunction* f)
 {
-  for (vector<_rtEmitEntry>::iterator it = mEntries.begin();
-       it != mEntries.end(); it++)
+  _rtEmitEvent* ev = findEvent(eventName);
+  if (ev)
   {
-    _rtEmitEntry& e = (*it);
-    if (e.n == eventName && e.isProp)
+    for (vector<_rtEmitEntry>::iterator it = ev->entries.begin();
+         it != ev->entries.end(); it++)
     {
-      mEntries.erase(it);
-      // There can only be one
-      break;
+      _rtEmitEntry& e = (*it);
+      if (e.isProp)
+      {
+        ev->entries.erase(it);
+        // There can only be one
+        break;
+      }
     }
   }
   if (f)
   {
+    ev = addEvent(eventName);
     _rtEmitEntry e;
-    e.n = eventName;
+    e.n = ev->n;
     e.f = f;
     e.isProp = true;
     e.markForDelete = false;
     e.fnHash = f->hash();
     e.emitOnce = false;
-    mEntries.push_back(e);
+    ev->entries.push_back(e);
   }
   
   return RT_OK;
@@ -72,15 +138,16 @@ rtError rtEmit::addListener(const char* eventName, rtIFunction* f, bool emitOnce
 {
   if (!eventName || !f)
     return RT_ERROR;
+  _rtEmitEvent* ev = addEvent(eventName);
   // Only allow unique entries
   bool found = false;
-  for (vector<_rtEmitEntry>::iterator it = mEntries.begin(); 
-       it != mEntries.end(); it++)
+  for (vector<_rtEmitEntry>::iterator it = ev->entries.begin(); 
+       it != ev->entries.end(); it++)
   {
     _rtEmitEntry& e = (*it);
     // mHash check for javscript events callback 
     // markForDelete check is added to handle scenario where same handler is deleted and added immediately in same handler
-    if (e.n == eventName && ((e.f.getPtr() == f) || ((f->hash() != (size_t)-1) && (e.fnHash == f->hash()) && (false == e.markForDelete))) && !e.isProp)
+    if (((e.f.getPtr() == f) || ((f->hash() != (size_t)-1) && (e.fnHash == f->hash()) && (false == e.markForDelete))) && !e.isProp)
     {
       found = true;
       break;
@@ -89,7 +156,7 @@ rtError rtEmit::addListener(const char* eventName, rtIFunction* f, bool emitOnce
   if (!found)
   {
     _rtEmitEntry e;
-    e.n = eventName;
+    e.n = ev->n;
     e.f = f;
     e.isProp = false;
     e.markForDelete = false;
@@ -97,7 +164,7 @@ rtError rtEmit::addListener(const char* eventName, rtIFunction* f, bool emitOnce
     e.emitOnce = emitOnce;
     if (!mProcessingEvents)
     {
-      mEntries.push_back(e);
+      ev->entries.push_back(e);
     }
     else
     {
@@ -114,17 +181,24 @@ rtError rtEmit::delListener(const char* eventName, rtIFunction* f)
   if (!eventName || !f)
     return RT_ERROR;
 
-  for (vector<_rtEmitEntry>::iterator it = mEntries.begin(); 
-       it != mEntries.end(); it++)
+  _rtEmitEvent* ev = findEvent(eventName);
+  if (!ev)
+    return RT_OK;
+
+  for (vector<_rtEmitEntry>::iterator it = ev->entries.begin(); 
+       it != ev->entries.end(); it++)
   {
     _rtEmitEntry& e = (*it);
-    if (e.n == eventName && ((e.f.getPtr() == f) || (((size_t)-1 != e.fnHash) && (e.fnHash == f->hash()))) && !e.isProp)
+    if (((e.f.getPtr() == f) || (((size_t)-1 != e.fnHash) && (e.fnHash == f->hash()))) && !e.isProp)
     {
       // if no events is being processed currently, remove the event entries
       if (!mProcessingEvents)
-      	mEntries.erase(it);
+      	ev->entries.erase(it);
       else
+      {
         it->markForDelete = true;
+        mPendingDeletes = true;
+      }
       // There can only be one
       break;
     }
@@ -132,6 +206,23 @@ rtError rtEmit::delListener(const char* eventName, rtIFunction* f)
   return RT_OK;
 }
 
+size_t rtEmit::listenerCount() const
+{
+  size_t count = 0;
+  for (vector<_rtEmitEvent*>::const_iterator it = mEvents.begin(); it != mEvents.end(); it++)
+  {
+    if (*it)
+      count += (*it)->entries.size();
+  }
+  return count;
+}
+
+size_t rtEmit::listenerCount(const char* eventName) const
+{
+  _rtEmitEvent* ev = findEvent(eventName);
+  return ev ? ev->entries.size() : 0;
+}
+
 rtError rtEmit::Send(int numArgs, const rtValue* args, rtValue* result) 
 {
   (void)result;
@@ -140,47 +231,44 @@ rtError rtEmit::Send(int numArgs, const rtValue* args, rtValue* result)
     rtString eventName = args[0].toString();
     rtLogDebug("rtEmit::Send %s", eventName.cString());
 
-    vector<_rtEmitEntry>::iterator it = mEntries.begin();
+    _rtEmitEvent* ev = findEvent(eventName.cString());
+    if (!ev)
+      return RT_OK;
+
+    vector<_rtEmitEntry>::iterator it = ev->entries.begin();
     
     mProcessingEvents = true;
-    while (it != mEntries.end())
+    while (it != ev->entries.end())
     {
       _rtEmitEntry& e = (*it);
-      if (e.n == eventName)
-      {
-        // Do this here to make interop synchronous
-        rtError err;
-        rtValue discard;
-        // have to invoke all no opportunity to return errors
-        // SYNC EVENTS
+      // Do this here to make interop synchronous
+      rtError err;
+      rtValue discard;
+      // have to invoke all no opportunity to return errors
+      // SYNC EVENTS
 #ifndef DISABLE_SYNC_EVENTS
-        // SYNC EVENTS ... enables stopPropagation() ...
-        //
-        // pass NULL as final argument for indication of asynchronous call
-        err = e.f->Send(numArgs-1, args+1, &discard);
+      // SYNC EVENTS ... enables stopPropagation() ...
+      //
+      // pass NULL as final argument for indication of asynchronous call
+      err = e.f->Send(numArgs-1, args+1, &discard);
 #else
 
 #warning "  >>>>>>  No SYNC EVENTS... stopPropagation() will be broken !!"
 
-        err = e.f->Send(numArgs-1, args+1, NULL);
+      err = e.f->Send(numArgs-1, args+1, NULL);
 #endif
-        if (err != RT_OK)
-          rtLogInfo("failed to send. %s", rtStrError(err));
+      if (err != RT_OK)
+        rtLogInfo("failed to send. %s", rtStrError(err));
 
-        // EPIPE means it's disconnected
-        if (err == rtErrorFromErrno(EPIPE) || err == RT_ERROR_STREAM_CLOSED)
-        {
-          rtLogInfo("removing entry from remote client");
-          it = mEntries.erase(it);
-        }
-        else if (e.emitOnce)
-        {
-          it = mEntries.erase(it);
-        }
-        else
-        {
-          ++it;
-        }
+      // EPIPE means it's disconnected
+      if (err == rtErrorFromErrno(EPIPE) || err == RT_ERROR_STREAM_CLOSED)
+      {
+        rtLogInfo("removing entry from remote client");
+        it = ev->entries.erase(it);
+      }
+      else if (e.emitOnce)
+      {
+        it = ev->entries.erase(it);
       }
       else
       {
@@ -201,32 +289,30 @@ rtError rtEmit::SendAsync(int numArgs, const rtValue* args)
   {
     rtString eventName = args[0].toString();
     rtLogDebug("rtEmit::SendAsync %s", eventName.cString());
-    vector<_rtEmitEntry>::iterator it = mEntries.begin();
 
-    while (it != mEntries.end())
+    _rtEmitEvent* ev = findEvent(eventName.cString());
+    if (!ev)
+      return RT_OK;
+
+    vector<_rtEmitEntry>::iterator it = ev->entries.begin();
+
+    while (it != ev->entries.end())
     {
       _rtEmitEntry& e = (*it);
-      if (e.n == eventName)
-      {
-        rtError err;
-        err = e.f->Send(numArgs-1, args+1, NULL);
-        if (err != RT_OK)
-          rtLogInfo("failed to send. %s", rtStrError(err));
+      rtError err;
+      err = e.f->Send(numArgs-1, args+1, NULL);
+      if (err != RT_OK)
+        rtLogInfo("failed to send. %s", rtStrError(err));
 
-        // EPIPE means it's disconnected
-        if (err == rtErrorFromErrno(EPIPE) || err == RT_ERROR_STREAM_CLOSED)
-        {
-          rtLogInfo("removing entry from remote client");
-          it = mEntries.erase(it);
-        }
-        else if (e.emitOnce)
-        {
-          it = mEntries.erase(it);
-        }
-        else
-        {
-          ++it;
-        }
+      // EPIPE means it's disconnected
+      if (err == rtErrorFromErrno(EPIPE) || err == RT_ERROR_STREAM_CLOSED)
+      {
+        rtLogInfo("removing entry from remote client");
+        it = ev->entries.erase(it);
+      }
+      else if (e.emitOnce)
+      {
+        it = ev->entries.erase(it);
       }
       else
       {
@@ -241,16 +327,27 @@ rtError rtEmit::SendAsync(int numArgs, const rtValue* args)
 // function to process pending events to get deleted or added
 void rtEmit::processPendingEvents()
 {
-  vector<_rtEmitEntry>::iterator it = mEntries.begin();
-  while (it != mEntries.end())
+  // only walk the listeners when something was marked during a send
+  if (mPendingDeletes)
   {
-    if (true == it->markForDelete)
-    {
-      it = mEntries.erase(it);
-    }
-    else
+    mPendingDeletes = false;
+    for (vector<_rtEmitEvent*>::iterator ev = mEvents.begin(); ev != mEvents.end(); ev++)
     {
-      ++it;
+      if (!*ev)
+        continue;
+      vector<_rtEmitEntry>& entries = (*ev)->entries;
+      vector<_rtEmitEntry>::iterator it = entries.begin();
+      while (it != entries.end())
+      {
+        if (true == it->markForDelete)
+        {
+          it = entries.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
     }
   }
 
@@ -258,42 +355,41 @@ void rtEmit::processPendingEvents()
   while (pendingit != mPendingEntriesToAdd.end())
   {
     _rtEmitEntry& src = (*pendingit);
-    _rtEmitEntry dest;
-    dest.n = src.n;
-    dest.f = src.f;
-    dest.isProp = src.isProp;
-    dest.markForDelete = src.markForDelete;
-    dest.fnHash = src.fnHash;
-    dest.emitOnce = src.emitOnce;
-
-    mEntries.push_back(dest);
+    addEvent(src.n->name)->entries.push_back(src);
     ++pendingit;
   }
   mPendingEntriesToAdd.clear();
 }
 
+rtError rtEmit::clearListeners()
+{
+  for (vector<_rtEmitEvent*>::iterator ev = mEvents.begin(); ev != mEvents.end(); ev++)
+  {
+    if (*ev)
+      (*ev)->entries.clear();
+  }
+  return RT_OK;
+}
+
 rtError rtEmit::clearListeners(const char* eventName)
 {
   if (!eventName)
     return RT_ERROR;
 
-  vector<_rtEmitEntry>::iterator it = mEntries.begin();
-  while (it != mEntries.end())
+  _rtEmitEvent* ev = findEvent(eventName);
+  if (!ev)
+    return RT_OK;
+
+  vector<_rtEmitEntry>::iterator it = ev->entries.begin();
+  while (it != ev->entries.end())
   {
-    _rtEmitEntry& e = (*it);
-    if (e.n == eventName)
-    {
-      // if no events is being processed currently, remove the event entries
-      if (!mProcessingEvents)
-        it = mEntries.erase(it);
-      else
-      {
-        it->markForDelete = true;
-        ++it;
-      }
-    }
+    // if no events is being processed currently, remove the event entries
+    if (!mProcessingEvents)
+      it = ev->entries.erase(it);
     else
     {
+      it->markForDelete = true;
+      mPendingDeletes = true;
       ++it;
     }
   }
@@ -366,16 +462,42 @@ rtError rtArrayObject::Set(uint32_t i, const rtValue* value)
 }
 
 // rtMapObject
+// maps up to this size are searched linearly
+#define RT_MAP_INDEX_THRESHOLD 8
+
 vector<rtNamedValue>::iterator rtMapObject::find(const char* name)
 {
-  vector<rtNamedValue>::iterator it = mProps.begin(); 
-  while(it != mProps.end())
+  if (mIndex.empty())
+  {
+    vector<rtNamedValue>::iterator it = mProps.begin(); 
+    while(it != mProps.end())
+    {
+      if (it->n == name)
+        return it;
+      it++;
+    }
+    return it;
+  }
+
+  uint32_t h = rtAtomHash(name);
+  uint32_t mask = static_cast<uint32_t>(mIndex.size()) - 1;
+  for (uint32_t i = h & mask; mIndex[i].index; i = (i + 1) & mask)
   {
-    if (it->n == name)
-      return it;
-    it++;
+    if (mIndex[i].hash == h && mProps[mIndex[i].index-1].n == name)
+      return mProps.begin() + (mIndex[i].index-1);
   }
-  return it;
+  return mProps.end();
+}
+
+void rtMapObject::indexProp(uint32_t i)
+{
+  uint32_t mask = static_cast<uint32_t>(mIndex.size()) - 1;
+  uint32_t h = rtAtomHash(mProps[i].n.cString());
+  uint32_t slot = h & mask;
+  while (mIndex[slot].index)
+    slot = (slot + 1) & mask;
+  mIndex[slot].hash = h;
+  mIndex[slot].index = i + 1;
 }
 
 rtError rtMapObject::Get(const char* name, rtValue* value) const
@@ -431,6 +553,21 @@ rtError rtMapObject::Set(const char* name, const rtValue* value)
     v.n = name;
     v.v = *value;
     mProps.push_back(v);
+
+    uint32_t count = static_cast<uint32_t>(mProps.size());
+    if (count > RT_MAP_INDEX_THRESHOLD && count * 2 > mIndex.size())
+    {
+      // (re)build the index at no more than half full
+      uint32_t size = 32;
+      while (size < count * 4)
+        size *= 2;
+      rtMapIndexSlot empty = { 0, 0 };
+      mIndex.assign(size, empty);
+      for (uint32_t i = 0; i < count; i++)
+        indexProp(i);
+    }
+    else if (!mIndex.empty())
+      indexProp(count - 1);
     return RT_OK;
   }
   return RT_PROP_NOT_FOUND;
@@ -469,6 +606,157 @@ rtError rtObject::init()
   return RT_OK;
 }
 
+// Atoms and method tables
+
+static std::mutex sAtomMutex;
+static std::mutex sMethodTableMutex;
+static std::mutex sFunctionCacheMutex;
+
+uint32_t rtAtomHash(const char* name)
+{
+  // FNV-1a
+  uint32_t h = 2166136261u;
+  for (const unsigned char* p = (const unsigned char*)name; *p; p++)
+  {
+    h ^= *p;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+uint32_t rtAtomHash(const char* name, uint32_t length)
+{
+  // FNV-1a over the first length bytes, which may include NULs
+  uint32_t h = 2166136261u;
+  for (const unsigned char* p = (const unsigned char*)name; length > 0; p++, length--)
+  {
+    h ^= *p;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+rtAtom rtAtomIntern(const char* name)
+{
+  // atoms live for the life of the process and are never destroyed
+  static map<string, rtAtomEntry>* atoms = new map<string, rtAtomEntry>;
+
+  if (!name)
+    return NULL;
+
+  std::lock_guard<std::mutex> lock(sAtomMutex);
+  map<string, rtAtomEntry>::iterator it = atoms->find(name);
+  if (it == atoms->end())
+  {
+    it = atoms->insert(make_pair(string(name), rtAtomEntry())).first;
+    it->second.name = it->first.c_str();
+    it->second.hash = rtAtomHash(name);
+  }
+  return &it->second;
+}
+
+static rtMethodSlot* rtMethodTableSlot(rtMethodTable* t, rtAtom atom)
+{
+  uint32_t i = atom->hash & t->mMask;
+  while (t->mSlots[i].atom && t->mSlots[i].atom != atom)
+    i = (i + 1) & t->mMask;
+  return &t->mSlots[i];
+}
+
+rtMethodTable* rtMethodTable::forMap(rtMethodMap* map)
+{
+  rtMethodTable* t = map->table.load(std::memory_order_acquire);
+  if (t)
+    return t;
+
+  std::lock_guard<std::mutex> lock(sMethodTableMutex);
+  t = map->table.load(std::memory_order_relaxed);
+  if (t)
+    return t;
+
+  uint32_t count = 0;
+  for (rtMethodMap* m = map; m; m = m->parentsMap)
+  {
+    for (rtPropertyEntry* e = m->getFirstProperty(); e; e = e->mNext)
+      count++;
+    for (rtMethodEntry* e = m->getFirstMethod(); e; e = e->mNext)
+      count++;
+  }
+
+  // keep the load factor at or below one half
+  uint32_t size = 8;
+  while (size < count * 2)
+    size *= 2;
+
+  t = new rtMethodTable;
+  rtMethodSlot empty = {NULL, NULL, NULL};
+  t->mSlots.assign(size, empty);
+  t->mMask = size - 1;
+
+  // walk from the most derived class so the first entry for a name wins
+  for (rtMethodMap* m = map; m; m = m->parentsMap)
+  {
+    for (rtPropertyEntry* e = m->getFirstProperty(); e; e = e->mNext)
+    {
+      rtAtom atom = rtAtomIntern(e->mPropertyName);
+      rtMethodSlot* s = rtMethodTableSlot(t, atom);
+      s->atom = atom;
+      if (!s->property)
+        s->property = e;
+    }
+    for (rtMethodEntry* e = m->getFirstMethod(); e; e = e->mNext)
+    {
+      rtAtom atom = rtAtomIntern(e->mMethodName);
+      rtMethodSlot* s = rtMethodTableSlot(t, atom);
+      s->atom = atom;
+      if (!s->method)
+        s->method = e;
+    }
+  }
+
+  map->table.store(t, std::memory_order_release);
+  return t;
+}
+
+const rtMethodSlot* rtMethodTable::find(const char* name) const
+{
+  uint32_t i = rtAtomHash(name) & mMask;
+  while (mSlots[i].atom)
+  {
+    if (strcmp(mSlots[i].atom->name, name) == 0)
+      return &mSlots[i];
+    i = (i + 1) & mMask;
+  }
+  return NULL;
+}
+
+const rtMethodSlot* rtMethodTable::find(rtAtom atom) const
+{
+  uint32_t i = atom->hash & mMask;
+  while (mSlots[i].atom)
+  {
+    if (mSlots[i].atom == atom)
+      return &mSlots[i];
+    i = (i + 1) & mMask;
+  }
+  return NULL;
+}
+
+// The atom getByAtom/setByAtom are looking up on this thread.  They go
+// through the virtual Get/Set so overrides see every access; when the
+// name reaches rtObject::Get/Set unchanged the atom is used instead of
+// hashing the name again.
+static thread_local rtAtom sLookupAtom = NULL;
+
+const rtMethodSlot* rtObject::findSlot(const char* name) const
+{
+  rtMethodTable* t = rtMethodTable::forMap(getMap());
+  rtAtom atom = sLookupAtom;
+  if (atom && atom->name == name)
+    return t->find(atom);
+  return t->find(name);
+}
+
 rtError rtObject::Get(uint32_t /*i*/, rtValue* /*value*/) const
 {
   return RT_PROP_NOT_FOUND;
@@ -476,51 +764,83 @@ rtError rtObject::Get(uint32_t /*i*/, rtValue* /*value*/) const
 
 rtError rtObject::Get(const char* name, rtValue* value) const
 {
-  rtError hr = RT_PROP_NOT_FOUND;
-  rtMethodMap* m = getMap();
-  
-  while(m) 
+  const rtMethodSlot* slot = findSlot(name);
+  if (!slot)
   {
-    rtPropertyEntry* e = m->getFirstProperty();
-    while(e) 
+    rtLogDebug("key: %s not found", name);
+    return RT_PROP_NOT_FOUND;
+  }
+  return getSlot(slot, value);
+}
+
+rtError rtObject::getByAtom(rtAtom name, rtValue* value) const
+{
+  rtAtom outer = sLookupAtom;
+  sLookupAtom = name;
+  rtError e = Get(name->name, value);
+  sLookupAtom = outer;
+  return e;
+}
+
+rtError rtObject::getSlot(const rtMethodSlot* slot, rtValue* value) const
+{
+  if (slot->property)
+  {
+    rtGetPropertyThunk t = slot->property->mGetThunk;
+    return (*this.*t)(*value);
+  }
+
+  rtLogDebug("found method: %s", slot->atom->name);
+  methodFunction(slot->method, value);
+  return RT_OK;
+}
+
+// Hands out one rtObjectFunction per (object, method) for as long as
+// anybody holds on to it, instead of allocating one per lookup
+void rtObject::methodFunction(const rtMethodEntry* entry, rtValue* value) const
+{
+  rtObjectFunction* f = NULL;
+  {
+    std::lock_guard<std::mutex> lock(sFunctionCacheMutex);
+    if (!mFunctions)
+      mFunctions = new vector<rtObjectFunction*>;
+    for (vector<rtObjectFunction*>::iterator it = mFunctions->begin(); it != mFunctions->end(); ++it)
     {
-      if (strcmp(name, e->mPropertyName) == 0) 
+      if ((*it)->mEntry == entry)
       {
-        rtGetPropertyThunk t = e->mGetThunk;
-        hr = (*this.*t)(*value);
-        return hr;
+        f = *it;
+        break;
       }
-      e = e->mNext;
     }
-    m = m->parentsMap;
+    if (!f)
+    {
+      f = new rtObjectFunction(this, entry->mThunk);
+      f->mEntry = entry;
+      mFunctions->push_back(f);
+    }
+    // a cached function only leaves mFunctions under this lock, so it
+    // can't be on its way out here
+    f->AddRef();
   }
-  rtLogDebug("key: %s not found", name);
-  
+  value->setFunction(f);
+  f->Release();
+}
+
+unsigned long rtObjectFunction::releaseCached()
+{
+  long l;
   {
-    rtLogDebug("Looking for function as property: %s", name);
-    
-    rtMethodMap* m;
-    m = getMap();
-    
-    while(m)
+    std::lock_guard<std::mutex> lock(sFunctionCacheMutex);
+    l = rtAtomicDec(&mRefCount);
+    if (l == 0)
     {
-      rtMethodEntry* e = m->getFirstMethod();
-      while(e)
-      {
-        if (strcmp(name, e->mMethodName) == 0)
-        {
-          rtLogDebug("found method: %s", name);
-          value->setFunction(new rtObjectFunction(this, e->mThunk));
-          hr = RT_OK;
-          return hr;
-        }
-        e = e->mNext;
-      }
-      
-      m = m->parentsMap;
+      vector<rtObjectFunction*>* functions = mObject->mFunctions;
+      functions->erase(std::find(functions->begin(), functions->end(), this));
     }
   }
-  return hr;
+  // drops the reference on mObject outside of the lock
+  if (l == 0) delete this;
+  return l;
 }
 
 rtError rtObject::Set(uint32_t /*i*/, const rtValue* /*value*/)
@@ -530,37 +850,31 @@ rtError rtObject::Set(uint32_t /*i*/, const rtValue* /*value*/)
 
 rtError rtObject::Set(const char* name, const rtValue* value) 
 {
-  rtError hr = RT_PROP_NOT_FOUND;
-  
-  rtMethodMap* m;
-  m = getMap();
-  
-  while(m) 
+  return setSlot(findSlot(name), name, value);
+}
+
+rtError rtObject::setByAtom(rtAtom name, const rtValue* value)
+{
+  rtAtom outer = sLookupAtom;
+  sLookupAtom = name;
+  rtError e = Set(name->name, value);
+  sLookupAtom = outer;
+  return e;
+}
+
+rtError rtObject::setSlot(const rtMethodSlot* slot, const char* name, const rtValue* value)
+{
+  if (!slot || !slot->property)
+    return RT_PROP_NOT_FOUND;
+
+  if (slot->property->mSetThunk)
   {
-    rtPropertyEntry* e = m->getFirstProperty();
-    while(e) 
-    {
-      if (strcmp(name, e->mPropertyName) == 0) 
-      {
-        if (e->mSetThunk) 
-        {
-          rtSetPropertyThunk t = e->mSetThunk;
-          hr = (*this.*t)(*value);
-        }
-        else
-        {
-          hr = RT_FAIL;
-          rtLogError("setter for %s is missing thunk.", name);
-        }
-        return hr;
-      }
-      e = e->mNext;
-    }
-    
-    m = m->parentsMap;
+    rtSetPropertyThunk t = slot->property->mSetThunk;
+    return (*this.*t)(*value);
   }
-  
-  return hr;
+
+  rtLogError("setter for %s is missing thunk.", name);
+  return RT_FAIL;
 }
 
 // rtObjectBase
@@ -740,7 +1054,11 @@ rtError rtObjectFunction::Send(int numArgs, const rtValue* args, rtValue* result
   return (*mObject.*mThunk)(numArgs, args, *result);
 }
 
-rtObject::~rtObject() {}
+rtObject::~rtObject()
+{
+  // every cached function holds a reference, so there are none left here
+  delete mFunctions;
+}
 
 rtError rtObject::description(rtString& d) const
 {
@@ -264,9 +264,46 @@ class rtFunctionRef: public rtRef<rtIFunction>, public rtFunctionBase
   virtual rtError Send(int numArgs, const rtValue* args, rtValue* result);
 };
 
+// Interned property and method name.  Interning the same string always
+// returns the same atom, so bindings can intern a name once and reuse the
+// atom (and its precomputed hash) for every lookup of that name.
+struct rtAtomEntry
+{
+  const char* name;
+  uint32_t hash;
+};
+typedef const rtAtomEntry* rtAtom;
+
+rtAtom rtAtomIntern(const char* name);
+uint32_t rtAtomHash(const char* name);
+uint32_t rtAtomHash(const char* name, uint32_t length);
+
+// A property and/or method reachable from an rtMethodMap.  Derived
+// classes shadow their parents and, as with the old list walk, a property
+// is preferred over a method of the same name.
+struct rtMethodSlot
+{
+  rtAtom atom;
+  rtPropertyEntry* property;
+  rtMethodEntry* method;
+};
+
+// Open addressed table over every property and method of a class,
+// inherited ones included.  Built once per rtMethodMap on first lookup.
+struct rtMethodTable
+{
+  static rtMethodTable* forMap(rtMethodMap* m);
+
+  const rtMethodSlot* find(const char* name) const;
+  const rtMethodSlot* find(rtAtom atom) const;
+
+  std::vector<rtMethodSlot> mSlots; // power of two sized, free slots have a NULL atom
+  uint32_t mMask;
+};
+
 class rtObjectFunction: public rtIFunction, public rtFunctionBase {
 public:
-  rtObjectFunction(const rtObject* o, rtMethodThunk t): mRefCount(0) 
+  rtObjectFunction(const rtObject* o, rtMethodThunk t): mEntry(NULL), mRefCount(0) 
   {
     mObject = o;
     mThunk = t;
@@ -276,6 +313,8 @@ public:
   virtual unsigned long AddRef() { return rtAtomicInc(&mRefCount); }
   virtual unsigned long Release() 
   {
+    if (mEntry)
+      return releaseCached();
     long l = rtAtomicDec(&mRefCount);
     if (l == 0) delete this;
     return l;
@@ -293,9 +332,14 @@ public:
 
  private:
   virtual rtError Send(int numArgs, const rtValue* args, rtValue* result);
+  unsigned long releaseCached();
+
+  friend class rtObject;
 
   rtRef<rtObject> mObject;
   rtMethodThunk mThunk;
+  // set when the function is cached on mObject, see rtObject::methodFunction
+  const rtMethodEntry* mEntry;
   unsigned long mRefCount;
 };
 
@@ -310,7 +354,7 @@ public:
   rtMethodNoArgAndReturn("description", description, rtString);
   rtReadOnlyProperty(allKeys, allKeys, rtObjectRef);
   
-  rtObject(): mInitialized(false), mRefCount(0) { }
+  rtObject(): mInitialized(false), mRefCount(0), mFunctions(NULL) { }
   virtual ~rtObject();
   
   virtual unsigned long /*__stdcall*/ AddRef();
@@ -331,9 +375,25 @@ public:
   virtual rtError Set(uint32_t i, const rtValue* value);
   virtual rtError Set(const char* name, const rtValue* value);
 
+  // Get/Set by an interned name.  They call the virtual Get/Set, and a
+  // declared property or method reached through rtObject::Get/Set is found
+  // without hashing or comparing the name.
+  rtError getByAtom(rtAtom name, rtValue* value) const;
+  rtError setByAtom(rtAtom name, const rtValue* value);
+
 protected:
+  const rtMethodSlot* findSlot(const char* name) const;
+  rtError getSlot(const rtMethodSlot* slot, rtValue* value) const;
+  rtError setSlot(const rtMethodSlot* slot, const char* name, const rtValue* value);
+  void methodFunction(const rtMethodEntry* entry, rtValue* value) const;
+
+  friend class rtObjectFunction;
+
   bool mInitialized;
   rtAtomic mRefCount;
+  // bound functions handed out for this object's methods; each holds a
+  // reference to the object and removes itself when released
+  mutable std::vector<rtObjectFunction*>* mFunctions;
 };
 
 #if 0
@@ -659,8 +719,9 @@ class rtEmit: public rtIFunction
 {
 
 public:
-  rtEmit(): mRefCount(0), mProcessingEvents(false), mPendingEntriesToAdd() {}
-  virtual ~rtEmit() {}
+  rtEmit(): mRefCount(0), mProcessingEvents(false), mPendingEntriesToAdd(),
+            mEventCount(0), mPendingDeletes(false) {}
+  virtual ~rtEmit();
 
   virtual unsigned long AddRef();
   virtual unsigned long Release();
@@ -670,9 +731,12 @@ public:
   rtError addListener(const char* eventName, rtIFunction* f, bool emitOnce);
   rtError delListener(const char* eventName, rtIFunction* f);
 
-  rtError clearListeners() {mEntries.clear(); return RT_OK;}
+  rtError clearListeners();
   rtError clearListeners(const char* eventName);
 
+  size_t listenerCount() const;
+  size_t listenerCount(const char* eventName) const;
+
   virtual rtError Send(int numArgs,const rtValue* args,rtValue* result);
   virtual rtError SendAsync(int numArgs, const rtValue* args);
 
@@ -688,23 +752,40 @@ public:
 
 
 private:
+  rtEmit(const rtEmit&);
+  rtEmit& operator=(const rtEmit&);
+
   void processPendingEvents();
 
 protected:
   struct _rtEmitEntry
   {
-    rtString n;
+    rtAtom n;
     rtFunctionRef f;
     bool isProp;
     bool markForDelete;
     size_t fnHash;
     bool emitOnce;
   };
+
+  // The listeners for one event name, in the order they were added
+  struct _rtEmitEvent
+  {
+    rtAtom n;
+    std::vector<_rtEmitEntry> entries;
+  };
+
+  _rtEmitEvent* findEvent(const char* eventName) const;
+  _rtEmitEvent* addEvent(const char* eventName);
   
-  std::vector<_rtEmitEntry> mEntries;
   rtAtomic mRefCount;
   bool mProcessingEvents;
   std::vector<_rtEmitEntry> mPendingEntriesToAdd;
+  // open addressed on the event name hash, power of two sized; events
+  // are kept once created so pointers to them stay valid during a Send
+  std::vector<_rtEmitEvent*> mEvents;
+  uint32_t mEventCount;
+  bool mPendingDeletes;
 };
 
 class rtEmitRef: public rtRef<rtEmit>, public rtFunctionBase
@@ -767,8 +848,20 @@ public:
   virtual rtError Set(uint32_t /*i*/, const rtValue* /*value*/);
 
 private:
+  // index is one based into mProps, zero marks a free slot
+  struct rtMapIndexSlot
+  {
+    uint32_t hash;
+    uint32_t index;
+  };
+
   std::vector<rtNamedValue>::iterator find(const char* name);
+  void indexProp(uint32_t i);
+
   std::vector<rtNamedValue> mProps;
+  // hash index over mProps, built once the map outgrows a linear scan;
+  // mProps keeps insertion order for allKeys
+  std::vector<rtMapIndexSlot> mIndex;
 };
 
 #endif
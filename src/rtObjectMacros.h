@@ -21,6 +21,8 @@
 #ifndef RT_OBJECT_MACROS_H
 #define RT_OBJECT_MACROS_H
 
+#include <atomic>
+
 #define __UNUSED(x)  ((x)=(x))
 
 class rtObject;
@@ -58,6 +60,8 @@ typedef struct rtPropertyEntry
     rtPropertyEntry* mNext;
 } rtPropertyEntry;
 
+struct rtMethodTable;
+
 typedef rtMethodEntry* (*fnhead)(rtMethodEntry* p);
 typedef rtPropertyEntry* (*fnPropHead)(rtPropertyEntry* p);
 
@@ -69,6 +73,10 @@ typedef struct rtMethodMap
   
   //unsigned long numEntries;
   rtMethodMap* parentsMap;
+
+  // flattened lookup table over this class and its parents; built on
+  // first use by rtMethodTable::forMap
+  std::atomic<rtMethodTable*> table;
   
   rtMethodEntry* getFirstMethod()
   {
@@ -139,7 +147,7 @@ int class::rtPropertyCount = sizeof(class::rtPropertyEntries)/sizeof(rtPropertyE
 	typedef rtObject PARENTTYPE__
 
 #define rtDefineObjectPtr(CLASSNAME__, PTR__)                           \
-    rtMethodMap CLASSNAME__::map = {"" #CLASSNAME__ "", CLASSNAME__::head, CLASSNAME__::headProperty, PTR__};
+    rtMethodMap CLASSNAME__::map = {"" #CLASSNAME__ "", CLASSNAME__::head, CLASSNAME__::headProperty, PTR__, {NULL}};
 
 #define rtDefineObject(CLASSNAME__, PARENT__)                           \
     rtDefineObjectPtr(CLASSNAME__, &PARENT__::map)
@@ -48,17 +48,16 @@ static duk_ret_t dukFunctionStub(duk_context *ctx)
 
   int numArgs = duk_get_top(ctx);
 
-  assert(numArgs < 16);
-  rtValue args[16];
+  rtValueList<16> args;
 
   for (int i = 0; i < numArgs; ++i) {
     duk_dup(ctx, i);
-    args[i] = duk2rt(ctx);
+    args.push_back(duk2rt(ctx));
     duk_pop(ctx);
   }
 
   rtValue result;
-  func->Send(numArgs, args, &result);
+  func->Send(args.size(), args.data(), &result);
   if (!result.isEmpty()) {
     rt2duk(ctx, result);
     return 1;
@@ -42,7 +42,7 @@ void rtSetupJsModuleBindings(duk_context *ctx)
   rtRegisterJsBinding(ctx, "httpGet", &rtHttpGetBinding);
 }
 
-class rtHttpResponse : public rtObject
+class rtHttpResponse : public rtObject, public rtFileDownloadSink
 {
 public:
   rtDeclareObject(rtHttpResponse, rtObject);
@@ -59,7 +59,7 @@ public:
   rtError addListener(rtString eventName, const rtFunctionRef& f) { mEmit->addListener(eventName, f); return RT_OK;  }
 
   static void onDownloadComplete(rtFileDownloadRequest* downloadRequest);
-  static size_t onDownloadInProgress(void *ptr, size_t size, size_t nmemb, void *userData);
+  virtual bool onDownloadData(rtFileDownloadRequest* downloadRequest, const char* data, size_t size);
 
 private:
   int32_t mStatusCode;
@@ -82,14 +82,12 @@ void rtHttpResponse::onDownloadComplete(rtFileDownloadRequest* downloadRequest)
   resp->mEmit.send(resp->mErrorMessage.isEmpty() ? "end" : "error", (rtIObject *)resp);
 }
 
-size_t rtHttpResponse::onDownloadInProgress(void *ptr, size_t size, size_t nmemb, void *userData)
+bool rtHttpResponse::onDownloadData(rtFileDownloadRequest* /*downloadRequest*/, const char* data, size_t size)
 {
-  rtHttpResponse* resp = (rtHttpResponse*)userData;
-
-  if (size * nmemb > 0) {
-    resp->mEmit.send("data", rtString((const char *)ptr, size*nmemb));
+  if (size > 0) {
+    mEmit.send("data", rtString(data, size));
   }
-  return 0;
+  return true;
 }
 
 rtError rtHttpGetBinding(int numArgs, const rtValue* args, rtValue* result, void* context)
@@ -110,7 +108,8 @@ rtError rtHttpGetBinding(int numArgs, const rtValue* args, rtValue* result, void
   args[1].toFunction().send(resp);
 
   rtFileDownloadRequest *downloadRequest = new rtFileDownloadRequest(args[0].toString(), resp.getPtr(), rtHttpResponse::onDownloadComplete);
-  downloadRequest->setDownloadProgressCallbackFunction(rtHttpResponse::onDownloadInProgress, resp.getPtr());
+  // the body only goes out as "data" events, so it isn't buffered as well
+  downloadRequest->setDownloadSink((rtHttpResponse*)resp.getPtr(), false);
   rtFileDownloader::instance()->addToDownloadQueue(downloadRequest);
   
   *result = resp;
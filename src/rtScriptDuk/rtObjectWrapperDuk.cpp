@@ -52,9 +52,10 @@ rtObjectWrapper::~rtObjectWrapper()
 
 struct dukObjectFunctionInfo
 {
-  dukObjectFunctionInfo(void) : mIsVoid(true), mType(dukObjectFunctionInfo::eMethod), mNext(NULL) {}
+  dukObjectFunctionInfo(void) : mAtom(NULL), mIsVoid(true), mType(dukObjectFunctionInfo::eMethod), mNext(NULL) {}
 
   std::string mMethodName;
+  rtAtom      mAtom;
   bool        mIsVoid;
 
   enum eType {
@@ -99,7 +100,7 @@ static duk_ret_t dukObjectMethodGetStub(duk_context *ctx)
   if (funcInfo->mType == dukObjectFunctionInfo::eGetProp)
   {
     rtValue val;
-    obj->Get(funcInfo->mMethodName.c_str(), &val);
+    obj->getByAtom(funcInfo->mAtom, &val);
     rt2duk(ctx, val);
     return 1;
   }
@@ -109,30 +110,29 @@ static duk_ret_t dukObjectMethodGetStub(duk_context *ctx)
     duk_dup(ctx, 0);
     rtValue val = duk2rt(ctx);
     duk_pop(ctx);
-    obj->Set(funcInfo->mMethodName.c_str(), &val);
+    obj->setByAtom(funcInfo->mAtom, &val);
     return 0;
   }
 
   assert(funcInfo->mType == dukObjectFunctionInfo::eMethod);
 
-  assert(numArgs < 16);
-  rtValue args[16];
+  rtValueList<16> args;
 
   for (int i = 0; i < numArgs; ++i)
   {
     duk_dup(ctx, i);
-    args[i] = duk2rt(ctx);
+    args.push_back(duk2rt(ctx));
     duk_pop(ctx);
   }
 
   rtValue func;
-  obj->Get(funcInfo->mMethodName.c_str(), &func);
+  obj->getByAtom(funcInfo->mAtom, &func);
 
   assert(func.getType() == RT_functionType);
   rtFunctionRef funcObj = func.toFunction();
 
   rtValue result;
-  funcObj->Send(numArgs, &args[0], &result);
+  funcObj->Send(args.size(), args.data(), &result);
 
   if (funcInfo->mIsVoid) {
     return 0;
@@ -176,6 +176,7 @@ static void wrapObjToDuk(duk_context *ctx, const rtObjectRef& ref)
       {
         dukObjectFunctionInfo *funcInfo = new dukObjectFunctionInfo();
         funcInfo->mMethodName = e->mMethodName;
+        funcInfo->mAtom = rtAtomIntern(e->mMethodName);
         funcInfo->mIsVoid = e->mReturnType == RT_voidType;
         funcInfo->mType = dukObjectFunctionInfo::eMethod;
 
@@ -212,6 +213,7 @@ static void wrapObjToDuk(duk_context *ctx, const rtObjectRef& ref)
         {
           dukObjectFunctionInfo *funcInfo = new dukObjectFunctionInfo();
           funcInfo->mMethodName = e->mPropertyName;
+          funcInfo->mAtom = rtAtomIntern(e->mPropertyName);
           funcInfo->mIsVoid = false;
           funcInfo->mType = dukObjectFunctionInfo::eGetProp;
 
@@ -231,6 +233,7 @@ static void wrapObjToDuk(duk_context *ctx, const rtObjectRef& ref)
         {
           dukObjectFunctionInfo *funcInfo = new dukObjectFunctionInfo();
           funcInfo->mMethodName = e->mPropertyName;
+          funcInfo->mAtom = rtAtomIntern(e->mPropertyName);
           funcInfo->mIsVoid = false;
           funcInfo->mType = dukObjectFunctionInfo::eSetProp;
 
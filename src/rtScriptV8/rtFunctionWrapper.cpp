@@ -239,7 +239,7 @@ void rtFunctionWrapper::call(const FunctionCallbackInfo<Value>& args)
   // rtLogInfo("id: %u", GetContextId(ctx));
   Context::Scope contextScope(ctx);
 
-  std::vector<rtValue> argList;
+  rtValueList<8> argList;
   for (int i = 0; i < args.Length(); ++i)
   {
     argList.push_back(js2rt(ctx, args[i], &error));
@@ -249,7 +249,7 @@ void rtFunctionWrapper::call(const FunctionCallbackInfo<Value>& args)
 
   rtValue result;
   rtWrapperSceneUpdateEnter();
-  rtError err = unwrap(args)->Send(args.Length(), &argList[0], &result);
+  rtError err = unwrap(args)->Send(argList.size(), argList.data(), &result);
 
   if (err != RT_OK)
   {
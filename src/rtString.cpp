@@ -19,6 +19,7 @@
 // rtString.h
 
 #include "rtString.h"
+#include "rtAtomic.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -29,16 +30,28 @@ extern "C"
 #include "utf8.h"
 }
 
-rtString::rtString(): mData(NULL) {}
+static rtAtomic sBufferAllocations = 0;
 
-rtString::rtString(const char* s): mData(NULL)
+uint32_t rtString::bufferAllocations()
 {
+  return (uint32_t)sBufferAllocations;
+}
+
+rtString::rtString(): mLength(0), mHeap(false)
+{
+  mInline[0] = 0;
+}
+
+rtString::rtString(const char* s): mLength(0), mHeap(false)
+{
+  mInline[0] = 0;
   if (s)
-    mData = strdup(s);
+    assign(s, (uint32_t)strlen(s));
 }
 
-rtString::rtString(const char* s, uint32_t byteLen): mData(NULL)
+rtString::rtString(const char* s, uint32_t byteLen): mLength(0), mHeap(false)
 {
+  mInline[0] = 0;
   if (s)
   {
     init(s, byteLen);
@@ -47,73 +60,187 @@ rtString::rtString(const char* s, uint32_t byteLen): mData(NULL)
 
 rtString& rtString::init(const char* s, size_t byteLen)
 {
-  mData = NULL;
-  
   if (s)
   {
-    mData = (char*)malloc(byteLen+1);
-    memcpy(mData, s, byteLen);
-    mData[byteLen] = 0; // null terminate
+    // stop at an embedded terminator, like the strlen based byteLength did
+    const char* end = (const char*)memchr(s, 0, byteLen);
+    assign(s, (uint32_t)(end?end-s:byteLen));
   }
+  else
+    term();
 
   return *this;
 }
 
-rtString::rtString(const rtString& s): mData(NULL)
+rtString::rtString(const rtString& s): mLength(s.mLength), mHeap(s.mHeap)
+{
+  if (mHeap)
+  {
+    mBuffer = s.mBuffer;
+    rtAtomicInc(&mBuffer->mRefCount);
+  }
+  else
+    memcpy(mInline, s.mInline, mLength+1);
+}
+
+rtString::rtString(rtString&& s): mLength(s.mLength), mHeap(s.mHeap)
 {
-  if (s.mData)
-    mData = strdup(s.mData);
+  if (mHeap)
+    mBuffer = s.mBuffer;
+  else
+    memcpy(mInline, s.mInline, mLength+1);
+  s.mInline[0] = 0;
+  s.mLength = 0;
+  s.mHeap = false;
 }
 
 rtString& rtString::operator=(const rtString& s) 
 {
   if (this != &s)
   {
-    term();
-    if (s.mData)
-      mData = strdup(s.mData);
+    if (s.mHeap)
+    {
+      rtAtomicInc(&s.mBuffer->mRefCount);
+      term();
+      mBuffer = s.mBuffer;
+      mHeap = true;
+      mLength = s.mLength;
+    }
+    else
+      assign(s.mInline, s.mLength);
   }
   return *this;
 }
 
-rtString& rtString::operator=(const char* s) 
+rtString& rtString::operator=(rtString&& s)
 {
-  if (s != mData)
+  if (this != &s)
   {
     term();
-    if (s)
-      mData = strdup(s);
+    mLength = s.mLength;
+    mHeap = s.mHeap;
+    if (mHeap)
+      mBuffer = s.mBuffer;
+    else
+      memcpy(mInline, s.mInline, mLength+1);
+    s.mInline[0] = 0;
+    s.mLength = 0;
+    s.mHeap = false;
   }
   return *this;
 }
 
+rtString& rtString::operator=(const char* s) 
+{
+  if (s)
+    assign(s, (uint32_t)strlen(s));
+  else
+    term();
+  return *this;
+}
+
+// s may point into this string's own storage
+void rtString::assign(const char* s, uint32_t byteLen)
+{
+  rtStringBuffer* old = mHeap?mBuffer:NULL;
+
+  if (byteLen <= kInlineCapacity)
+  {
+    memmove(mInline, s, byteLen);
+    mInline[byteLen] = 0;
+    mHeap = false;
+  }
+  else if (old && old->mRefCount == 1 && byteLen <= old->mCapacity)
+  {
+    memmove(old->mData, s, byteLen);
+    old->mData[byteLen] = 0;
+    old->mCharLength = -1;
+    old = NULL;
+  }
+  else
+  {
+    rtStringBuffer* b = (rtStringBuffer*)malloc(sizeof(rtStringBuffer)+byteLen);
+    rtAtomicInc(&sBufferAllocations);
+    b->mRefCount = 1;
+    b->mCapacity = byteLen;
+    b->mCharLength = -1;
+    memcpy(b->mData, s, byteLen);
+    b->mData[byteLen] = 0;
+    mBuffer = b;
+    mHeap = true;
+  }
+  mLength = byteLen;
+
+  if (old)
+    releaseBuffer(old);
+}
+
+void rtString::releaseBuffer(rtStringBuffer* b)
+{
+  if (rtAtomicDec(&b->mRefCount) == 0)
+    free(b);
+}
+
 bool rtString::isEmpty() const
 {
-  return (!mData || !(*mData));
+  return mLength == 0;
 }
 
 rtString::~rtString() { term(); }
 
 void rtString::term() 
 {
-  if (mData)
-    free(mData);
-  mData = 0;
+  if (mHeap)
+    releaseBuffer(mBuffer);
+  mHeap = false;
+  mInline[0] = 0;
+  mLength = 0;
 }
 
 rtString& rtString::append(const char* s)
 {
-  size_t sl = s?strlen(s):0;
-  size_t dl = mData?strlen(mData):0;
-  mData = (char*)realloc((void*)mData, dl+sl+1);
-  strcpy(mData+dl, s?s:"");
+  uint32_t sl = s?(uint32_t)strlen(s):0;
+  if (sl == 0)
+    return *this;
+
+  uint32_t len = mLength+sl;
+  if (!mHeap && len <= kInlineCapacity)
+  {
+    memcpy(mInline+mLength, s, sl);
+    mInline[len] = 0;
+  }
+  else if (mHeap && mBuffer->mRefCount == 1 && len <= mBuffer->mCapacity)
+  {
+    memcpy(mBuffer->mData+mLength, s, sl);
+    mBuffer->mData[len] = 0;
+    mBuffer->mCharLength = -1;
+  }
+  else
+  {
+    // grow geometrically so repeated appends stay linear; s may point into
+    // the old storage, which is only released once the copy is done
+    uint32_t capacity = len + len/2;
+    rtStringBuffer* b = (rtStringBuffer*)malloc(sizeof(rtStringBuffer)+capacity);
+    rtAtomicInc(&sBufferAllocations);
+    b->mRefCount = 1;
+    b->mCapacity = capacity;
+    b->mCharLength = -1;
+    memcpy(b->mData, cString(), mLength);
+    memcpy(b->mData+mLength, s, sl);
+    b->mData[len] = 0;
+    if (mHeap)
+      releaseBuffer(mBuffer);
+    mBuffer = b;
+    mHeap = true;
+  }
+  mLength = len;
   
   return *this;
 }
 
 int rtString::compare(const char* s) const 
 {
-  const char *d = mData?mData:"";
+  const char *d = cString();
   s = s?s:"";
  
   u_int32_t c1, c2;
@@ -128,20 +255,19 @@ int rtString::compare(const char* s) const
   return c1==c2?0:c1<c2?-1:1;
 }
 
-
-const char* rtString::cString() const 
-{
-  return mData?mData:"";
-}
-
 int32_t rtString::length() const 
 {
-  return mData?u8_strlen(mData):0;
+  if (!mHeap)
+    return u8_strlen((char*)mInline);
+  // a shared buffer is immutable, so its count can be kept with it
+  if (mBuffer->mCharLength < 0)
+    mBuffer->mCharLength = u8_strlen(mBuffer->mData);
+  return mBuffer->mCharLength;
 }
 
 int32_t rtString::byteLength() const 
 {
-  return (int32_t)(mData?strlen(mData):0);
+  return (int32_t)mLength;
 }
 
 bool rtString::beginsWith(const char* s) const
@@ -153,7 +279,7 @@ bool rtString::beginsWith(const char* s) const
 bool rtString::endsWith(const char* s) const
 {
   s = s?s:"";
-  const char* t = mData?mData:"";
+  const char* t = cString();
   int sl = u8_strlen((char*)s);
   int tl = u8_strlen((char*)t);
 
@@ -173,20 +299,21 @@ int32_t rtString::find(size_t pos, const char* str) const
   int needle = 0;
   size_t haystackPos = 0;
   char* s = (char*)str;
+  char* data = (char*)cString();
 
   old = haystack;
-  uint32_t haystackChar = u8_nextchar(mData, &haystack);
-  for(;haystackChar && (haystackPos < pos);old=haystack,haystackChar=u8_nextchar(mData,&haystack),++haystackPos)
+  uint32_t haystackChar = u8_nextchar(data, &haystack);
+  for(;haystackChar && (haystackPos < pos);old=haystack,haystackChar=u8_nextchar(data,&haystack),++haystackPos)
   {
     // skipping
   }
-  for(;haystackChar;old=haystack,haystackChar=u8_nextchar(mData,&haystack),++haystackPos)
+  for(;haystackChar;old=haystack,haystackChar=u8_nextchar(data,&haystack),++haystackPos)
   {
     int h = old;
     int n = needle;
-    uint32_t hChar = u8_nextchar(mData,&h);
+    uint32_t hChar = u8_nextchar(data,&h);
     uint32_t nChar = u8_nextchar(s,&n);
-    for(;hChar && nChar && (hChar==nChar); hChar=u8_nextchar(mData,&h),nChar=u8_nextchar(s,&n))
+    for(;hChar && nChar && (hChar==nChar); hChar=u8_nextchar(data,&h),nChar=u8_nextchar(s,&n))
     {
       // matching
     }
@@ -202,12 +329,13 @@ int32_t rtString::find(size_t pos, const char* str) const
 
 int32_t rtString::find(size_t pos, uint32_t codePoint) const
 {
+  char* data = (char*)cString();
   int i = 0;
   size_t p = 0;
-  u_int32_t c = u8_nextchar(mData, &i);
+  u_int32_t c = u8_nextchar(data, &i);
   while(p < pos && c)
   {
-    c = u8_nextchar(mData, &i);
+    c = u8_nextchar(data, &i);
     p++;
   }
   
@@ -216,7 +344,7 @@ int32_t rtString::find(size_t pos, uint32_t codePoint) const
 
     while(c && c != codePoint)
     {
-      c = u8_nextchar(mData, &i);
+      c = u8_nextchar(data, &i);
       p++;
     }
     if (c == codePoint)
@@ -228,7 +356,7 @@ int32_t rtString::find(size_t pos, uint32_t codePoint) const
 
 rtString rtString::substring(size_t pos, size_t len) const
 {
-  char* s = mData;
+  char* s = (char*)cString();
   if (pos>0)
     s = s + u8_offset(s,(int)pos);
 
@@ -32,6 +32,10 @@
 
 /**
   A lightweight utf-8 string class.
+
+  Strings of up to 23 bytes are stored inline.  Longer strings live in a
+  refcounted heap buffer that copies share; a shared buffer is copied
+  before it is modified.
 */
 class rtString 
 {
@@ -47,10 +51,12 @@ public:
   rtString(const char* s, uint32_t byteLen);
 
   rtString(const rtString& s);
+  rtString(rtString&& s);
   
   ~rtString();
 
   rtString& operator=(const rtString& s);
+  rtString& operator=(rtString&& s);
   rtString& operator=(const char* s);
 
   friend
@@ -98,8 +104,8 @@ public:
   }
 #endif
 
-  const char* cString() const;
-  operator const char* () const { return mData?mData:""; }
+  const char* cString() const { return mHeap?mBuffer->mData:mInline; }
+  operator const char* () const { return cString(); }
 
   //uint32_t operator[](uint32_t i) const {}
 
@@ -122,8 +128,32 @@ public:
   int32_t find(size_t pos, const char* s) const;
   int32_t find(size_t pos, uint32_t codePoint) const;
 
+  /**
+   * The number of heap buffers allocated by all rtStrings so far.
+   */
+  static uint32_t bufferAllocations();
+
 private:
-  char* mData;
+  enum { kInlineCapacity = 23 };
+
+  struct rtStringBuffer
+  {
+    volatile int32_t mRefCount;
+    uint32_t mCapacity;
+    int32_t mCharLength; // utf8 characters, -1 until length() is called
+    char mData[1];
+  };
+
+  void assign(const char* s, uint32_t byteLen);
+  void releaseBuffer(rtStringBuffer* b);
+
+  union
+  {
+    char mInline[kInlineCapacity+1];
+    rtStringBuffer* mBuffer;
+  };
+  uint32_t mLength; // bytes, not counting the terminator
+  bool mHeap;
 };
 
 #endif
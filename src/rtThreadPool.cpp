@@ -20,12 +20,14 @@
 
 #include "rtThreadPool.h"
 
+#include <stdlib.h>
+
 #include <iostream>
 using namespace std;
 
 #define RT_THREAD_POOL_DEFAULT_THREAD_COUNT 6
 
-rtThreadPool* rtThreadPool::mGlobalInstance = new rtThreadPool(RT_THREAD_POOL_DEFAULT_THREAD_COUNT);
+rtThreadPool* rtThreadPool::mGlobalInstance = new rtThreadPool(rtThreadPool::defaultThreadCount());
 
 
 rtThreadPool::rtThreadPool(int numberOfThreads) : rtThreadPoolNative(numberOfThreads)
@@ -44,7 +46,19 @@ rtThreadPool* rtThreadPool::globalInstance()
 {
     if (mGlobalInstance == NULL)
     {
-        mGlobalInstance = new rtThreadPool(RT_THREAD_POOL_DEFAULT_THREAD_COUNT);
+        mGlobalInstance = new rtThreadPool(defaultThreadCount());
     }
     return mGlobalInstance;
 }
+
+int rtThreadPool::defaultThreadCount()
+{
+    const char* s = getenv("RT_THREAD_POOL_THREAD_COUNT");
+    if (s)
+    {
+        int count = atoi(s);
+        if (count > 0)
+            return count;
+    }
+    return RT_THREAD_POOL_DEFAULT_THREAD_COUNT;
+}
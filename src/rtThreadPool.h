@@ -27,13 +27,13 @@ public:
     rtThreadPool(int numberOfThreads);
     ~rtThreadPool();
     
+    // The global pool starts RT_THREAD_POOL_THREAD_COUNT threads when that
+    // is set in the environment
     static rtThreadPool* globalInstance();
-
-	void raisePriority(const rtString & /*url*/) {
-		//TODO
-	};
     
 private:
+    static int defaultThreadCount();
+
     
     static rtThreadPool* mGlobalInstance;
 };
@@ -21,64 +21,206 @@
 #include "rtThreadQueue.h"
 #include "pxTimer.h"
 
+#include <algorithm>
+
 using namespace std;
 
-rtThreadQueue::rtThreadQueue(){}
-rtThreadQueue::~rtThreadQueue() {}
+rtThreadQueue::rtThreadQueue():
+  mIncoming(NULL), mNextSeq(0), mAdding(0), mHead(NULL), mTail(NULL),
+  mTombstoneMutex(), mTombstones(), mTombstoneVersion(0), mActiveTombstones(),
+  mActiveTombstoneVersion(0), mDepth(0), mMaxDepth(0), mLastProcessed(0),
+  mLastDrainSeconds(0), mMaxDrainSeconds(0), mTotalProcessed(0)
+{
+}
+
+rtThreadQueue::~rtThreadQueue()
+{
+  takeIncoming();
+  while (mHead)
+  {
+    ThreadQueueEntry* next = mHead->next;
+    delete mHead;
+    mHead = next;
+  }
+}
 
 rtError rtThreadQueue::addTask(rtThreadTaskCB t, void* context, void* data)
 {
-  mTaskMutex.lock();
-  ThreadQueueEntry entry;
-  entry.task = t;
-  entry.context = context;
-  entry.data = data;
-  mTasks.push_back(entry);
-  mTaskMutex.unlock();
+  ThreadQueueEntry* entry = new ThreadQueueEntry;
+  entry->task = t;
+  entry->context = context;
+  entry->data = data;
+
+  mAdding++;
+  entry->seq = mNextSeq++;
+  ThreadQueueEntry* head = mIncoming.load(std::memory_order_relaxed);
+  do
+  {
+    entry->next = head;
+  } while (!mIncoming.compare_exchange_weak(head, entry, std::memory_order_release,
+                                            std::memory_order_relaxed));
+  mAdding--;
+
+  uint32_t depth = ++mDepth;
+  uint32_t maxDepth = mMaxDepth;
+  while (depth > maxDepth && !mMaxDepth.compare_exchange_weak(maxDepth, depth))
+    ;
 
   return RT_OK;
 }
 
 rtError rtThreadQueue::removeAllTasksForObject(void* context)
 {
-  mTaskMutex.lock();
-  for(deque<ThreadQueueEntry>::iterator it = mTasks.begin();
-        it != mTasks.end(); ++it)
+  mTombstoneMutex.lock();
+  rtThreadQueueTombstone t;
+  t.context = context;
+  t.seq = mNextSeq;
+  mTombstones.push_back(t);
+  mTombstoneVersion++;
+  mTombstoneMutex.unlock();
+
+  return RT_OK;
+}
+
+void rtThreadQueue::takeIncoming()
+{
+  ThreadQueueEntry* entry = mIncoming.exchange(NULL, std::memory_order_acquire);
+
+  // the stack is newest first
+  ThreadQueueEntry* batch = NULL;
+  ThreadQueueEntry* batchTail = entry;
+  while (entry)
   {
-    if ((it)->context == context)
-    {
-      it = mTasks.erase(it);
-      break;
-    }
+    ThreadQueueEntry* next = entry->next;
+    entry->next = batch;
+    batch = entry;
+    entry = next;
   }
-  mTaskMutex.unlock();
+  if (!batch)
+    return;
 
-  return RT_OK;
+  if (mTail)
+    mTail->next = batch;
+  else
+    mHead = batch;
+  mTail = batchTail;
+}
+
+void rtThreadQueue::refreshTombstones()
+{
+  if (mTombstoneVersion != mActiveTombstoneVersion)
+  {
+    mTombstoneMutex.lock();
+    mActiveTombstones = mTombstones;
+    mActiveTombstoneVersion = mTombstoneVersion;
+    mTombstoneMutex.unlock();
+  }
+}
+
+bool rtThreadQueue::isTombstoned(const ThreadQueueEntry* entry)
+{
+  refreshTombstones();
+  for (vector<rtThreadQueueTombstone>::const_iterator it = mActiveTombstones.begin();
+       it != mActiveTombstones.end(); ++it)
+  {
+    if (it->context == entry->context && entry->seq < it->seq)
+      return true;
+  }
+  return false;
 }
 
 rtError rtThreadQueue::process(double maxSeconds)
 {
-  bool done = false;
+  // once every task numbered below seqBound has been taken and run the
+  // tombstones up to it can go; that holds if nobody was midway through
+  // addTask when we looked
+  uint64_t seqBound = mNextSeq;
+  bool quiescent = (mAdding == 0);
+  takeIncoming();
+
   double start = pxSeconds();
-  do
+  double elapsed = 0;
+  uint32_t processed = 0;
+  uint32_t nextTimeCheck = 1;
+  bool outOfTime = false;
+  while (!outOfTime)
   {
-    ThreadQueueEntry entry;
-    mTaskMutex.lock();
-    if (!mTasks.empty())
+    if (!mHead)
     {
-      entry = mTasks.front();
-      mTasks.pop_front();
+      // pick up anything the tasks we just ran queued
+      takeIncoming();
+      if (!mHead)
+        break;
     }
-    else done = true;
-    mTaskMutex.unlock();
-    
-    if (!done)
+
+    ThreadQueueEntry* entry = mHead;
+    mHead = entry->next;
+    if (!mHead)
+      mTail = NULL;
+
+    if (!isTombstoned(entry))
+    {
+      entry->task(entry->context, entry->data);
+      processed++;
+    }
+    delete entry;
+    mDepth--;
+
+    // reading the clock after every task costs more than most tasks, so
+    // check again after about half the tasks the remaining budget allows
+    if (maxSeconds > 0 && --nextTimeCheck == 0)
     {
-      entry.task(entry.context,entry.data);  
-      if (maxSeconds > 0)
-        done = (pxSeconds()-start) >= maxSeconds;
+      elapsed = pxSeconds() - start;
+      if (elapsed >= maxSeconds)
+        outOfTime = true;
+      else
+      {
+        double perTask = elapsed / (processed ? processed : 1);
+        double remaining = (maxSeconds - elapsed) / (perTask > 0 ? perTask : 1e-6);
+        nextTimeCheck = std::max(1u, std::min(1024u, (uint32_t)(remaining / 2)));
+      }
     }
-  } while (!done);
+  }
+
+  if (quiescent && !mHead)
+  {
+    refreshTombstones();
+    if (!mActiveTombstones.empty())
+    {
+      mTombstoneMutex.lock();
+      vector<rtThreadQueueTombstone>::iterator it = mTombstones.begin();
+      while (it != mTombstones.end())
+      {
+        if (it->seq <= seqBound)
+          it = mTombstones.erase(it);
+        else
+          ++it;
+      }
+      mTombstoneVersion++;
+      mTombstoneMutex.unlock();
+    }
+  }
+
+  mLastDrainSeconds = pxSeconds() - start;
+  mMaxDrainSeconds = std::max(mMaxDrainSeconds, mLastDrainSeconds);
+  mLastProcessed = processed;
+  mTotalProcessed += processed;
 
   return RT_OK;
 }
+
+void rtThreadQueue::stats(rtThreadQueueStats& s) const
+{
+  s.depth = mDepth;
+  s.maxDepth = mMaxDepth;
+  s.lastProcessed = mLastProcessed;
+  s.lastDrainSeconds = mLastDrainSeconds;
+  s.maxDrainSeconds = mMaxDrainSeconds;
+  s.totalProcessed = mTotalProcessed;
+}
+
+void rtThreadQueue::resetStats()
+{
+  mMaxDepth = (uint32_t)mDepth;
+  mMaxDrainSeconds = 0;
+}
@@ -23,7 +23,10 @@
 #include "rtError.h"
 #include "rtMutex.h"
 
-#include <deque>
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
 
 typedef void (*rtThreadTaskCB)(void* context, void* data);
 
@@ -32,8 +35,23 @@ struct ThreadQueueEntry
   rtThreadTaskCB task;
   void* context;
   void* data;
+  uint64_t seq;
+  ThreadQueueEntry* next;
 };
 
+struct rtThreadQueueStats
+{
+  uint32_t depth;            // tasks waiting right now
+  uint32_t maxDepth;         // deepest the queue got since the last reset
+  uint32_t lastProcessed;    // tasks run by the last process call
+  double lastDrainSeconds;   // time spent in the last process call
+  double maxDrainSeconds;    // longest process call since the last reset
+  uint64_t totalProcessed;
+};
+
+// Any thread can add tasks; only the owning thread calls process.  Adding
+// is lock free: tasks are pushed on a stack that process takes over in one
+// swap and runs in the order they were added.
 class rtThreadQueue
 {
 public:
@@ -44,14 +62,49 @@ public:
   // Thread safe
   rtError addTask(rtThreadTaskCB t, void* context, void* data);
 
+  // Drops every task queued so far for context.  The tasks are tombstoned
+  // rather than unlinked, so this is safe from any thread.
   rtError removeAllTasksForObject(void* context);
 
   // Invoke this method periodically on the dispatching (owning) thread
   // maxSeconds=0 means process until empty
   rtError process(double maxSeconds = 0);
 
+  uint32_t depth() const { return mDepth; }
+  void stats(rtThreadQueueStats& s) const;
+  void resetStats();
+
 private:
-  std::deque<ThreadQueueEntry> mTasks;
-  rtMutex mTaskMutex;
+  struct rtThreadQueueTombstone
+  {
+    void* context;
+    uint64_t seq; // tasks queued before this are dropped
+  };
+
+  void takeIncoming();
+  void refreshTombstones();
+  bool isTombstoned(const ThreadQueueEntry* entry);
+
+  // producers
+  std::atomic<ThreadQueueEntry*> mIncoming;
+  std::atomic<uint64_t> mNextSeq;
+  std::atomic<int> mAdding;
+
+  // owning thread only, in the order the tasks were added
+  ThreadQueueEntry* mHead;
+  ThreadQueueEntry* mTail;
+
+  rtMutex mTombstoneMutex;
+  std::vector<rtThreadQueueTombstone> mTombstones;
+  std::atomic<uint32_t> mTombstoneVersion;
+  std::vector<rtThreadQueueTombstone> mActiveTombstones; // owning thread copy
+  uint32_t mActiveTombstoneVersion;
+
+  std::atomic<uint32_t> mDepth;
+  std::atomic<uint32_t> mMaxDepth;
+  uint32_t mLastProcessed;
+  double mLastDrainSeconds;
+  double mMaxDrainSeconds;
+  uint64_t mTotalProcessed;
 };
 #endif //RT_THREAD_QUEUE_H
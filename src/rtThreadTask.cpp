@@ -20,8 +20,10 @@
 
 #include <stddef.h>
 
-rtThreadTask::rtThreadTask(void (*functionPointer)(void*), void* data, rtString key) :
-    mFunctionPointer(functionPointer), mData(data), mKey(key)
+rtThreadTask::rtThreadTask(void (*functionPointer)(void*), void* data, rtString key,
+                           rtThreadTaskPriority priority) :
+    mFunctionPointer(functionPointer), mData(data), mKey(key), mPriority(priority),
+    mPrev(NULL), mNext(NULL), mKeyHash(0)
 {
 }
 
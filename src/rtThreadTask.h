@@ -21,18 +21,40 @@
 
 #include "rtString.h"
 
+#include <stdint.h>
+
+// rtThreadPool queue lanes; workers always take from the highest lane that
+// has work
+enum rtThreadTaskPriority
+{
+    RT_THREAD_TASK_PRIORITY_VISIBLE = 0, // needed for what is on screen now
+    RT_THREAD_TASK_PRIORITY_PREFETCH,    // likely to be needed soon
+    RT_THREAD_TASK_PRIORITY_BACKGROUND,  // everything else
+    RT_THREAD_TASK_PRIORITY_COUNT
+};
+
 class rtThreadTask
 {  
 public:
-    rtThreadTask(void (*functionPointer)(void*), void* data, rtString key);
+    rtThreadTask(void (*functionPointer)(void*), void* data, rtString key,
+                 rtThreadTaskPriority priority = RT_THREAD_TASK_PRIORITY_PREFETCH);
     ~rtThreadTask();
     void execute();
     rtString getKey();
+    rtThreadTaskPriority priority() const { return mPriority; }
     
 private:
+    friend class rtThreadPoolNative;
+
     void (*mFunctionPointer)(void*);
     void* mData;
     rtString mKey;
+    rtThreadTaskPriority mPriority;
+
+    // owned by the thread pool while the task is queued
+    rtThreadTask* mPrev;
+    rtThreadTask* mNext;
+    uint32_t mKeyHash;
 };
 
 #endif //RT_THREAD_TASK_H
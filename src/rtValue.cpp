@@ -41,6 +41,8 @@ rtValue::rtValue(const rtObjectRef& v)  :mType(0) { setObject(v); }
 rtValue::rtValue(const rtIFunction* v)  :mType(0) { setFunction(v); }
 rtValue::rtValue(const rtFunctionRef& v):mType(0) { setFunction(v); }
 rtValue::rtValue(const rtValue& v)      :mType(0) { setValue(v);  }
+rtValue::rtValue(rtValue&& v)           :mType(0) { moveValue(v); }
+rtValue::rtValue(rtString&& v)          :mType(0) { setString(std::move(v)); }
 rtValue::rtValue(voidPtr v)             :mType(0) { setVoidPtr(v); }
 
 rtValue::~rtValue()
@@ -70,14 +72,7 @@ bool rtValue::compare(const rtValue& lhs, const rtValue& rhs)
     case RT_uint64_tType: result = (lhs.mValue.uint64Value == rhs.mValue.uint64Value); break;
     case RT_floatType:    result = (lhs.mValue.floatValue == rhs.mValue.floatValue); break;
     case RT_doubleType:   result = (lhs.mValue.doubleValue == rhs.mValue.doubleValue); break;
-    case RT_stringType:
-    {
-      if (lhs.mValue.stringValue && rhs.mValue.stringValue)
-        result = (*lhs.mValue.stringValue == *rhs.mValue.stringValue);
-      else
-        result = (lhs.mValue.stringValue == rhs.mValue.stringValue);
-    }
-    break;
+    case RT_stringType:   result = (lhs.mValue.stringValue == rhs.mValue.stringValue.cString()); break;
     case RT_objectType:   result = (lhs.mValue.objectValue == rhs.mValue.objectValue); break;
     case RT_functionType: result = (lhs.mValue.functionValue == rhs.mValue.functionValue); break;
     }
@@ -121,11 +116,7 @@ void rtValue::setEmpty()
   }
   else if (mType == RT_stringType)
   {
-    if (mValue.stringValue)
-    {
-      delete mValue.stringValue;
-      mValue.stringValue = NULL;
-    }
+    mValue.stringValue.~rtString();
   }
 
   // TODO setting this to '0' makes node wrappers unhappy
@@ -151,18 +142,38 @@ void rtValue::setValue(const rtValue& v)
       mValue.functionValue = v.mValue.functionValue;
       mValue.functionValue->AddRef();
     }
-#if 1
-    else if (mType == RT_stringType && v.mValue.stringValue != NULL)
+    else if (mType == RT_stringType)
     {
-      setString(*(v.mValue.stringValue));
+      new (&mValue.stringValue) rtString(v.mValue.stringValue);
     }
-#endif
     else
-      mValue = v.mValue;
+      mValue.uint64Value = v.mValue.uint64Value;
     mIsEmpty = v.mIsEmpty;
   }
 }
 
+void rtValue::moveValue(rtValue& v)
+{
+  if (this != &v)
+  {
+    setEmpty();
+    mType = v.mType;
+    if (mType == RT_stringType)
+    {
+      new (&mValue.stringValue) rtString(std::move(v.mValue.stringValue));
+      v.mValue.stringValue.~rtString();
+    }
+    else
+      mValue.uint64Value = v.mValue.uint64Value;
+    mIsEmpty = v.mIsEmpty;
+
+    // the object or function reference now belongs to this value
+    v.mType = 0;
+    v.mValue.uint64Value = 0;
+    v.mIsEmpty = true;
+  }
+}
+
 void rtValue::setBool(bool v)
 {
   setEmpty();
@@ -228,8 +239,32 @@ void rtValue::setDouble(double v)
 
 void rtValue::setString(const rtString& v)
 {
-  setEmpty();
-  mType    = RT_stringType; mValue.stringValue = new rtString(v);
+  if (mType == RT_stringType)
+  {
+    // v may be our own payload; rtString assignment handles that
+    mValue.stringValue = v;
+  }
+  else
+  {
+    setEmpty();
+    mType = RT_stringType;
+    new (&mValue.stringValue) rtString(v);
+  }
+  mIsEmpty = false;
+}
+
+void rtValue::setString(rtString&& v)
+{
+  if (mType == RT_stringType)
+  {
+    mValue.stringValue = std::move(v);
+  }
+  else
+  {
+    setEmpty();
+    mType = RT_stringType;
+    new (&mValue.stringValue) rtString(std::move(v));
+  }
   mIsEmpty = false;
 }
 
@@ -300,9 +335,7 @@ rtError rtValue::getBool(bool& v) const
     case RT_doubleType:   v = (mValue.doubleValue==0.0) ? false:true; break;
     case RT_stringType:
     {
-      if (mValue.stringValue) {
-        v = (*mValue.stringValue=="")?false:true;
-      }
+      v = mValue.stringValue.isEmpty()?false:true;
     }
     break;
     case RT_objectType: v = mValue.objectValue?     true:false; break;
@@ -338,8 +371,7 @@ rtError rtValue::getInt8(int8_t& v)  const
     case RT_doubleType:   v = (int8_t)mValue.doubleValue;   break;
     case RT_stringType:
     {
-      if (mValue.stringValue)
-        v = (int8_t)atol(mValue.stringValue->cString());
+      v = (int8_t)atol(mValue.stringValue.cString());
     }
     break;
     case RT_objectType: /* Leave as default */ break;
@@ -380,8 +412,7 @@ rtError rtValue::getUInt8(uint8_t& v) const
 #endif //PX_RTVALUE_CAST_UINT_BASIC
     case RT_stringType:
     {
-      if (mValue.stringValue)
-        v = (uint8_t)atol(mValue.stringValue->cString());
+      v = (uint8_t)atol(mValue.stringValue.cString());
     }
     break;
     case RT_objectType:   /* Leave as default */ break;
@@ -417,8 +448,7 @@ rtError rtValue::getInt32(int32_t& v) const
     case RT_doubleType:   v = (int32_t)mValue.doubleValue;   break;
     case RT_stringType:
     {
-      if (mValue.stringValue)
-        v = (int32_t)atol(mValue.stringValue->cString());
+      v = (int32_t)atol(mValue.stringValue.cString());
     }
     break;
     case RT_objectType:   /* Leave as default */ break;
@@ -459,8 +489,7 @@ rtError rtValue::getUInt32(uint32_t& v) const
 #endif //PX_RTVALUE_CAST_UINT_BASIC
     case RT_stringType:
     {
-      if (mValue.stringValue)
-        v = (uint32_t)atol(mValue.stringValue->cString());
+      v = (uint32_t)atol(mValue.stringValue.cString());
     }
     break;
     case RT_objectType:   /* Leave as default */ break;
@@ -496,8 +525,7 @@ rtError rtValue::getInt64(int64_t& v) const
     case RT_doubleType:   v = (int64_t)mValue.doubleValue;   break;
     case RT_stringType:
     {
-      if (mValue.stringValue)
-        v = (int64_t)atoll(mValue.stringValue->cString());
+      v = (int64_t)atoll(mValue.stringValue.cString());
     }
     break;
     case RT_objectType:   /* Leave as default */ break;
@@ -538,8 +566,7 @@ rtError rtValue::getUInt64(uint64_t& v) const
 #endif
     case RT_stringType:
     {
-      if (mValue.stringValue)
-        v = (uint64_t)atoll(mValue.stringValue->cString());
+      v = (uint64_t)atoll(mValue.stringValue.cString());
     }
     break;
     case RT_objectType:   /* Leave as default */ break;
@@ -574,8 +601,7 @@ rtError rtValue::getFloat(float& v) const
     case RT_doubleType: v = (float)mValue.doubleValue;    break;
     case RT_stringType:
     {
-      if (mValue.stringValue)
-        v = (float)atof(mValue.stringValue->cString());
+      v = (float)atof(mValue.stringValue.cString());
     }
     break;
     case RT_objectType:   /* Leave as default */ break;
@@ -610,8 +636,7 @@ rtError rtValue::getDouble(double& v) const
 //    case RT_doubleType: break;
     case RT_stringType:
     {
-      if (mValue.stringValue)
-        v = atof(mValue.stringValue->cString());
+      v = atof(mValue.stringValue.cString());
     }
     break;
     case RT_objectType:   /* Leave as default */ break;
@@ -627,8 +652,8 @@ rtError rtValue::getDouble(double& v) const
 
 rtError rtValue::getString(rtString& v) const
 {
-  if (mType == RT_stringType && mValue.stringValue)
-    v = *mValue.stringValue;
+  if (mType == RT_stringType)
+    v = mValue.stringValue;
   else
   {
     // TODO EVIL buffer on stack
@@ -21,6 +21,9 @@
 #define RT_VALUE_H
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <utility>
 
 #include "rtCore.h"
 #include "rtString.h"
@@ -78,8 +81,13 @@ const char* rtStrType(char t); //fwd
 
 typedef void* voidPtr;
 
+// The string payload is stored in place; rtValue constructs and destroys
+// it explicitly when the type changes to or from RT_stringType.
 union rtValue_
 {
+  rtValue_() {}
+  ~rtValue_() {}
+
   bool        boolValue;
   int8_t      int8Value;
   uint8_t     uint8Value;
@@ -89,7 +97,7 @@ union rtValue_
   uint32_t    uint32Value;
   float       floatValue;
   double      doubleValue;
-  rtString    *stringValue;
+  rtString    stringValue;
   rtIObject   *objectValue;
   rtIFunction *functionValue;
   voidPtr     voidPtrValue;  // For creating mischief
@@ -117,6 +125,8 @@ class rtValue
   rtValue(const rtIFunction* v);
   rtValue(const rtFunctionRef& v);
   rtValue(const rtValue& v);
+  rtValue(rtValue&& v);
+  rtValue(rtString&& v);
   rtValue(voidPtr v);
   ~rtValue();
 
@@ -138,6 +148,8 @@ class rtValue
   finline rtValue& operator=(const rtIFunction* v)  { setFunction(v); return *this; }
   finline rtValue& operator=(const rtFunctionRef& v){ setFunction(v); return *this; }
   finline rtValue& operator=(const rtValue& v)      { setValue(v);    return *this; }
+  finline rtValue& operator=(rtValue&& v)           { moveValue(v);   return *this; }
+  finline rtValue& operator=(rtString&& v)          { setString(std::move(v)); return *this; }
   finline rtValue& operator=(voidPtr v)             { setVoidPtr(v);  return *this; }
 
   bool operator!=(const rtValue& rhs) const { return !(*this == rhs); }
@@ -176,6 +188,7 @@ class rtValue
   void setFloat(float v);
   void setDouble(double v);
   void setString(const rtString& v);
+  void setString(rtString&& v);
   void setObject(const rtIObject* v);
   void setObject(const rtObjectRef& v);
   void setFunction(const rtIFunction* v);
@@ -247,10 +260,87 @@ class rtValue
 
   rtError coerceType(rtType newType);
 
+  // Takes over v's payload without touching refcounts and leaves v empty
+  void moveValue(rtValue& v);
+
   rtType   mType;
+  bool     mIsEmpty;
   rtValue_ mValue;
+};
 
-  bool     mIsEmpty;
+/**
+  An argument list for rtIFunction::Send.  The first N values live in the
+  list itself so building the arguments for a typical call does not touch
+  the heap; longer lists spill over to a heap block.
+*/
+template <int N>
+class rtValueList
+{
+public:
+  rtValueList(): mValues((rtValue*)mInline), mSize(0), mCapacity(N) {}
+
+  ~rtValueList()
+  {
+    clear();
+    if (mValues != (rtValue*)mInline)
+      free(mValues);
+  }
+
+  void push_back(const rtValue& v)
+  {
+    reserve(mSize+1);
+    new (&mValues[mSize++]) rtValue(v);
+  }
+
+  void push_back(rtValue&& v)
+  {
+    reserve(mSize+1);
+    new (&mValues[mSize++]) rtValue(std::move(v));
+  }
+
+  void clear()
+  {
+    for (int i = 0; i < mSize; i++)
+      mValues[i].~rtValue();
+    mSize = 0;
+  }
+
+  void reserve(int n)
+  {
+    if (n <= mCapacity)
+      return;
+    int capacity = mCapacity*2;
+    if (capacity < n)
+      capacity = n;
+    rtValue* values = (rtValue*)malloc(capacity*sizeof(rtValue));
+    for (int i = 0; i < mSize; i++)
+    {
+      new (&values[i]) rtValue(std::move(mValues[i]));
+      mValues[i].~rtValue();
+    }
+    if (mValues != (rtValue*)mInline)
+      free(mValues);
+    mValues = values;
+    mCapacity = capacity;
+  }
+
+  int size() const { return mSize; }
+  bool isHeap() const { return mValues != (const rtValue*)mInline; }
+
+  rtValue* data() { return mValues; }
+  const rtValue* data() const { return mValues; }
+
+  rtValue& operator[](int i) { return mValues[i]; }
+  const rtValue& operator[](int i) const { return mValues[i]; }
+
+private:
+  rtValueList(const rtValueList&);
+  rtValueList& operator=(const rtValueList&);
+
+  rtValue* mValues;
+  int mSize;
+  int mCapacity;
+  alignas(rtValue) char mInline[N*sizeof(rtValue)];
 };
 
 #define RT_TYPE_CASE(t) case t: s = # t; break;
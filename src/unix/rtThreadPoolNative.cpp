@@ -17,21 +17,48 @@ limitations under the License.
 */
 
 #include "rtThreadPoolNative.h"
+#include "rtObject.h"
+
+#include <string.h>
 
 #include <iostream>
 using namespace std;
 
-void* launchThread(void* threadPool)
+struct rtThreadPoolWorker
+{
+    rtThreadPoolNative* pool;
+    int worker;
+};
+
+void* launchThread(void* context)
 {
-    rtThreadPoolNative* pool = (rtThreadPoolNative*) threadPool;
-    pool->startThread();
+    rtThreadPoolWorker* w = (rtThreadPoolWorker*) context;
+    rtThreadPoolNative* pool = w->pool;
+    int worker = w->worker;
+    delete w;
+    pool->startThread(worker);
     return NULL;
 }
 
+rtThreadPoolNative::rtThreadTaskQueue::rtThreadTaskQueue() : mMutex(), mKeys()
+{
+    for (int i = 0; i < RT_THREAD_TASK_PRIORITY_COUNT; i++)
+    {
+        mHead[i] = NULL;
+        mTail[i] = NULL;
+        mCount[i] = 0;
+    }
+}
+
 rtThreadPoolNative::rtThreadPoolNative(int numberOfThreads) : 
-    mNumberOfThreads(numberOfThreads), mRunning(false), mThreadTaskMutex(),
-    mThreadTaskCondition(), mThreads(), mThreadTasks()
+    mNumberOfThreads(0), mRunning(false), mThreadTaskMutex(),
+    mThreadTaskCondition(), mThreads(), mQueueCount(0), mPendingTasks(0), mNextQueue(0)
 {
+    if (numberOfThreads < 0)
+        numberOfThreads = 0;
+    if (numberOfThreads > RT_THREAD_POOL_MAX_THREADS)
+        numberOfThreads = RT_THREAD_POOL_MAX_THREADS;
+    mNumberOfThreads = numberOfThreads;
     initialize();
 }
 
@@ -42,18 +69,51 @@ rtThreadPoolNative::~rtThreadPoolNative()
         destroy();
     }
     mThreads.clear();
+    for (int i = 0; i < mQueueCount; i++)
+    {
+        rtThreadTaskQueue* queue = mQueues[i];
+        for (int lane = 0; lane < RT_THREAD_TASK_PRIORITY_COUNT; lane++)
+        {
+            rtThreadTask* threadTask = queue->mHead[lane];
+            while (threadTask != NULL)
+            {
+                rtThreadTask* next = threadTask->mNext;
+                delete threadTask;
+                threadTask = next;
+            }
+        }
+        delete queue;
+    }
 }
 
 bool rtThreadPoolNative::initialize()
 {
     mRunning = true;
-    for (int i = 0; i < mNumberOfThreads; i++)
+    // there is always a queue so tasks can be added to a pool without threads
+    mQueues[0] = new rtThreadTaskQueue();
+    mQueueCount = 1;
+    return startThreads(mNumberOfThreads);
+}
+
+bool rtThreadPoolNative::startThreads(int numberOfThreads)
+{
+    for (int i = (int)mThreads.size(); i < numberOfThreads; i++)
     {
+        if (i >= mQueueCount)
+        {
+            mQueues[i] = new rtThreadTaskQueue();
+            mQueueCount = i + 1;
+        }
+        rtThreadPoolWorker* w = new rtThreadPoolWorker;
+        w->pool = this;
+        w->worker = i;
         pthread_t tid;
-        int returnValue = pthread_create(&tid, NULL, launchThread, (void*) this);
+        int returnValue = pthread_create(&tid, NULL, launchThread, (void*) w);
         if (returnValue != 0)
         {
             cout << "Error creating thread.  The return value is " << returnValue << endl;
+            delete w;
+            mNumberOfThreads = i;
             return false;
         }
         mThreads.push_back(tid);
@@ -68,7 +128,7 @@ void rtThreadPoolNative::destroy()
     mThreadTaskMutex.unlock();
     //broadcast to all the threads that we are shutting down
     mThreadTaskCondition.broadcast();
-    for (int i = 0; i < mNumberOfThreads; i++)
+    for (size_t i = 0; i < mThreads.size(); i++)
     {
         void* result;
         int returnValue = pthread_join(mThreads[i], &result);
@@ -79,61 +139,262 @@ void rtThreadPoolNative::destroy()
         //make another attempt to broadcast to threads 
         mThreadTaskCondition.broadcast();
     }
+    mThreads.clear();
 }
 
-void rtThreadPoolNative::startThread()
+void rtThreadPoolNative::setThreadCount(int numberOfThreads)
 {
-    rtThreadTask* threadTask = NULL;
-    while(true)
+    if (numberOfThreads < 0)
+        numberOfThreads = 0;
+    if (numberOfThreads > RT_THREAD_POOL_MAX_THREADS)
+        numberOfThreads = RT_THREAD_POOL_MAX_THREADS;
+
+    mThreadTaskMutex.lock();
+    if (!mRunning)
     {
-        mThreadTaskMutex.lock();
-        while (mRunning && (mThreadTasks.empty()))
+        mThreadTaskMutex.unlock();
+        return;
+    }
+    int oldCount = mNumberOfThreads;
+    mNumberOfThreads = numberOfThreads;
+    mThreadTaskMutex.unlock();
+
+    if (numberOfThreads > oldCount)
+    {
+        startThreads(numberOfThreads);
+        return;
+    }
+
+    // workers past the new count exit once their current task is done;
+    // whatever is left in their queues gets stolen by the others
+    mThreadTaskCondition.broadcast();
+    for (int i = numberOfThreads; i < oldCount; i++)
+    {
+        void* result;
+        if (pthread_join(mThreads[i], &result) != 0)
         {
-            mThreadTaskCondition.wait(mThreadTaskMutex.getNativeMutexDescription());
+            cout << "Error joining threads" << endl;
+        }
+    }
+    mThreads.resize(numberOfThreads);
+    if (mPendingTasks > 0)
+        mThreadTaskCondition.broadcast();
+}
+
+void rtThreadPoolNative::pushTask(rtThreadTaskQueue* queue, rtThreadTask* threadTask, bool front)
+{
+    int lane = threadTask->mPriority;
+    if (front)
+    {
+        threadTask->mPrev = NULL;
+        threadTask->mNext = queue->mHead[lane];
+        if (queue->mHead[lane])
+            queue->mHead[lane]->mPrev = threadTask;
+        else
+            queue->mTail[lane] = threadTask;
+        queue->mHead[lane] = threadTask;
+    }
+    else
+    {
+        threadTask->mNext = NULL;
+        threadTask->mPrev = queue->mTail[lane];
+        if (queue->mTail[lane])
+            queue->mTail[lane]->mNext = threadTask;
+        else
+            queue->mHead[lane] = threadTask;
+        queue->mTail[lane] = threadTask;
+    }
+    queue->mCount[lane]++;
+}
+
+void rtThreadPoolNative::unlinkTask(rtThreadTaskQueue* queue, rtThreadTask* threadTask)
+{
+    int lane = threadTask->mPriority;
+    if (threadTask->mPrev)
+        threadTask->mPrev->mNext = threadTask->mNext;
+    else
+        queue->mHead[lane] = threadTask->mNext;
+    if (threadTask->mNext)
+        threadTask->mNext->mPrev = threadTask->mPrev;
+    else
+        queue->mTail[lane] = threadTask->mPrev;
+    threadTask->mPrev = NULL;
+    threadTask->mNext = NULL;
+    queue->mCount[lane]--;
+}
+
+rtThreadTask* rtThreadPoolNative::takeTask(rtThreadTaskQueue* queue, int lane)
+{
+    if (queue->mCount[lane] == 0)
+        return NULL;
+
+    queue->mMutex.lock();
+    rtThreadTask* threadTask = queue->mHead[lane];
+    if (threadTask != NULL)
+    {
+        unlinkTask(queue, threadTask);
+        if (!threadTask->mKey.isEmpty())
+        {
+            std::pair<std::unordered_multimap<uint32_t, rtThreadTask*>::iterator,
+                      std::unordered_multimap<uint32_t, rtThreadTask*>::iterator> range =
+                queue->mKeys.equal_range(threadTask->mKeyHash);
+            for (std::unordered_multimap<uint32_t, rtThreadTask*>::iterator it = range.first; it != range.second; ++it)
+            {
+                if (it->second == threadTask)
+                {
+                    queue->mKeys.erase(it);
+                    break;
+                }
+            }
+        }
+    }
+    queue->mMutex.unlock();
+
+    if (threadTask != NULL)
+        mPendingTasks--;
+    return threadTask;
+}
+
+rtThreadTask* rtThreadPoolNative::nextTask(int worker)
+{
+    int queueCount = mQueueCount;
+    if (worker >= queueCount)
+        worker = 0;
+    for (int lane = 0; lane < RT_THREAD_TASK_PRIORITY_COUNT; lane++)
+    {
+        rtThreadTask* threadTask = takeTask(mQueues[worker], lane);
+        if (threadTask != NULL)
+            return threadTask;
+        // steal the oldest task of this lane from another worker before
+        // looking at our own lower priority work
+        for (int i = 1; i < queueCount; i++)
+        {
+            threadTask = takeTask(mQueues[(worker + i) % queueCount], lane);
+            if (threadTask != NULL)
+                return threadTask;
         }
-        if (!mRunning)
+    }
+    return NULL;
+}
+
+void rtThreadPoolNative::startThread(int worker)
+{
+    while(true)
+    {
+        if (!mRunning || worker >= mNumberOfThreads)
         {
-            mThreadTaskMutex.unlock();
-            pthread_exit(NULL);
+            return;
         }
-        threadTask = mThreadTasks.front();
-        mThreadTasks.pop_front();
-        mThreadTaskMutex.unlock();
-        
+
+        rtThreadTask* threadTask = nextTask(worker);
         if (threadTask != NULL)
         {
             threadTask->execute();
             delete threadTask;
-            threadTask = NULL;
+            continue;
+        }
+
+        mThreadTaskMutex.lock();
+        while (mRunning && worker < mNumberOfThreads && mPendingTasks <= 0)
+        {
+            mThreadTaskCondition.wait(mThreadTaskMutex.getNativeMutexDescription());
         }
+        mThreadTaskMutex.unlock();
     }
 }
 
 void rtThreadPoolNative::executeTask(rtThreadTask* threadTask)
 {
+    if (threadTask == NULL)
+        return;
+
+    // spread tasks over the running workers; the queue count can lag the
+    // thread count while setThreadCount is starting threads
+    int queueCount = mNumberOfThreads;
+    if (queueCount > mQueueCount)
+        queueCount = mQueueCount;
+    rtThreadTaskQueue* queue = mQueues[queueCount > 0 ? mNextQueue++ % queueCount : 0];
+
+    queue->mMutex.lock();
+    pushTask(queue, threadTask, false);
+    if (!threadTask->mKey.isEmpty())
+    {
+        threadTask->mKeyHash = rtAtomHash(threadTask->mKey.cString());
+        queue->mKeys.insert(std::make_pair(threadTask->mKeyHash, threadTask));
+    }
+    queue->mMutex.unlock();
+
+    mPendingTasks++;
     mThreadTaskMutex.lock();
-    mThreadTasks.push_back(threadTask);
     mThreadTaskCondition.signal();
     mThreadTaskMutex.unlock();
 }
 
-void rtThreadPoolNative::raisePriority(rtString key)
+void rtThreadPoolNative::raisePriority(const rtString& key)
 {
-    mThreadTaskMutex.lock();
-    rtThreadTask* threadTask = NULL;
-    for (std::deque<rtThreadTask*>::iterator it = mThreadTasks.begin(); it!=mThreadTasks.end(); ++it)
+    if (key.isEmpty())
+        return;
+
+    uint32_t h = rtAtomHash(key.cString());
+    int queueCount = mQueueCount;
+    for (int i = 0; i < queueCount; i++)
     {
-        if ((*it)->getKey().compare(key) == 0)
+        rtThreadTaskQueue* queue = mQueues[i];
+        queue->mMutex.lock();
+        std::pair<std::unordered_multimap<uint32_t, rtThreadTask*>::iterator,
+                  std::unordered_multimap<uint32_t, rtThreadTask*>::iterator> range =
+            queue->mKeys.equal_range(h);
+        for (std::unordered_multimap<uint32_t, rtThreadTask*>::iterator it = range.first; it != range.second; ++it)
         {
-            threadTask = *it;
-            it = mThreadTasks.erase(it);
-            break;
+            rtThreadTask* threadTask = it->second;
+            if (threadTask->mKey.compare(key.cString()) == 0)
+            {
+                unlinkTask(queue, threadTask);
+                threadTask->mPriority = RT_THREAD_TASK_PRIORITY_VISIBLE;
+                pushTask(queue, threadTask, true);
+                queue->mMutex.unlock();
+                return;
+            }
         }
+        queue->mMutex.unlock();
     }
-    if (threadTask != NULL)
+}
+
+int rtThreadPoolNative::cancelTask(const rtString& key)
+{
+    if (key.isEmpty())
+        return 0;
+
+    uint32_t h = rtAtomHash(key.cString());
+    int queueCount = mQueueCount;
+    std::vector<rtThreadTask*> canceled;
+    for (int i = 0; i < queueCount; i++)
     {
-        mThreadTasks.push_front(threadTask);
+        rtThreadTaskQueue* queue = mQueues[i];
+        queue->mMutex.lock();
+        std::pair<std::unordered_multimap<uint32_t, rtThreadTask*>::iterator,
+                  std::unordered_multimap<uint32_t, rtThreadTask*>::iterator> range =
+            queue->mKeys.equal_range(h);
+        std::unordered_multimap<uint32_t, rtThreadTask*>::iterator it = range.first;
+        while (it != range.second)
+        {
+            rtThreadTask* threadTask = it->second;
+            if (threadTask->mKey.compare(key.cString()) == 0)
+            {
+                unlinkTask(queue, threadTask);
+                canceled.push_back(threadTask);
+                it = queue->mKeys.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        queue->mMutex.unlock();
     }
-    mThreadTaskCondition.signal();
-    mThreadTaskMutex.unlock();
+
+    mPendingTasks -= (int)canceled.size();
+    for (size_t i = 0; i < canceled.size(); i++)
+        delete canceled[i];
+    return (int)canceled.size();
 }
@@ -25,9 +25,16 @@ limitations under the License.
 
 #include <pthread.h>
 
+#include <atomic>
+#include <unordered_map>
 #include <vector>
-#include <deque>
 
+#define RT_THREAD_POOL_MAX_THREADS 64
+
+// Each worker has its own queue, one FIFO list per priority lane.  A worker
+// takes the oldest task of the highest non-empty lane, looking at its own
+// queue first and then stealing from the others, so a busy worker never
+// holds up visible work another thread could be doing.
 class rtThreadPoolNative
 {
 public:
@@ -35,21 +42,54 @@ public:
     ~rtThreadPoolNative();
     
     void executeTask(rtThreadTask* threadTask);
-    void raisePriority(rtString key);
-    void startThread();
+
+    // Moves the first queued task with a matching key to the front of the
+    // visible lane
+    void raisePriority(const rtString& key);
+
+    // Removes and deletes every queued task with a matching key; tasks that
+    // are already running are not affected.  The task data is left to the
+    // caller.  Returns the number of tasks removed.
+    int cancelTask(const rtString& key);
+
+    // Starts or stops workers; must not be called from a pool task
+    void setThreadCount(int numberOfThreads);
+    int threadCount() const { return mNumberOfThreads; }
+
+    void startThread(int worker);
     void destroy();
     
 protected:
     
-    bool initialize();
+    struct rtThreadTaskQueue
+    {
+        rtThreadTaskQueue();
 
+        rtMutex mMutex;
+        rtThreadTask* mHead[RT_THREAD_TASK_PRIORITY_COUNT];
+        rtThreadTask* mTail[RT_THREAD_TASK_PRIORITY_COUNT];
+        // read without the lock so idle workers can skip empty queues
+        std::atomic<int> mCount[RT_THREAD_TASK_PRIORITY_COUNT];
+        // queued tasks by key hash for promotion and cancellation
+        std::unordered_multimap<uint32_t, rtThreadTask*> mKeys;
+    };
+
+    bool initialize();
+    bool startThreads(int numberOfThreads);
+    rtThreadTask* nextTask(int worker);
+    rtThreadTask* takeTask(rtThreadTaskQueue* queue, int lane);
+    static void pushTask(rtThreadTaskQueue* queue, rtThreadTask* threadTask, bool front);
+    static void unlinkTask(rtThreadTaskQueue* queue, rtThreadTask* threadTask);
     
-    int mNumberOfThreads;
-    bool mRunning;
+    std::atomic<int> mNumberOfThreads;
+    std::atomic<bool> mRunning;
     rtMutex mThreadTaskMutex;
     rtThreadCondition mThreadTaskCondition;
     std::vector<pthread_t> mThreads;
-    std::deque<rtThreadTask*> mThreadTasks;
+    rtThreadTaskQueue* mQueues[RT_THREAD_POOL_MAX_THREADS];
+    std::atomic<int> mQueueCount;
+    std::atomic<int> mPendingTasks;
+    std::atomic<unsigned int> mNextQueue;
 };
 
 #endif //RT_THREAD_POOL_H
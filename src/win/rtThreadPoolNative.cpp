@@ -116,7 +116,62 @@ void rtThreadPoolNative::startThread()
 void rtThreadPoolNative::executeTask(rtThreadTask* threadTask)
 {
     mThreadTaskMutex.lock();
-    mThreadTasks.push_back(threadTask);
+    // a single queue here; visible tasks simply go to the front
+    if (threadTask->priority() == RT_THREAD_TASK_PRIORITY_VISIBLE)
+      mThreadTasks.push_front(threadTask);
+    else
+      mThreadTasks.push_back(threadTask);
     mThreadTaskCondition.signal();
     mThreadTaskMutex.unlock();
 }
+
+void rtThreadPoolNative::raisePriority(const rtString& key)
+{
+    mThreadTaskMutex.lock();
+    for (std::deque<rtThreadTask*>::iterator it = mThreadTasks.begin(); it != mThreadTasks.end(); ++it)
+    {
+        if ((*it)->getKey().compare(key.cString()) == 0)
+        {
+            rtThreadTask* threadTask = *it;
+            mThreadTasks.erase(it);
+            mThreadTasks.push_front(threadTask);
+            break;
+        }
+    }
+    mThreadTaskMutex.unlock();
+}
+
+int rtThreadPoolNative::cancelTask(const rtString& key)
+{
+    std::vector<rtThreadTask*> canceled;
+    mThreadTaskMutex.lock();
+    std::deque<rtThreadTask*>::iterator it = mThreadTasks.begin();
+    while (it != mThreadTasks.end())
+    {
+        if ((*it)->getKey().compare(key.cString()) == 0)
+        {
+            canceled.push_back(*it);
+            it = mThreadTasks.erase(it);
+        }
+        else
+          ++it;
+    }
+    mThreadTaskMutex.unlock();
+    for (size_t i = 0; i < canceled.size(); i++)
+      delete canceled[i];
+    return (int)canceled.size();
+}
+
+void rtThreadPoolNative::setThreadCount(int numberOfThreads)
+{
+    // threads can be added but not stopped individually here
+    mThreadTaskMutex.lock();
+    for (int i = mNumberOfThreads; i < numberOfThreads; i++)
+    {
+      uintptr_t threadHandle = _beginthread(launchThread, 0, this);
+      mThreads.push_back((HANDLE) threadHandle );
+    }
+    if (numberOfThreads > mNumberOfThreads)
+      mNumberOfThreads = numberOfThreads;
+    mThreadTaskMutex.unlock();
+}
@@ -32,6 +32,10 @@ public:
   ~rtThreadPoolNative();
 
   void executeTask(rtThreadTask* threadTask);
+  void raisePriority(const rtString& key);
+  int cancelTask(const rtString& key);
+  void setThreadCount(int numberOfThreads);
+  int threadCount() const { return mNumberOfThreads; }
   void startThread();
 
   void destroy();
@@ -0,0 +1,116 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define private public
+#define protected public
+
+#include "rtFileCache.h"
+#include "rtHttpCache.h"
+#include "pxTimer.h"
+
+#include "test_includes.h" // Needs to be included last
+
+using namespace std;
+
+class rtFileCacheBenchmark : public testing::Test
+{
+  public:
+    virtual void TearDown()
+    {
+      rtFileCache::instance()->clearCache();
+      rtFileCache::destroy();
+    }
+
+    void addDataToCache(const char* url, const char* data, int size)
+    {
+      rtHttpCacheData cacheData(url, "Expires: Sun, 02 Oct 2099 22:33:33 UTC\n", data, size);
+      rtFileCache::instance()->addToCache(cacheData);
+    }
+
+    // Startup from the index against a directory scan, lookups and eviction
+    void cacheIndexBenchmark()
+    {
+      const int count = 50000;
+      rtFileCache* cache = rtFileCache::instance();
+      cache->clearCache();
+      int64_t oldMaxSize = cache->maxCacheSize();
+      cache->setMaxCacheSize(1024*1024*1024);
+      rtLogSetLevel(RT_LOG_WARN);
+
+      vector<string> urls;
+      for (int i = 0; i < count; i++)
+        urls.push_back("http://fileserver/image" + to_string(i) + ".png");
+
+      double start = pxMilliseconds();
+      for (int i = 0; i < count; i++)
+        addDataToCache(urls[i].c_str(),"0123456789",10);
+      double add = pxMilliseconds() - start;
+      cache->waitForWrites();
+      double written = pxMilliseconds() - start;
+      int64_t size = cache->cacheSize();
+
+      rtFileCache::destroy();
+      start = pxMilliseconds();
+      cache = rtFileCache::instance();
+      double indexLoad = pxMilliseconds() - start;
+      EXPECT_EQ (size, cache->cacheSize());
+
+      start = pxMilliseconds();
+      cache->populateExistingFiles();
+      double scan = pxMilliseconds() - start;
+      EXPECT_EQ (size, cache->cacheSize());
+
+      start = pxMilliseconds();
+      int hits = 0;
+      for (int i = 0; i < count; i++)
+      {
+        rtHttpCacheData data;
+        if (cache->httpCacheData(urls[i].c_str(),data) == RT_OK)
+        {
+          hits++;
+          fclose(data.filePointer());
+        }
+      }
+      double lookup = pxMilliseconds() - start;
+      EXPECT_EQ (count, hits);
+
+      start = pxMilliseconds();
+      cache->setMaxCacheSize(size / 2);
+      cache->cleanup();
+      double evict = pxMilliseconds() - start;
+      EXPECT_LE (cache->cacheSize(), size / 2);
+      cache->waitForWrites();
+
+      printf("rtFileCache %d entries: add %.1f ms (written %.1f ms), startup from index %.1f ms vs directory scan %.1f ms, "
+             "lookup %.1f us, evicting half %.1f ms\n",
+             count, add, written, indexLoad, scan, lookup * 1000 / count, evict);
+
+      cache->setMaxCacheSize(oldMaxSize);
+      cache->clearCache();
+    }
+
+};
+
+TEST_F(rtFileCacheBenchmark, cacheIndexBenchmark)
+{
+  cacheIndexBenchmark();
+}
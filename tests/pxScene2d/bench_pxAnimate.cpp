@@ -0,0 +1,79 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sstream>
+#include <vector>
+
+#define private public
+#define protected public
+
+#include "pxAnimate.h"
+#include "pxScene2d.h"
+#include "pxTimer.h"
+
+#include "test_includes.h" // Needs to be included last
+
+class pxAnimateBenchmark : public testing::Test
+{
+  public:
+    virtual void SetUp()
+    {
+      mScene = new pxScene2d(false);
+    }
+
+    virtual void TearDown()
+    {
+    }
+
+    // Animates 10k properties and reports the per property update cost
+    void updateBenchmark()
+    {
+         const char* props[] = {"x", "y", "a", "sx"};
+         const int numProps = sizeof(props)/sizeof(props[0]);
+         const int numObjects = 2500;
+         const int numFrames = 60;
+
+         pxScene2d* scene = (pxScene2d*)mScene.getPtr();
+         std::vector<rtRef<pxObject> > objects;
+         for (int i = 0; i < numObjects; i++)
+         {
+           rtRef<pxObject> o = new pxObject(scene);
+           for (int p = 0; p < numProps; p++)
+             o->animateTo(props[p], 100, 10.0, pxConstantsAnimation::TWEEN_LINEAR, pxConstantsAnimation::OPTION_LOOP, 1, rtObjectRef());
+           objects.push_back(o);
+         }
+
+         double start = pxSeconds();
+         for (int f = 0; f < numFrames; f++)
+         {
+           scene->mAnimationEngine.update(1.0 + f / 60.0);
+         }
+         double elapsed = pxSeconds() - start;
+
+         printf("animation update: %.1f ns/property/frame (%d properties)\n",
+                elapsed * 1e9 / (numFrames * numObjects * numProps), numObjects * numProps);
+    }
+
+    private:
+      pxScene2dRef mScene;
+};
+
+TEST_F(pxAnimateBenchmark, updateBenchmark)
+{
+    updateBenchmark();
+}
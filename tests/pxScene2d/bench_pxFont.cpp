@@ -0,0 +1,71 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sstream>
+
+#define private public
+#define protected public
+
+#include "pxFont.h"
+#include "pxTimer.h"
+#include <string.h>
+
+#include "test_includes.h" // Needs to be included last
+
+TEST(pxFontBenchmark, measureTextBenchmark)
+{
+  pxFontManager::initFT();
+  rtRef<pxFont> font = new pxFont("FreeSans.ttf", 0, "");
+  ASSERT_EQ(RT_OK, font->init("../../examples/pxScene2d/src/FreeSans.ttf"));
+
+  const char* corpus[] =
+  {
+    "OK",
+    "Settings",
+    "Recently Watched",
+    "The quick brown fox jumps over the lazy dog 0123456789",
+    "Caf\303\251 cr\303\250me br\303\273l\303\251e \303\240 la fran\303\247aise, \303\274ber na\303\257ve",
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "
+    "incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud "
+    "exercitation ullamco laboris nisi ut aliquip ex ea commodo consequat.\nDuis aute",
+  };
+  const int corpusSize = sizeof(corpus)/sizeof(corpus[0]);
+  uint32_t sizes[] = { 12, 16, 24, 36 };
+  const int iterations = 20000;
+
+  // warm the glyph cache so only lookups are timed
+  rtObjectRef o;
+  for (int s = 0; s < 4; s++)
+    for (int c = 0; c < corpusSize; c++)
+      font->measureText(sizes[s], corpus[c], o);
+
+  uint64_t chars = 0;
+  double start = pxMilliseconds();
+  for (int i = 0; i < iterations; i++)
+  {
+    const char* text = corpus[i%corpusSize];
+    font->measureText(sizes[i%4], text, o);
+    chars += strlen(text);
+  }
+  double elapsed = pxMilliseconds()-start;
+
+  EXPECT_GT(o.get<float>("w"), 0);
+  EXPECT_GT(o.get<float>("h"), 0);
+  printf("measureText: %d calls, %llu bytes in %.2f ms (%.1f ns/byte)\n", iterations,
+         (unsigned long long)chars, elapsed, elapsed*1000000.0/(double)chars);
+}
@@ -0,0 +1,113 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sstream>
+#include <string.h>
+#include <string>
+
+#define private public
+#define protected public
+
+#include "pxScene2d.h"
+#include "pxFont.h"
+#include "pxTextBox.h"
+#include "pxTimer.h"
+
+#include "test_includes.h" // Needs to be included last
+
+static const char* epgDescription =
+  "After a mysterious signal is picked up by an isolated research station, a team of "
+  "scientists, engineers and one reluctant pilot travel to the edge of the ice shelf to "
+  "find its source. What they discover there changes everything they thought they knew "
+  "about the planet, the people who sent them and each other. Meanwhile, back home, an "
+  "investigative journalist starts asking questions about the funding of the expedition, "
+  "and a former colleague resurfaces with a warning nobody wants to hear. ";
+
+class pxTextBoxBenchmark : public testing::Test
+{
+  public:
+    virtual void SetUp()
+    {
+      mScene = new pxScene2d();
+      pxFontManager::initFT();
+      mFont = new pxFont("FreeSans.ttf", 0, "");
+      mFontOk = mFont->init("../../examples/pxScene2d/src/FreeSans.ttf") == RT_OK;
+    }
+
+    virtual void TearDown()
+    {
+      mFont = NULL;
+      delete mScene;
+    }
+
+    rtRef<pxTextBox> createTextBox(const char* text, float w, float h)
+    {
+      rtRef<pxTextBox> t = new pxTextBox(mScene);
+      t->mFont = mFont.getPtr();
+      t->mFontLoaded = true;
+      t->mInitialized = true;
+      t->mw = w;
+      t->mh = h;
+      t->setText(text);
+      t->recalc();
+      return t;
+    }
+
+    void relayoutBenchmark()
+    {
+      ASSERT_TRUE(mFontOk);
+      std::string text;
+      for (int i = 0; i < 8; i++)
+        text += epgDescription;
+
+      rtRef<pxTextBox> t = createTextBox(text.c_str(), 640, 2000);
+      t->setWordWrap(true);
+      t->recalc();
+
+      const int iterations = 200;
+      double start = pxMilliseconds();
+      for (int i = 0; i < iterations; i++)
+      {
+        // alternate widths so every iteration is a real relayout
+        t->setW((i & 1) ? 640 : 600);
+        t->recalc();
+      }
+      double relayout = (pxMilliseconds()-start)/iterations;
+
+      start = pxMilliseconds();
+      for (int i = 0; i < iterations; i++)
+      {
+        t->setW(600);
+        t->recalc();
+      }
+      double cached = (pxMilliseconds()-start)/iterations;
+
+      printf("pxTextBox %d byte wrapped relayout: %.3f ms, unchanged relayout: %.4f ms\n",
+             (int)text.length(), relayout, cached);
+    }
+
+  private:
+    pxScene2d* mScene;
+    rtRef<pxFont> mFont;
+    bool mFontOk;
+};
+
+TEST_F(pxTextBoxBenchmark, relayoutBenchmark)
+{
+  relayoutBenchmark();
+}
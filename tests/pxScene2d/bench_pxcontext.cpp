@@ -0,0 +1,139 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sstream>
+#include <vector>
+
+#define private public
+#define protected public
+#include <pxCore.h>
+#include <pxWindow.h>
+#include <pxScene2d.h>
+#include <pxContext.h>
+#include <rtRef.h>
+#include "pxTimer.h"
+
+#include "test_includes.h" // Needs to be included last
+
+extern pxContext context;
+
+class benchWindow : public pxWindow, public pxIViewContainer
+{
+  public:
+    virtual void invalidateRect(pxRect* /*r*/)
+    {
+    }
+
+    virtual void* RT_STDCALL getInterface(const char* /*t*/)
+    {
+      return NULL;
+    }
+
+    rtError setView(pxIView* /*v*/)
+    {
+      return RT_OK;
+    }
+
+    virtual void onAnimationTimer()
+    {
+    }
+};
+
+class benchDrawObject : public pxObject
+{
+  public:
+    benchDrawObject(pxScene2d* scene): pxObject(scene) {}
+    virtual void draw() {}
+};
+
+class pxContextBenchmark : public testing::Test
+{
+  public:
+    virtual void SetUp()
+    {
+      mWindow = new benchWindow();
+      mWindow->init(0,0,1280,720);
+      context.init();
+      context.setSize(1280,720);
+    }
+
+    virtual void TearDown()
+    {
+    }
+
+    double drawFrames(rtRef<pxObject> root, int frames)
+    {
+      root->update(pxSeconds());
+      double start = pxSeconds();
+      for (int i = 0; i < frames; i++)
+      {
+        context.pushState();
+        root->drawInternal();
+        context.popState();
+      }
+      return pxSeconds() - start;
+    }
+
+    // Draws a scene with 10k children parked off screen and again without them
+    void offscreenChildrenBenchmark()
+    {
+      pxScene2d* scene = new pxScene2d(false);
+      rtRef<pxObject> root = new pxObject(scene);
+      root->mw = 1280;
+      root->mh = 720;
+
+      rtRef<benchDrawObject> visible = new benchDrawObject(scene);
+      visible->mw = 100;
+      visible->mh = 100;
+      visible->setParent(root);
+
+      rtRef<pxObject> offscreen = new pxObject(scene);
+      offscreen->mx = 2000;
+      offscreen->setParent(root);
+
+      const int numChildren = 10000;
+      std::vector<rtRef<benchDrawObject> > children;
+      for (int i = 0; i < numChildren; i++)
+      {
+        rtRef<benchDrawObject> child = new benchDrawObject(scene);
+        child->mx = (float)((i % 100) * 20);
+        child->my = (float)((i / 100) * 20);
+        child->mw = 10;
+        child->mh = 10;
+        rtRef<pxObject> parent = offscreen;
+        child->setParent(parent);
+        children.push_back(child);
+      }
+
+      const int frames = 100;
+      double withOffscreen = drawFrames(root, frames);
+      offscreen->remove();
+      double withoutOffscreen = drawFrames(root, frames);
+
+      printf("draw with %d offscreen children: %f ms/frame, without: %f ms/frame\n",
+             numChildren, withOffscreen*1000/frames, withoutOffscreen*1000/frames);
+    }
+
+  private:
+    benchWindow* mWindow;
+};
+
+TEST_F(pxContextBenchmark, offscreenChildrenBenchmark)
+{
+  offscreenChildrenBenchmark();
+}
@@ -0,0 +1,118 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sstream>
+
+#define private public
+#define protected public
+
+#include "rtFileDownloader.h"
+#include "pxTimer.h"
+#include "test_httpserver.h"
+#include <condition_variable>
+#include <mutex>
+
+#include "test_includes.h" // Needs to be included last
+
+class rtFileDownloaderBenchmark : public testing::Test
+{
+  public:
+    virtual void SetUp()
+    {
+      mServerOk = mServer.start();
+      mCompleted = 0;
+      mMaxDownloads = rtFileDownloader::instance()->mMaxDownloads;
+      mMaxDownloadsPerHost = rtFileDownloader::instance()->mMaxDownloadsPerHost;
+    }
+
+    virtual void TearDown()
+    {
+      rtFileDownloader::instance()->setMaxConnections(mMaxDownloads, mMaxDownloadsPerHost);
+      mServer.stop();
+    }
+
+    static void downloadCallback(rtFileDownloadRequest* request)
+    {
+      rtFileDownloaderBenchmark* bench = (rtFileDownloaderBenchmark*)request->callbackData();
+      std::lock_guard<std::mutex> lock(bench->mMutex);
+      bench->mCompleted++;
+      bench->mCondition.notify_all();
+    }
+
+    void download(const std::string& url)
+    {
+      rtFileDownloadRequest* request = new rtFileDownloadRequest(url.c_str(), this, downloadCallback);
+#ifdef ENABLE_HTTP_CACHE
+      request->setCacheEnabled(false);
+#endif
+      rtFileDownloader::instance()->addToDownloadQueue(request);
+    }
+
+    bool waitForDownloads(int count)
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      return mCondition.wait_for(lock, std::chrono::seconds(60), [&]{ return mCompleted >= count; });
+    }
+
+    // Blocking transfers one at a time, as the thread pool workers did, and
+    // the same requests queued on the shared multi handle
+    void downloadBenchmark()
+    {
+      ASSERT_TRUE(mServerOk);
+      const int count = 500;
+      rtFileDownloader::instance()->setMaxConnections(256, 16);
+
+      double start = pxMilliseconds();
+      for (int i = 0; i < 50; i++)
+      {
+        char path[32];
+        snprintf(path, sizeof(path), "/serial/%d", i);
+        rtFileDownloadRequest request(mServer.url(path).c_str(), NULL);
+        rtFileDownloader::instance()->downloadFromNetwork(&request);
+      }
+      double serial = (pxMilliseconds() - start)/50;
+
+      int connections = mServer.connections();
+      start = pxMilliseconds();
+      for (int i = 0; i < count; i++)
+      {
+        char path[32];
+        snprintf(path, sizeof(path), "/bench/%d", i);
+        download(mServer.url(path));
+      }
+      ASSERT_TRUE(waitForDownloads(count));
+      double multi = (pxMilliseconds() - start)/count;
+
+      printf("rtFileDownloader per request: blocking %.3f ms, multi %.3f ms (%d requests, %d new connections)\n",
+             serial, multi, count, mServer.connections() - connections);
+    }
+
+  private:
+    rtTestHttpServer mServer;
+    bool mServerOk;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    int mCompleted;
+    unsigned int mMaxDownloads;
+    unsigned int mMaxDownloadsPerHost;
+};
+
+TEST_F(rtFileDownloaderBenchmark, downloadBenchmark)
+{
+  downloadBenchmark();
+}
@@ -0,0 +1,48 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "rtLog.h"
+#include "test_logcapture.h"
+
+#include "test_includes.h" // Needs to be included last
+
+// Time spent in the logging calls, written synchronously and through the
+// async queue
+TEST(rtLogBenchmark, syncAsyncBenchmark)
+{
+  const int threads = 4;
+  const int count = 20000;
+  rtLogSetLevel(RT_LOG_WARN);
+
+  rtLogCapture syncCapture("/tmp/rtLogBenchmarkSync.log");
+  double sync = logFromThreads(threads, count);
+  size_t syncLines = syncCapture.lines().size();
+
+  rtLogCapture asyncCapture("/tmp/rtLogBenchmarkAsync.log");
+  uint64_t dropped = rtLogDroppedCount();
+  rtLogSetAsync(true);
+  double async = logFromThreads(threads, count);
+  rtLogSetAsync(false);
+  dropped = rtLogDroppedCount() - dropped;
+  size_t asyncLines = asyncCapture.lines().size();
+
+  printf("rtLog %d lines from %d threads: sync %.0f ns/line, async %.0f ns/line in the caller (%d dropped)\n",
+         threads*count, threads, sync*1e6/(threads*count), async*1e6/(threads*count), (int)dropped);
+  EXPECT_EQ((size_t)(threads*count), syncLines);
+  EXPECT_EQ((size_t)(threads*count), asyncLines + dropped);
+}
@@ -0,0 +1,106 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "rtObject.h"
+#include "rtString.h"
+#include "pxTimer.h"
+#include <vector>
+
+#include "test_includes.h" // Needs to be included last
+
+class rtBenchObject : public rtObject
+{
+public:
+  rtDeclareObject(rtBenchObject, rtObject);
+  rtProperty(width, width, setWidth, int32_t);
+  rtMethodNoArgAndReturn("area", area, int32_t);
+
+  rtBenchObject(): mWidth(0) {}
+
+  rtError width(int32_t& v) const { v = mWidth; return RT_OK; }
+  rtError setWidth(int32_t v) { mWidth = v; return RT_OK; }
+  rtError area(int32_t& v) { v = mWidth * mWidth; return RT_OK; }
+
+  int32_t mWidth;
+};
+
+rtDefineObject(rtBenchObject, rtObject);
+rtDefineProperty(rtBenchObject, width);
+rtDefineMethod(rtBenchObject, area);
+
+TEST(rtObjectBenchmark, lookupBenchmark)
+{
+  rtObjectRef o = new rtBenchObject;
+  rtAtom width = rtAtomIntern("width");
+  rtValue v;
+  const int iterations = 1000000;
+
+  double start = pxMilliseconds();
+  for (int i = 0; i < iterations; i++)
+    o->Get("width", &v);
+  double byName = pxMilliseconds() - start;
+
+  start = pxMilliseconds();
+  for (int i = 0; i < iterations; i++)
+    ((rtObject*)o.getPtr())->getByAtom(width, &v);
+  double byAtom = pxMilliseconds() - start;
+
+  start = pxMilliseconds();
+  for (int i = 0; i < iterations; i++)
+    o->Get("area", &v);
+  double method = pxMilliseconds() - start;
+
+  printf("rtObject lookups per second: by name %.0f, by atom %.0f, method %.0f\n",
+         iterations / byName * 1000, iterations / byAtom * 1000, iterations / method * 1000);
+}
+
+static rtError countEvent(int /*numArgs*/, const rtValue* /*args*/, rtValue* /*result*/, void* context)
+{
+  (*(int*)context)++;
+  return RT_OK;
+}
+
+// a scene sized emitter: lots of listeners spread over many events
+TEST(rtObjectBenchmark, dispatchBenchmark)
+{
+  rtRefT<rtEmit> emit = new rtEmit;
+  const int numEvents = 50;
+  const int perEvent = 4;
+  int count = 0;
+  std::vector<rtFunctionRef> listeners;
+  char name[32];
+  for (int i = 0; i < numEvents; i++)
+  {
+    snprintf(name, sizeof(name), "onSceneEvent%d", i);
+    for (int j = 0; j < perEvent; j++)
+    {
+      rtFunctionRef f = new rtFunctionCallback(countEvent, &count);
+      listeners.push_back(f);
+      emit->addListener(name, f.getPtr());
+    }
+  }
+
+  rtEmitRef e = emit.getPtr();
+  const int iterations = 100000;
+  double start = pxMilliseconds();
+  for (int i = 0; i < iterations; i++)
+    e.send("onSceneEvent25", i);
+  double elapsed = pxMilliseconds() - start;
+  printf("rtEmit %d listeners over %d events: %.3f us per dispatch\n",
+         numEvents*perEvent, numEvents, elapsed*1000/iterations);
+}
@@ -0,0 +1,80 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sstream>
+
+#define private public
+#define protected public
+
+#include "rtString.h"
+#include <vector>
+#include <map>
+
+#include "pxTimer.h"
+
+#include "test_includes.h" // Needs to be included last
+
+// One frame's worth of the string traffic we see in scene updates:
+// property names looked up and copied into rtValues, event names
+// keyed into maps, and urls and text passed around and extended
+TEST(rtStringBenchmark, allocationBenchmark)
+{
+  const char* names[] = {"x", "y", "w", "h", "a", "r", "sx", "sy", "cx", "cy",
+                         "draw", "interactive", "painting", "clip", "mask", "onMouseMove"};
+  const char* urls[] = {"https://px-apps.sys.comcast.net/pxscene-samples/images/tiles/008.jpg",
+                        "http://localhost:8080/examples/pxScene2d/src/browser/images/status_bg.png"};
+  const int frames = 200;
+  uint32_t strdupAllocations = 0;
+
+  uint32_t allocations = rtString::bufferAllocations();
+  double start = pxMilliseconds();
+  for (int frame = 0; frame < frames; frame++)
+  {
+    std::map<rtString, int> events;
+    std::vector<rtString> values;
+    for (int object = 0; object < 100; object++)
+    {
+      for (size_t n = 0; n < sizeof(names)/sizeof(names[0]); n++)
+      {
+        rtString name(names[n]);
+        values.push_back(name);
+        strdupAllocations += 2;
+      }
+      rtString url(urls[object & 1]);
+      rtString copy = url;
+      values.push_back(copy);
+      strdupAllocations += 3;
+
+      rtString text("item ");
+      text.append(names[object % 16]);
+      text.append(" of the list");
+      values.push_back(text);
+      strdupAllocations += 4;
+    }
+    for (size_t n = 0; n < sizeof(names)/sizeof(names[0]); n++)
+    {
+      events[names[n]]++;
+      strdupAllocations += 1;
+    }
+  }
+  double elapsed = pxMilliseconds() - start;
+  uint32_t sso = rtString::bufferAllocations() - allocations;
+
+  printf("rtString allocations per frame: %u with strdup copies, %u now (%.3f ms per frame)\n",
+         strdupAllocations / frames, sso / frames, elapsed / frames);
+}
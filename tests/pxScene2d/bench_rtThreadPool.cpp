@@ -0,0 +1,118 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "rtThreadPool.h"
+#include "rtMutex.h"
+#include "pxTimer.h"
+#include <algorithm>
+#include <vector>
+
+#include "test_includes.h" // Needs to be included last
+
+class rtThreadPoolBenchmark : public testing::Test
+{
+  public:
+    virtual void SetUp()
+    {
+      mCompleted = 0;
+    }
+
+    struct rtQueueLatency
+    {
+      rtThreadPoolBenchmark* test;
+      double submitted;
+      double started;
+      int work;
+    };
+
+    static void latencyTask(void* data)
+    {
+      rtQueueLatency* l = (rtQueueLatency*)data;
+      l->started = pxMilliseconds();
+      // large tasks stand in for an image decode, tiny ones for bookkeeping
+      volatile double x = 0;
+      for (int i = 0; i < l->work; i++)
+        x += i * 0.5;
+      l->test->mMutex.lock();
+      l->test->mCompleted++;
+      l->test->mMutex.unlock();
+    }
+
+    void waitForCompleted(int count)
+    {
+      for (;;)
+      {
+        mMutex.lock();
+        int completed = mCompleted;
+        mMutex.unlock();
+        if (completed >= count)
+          return;
+        pxSleepMS(1);
+      }
+    }
+
+    static double percentile(std::vector<double>& v, double p)
+    {
+      if (v.empty())
+        return 0;
+      std::sort(v.begin(), v.end());
+      return v[(size_t)(p * (v.size() - 1))];
+    }
+
+    void floodBenchmark()
+    {
+      rtThreadPool p(4);
+      const int count = 20000;
+      std::vector<rtQueueLatency> tasks(count);
+      double start = pxMilliseconds();
+      for (int i = 0; i < count; i++)
+      {
+        rtQueueLatency& l = tasks[i];
+        l.test = this;
+        // one in twenty tasks is large, and every tenth one is for something
+        // on screen
+        l.work = (i % 20 == 0) ? 200000 : 100;
+        rtThreadTaskPriority priority = (i % 10 == 5) ? RT_THREAD_TASK_PRIORITY_VISIBLE :
+                                        (i % 2) ? RT_THREAD_TASK_PRIORITY_PREFETCH : RT_THREAD_TASK_PRIORITY_BACKGROUND;
+        l.submitted = pxMilliseconds();
+        p.executeTask(new rtThreadTask(latencyTask, &l, "", priority));
+      }
+      waitForCompleted(count);
+      double elapsed = pxMilliseconds() - start;
+
+      std::vector<double> all, visible;
+      for (int i = 0; i < count; i++)
+      {
+        double latency = tasks[i].started - tasks[i].submitted;
+        all.push_back(latency);
+        if (i % 10 == 5)
+          visible.push_back(latency);
+      }
+      printf("rtThreadPool %d mixed tasks on 4 threads: %.0f tasks/s, queueing p50 %.2f ms p99 %.2f ms, visible p99 %.2f ms\n",
+             count, count * 1000 / elapsed, percentile(all, 0.5), percentile(all, 0.99), percentile(visible, 0.99));
+    }
+
+  private:
+    rtMutex mMutex;
+    int mCompleted;
+};
+
+TEST_F(rtThreadPoolBenchmark, floodBenchmark)
+{
+  floodBenchmark();
+}
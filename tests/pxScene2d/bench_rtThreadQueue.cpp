@@ -0,0 +1,79 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "rtThreadQueue.h"
+#include "pxTimer.h"
+#include <pthread.h>
+
+#include "test_includes.h" // Needs to be included last
+
+static void countTask(void* context, void* /*data*/)
+{
+  (*(int*)context)++;
+}
+
+struct rtThreadQueueProducer
+{
+  rtThreadQueue* queue;
+  int* counter;
+  int count;
+};
+
+static void* produceTasks(void* arg)
+{
+  rtThreadQueueProducer* p = (rtThreadQueueProducer*)arg;
+  for (int i = 0; i < p->count; i++)
+    p->queue->addTask(countTask, p->counter, NULL);
+  return NULL;
+}
+
+// Producers flood the queue while the main thread drains it in 5 ms frames
+TEST(rtThreadQueueBenchmark, drainBenchmark)
+{
+  const int producers = 4;
+  const int count = 50000;
+  rtThreadQueue q;
+  int counter = 0;
+  pthread_t threads[producers];
+  rtThreadQueueProducer p[producers];
+  double start = pxMilliseconds();
+  for (int i = 0; i < producers; i++)
+  {
+    p[i].queue = &q;
+    p[i].counter = &counter;
+    p[i].count = count;
+    pthread_create(&threads[i], NULL, produceTasks, &p[i]);
+  }
+  int frames = 0;
+  double maxFrame = 0;
+  while (counter < producers*count)
+  {
+    double frameStart = pxMilliseconds();
+    q.process(0.005);
+    double frame = pxMilliseconds()-frameStart;
+    if (frame > maxFrame)
+      maxFrame = frame;
+    frames++;
+  }
+  double elapsed = pxMilliseconds()-start;
+  for (int i = 0; i < producers; i++)
+    pthread_join(threads[i], NULL);
+
+  printf("rtThreadQueue %d tasks from %d producers: %.1f ms (%.0f tasks/ms), %d drains, longest %.2f ms\n",
+         producers*count, producers, elapsed, producers*count/elapsed, frames, maxFrame);
+}
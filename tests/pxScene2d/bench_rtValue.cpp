@@ -0,0 +1,75 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "rtValue.h"
+#include "rtObject.h"
+#include "pxTimer.h"
+#include <vector>
+
+#include "test_includes.h" // Needs to be included last
+
+static rtError countArgs(int numArgs, const rtValue* /*args*/, rtValue* /*result*/, void* context)
+{
+  *(int*)context += numArgs;
+  return RT_OK;
+}
+
+// Calls a four argument function with the arguments passed directly, in a
+// std::vector and in an rtValueList
+TEST(rtValueBenchmark, sendArgumentsBenchmark)
+{
+  int calls = 0;
+  rtFunctionRef f(new rtFunctionCallback(countArgs, &calls));
+  rtString title("Channel 4 News");
+  rtString description("After a mysterious signal is picked up by an isolated research station");
+  rtObjectRef obj(new rtMapObject);
+
+  const int iterations = 100000;
+  double start = pxMilliseconds();
+  for (int i = 0; i < iterations; i++)
+    f.send(title, description, i, obj);
+  double sendTime = pxMilliseconds()-start;
+
+  start = pxMilliseconds();
+  for (int i = 0; i < iterations; i++)
+  {
+    std::vector<rtValue> argv;
+    argv.push_back(title);
+    argv.push_back(description);
+    argv.push_back(i);
+    argv.push_back(obj);
+    f->Send((int)argv.size(), &argv[0], NULL);
+  }
+  double vectorTime = pxMilliseconds()-start;
+
+  start = pxMilliseconds();
+  for (int i = 0; i < iterations; i++)
+  {
+    rtValueList<8> argv;
+    argv.push_back(title);
+    argv.push_back(description);
+    argv.push_back(i);
+    argv.push_back(obj);
+    f->Send(argv.size(), argv.data(), NULL);
+  }
+  double listTime = pxMilliseconds()-start;
+
+  printf("rtFunctionRef::send 4 args: %.3f us/call\n", sendTime*1000/iterations);
+  printf("std::vector<rtValue> args:  %.3f us/call\n", vectorTime*1000/iterations);
+  printf("rtValueList<8> args:        %.3f us/call\n", listTime*1000/iterations);
+}
@@ -0,0 +1,204 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef TEST_HTTPSERVER_H
+#define TEST_HTTPSERVER_H
+
+#include "pxTimer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal keep-alive HTTP server on the loopback interface.  Every GET is
+// answered with "body:<path>"; paths starting with /slow/ are held back for
+// a while so requests pile up behind them.  /big/<n> and /chunked/<n> answer
+// with bigBody(n), with and without a Content-Length.
+static std::string bigBody(size_t size)
+{
+  std::string body(size, ' ');
+  for (size_t i = 0; i < size; i++)
+    body[i] = 'a' + (i % 26);
+  return body;
+}
+
+class rtTestHttpServer
+{
+public:
+  rtTestHttpServer() : mSocket(-1), mPort(0), mRunning(false), mConnections(0), mInFlight(0), mMaxInFlight(0) {}
+  ~rtTestHttpServer() { stop(); }
+
+  bool start()
+  {
+    mSocket = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(mSocket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(mSocket, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(mSocket, 512) != 0)
+      return false;
+    socklen_t len = sizeof(addr);
+    getsockname(mSocket, (struct sockaddr*)&addr, &len);
+    mPort = ntohs(addr.sin_port);
+    mRunning = true;
+    mAcceptThread = std::thread(&rtTestHttpServer::acceptConnections, this);
+    return true;
+  }
+
+  void stop()
+  {
+    if (!mRunning)
+      return;
+    mRunning = false;
+    shutdown(mSocket, SHUT_RDWR);
+    close(mSocket);
+    mAcceptThread.join();
+    mMutex.lock();
+    for (size_t i = 0; i < mClientSockets.size(); i++)
+      shutdown(mClientSockets[i], SHUT_RDWR);
+    mMutex.unlock();
+    for (size_t i = 0; i < mClientThreads.size(); i++)
+      mClientThreads[i].join();
+  }
+
+  std::string url(const char* path) const
+  {
+    char u[256];
+    snprintf(u, sizeof(u), "http://127.0.0.1:%d%s", mPort, path);
+    return u;
+  }
+
+  int requestCount(const std::string& path)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return (int)std::count(mRequests.begin(), mRequests.end(), path);
+  }
+
+  std::vector<std::string> requests()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mRequests;
+  }
+
+  int connections() { std::lock_guard<std::mutex> lock(mMutex); return mConnections; }
+  int maxInFlight() { std::lock_guard<std::mutex> lock(mMutex); return mMaxInFlight; }
+
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRequests.clear();
+    mMaxInFlight = 0;
+  }
+
+private:
+  void acceptConnections()
+  {
+    while (mRunning)
+    {
+      int client = accept(mSocket, NULL, NULL);
+      if (client < 0)
+        continue;
+      std::lock_guard<std::mutex> lock(mMutex);
+      mConnections++;
+      mClientSockets.push_back(client);
+      mClientThreads.push_back(std::thread(&rtTestHttpServer::serveConnection, this, client));
+    }
+  }
+
+  void serveConnection(int client)
+  {
+    std::string buffer;
+    char data[4096];
+    while (true)
+    {
+      size_t end = buffer.find("\r\n\r\n");
+      if (end == std::string::npos)
+      {
+        ssize_t n = recv(client, data, sizeof(data), 0);
+        if (n <= 0)
+          break;
+        buffer.append(data, n);
+        continue;
+      }
+      std::string request = buffer.substr(0, end);
+      buffer.erase(0, end + 4);
+      size_t pathStart = request.find(' ') + 1;
+      std::string path = request.substr(pathStart, request.find(' ', pathStart) - pathStart);
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRequests.push_back(path);
+        mMaxInFlight = std::max(mMaxInFlight, ++mInFlight);
+      }
+      if (path.compare(0, 6, "/slow/") == 0)
+        pxSleepMS(100);
+      std::string response;
+      if (path.compare(0, 9, "/chunked/") == 0)
+      {
+        std::string body = bigBody(atoi(path.c_str() + 9));
+        response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nConnection: keep-alive\r\n\r\n";
+        for (size_t offset = 0; offset < body.length(); offset += 5000)
+        {
+          std::string piece = body.substr(offset, 5000);
+          char size[32];
+          snprintf(size, sizeof(size), "%x\r\n", (int)piece.length());
+          response += size + piece + "\r\n";
+        }
+        response += "0\r\n\r\n";
+      }
+      else
+      {
+        std::string body = path.compare(0, 5, "/big/") == 0 ? bigBody(atoi(path.c_str() + 5)) : "body:" + path;
+        char header[256];
+        snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\nConnection: keep-alive\r\n\r\n", (int)body.length());
+        response = std::string(header) + body;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mInFlight--;
+      }
+      if (send(client, response.c_str(), response.length(), MSG_NOSIGNAL) < 0)
+        break;
+    }
+    close(client);
+  }
+
+  int mSocket;
+  int mPort;
+  std::atomic<bool> mRunning;
+  std::thread mAcceptThread;
+  std::mutex mMutex;
+  std::vector<int> mClientSockets;
+  std::vector<std::thread> mClientThreads;
+  std::vector<std::string> mRequests;
+  int mConnections;
+  int mInFlight;
+  int mMaxInFlight;
+};
+
+#endif // TEST_HTTPSERVER_H
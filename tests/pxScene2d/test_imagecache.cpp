@@ -160,9 +160,14 @@ class pxFileCacheTest : public testing::Test, public commonTestFns
     void fileCachePopulateExistingFilesWithCacheTest()
     {
       rtFileCache::instance()->initCache();
-      bool sysret = system("touch /tmp/cache/a.txt");
+      // only files named like cache files are picked up
+      bool sysret = system("echo \"Hello\" >  /tmp/cache/a.txt");
       UNUSED_PARAM(sysret);
-      sysret = system("echo \"Hello\" >  /tmp/cache/a.txt");
+      rtFileCache::instance()->populateExistingFiles();
+      EXPECT_TRUE (rtFileCache::instance()->cacheSize() == 0);
+      rtString cmd("echo \"Hello\" >  /tmp/cache/");
+      cmd.append(rtFileCache::instance()->hashedFileName("http://fileserver/a.txt").cString());
+      sysret = system(cmd.cString());
       rtFileCache::instance()->populateExistingFiles();
       EXPECT_TRUE (rtFileCache::instance()->cacheSize() > 0);
     }
@@ -312,6 +317,136 @@ class pxFileCacheTest : public testing::Test, public commonTestFns
       rtHttpCacheData data;
       EXPECT_FALSE  (rtFileCache::instance()->readFileHeader(fileName,data));
     }
+    void indexReloadTest()
+    {
+      resetAndAddCacheData();
+      addDataToCache("http://fileserver/b.jpeg","ETag: \"b1\"\n","fghij",5);
+      int64_t size = rtFileCache::instance()->cacheSize();
+      rtFileCache::destroy();
+      struct stat st;
+      EXPECT_TRUE (stat("/tmp/cache/cache.index", &st) == 0);
+
+      // the new instance loads the index instead of scanning the directory,
+      // so a file the index doesn't know about is not picked up
+      bool sysret = system("echo \"Hello\" > /tmp/cache/12345");
+      UNUSED_PARAM(sysret);
+      EXPECT_EQ (size, rtFileCache::instance()->cacheSize());
+      unlink("/tmp/cache/12345");
+
+      // the etag still comes from the header in the cache file
+      rtFileCache* cache = rtFileCache::instance();
+      EXPECT_TRUE (cache->mEntries.find(cache->urlKey("http://fileserver/b.jpeg")) != cache->mEntries.end());
+      rtHttpCacheData data;
+      EXPECT_TRUE (cache->httpCacheData("http://fileserver/b.jpeg",data) == RT_OK);
+      rtString tag;
+      EXPECT_TRUE (data.etag(tag) == RT_OK);
+      fclose(data.filePointer());
+    }
+
+    void lruEvictionTest()
+    {
+      rtFileCache* cache = rtFileCache::instance();
+      cache->clearCache();
+      addDataToCache("http://fileserver/a.jpeg","","abcde",5);
+      addDataToCache("http://fileserver/b.jpeg","","abcde",5);
+      addDataToCache("http://fileserver/c.jpeg","","abcde",5);
+      int64_t entrySize = cache->cacheSize() / 3;
+
+      // a was added first but used last, so b is the one to go
+      rtHttpCacheData data;
+      EXPECT_TRUE (cache->httpCacheData("http://fileserver/a.jpeg",data) == RT_OK);
+      fclose(data.filePointer());
+      int64_t oldMaxSize = cache->maxCacheSize();
+      cache->setMaxCacheSize(2 * entrySize);
+      EXPECT_EQ (2 * entrySize, cache->cleanup());
+      cache->setMaxCacheSize(oldMaxSize);
+
+      rtHttpCacheData a, b, c;
+      EXPECT_TRUE (cache->httpCacheData("http://fileserver/a.jpeg",a) == RT_OK);
+      EXPECT_TRUE (cache->httpCacheData("http://fileserver/b.jpeg",b) == RT_ERROR);
+      EXPECT_TRUE (cache->httpCacheData("http://fileserver/c.jpeg",c) == RT_OK);
+      fclose(a.filePointer());
+      fclose(c.filePointer());
+      cache->waitForWrites();
+      struct stat st;
+      rtString bFile = cache->absPath(cache->hashedFileName("http://fileserver/b.jpeg"));
+      EXPECT_TRUE (stat(bFile.cString(), &st) != 0);
+    }
+
+    void hotEntryTest()
+    {
+      rtFileCache* cache = rtFileCache::instance();
+      resetAndAddCacheData();
+      cache->waitForWrites();
+      rtString filename = cache->hashedFileName("http://fileserver/a.jpeg");
+      struct stat st;
+      EXPECT_TRUE (stat(cache->absPath(filename).cString(), &st) == 0);
+
+      // small entries are answered from memory
+      rtFileCache::rtFileCacheEntry& entry = cache->mEntries[cache->urlKey("http://fileserver/a.jpeg")];
+      EXPECT_TRUE (entry.hot);
+      EXPECT_FALSE (entry.pendingWrite);
+      rtHttpCacheData data;
+      EXPECT_TRUE (cache->httpCacheData("http://fileserver/a.jpeg",data) == RT_OK);
+      data.populateExpirationDateFromCache();
+      EXPECT_TRUE (data.readFileData());
+      EXPECT_EQ (5u, data.contentsData().length());
+      EXPECT_TRUE (memcmp(data.contentsData().data(), "abcde", 5) == 0);
+
+      // large ones are read from the file once written
+      string large(256 * 1024, 'x');
+      addDataToCache("http://fileserver/large.jpeg","",large.c_str(),large.length());
+      cache->waitForWrites();
+      rtFileCache::rtFileCacheEntry& largeEntry = cache->mEntries[cache->urlKey("http://fileserver/large.jpeg")];
+      EXPECT_FALSE (largeEntry.hot);
+      EXPECT_TRUE (largeEntry.data.get() == NULL);
+      rtHttpCacheData largeData;
+      EXPECT_TRUE (cache->httpCacheData("http://fileserver/large.jpeg",largeData) == RT_OK);
+      largeData.populateExpirationDateFromCache();
+      EXPECT_TRUE (largeData.readFileData());
+      EXPECT_EQ (large.length(), largeData.contentsData().length());
+    }
+
+    void evictAndReaddTest()
+    {
+      rtFileCache* cache = rtFileCache::instance();
+      cache->clearCache();
+      cache->waitForWrites();
+      rtString filename = cache->absPath(cache->hashedFileName("http://fileserver/a.jpeg"));
+
+      // hold the writer back while a.jpeg is written, dropped and written again
+      cache->stopWriter();
+      addDataToCache("http://fileserver/a.jpeg","","stale",5);
+      EXPECT_TRUE (cache->removeData("http://fileserver/a.jpeg") == RT_OK);
+      addDataToCache("http://fileserver/a.jpeg","","fresh",5);
+      uint64_t key = cache->urlKey("http://fileserver/a.jpeg");
+      EXPECT_EQ (3u, cache->mWrites.size());
+      EXPECT_NE (cache->mWrites.front().generation, cache->mEntries[key].generation);
+
+      // the write queued for the dropped entry must not count for the new one
+      std::list<rtFileCache::rtFileCacheWrite> later;
+      later.splice(later.end(), cache->mWrites, ++cache->mWrites.begin(), cache->mWrites.end());
+      cache->startWriter();
+      cache->waitForWrites();
+      struct stat st;
+      EXPECT_TRUE (stat(filename.cString(), &st) != 0);
+      EXPECT_TRUE (cache->mEntries[key].pendingWrite);
+
+      cache->mCacheMutex.lock();
+      cache->mWrites.splice(cache->mWrites.end(), later);
+      cache->mWriterCondition.signal();
+      cache->mCacheMutex.unlock();
+      cache->waitForWrites();
+      EXPECT_FALSE (cache->mEntries[key].pendingWrite);
+      rtData written;
+      EXPECT_TRUE (rtLoadFile(filename.cString(), written) == RT_OK);
+      EXPECT_TRUE (written.length() > 5);
+      if (written.length() > 5)
+      {
+        EXPECT_TRUE (memcmp(written.data() + written.length() - 5, "fresh", 5) == 0);
+      }
+    }
+
   private:
 
      void resetAndAddCacheData()
@@ -345,6 +480,10 @@ TEST_F(pxFileCacheTest, fileCacheCompleteTest)
   cleanupCacheTest();
   createNewDirectoryCacheTest();
   improperCacheFileFailReadTest();
+  indexReloadTest();
+  lruEvictionTest();
+  hotEntryTest();
+  evictAndReaddTest();
 }
 
 class rtHttpCacheTest : public testing::Test, public commonTestFns
@@ -0,0 +1,107 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef TEST_LOGCAPTURE_H
+#define TEST_LOGCAPTURE_H
+
+#include "rtLog.h"
+#include "pxTimer.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// sends stdout to a file while it's in scope
+class rtLogCapture
+{
+public:
+  rtLogCapture(const char* path) : mPath(path)
+  {
+    fflush(stdout);
+    mStdout = dup(STDOUT_FILENO);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(fd, STDOUT_FILENO);
+    close(fd);
+  }
+
+  ~rtLogCapture()
+  {
+    release();
+  }
+
+  void release()
+  {
+    if (mStdout < 0)
+      return;
+    fflush(stdout);
+    dup2(mStdout, STDOUT_FILENO);
+    close(mStdout);
+    mStdout = -1;
+  }
+
+  std::vector<std::string> lines()
+  {
+    release();
+    std::vector<std::string> result;
+    std::ifstream in(mPath.c_str());
+    std::string line;
+    while (std::getline(in, line))
+      result.push_back(line);
+    unlink(mPath.c_str());
+    return result;
+  }
+
+private:
+  std::string mPath;
+  int mStdout;
+};
+
+// logs in bursts of 100 lines a millisecond apart, the way a busy app does;
+// returns the time spent in the logging calls
+static void logLines(int thread, int count, double* elapsed)
+{
+  *elapsed = 0;
+  for (int i = 0; i < count; i += 100)
+  {
+    double start = pxMilliseconds();
+    for (int j = i; j < i + 100 && j < count; j++)
+      rtLogWarn("thread %d line %d", thread, j);
+    *elapsed += pxMilliseconds() - start;
+    pxSleepMS(1);
+  }
+}
+
+static double logFromThreads(int threads, int count)
+{
+  std::vector<std::thread> loggers;
+  std::vector<double> elapsed(threads);
+  for (int t = 0; t < threads; t++)
+    loggers.push_back(std::thread(logLines, t, count, &elapsed[t]));
+  double total = 0;
+  for (int t = 0; t < threads; t++)
+  {
+    loggers[t].join();
+    total += elapsed[t];
+  }
+  return total;
+}
+
+#endif // TEST_LOGCAPTURE_H
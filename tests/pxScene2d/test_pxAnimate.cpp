@@ -95,6 +95,53 @@ class pxAnimateTest : public testing::Test
          EXPECT_TRUE (mAnimate->mStatus == pxConstantsAnimation::STATUS_INPROGRESS);
     }
 
+    void pxAnimateTypedSlotTest ()
+    {
+         pxScene2d* scene = (pxScene2d*)mScene.getPtr();
+         rtRef<pxObject> o = new pxObject(scene);
+         o->animateTo("x", 100, 1.0, pxConstantsAnimation::TWEEN_LINEAR, pxConstantsAnimation::OPTION_LOOP, 1, rtObjectRef());
+         o->animateTo("m11", 2, 1.0, pxConstantsAnimation::TWEEN_LINEAR, pxConstantsAnimation::OPTION_LOOP, 1, rtObjectRef());
+         EXPECT_TRUE (o->mAnimations.size() == 2);
+         EXPECT_TRUE (o->mAnimations[0]->setter == &pxObject::setX);
+         EXPECT_TRUE (o->mAnimations[1]->setter == NULL);
+         scene->mAnimationEngine.update(1.0);
+         scene->mAnimationEngine.update(1.5);
+         EXPECT_TRUE (o->x() == 50);
+         EXPECT_TRUE (o->mMatrix.constData(0) == 1.5);
+         scene->mAnimationEngine.update(2.0);
+         EXPECT_TRUE (o->x() == 100);
+         EXPECT_TRUE (o->mAnimations.empty());
+         EXPECT_TRUE (scene->mAnimationEngine.size() == 0);
+    }
+
+    void pxAnimationEngineTest ()
+    {
+         pxScene2d* scene = (pxScene2d*)mScene.getPtr();
+         rtRef<pxObject> o1 = new pxObject(scene);
+         rtRef<pxObject> o2 = new pxObject(scene);
+         rtObjectRef promise = new rtPromise();
+         o1->animateTo("x", 10, 1.0, pxConstantsAnimation::TWEEN_LINEAR, pxConstantsAnimation::OPTION_LOOP, 1, promise);
+         o1->animateTo("y", 10, 2.0, pxConstantsAnimation::TWEEN_EXP1, pxConstantsAnimation::OPTION_LOOP, 1, rtObjectRef());
+         o2->animateTo("x", 10, 2.0, pxConstantsAnimation::TWEEN_LINEAR, pxConstantsAnimation::OPTION_LOOP, 1, rtObjectRef());
+         EXPECT_TRUE (scene->mAnimationEngine.size() == 3);
+
+         // setting the property cancels its animation and swap removes it
+         o1->setY(5);
+         EXPECT_TRUE (o1->mAnimations.size() == 1);
+         EXPECT_TRUE (scene->mAnimationEngine.size() == 2);
+
+         scene->mAnimationEngine.update(1.0);
+         scene->mAnimationEngine.update(2.0);
+         EXPECT_TRUE (o1->x() == 10);
+         EXPECT_TRUE (o1->mAnimations.empty());
+         EXPECT_TRUE (((rtPromise*)promise.getPtr())->status());
+         EXPECT_TRUE (o2->x() == 5);
+
+         o2->dispose(false);
+         EXPECT_TRUE (o2->mAnimations.empty());
+         EXPECT_TRUE (scene->mAnimationEngine.size() == 0);
+    }
+
     private:
 
       void validateReadOnlyMembers(rtObjectRef props, uint32_t interp, pxConstantsAnimation::animationOptions type, double duration, int32_t count)
@@ -117,5 +164,7 @@ TEST_F(pxAnimateTest, pxAnimateCompleteTest)
     pxAnimateCancelTest();
     pxAnimatePropsUpdateTest();
     pxAnimateSetStatusTest();
+    pxAnimateTypedSlotTest();
+    pxAnimationEngineTest();
 }
 
@@ -94,3 +94,106 @@ TEST(pxFontTest, loadResourceFromArchiveFailureTest)
       delete scene;
 }
 
+
+#ifdef PXSCENE_FONT_ATLAS
+static bool glyphsOverlap(const GlyphTextureEntry& a, const GlyphTextureEntry& b)
+{
+  if (a.t != b.t)
+    return false;
+  return a.u1 < b.u2 && b.u1 < a.u2 && a.v1 < b.v2 && b.v1 < a.v2;
+}
+
+TEST(pxFontTest, fontAtlasPackingTest)
+{
+  // 64x64 pages; 15x15 glyphs plus padding tile a page exactly 4x4
+  pxFontAtlas atlas(64, 2);
+  uint8_t buffer[64*64];
+  memset(buffer, 0xff, sizeof(buffer));
+
+  vector<GlyphTextureEntry> entries;
+  for (int i = 0; i < 16; i++)
+  {
+    GlyphTextureEntry e;
+    EXPECT_TRUE(atlas.addGlyph(15, 15, buffer, e));
+    entries.push_back(e);
+  }
+  EXPECT_EQ(1u, atlas.stats().pages);
+  EXPECT_EQ(64u*64u, atlas.stats().usedArea);
+
+  // mixed sizes must never overlap within a page
+  uint32_t sizes[] = { 7, 30, 3, 12, 20, 5 };
+  for (int i = 0; i < 6; i++)
+  {
+    GlyphTextureEntry e;
+    EXPECT_TRUE(atlas.addGlyph(sizes[i], sizes[(i+1)%6], buffer, e));
+    entries.push_back(e);
+  }
+  EXPECT_EQ(2u, atlas.stats().pages);
+  for (size_t i = 0; i < entries.size(); i++)
+    for (size_t j = i+1; j < entries.size(); j++)
+      EXPECT_FALSE(glyphsOverlap(entries[i], entries[j]));
+
+  // glyphs that can never fit a page fall back
+  GlyphTextureEntry big;
+  EXPECT_FALSE(atlas.addGlyph(64, 10, buffer, big));
+  EXPECT_EQ(1u, atlas.stats().fallbacks);
+  EXPECT_EQ(0u, atlas.stats().evictions);
+}
+
+TEST(pxFontTest, fontAtlasEvictionTest)
+{
+  pxFontAtlas atlas(32, 2);
+  uint8_t buffer[32*32];
+  memset(buffer, 0xff, sizeof(buffer));
+
+  // one full page glyph per page
+  GlyphTextureEntry first, second;
+  EXPECT_TRUE(atlas.addGlyph(31, 31, buffer, first));
+  EXPECT_TRUE(atlas.addGlyph(31, 31, buffer, second));
+  EXPECT_EQ(2u, atlas.stats().pages);
+  EXPECT_TRUE(first.t != second.t);
+
+  // the first page is the most recently used so the second gets recycled
+  atlas.touch(first.t.getPtr());
+  GlyphTextureEntry third;
+  pxTextureRef retired;
+  EXPECT_TRUE(atlas.addGlyph(31, 31, buffer, third, retired));
+  EXPECT_TRUE(retired == second.t);
+  EXPECT_TRUE(third.t != first.t);
+  EXPECT_TRUE(third.t != second.t);
+  EXPECT_EQ(1u, atlas.stats().evictions);
+  EXPECT_EQ(2u, atlas.stats().pages);
+  EXPECT_EQ(2u, atlas.stats().glyphs);
+  EXPECT_EQ(3u, atlas.stats().glyphsAdded);
+
+  atlas.clearTexture();
+  EXPECT_EQ(0u, atlas.stats().pages);
+  EXPECT_TRUE(atlas.mPageIndex.empty());
+}
+
+TEST(pxFontTest, fontAtlasDrawTouchesPageTest)
+{
+  pxFontAtlas saved = gFontAtlas;
+  gFontAtlas = pxFontAtlas(32, 2);
+  uint8_t buffer[32*32];
+  memset(buffer, 0xff, sizeof(buffer));
+
+  GlyphTextureEntry first, second;
+  EXPECT_TRUE(gFontAtlas.addGlyph(31, 31, buffer, first));
+  EXPECT_TRUE(gFontAtlas.addGlyph(31, 31, buffer, second));
+
+  // text laid out earlier only touches its page when it's drawn
+  pxTexturedQuads quads;
+  quads.addQuad(0, 0, 31, 31, first.u1, first.v1, first.u2, first.v2, first.t);
+  float color[4] = {1, 1, 1, 1};
+  quads.draw(0, 0, color);
+
+  GlyphTextureEntry third;
+  pxTextureRef retired;
+  EXPECT_TRUE(gFontAtlas.addGlyph(31, 31, buffer, third, retired));
+  EXPECT_TRUE(retired == second.t);
+
+  gFontAtlas.clearTexture();
+  gFontAtlas = saved;
+}
+#endif
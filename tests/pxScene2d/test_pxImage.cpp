@@ -25,11 +25,17 @@ limitations under the License.
 #include "pxImage.h"
 #include "pxResource.h"
 #include "rtPromise.h"
+#include "rtThreadQueue.h"
+#include "rtThreadPool.h"
+#include "pxTimer.h"
 #include <string.h>
 #include <sstream>
 
 #include "test_includes.h" // Needs to be included last
 
+extern rtThreadQueue* gUIThreadQueue;
+extern rtThreadPool imageDecodeThreadPool;
+
 #define IMAGE_URL "https://px-apps.sys.comcast.net/pxscene-samples/images/tiles/008.jpg"
 #define IMAGE_WIDTH 246
 #define IMAGE_HEIGHT 164
@@ -160,18 +166,26 @@ class rtImageResourceTest : public testing::Test
     {
     }
 
+    // Local and archive images finish decoding on the UI thread queue
+    int32_t waitForDecode(rtImageResource* res)
+    {
+      for (int i = 0; i < 500 && res->isDecodePending(); i++)
+      {
+        pxSleepMS(10);
+        gUIThreadQueue->process();
+      }
+      gUIThreadQueue->process();
+      return res->getLoadStatus("statusCode").toInt32();
+    }
+
     void rtImageResourceLoadFromArchiveSuccessTest()
     {
-      rtImageResource res("images/status_bg.svg");
+      rtRef<rtImageResource> res = new rtImageResource("images/status_bg.svg");
       pxScene2d* scene = new pxScene2d();
       rtObjectRef archive;
       EXPECT_TRUE(RT_OK == scene->loadArchive("supportfiles/test_arc_resources.jar", archive));
-      res.loadResourceFromArchive(scene->getArchive());
-      rtObjectRef loadStatus = new rtMapObject;
-      res.loadStatus(loadStatus);
-      rtValue status;
-      loadStatus.Get("statusCode",&status);
-      EXPECT_TRUE(status == PX_RESOURCE_STATUS_OK);
+      res->loadResourceFromArchive(scene->getArchive());
+      EXPECT_TRUE(waitForDecode(res) == PX_RESOURCE_STATUS_OK);
       rtString key("supportfiles/test_arc_resources.jar_images/status_bg.svg");
       ImageMap::iterator it = pxImageManager::mImageMap.find(key.cString());
       EXPECT_TRUE (it != pxImageManager::mImageMap.end());
@@ -192,12 +206,57 @@ class rtImageResourceTest : public testing::Test
       EXPECT_TRUE(status == PX_RESOURCE_STATUS_FILE_NOT_FOUND);
       delete scene;
     }
+
+    void rtImageResourceLoadFromFileAsyncTest()
+    {
+      rtRef<rtImageResource> res = new rtImageResource("supportfiles/status_bg.png");
+      res->loadResourceFromFile();
+      // the decode has been handed to the pool; nothing is ready yet
+      EXPECT_TRUE(res->isDecodePending());
+      EXPECT_EQ(-1, res->getLoadStatus("statusCode").toInt32());
+      EXPECT_TRUE(waitForDecode(res) == PX_RESOURCE_STATUS_OK);
+      EXPECT_FALSE(res->isDecodePending());
+      EXPECT_GT(res->w(), 0);
+      EXPECT_GT(res->h(), 0);
+
+      rtRef<rtImageResource> missing = new rtImageResource("supportfiles/does_not_exist.png");
+      missing->loadResourceFromFile();
+      EXPECT_TRUE(waitForDecode(missing) == PX_RESOURCE_STATUS_FILE_NOT_FOUND);
+    }
+
+    void rtImageResourceCancelDecodeTest()
+    {
+      // with no decode threads the request stays in the queue
+      int threads = imageDecodeThreadPool.threadCount();
+      imageDecodeThreadPool.setThreadCount(0);
+
+      rtRef<rtImageResource> res = new rtImageResource("supportfiles/status_bg.png");
+      res->loadResourceFromFile();
+      EXPECT_TRUE(res->isDecodePending());
+      res->raiseDownloadPriority();
+      EXPECT_TRUE(res->priorityRaised);
+
+      // canceling takes it out of the queue and completes it on the UI thread
+      res->cancelPendingLoad();
+      EXPECT_EQ(0, imageDecodeThreadPool.cancelTask(res->decodeTaskKey()));
+      EXPECT_EQ(-1, waitForDecode(res));
+      EXPECT_FALSE(res->isDecodePending());
+      EXPECT_TRUE(res->isLoadCanceled());
+
+      // a new load starts out at normal priority
+      imageDecodeThreadPool.setThreadCount(threads);
+      res->loadResourceFromFile();
+      EXPECT_FALSE(res->priorityRaised);
+      EXPECT_TRUE(waitForDecode(res) == PX_RESOURCE_STATUS_OK);
+    }
 };
 
 TEST_F(rtImageResourceTest, rtImageResourcesTest)
 {
     rtImageResourceLoadFromArchiveSuccessTest();
     rtImageResourceLoadFromArchiveFailureTest();
+    rtImageResourceLoadFromFileAsyncTest();
+    rtImageResourceCancelDecodeTest();
 }
 
 class rtImageAResourceTest : public testing::Test
@@ -0,0 +1,137 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sstream>
+#include <string.h>
+#include <string>
+
+#define private public
+#define protected public
+
+#include "pxScene2d.h"
+#include "pxFont.h"
+#include "pxTextBox.h"
+#include "pxConstants.h"
+
+#include "test_includes.h" // Needs to be included last
+
+static const char* epgDescription =
+  "After a mysterious signal is picked up by an isolated research station, a team of "
+  "scientists, engineers and one reluctant pilot travel to the edge of the ice shelf to "
+  "find its source. What they discover there changes everything they thought they knew "
+  "about the planet, the people who sent them and each other. Meanwhile, back home, an "
+  "investigative journalist starts asking questions about the funding of the expedition, "
+  "and a former colleague resurfaces with a warning nobody wants to hear. ";
+
+class pxTextBoxTest : public testing::Test
+{
+  public:
+    virtual void SetUp()
+    {
+      mScene = new pxScene2d();
+      pxFontManager::initFT();
+      mFont = new pxFont("FreeSans.ttf", 0, "");
+      mFontOk = mFont->init("../../examples/pxScene2d/src/FreeSans.ttf") == RT_OK;
+    }
+
+    virtual void TearDown()
+    {
+      mFont = NULL;
+      delete mScene;
+    }
+
+    rtRef<pxTextBox> createTextBox(const char* text, float w, float h)
+    {
+      rtRef<pxTextBox> t = new pxTextBox(mScene);
+      t->mFont = mFont.getPtr();
+      t->mFontLoaded = true;
+      t->mInitialized = true;
+      t->mw = w;
+      t->mh = h;
+      t->setText(text);
+      t->recalc();
+      return t;
+    }
+
+    void layoutCacheTest()
+    {
+      ASSERT_TRUE(mFontOk);
+      rtRef<pxTextBox> t = createTextBox(epgDescription, 400, 300);
+      t->setWordWrap(true);
+      t->recalc();
+
+      EXPECT_TRUE(t->mLayoutValid);
+      EXPECT_FALSE(t->mNeedsRecalc);
+      float y2 = t->getMeasurements()->getBounds()->y2();
+      EXPECT_GT(y2, 0);
+
+      // a property set that does not change any layout input must not
+      // relayout; the quads are left exactly as they were
+      pxTexturedQuads* quads = &t->mQuadsVector[0];
+      size_t lines = t->mQuadsVector.size();
+      t->setSX(2);
+      t->setWordWrap(true);
+      EXPECT_TRUE(t->mNeedsRecalc);
+      t->recalc();
+      EXPECT_FALSE(t->mNeedsRecalc);
+      EXPECT_EQ(quads, &t->mQuadsVector[0]);
+      EXPECT_EQ(lines, t->mQuadsVector.size());
+      EXPECT_EQ(y2, t->getMeasurements()->getBounds()->y2());
+
+      // narrowing the box does
+      t->setW(200);
+      t->recalc();
+      EXPECT_GT(t->mQuadsVector.size(), lines);
+      EXPECT_GT(t->getMeasurements()->getBounds()->y2(), y2);
+
+      // and restoring it gives back the original layout
+      t->setW(400);
+      t->recalc();
+      EXPECT_EQ(lines, t->mQuadsVector.size());
+      EXPECT_EQ(y2, t->getMeasurements()->getBounds()->y2());
+    }
+
+    void truncationTest()
+    {
+      ASSERT_TRUE(mFontOk);
+      rtRef<pxTextBox> t = createTextBox(epgDescription, 300, 30);
+      t->setTruncation(pxConstantsTruncation::TRUNCATE);
+      t->setEllipsis(true);
+      t->recalc();
+
+      rtRefT<pxTextBounds> bounds = t->getMeasurements()->getBounds();
+      EXPECT_GT(bounds->x2(), 0);
+      EXPECT_LE(bounds->x2(), 300);
+
+      t->setTruncation(pxConstantsTruncation::TRUNCATE_AT_WORD);
+      t->recalc();
+      EXPECT_GT(bounds->x2(), 0);
+      EXPECT_LE(bounds->x2(), 300);
+    }
+
+  private:
+    pxScene2d* mScene;
+    rtRef<pxFont> mFont;
+    bool mFontOk;
+};
+
+TEST_F(pxTextBoxTest, pxTextBoxTests)
+{
+  layoutCacheTest();
+  truncationTest();
+}
@@ -273,6 +273,43 @@ class pxUtilTest : public testing::Test
       EXPECT_TRUE (ret == RT_OK);
     }
 
+    void pxLoadPNGImageDecodeHintTest()
+    {
+      pxOffscreen src;
+      src.initWithColor(64, 48, pxBlue);
+      rtData d;
+      EXPECT_TRUE (pxStorePNGImage(src, d) == RT_OK);
+
+      // no hint decodes at full size
+      pxOffscreen full;
+      EXPECT_TRUE (pxLoadImage((const char*)d.data(), d.length(), full) == RT_OK);
+      EXPECT_EQ (64, full.width());
+      EXPECT_EQ (48, full.height());
+
+      // a 16 pixel wide hint reduces by 4, keeping the aspect ratio
+      pxOffscreen reduced;
+      EXPECT_TRUE (pxLoadImage((const char*)d.data(), d.length(), reduced, 16, 0) == RT_OK);
+      EXPECT_EQ (16, reduced.width());
+      EXPECT_EQ (12, reduced.height());
+      EXPECT_TRUE (reduced.scanline(5)[7].u == full.scanline(20)[28].u);
+
+      // a hint larger than the image never scales up
+      pxOffscreen larger;
+      EXPECT_TRUE (pxLoadImage((const char*)d.data(), d.length(), larger, 128, 128) == RT_OK);
+      EXPECT_EQ (64, larger.width());
+      EXPECT_EQ (48, larger.height());
+    }
+
+    void pxImageDecodeFactorTest()
+    {
+      EXPECT_EQ (1, pxImageDecodeFactor(1920, 1080, 0, 0, 1.0f, 1.0f, 64));
+      EXPECT_EQ (3, pxImageDecodeFactor(1920, 1080, 200, 300, 1.0f, 1.0f, 64));
+      EXPECT_EQ (4, pxImageDecodeFactor(1920, 1080, 480, 0, 1.0f, 1.0f, 64));
+      EXPECT_EQ (2, pxImageDecodeFactor(1920, 1080, 0, 0, 0.5f, 0.5f, 64));
+      EXPECT_EQ (8, pxImageDecodeFactor(1920, 1080, 10, 10, 1.0f, 1.0f, 8));
+      EXPECT_EQ (1, pxImageDecodeFactor(100, 100, 100, 100, 1.0f, 1.0f, 8));
+    }
+
     void pxLoadPNGImage2ArgsFailureTest()
     {
       rtError ret = pxLoadPNGImage("bad_path_to_file/status_bg.png", mPngData);
@@ -404,6 +441,8 @@ TEST_F(pxUtilTest, pxutilsTest)
     pxLoadPNGImage2ArgsSuccessTest();
     pxLoadPNGImage2ArgsFailureTest();
     pxLoadPNGImage3ArgsCreateReadStructFailTest();
+    pxLoadPNGImageDecodeHintTest();
+    pxImageDecodeFactorTest();
 
     // SVG tests...
     pxLoadSVGImage2ArgsSuccessTest();
@@ -29,18 +29,21 @@ limitations under the License.
 #include <pxContext.h>
 #include <rtRef.h>
 #include <stdlib.h>
+#include "pxTimer.h"
 
 #include "test_includes.h" // Needs to be included last
 
 class shaderProgram;
 class solidShaderProgram;
 extern solidShaderProgram*  gSolidShader;
-extern std::vector<pxTexture*> textureList;
-extern rtMutex textureListMutex;
-pxError addToTextureList(pxTexture* texture);
-pxError removeFromTextureList(pxTexture* texture);
+extern uint32_t gRenderTick;
 pxError ejectNotRecentlyUsedTextureMemory(int64_t bytesNeeded, uint32_t maxAge=5);
 
+#ifdef USE_RENDER_STATS
+extern uint32_t gDrawCalls;
+extern uint32_t gTexBindCalls;
+#endif //USE_RENDER_STATS
+
 using namespace std;
 
 #include "test_includes.h" // Needs to be included last
@@ -88,6 +91,14 @@ class sceneWindow : public pxWindow, public pxIViewContainer
 
 };
 
+class drawCountObject : public pxObject
+{
+  public:
+    drawCountObject(pxScene2d* scene): pxObject(scene), mDrawCount(0) {}
+    virtual void draw() { mDrawCount++; }
+    int mDrawCount;
+};
+
 class pxContextTest : public testing::Test
 {
   public:
@@ -191,6 +202,149 @@ class pxContextTest : public testing::Test
       EXPECT_TRUE (mContext.isObjectOnScreen(0,0,0,0) == true);
     }
 
+    void isObjectOnScreenTransformTest()
+    {
+      mContext.setSize(1280,720);
+      pxMatrix4f m;
+      mContext.setMatrix(m);
+      EXPECT_TRUE (mContext.isObjectOnScreen(10,10,100,100) == true);
+      EXPECT_TRUE (mContext.isObjectOnScreen(1300,10,100,100) == false);
+      EXPECT_TRUE (mContext.isObjectOnScreen(-200,-200,100,100) == false);
+      // partially visible
+      EXPECT_TRUE (mContext.isObjectOnScreen(1250,700,100,100) == true);
+
+      m.translate(-2000, 0);
+      mContext.setMatrix(m);
+      EXPECT_TRUE (mContext.isObjectOnScreen(10,10,100,100) == false);
+      EXPECT_TRUE (mContext.isObjectOnScreen(2010,10,100,100) == true);
+
+      // rotated into view from the left edge
+      pxMatrix4f r;
+      r.translate(0, 100);
+      r.rotateInDegrees(-90);
+      mContext.setMatrix(r);
+      EXPECT_TRUE (mContext.isObjectOnScreen(0,0,100,100) == true);
+      pxMatrix4f identity;
+      mContext.setMatrix(identity);
+    }
+
+    void drawBatchingTest()
+    {
+      mContext.setSize(1280,720);
+      pxMatrix4f identity;
+      mContext.setMatrix(identity);
+      float transparent[4] = {0,0,0,0};
+      mContext.clear(1280,720,transparent);
+
+      pxOffscreen o;
+      o.init(8,8);
+      o.fill(pxRed);
+      pxTextureRef texture = mContext.createTexture(o);
+
+#ifdef USE_RENDER_STATS
+      mContext.flush();
+      uint32_t drawCalls = gDrawCalls;
+      uint32_t bindCalls = gTexBindCalls;
+#endif //USE_RENDER_STATS
+
+      // a grid of images with the same texture but their own matrix
+      for (int i = 0; i < 500; i++)
+      {
+        mContext.pushState();
+        pxMatrix4f m;
+        m.translate((float)((i % 25) * 50), (float)((i / 25) * 30));
+        mContext.setMatrix(m);
+        mContext.drawImage(0, 0, 8, 8, texture, pxTextureRef(), false);
+        mContext.popState();
+      }
+      mContext.flush();
+
+#ifdef USE_RENDER_STATS
+      EXPECT_TRUE (gDrawCalls - drawCalls <= 1);
+      EXPECT_TRUE (gTexBindCalls - bindCalls <= 2);
+#endif //USE_RENDER_STATS
+
+      pxOffscreen snap;
+      mContext.snapshot(snap);
+      EXPECT_TRUE (snap.pixel(50*3+4, 30*2+4)->a == 255);
+      EXPECT_TRUE (snap.pixel(50*3+20, 30*2+4)->a == 0);
+
+      // a state change in the middle of a batch must flush it first
+      float blue[4] = {0,0,1,1};
+      mContext.drawRect(100, 100, 0, blue, NULL);
+      mContext.enableClipping(false);
+      mContext.drawImage(0, 0, 8, 8, texture, pxTextureRef(), false);
+      mContext.flush();
+      mContext.snapshot(snap);
+      pxPixel* rect = snap.pixel(50, 50);
+      pxPixel* image = snap.pixel(4, 4);
+      EXPECT_TRUE (rect->a == 255 && image->a == 255);
+      EXPECT_TRUE (rect->u != image->u);
+    }
+
+    void offscreenChildrenCullTest()
+    {
+      mContext.setSize(1280,720);
+      pxScene2d* scene = new pxScene2d(false);
+      rtRef<pxObject> root = new pxObject(scene);
+      root->mw = 1280;
+      root->mh = 720;
+
+      rtRef<drawCountObject> visible = new drawCountObject(scene);
+      visible->mw = 100;
+      visible->mh = 100;
+      visible->setParent(root);
+
+      rtRef<pxObject> offscreen = new pxObject(scene);
+      offscreen->mx = 2000;
+      offscreen->setParent(root);
+
+      const int numChildren = 100;
+      vector<rtRef<drawCountObject> > children;
+      for (int i = 0; i < numChildren; i++)
+      {
+        rtRef<drawCountObject> child = new drawCountObject(scene);
+        child->mx = (float)((i % 10) * 20);
+        child->my = (float)((i / 10) * 20);
+        child->mw = 10;
+        child->mh = 10;
+        rtRef<pxObject> parent = offscreen;
+        child->setParent(parent);
+        children.push_back(child);
+      }
+
+      const int frames = 10;
+      root->update(pxSeconds());
+      EXPECT_TRUE (offscreen->mBoundsValid == true);
+      EXPECT_TRUE (offscreen->mBoundsX2 == 190);
+
+      for (int i = 0; i < frames; i++)
+      {
+        mContext.pushState();
+        root->drawInternal();
+        mContext.popState();
+      }
+
+      int offscreenDraws = 0;
+      for (size_t i = 0; i < children.size(); i++)
+        offscreenDraws += children[i]->mDrawCount;
+      EXPECT_TRUE (offscreenDraws == 0);
+      EXPECT_TRUE (visible->mDrawCount == frames);
+
+      // moving a child back on screen must not be culled by stale bounds
+      children[0]->mx = -2000;
+      children[0]->invalidateBounds();
+      mContext.pushState();
+      root->drawInternal();
+      mContext.popState();
+      EXPECT_TRUE (children[0]->mDrawCount == 1);
+
+      children.clear();
+      offscreen = NULL;
+      visible = NULL;
+      root = NULL;
+    }
+
     void textureMemoryOverflowTrueTest()
     {
       char *buffer = new char[100*100];
@@ -379,6 +533,9 @@ TEST_F(pxContextTest, pxContextTests)
   updateFramebufferFailTest();
   pxTextureNoneTest();
   isObjectOnScreenTest();
+  isObjectOnScreenTransformTest();
+  drawBatchingTest();
+  offscreenChildrenCullTest();
   textureMemoryOverflowTrueTest();
   textureMemoryOverflowFalseTest();
   adjustCurrentTextureMemorySizeTest();
@@ -399,20 +556,120 @@ TEST_F(pxContextTest, pxContextTests)
 }
 
 
-void addToTextureTest()
+class cacheTexture : public pxTexture
+{
+  public:
+    cacheTexture(): mUnloaded(false), mOwner(NULL) {}
+    virtual pxError deleteTexture() { return PX_OK; }
+    virtual int width() { return 0; }
+    virtual int height() { return 0; }
+    virtual pxError getOffscreen(pxOffscreen& /*o*/) { return PX_FAIL; }
+    virtual pxError bindGLTexture(int /*tLoc*/) { return PX_FAIL; }
+    virtual pxError bindGLTextureAsMask(int /*mLoc*/) { return PX_FAIL; }
+    virtual pxError unloadTextureData()
+    {
+      gTextureCache.remove(this);
+      // the owner lets go of the texture while it's being unloaded
+      if (mOwner != NULL)
+      {
+        pxTextureRef* owner = mOwner;
+        mOwner = NULL;
+        *owner = NULL;
+      }
+      mUnloaded = true;
+      return PX_OK;
+    }
+    bool mUnloaded;
+    pxTextureRef* mOwner;
+};
+
+void textureCacheAddRemoveTest()
 {
-  EXPECT_TRUE (addToTextureList(NULL) == RT_OK);
-  std::vector<pxTexture*>::iterator it;
-  textureListMutex.lock();
-  it = find (textureList.begin(), textureList.end(), (pxTexture*)NULL);
-  EXPECT_TRUE (it != textureList.end());
-  textureListMutex.unlock();
+  pxTextureCacheStats before = gTextureCache.stats();
+  cacheTexture* t = new cacheTexture();
+  gTextureCache.add(NULL, 100);
+  gTextureCache.add(t, 100);
+  EXPECT_TRUE (gTextureCache.stats().residentBytes == before.residentBytes + 100);
+  EXPECT_TRUE (gTextureCache.stats().uploads == before.uploads + 1);
+  gTextureCache.remove(NULL);
+  gTextureCache.remove(t);
+  gTextureCache.remove(t);
+  EXPECT_TRUE (gTextureCache.stats().residentBytes == before.residentBytes);
+
+  // destroying a resident texture takes it out of the cache
+  gTextureCache.add(t, 100);
+  delete t;
+  EXPECT_TRUE (gTextureCache.stats().residentBytes == before.residentBytes);
 }
 
-void removeFromTextureListTest()
+void textureCacheEjectTest()
 {
-  EXPECT_TRUE (removeFromTextureList(NULL) == RT_OK);
-  EXPECT_TRUE (removeFromTextureList((pxTexture*)0x9aabc) == RT_OK);
+  gTextureCache.resetStats();
+  uint32_t resident = gTextureCache.stats().residentTextures;
+  const int count = 4;
+  const int64_t bytes = 1000;
+  cacheTexture* textures[count];
+  pxTextureRef refs[count];
+  uint32_t tick = gRenderTick + 100;
+  for (int i = 0; i < count; i++)
+  {
+    textures[i] = new cacheTexture();
+    refs[i] = textures[i];
+    textures[i]->setLastRenderTick(tick - 50);
+    gTextureCache.add(textures[i], bytes);
+  }
+  // draw 0 and 2 recently, 1 is the least recently drawn
+  textures[3]->setLastRenderTick(tick - 20);
+  textures[0]->setLastRenderTick(tick - 10);
+  textures[2]->setLastRenderTick(tick);
+  EXPECT_TRUE (gTextureCache.stats().hits == 3);
+
+  // stops exactly once enough has been released
+  int ejected = 0;
+  EXPECT_TRUE (gTextureCache.eject(bytes, 5, tick, ejected) == bytes);
+  EXPECT_TRUE (ejected == 1);
+  EXPECT_TRUE (textures[1]->mUnloaded);
+  EXPECT_FALSE (textures[3]->mUnloaded);
+
+  // never ejects textures drawn within maxAge
+  EXPECT_TRUE (gTextureCache.eject(bytes*10, 15, tick, ejected) == bytes);
+  EXPECT_TRUE (textures[3]->mUnloaded);
+  EXPECT_FALSE (textures[0]->mUnloaded);
+  EXPECT_FALSE (textures[2]->mUnloaded);
+
+  // drawing an ejected texture is a miss until it is uploaded again
+  textures[1]->setLastRenderTick(tick + 1);
+  gTextureCache.add(textures[1], bytes);
+  pxTextureCacheStats stats = gTextureCache.stats();
+  EXPECT_TRUE (stats.misses == 1);
+  EXPECT_TRUE (stats.reuploads == 1);
+  EXPECT_TRUE (stats.ejections == 2);
+  EXPECT_TRUE (stats.bytesEjected == 2*bytes);
+
+  for (int i = 0; i < count; i++)
+    refs[i] = NULL;
+  EXPECT_TRUE (gTextureCache.stats().residentTextures == resident);
+
+  // a texture with no references left is being destroyed, and is only
+  // taken out of the list
+  cacheTexture* dying = new cacheTexture();
+  dying->setLastRenderTick(tick - 50);
+  gTextureCache.add(dying, bytes);
+  EXPECT_TRUE (gTextureCache.eject(bytes, 5, tick, ejected) == 0);
+  EXPECT_TRUE (ejected == 0);
+  EXPECT_FALSE (dying->mUnloaded);
+  EXPECT_TRUE (gTextureCache.stats().residentTextures == resident);
+  delete dying;
+
+  // the cache holds its own reference while unloading
+  cacheTexture* owned = new cacheTexture();
+  pxTextureRef owner = owned;
+  owned->mOwner = &owner;
+  owned->setLastRenderTick(tick - 50);
+  gTextureCache.add(owned, bytes);
+  EXPECT_TRUE (gTextureCache.eject(bytes, 5, tick, ejected) == bytes);
+  EXPECT_TRUE (ejected == 1);
+  EXPECT_TRUE (owner.getPtr() == NULL);
 }
 
 void ejectNotRecentlyUsedTextureMemoryTest()
@@ -424,8 +681,8 @@ void ejectNotRecentlyUsedTextureMemoryTest()
 
 TEST(pxContextGLFileTest, pxContextGLFileTests)
 {
-  addToTextureTest();
-  removeFromTextureListTest();
+  textureCacheAddRemoveTest();
+  textureCacheEjectTest();
   ejectNotRecentlyUsedTextureMemoryTest();
 }
 
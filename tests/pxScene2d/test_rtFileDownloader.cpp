@@ -0,0 +1,271 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sstream>
+
+#define private public
+#define protected public
+
+#include "rtFileDownloader.h"
+#include "rtString.h"
+#include "pxTimer.h"
+#include "test_httpserver.h"
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "test_includes.h" // Needs to be included last
+
+using namespace std;
+
+class rtTestDownloadSink : public rtFileDownloadSink
+{
+public:
+  rtTestDownloadSink(size_t abortAfter = 0) : mContentLength(-2), mStarts(0), mChunks(0), mAbortAfter(abortAfter) {}
+
+  virtual void onDownloadStart(rtFileDownloadRequest* /*request*/, int64_t contentLength)
+  {
+    mContentLength = contentLength;
+    mStarts++;
+  }
+
+  virtual bool onDownloadData(rtFileDownloadRequest* /*request*/, const char* data, size_t size)
+  {
+    mData.append(data, size);
+    mChunks++;
+    return mAbortAfter == 0 || mData.length() < mAbortAfter;
+  }
+
+  string mData;
+  int64_t mContentLength;
+  int mStarts;
+  int mChunks;
+  size_t mAbortAfter;
+};
+
+class rtFileDownloaderEngineTest : public testing::Test
+{
+  public:
+    virtual void SetUp()
+    {
+      mServerOk = mServer.start();
+      mCompleted = 0;
+      mMaxDownloads = rtFileDownloader::instance()->mMaxDownloads;
+      mMaxDownloadsPerHost = rtFileDownloader::instance()->mMaxDownloadsPerHost;
+    }
+
+    virtual void TearDown()
+    {
+      rtFileDownloader::instance()->setMaxConnections(mMaxDownloads, mMaxDownloadsPerHost);
+      mServer.stop();
+    }
+
+    static void downloadCallback(rtFileDownloadRequest* request)
+    {
+      rtFileDownloaderEngineTest* test = (rtFileDownloaderEngineTest*)request->callbackData();
+      string body;
+      if (request->downloadedData() != NULL)
+        body.assign(request->downloadedData(), request->downloadedDataSize());
+      lock_guard<mutex> lock(test->mMutex);
+      test->mResults.push_back(make_pair(string(request->fileUrl().cString()), body));
+      test->mHttpCodes.push_back(request->httpStatusCode());
+      test->mCompleted++;
+      test->mCondition.notify_all();
+    }
+
+    rtFileDownloadRequest* download(const string& url)
+    {
+      rtFileDownloadRequest* request = new rtFileDownloadRequest(url.c_str(), this, downloadCallback);
+#ifdef ENABLE_HTTP_CACHE
+      request->setCacheEnabled(false);
+#endif
+      rtFileDownloader::instance()->addToDownloadQueue(request);
+      return request;
+    }
+
+    bool waitForDownloads(int count)
+    {
+      unique_lock<mutex> lock(mMutex);
+      return mCondition.wait_for(lock, chrono::seconds(30), [&]{ return mCompleted >= count; });
+    }
+
+    void clearResults()
+    {
+      lock_guard<mutex> lock(mMutex);
+      mResults.clear();
+      mHttpCodes.clear();
+      mCompleted = 0;
+    }
+
+    void coalesceTest()
+    {
+      ASSERT_TRUE(mServerOk);
+      clearResults();
+      string url = mServer.url("/slow/shared");
+      for (int i = 0; i < 10; i++)
+        download(url);
+      ASSERT_TRUE(waitForDownloads(10));
+
+      // one transfer, every request gets its own copy of the data
+      EXPECT_EQ(1, mServer.requestCount("/slow/shared"));
+      for (size_t i = 0; i < mResults.size(); i++)
+      {
+        EXPECT_EQ(url, mResults[i].first);
+        EXPECT_EQ("body:/slow/shared", mResults[i].second);
+        EXPECT_EQ(200, mHttpCodes[i]);
+      }
+
+      // a later request for the same url goes out again
+      download(url);
+      ASSERT_TRUE(waitForDownloads(11));
+      EXPECT_EQ(2, mServer.requestCount("/slow/shared"));
+    }
+
+    void priorityTest()
+    {
+      ASSERT_TRUE(mServerOk);
+      clearResults();
+      mServer.reset();
+      rtFileDownloader::instance()->setMaxConnections(1, 1);
+
+      // wait for the first transfer to take the only connection
+      download(mServer.url("/slow/first"));
+      for (int i = 0; i < 1000 && mServer.requests().empty(); i++)
+        pxSleepMS(1);
+      vector<rtFileDownloadRequest*> requests;
+      for (int i = 0; i < 5; i++)
+      {
+        char path[32];
+        snprintf(path, sizeof(path), "/queued/%d", i);
+        requests.push_back(download(mServer.url(path)));
+      }
+      rtFileDownloader::instance()->raiseDownloadPriority(requests[4]);
+      ASSERT_TRUE(waitForDownloads(6));
+
+      vector<string> order = mServer.requests();
+      ASSERT_EQ(6u, order.size());
+      EXPECT_EQ("/queued/4", order[1]);
+      EXPECT_EQ("/queued/0", order[2]);
+    }
+
+    void connectionLimitTest()
+    {
+      ASSERT_TRUE(mServerOk);
+      clearResults();
+      mServer.reset();
+      const int perHost = 16;
+      const int count = 128;
+      rtFileDownloader::instance()->setMaxConnections(256, perHost);
+      int connections = mServer.connections();
+
+      for (int wave = 0; wave < 2; wave++)
+      {
+        for (int i = 0; i < count/2; i++)
+        {
+          char path[32];
+          snprintf(path, sizeof(path), "/slow/%d/%d", wave, i);
+          download(mServer.url(path));
+        }
+        ASSERT_TRUE(waitForDownloads((wave+1)*count/2));
+      }
+
+      // transfers overlap up to the host limit, and the second wave reuses
+      // the connections the first one opened
+      EXPECT_LE(mServer.maxInFlight(), perHost);
+      EXPECT_GT(mServer.maxInFlight(), 1);
+      EXPECT_LE(mServer.connections() - connections, perHost + 2);
+    }
+
+    void sinkTest()
+    {
+      ASSERT_TRUE(mServerOk);
+      const size_t size = 300000;
+      const char* paths[] = { "/big/300000", "/chunked/300000" };
+      for (int i = 0; i < 2; i++)
+      {
+        rtTestDownloadSink sink;
+        rtFileDownloadRequest request(mServer.url(paths[i]).c_str(), NULL);
+        request.setDownloadSink(&sink, false);
+        EXPECT_TRUE(rtFileDownloader::instance()->downloadFromNetwork(&request));
+
+        // the body only went to the sink
+        EXPECT_EQ(1, sink.mStarts);
+        EXPECT_EQ(i == 0 ? (int64_t)size : -1, sink.mContentLength);
+        EXPECT_GT(sink.mChunks, 1);
+        EXPECT_TRUE(sink.mData == bigBody(size));
+        EXPECT_TRUE(request.downloadedData() == NULL);
+        EXPECT_EQ(size, request.downloadedDataSize());
+      }
+
+      // a sink can keep the data as well, and can stop a download early
+      rtTestDownloadSink keepSink;
+      rtFileDownloadRequest keepRequest(mServer.url("/big/1000").c_str(), NULL);
+      keepRequest.setDownloadSink(&keepSink);
+      EXPECT_TRUE(rtFileDownloader::instance()->downloadFromNetwork(&keepRequest));
+      ASSERT_TRUE(keepRequest.downloadedData() != NULL);
+      EXPECT_EQ(keepSink.mData, string(keepRequest.downloadedData(), keepRequest.downloadedDataSize()));
+
+      rtTestDownloadSink abortSink(1);
+      rtFileDownloadRequest abortRequest(mServer.url("/big/300000").c_str(), NULL);
+      abortRequest.setDownloadSink(&abortSink, false);
+      EXPECT_FALSE(rtFileDownloader::instance()->downloadFromNetwork(&abortRequest));
+      EXPECT_EQ(1, abortSink.mChunks);
+    }
+
+    void largeBodyTest()
+    {
+      ASSERT_TRUE(mServerOk);
+      clearResults();
+      const size_t size = 4*1024*1024 + 17;
+      char path[64];
+      snprintf(path, sizeof(path), "/big/%d", (int)size);
+      download(mServer.url(path));
+      snprintf(path, sizeof(path), "/chunked/%d", (int)size);
+      download(mServer.url(path));
+      ASSERT_TRUE(waitForDownloads(2));
+
+      string expected = bigBody(size);
+      for (size_t i = 0; i < mResults.size(); i++)
+      {
+        EXPECT_EQ(200, mHttpCodes[i]);
+        EXPECT_EQ(size, mResults[i].second.length());
+        EXPECT_TRUE(mResults[i].second == expected);
+      }
+    }
+
+  private:
+    rtTestHttpServer mServer;
+    bool mServerOk;
+    mutex mMutex;
+    condition_variable mCondition;
+    vector<pair<string, string> > mResults;
+    vector<long> mHttpCodes;
+    int mCompleted;
+    unsigned int mMaxDownloads;
+    unsigned int mMaxDownloadsPerHost;
+};
+
+TEST_F(rtFileDownloaderEngineTest, rtFileDownloaderEngineTests)
+{
+  coalesceTest();
+  sinkTest();
+  largeBodyTest();
+  priorityTest();
+  connectionLimitTest();
+}
@@ -22,6 +22,9 @@ limitations under the License.
 #define protected public
 #include "rtString.h"
 #include "rtLog.h"
+#include "test_logcapture.h"
+#include <string>
+#include <vector>
 
 #include "test_includes.h" // Needs to be included last
 
@@ -110,3 +113,62 @@ TEST_F(rtLogTest, rtLogHandlerTest) {
   // Reset to default handler
   rtLogSetLogHandler(NULL);
 }
+
+TEST_F(rtLogTest, rtLogAsyncTest)
+{
+  const int threads = 4;
+  const int count = 500;
+  rtLogSetLevel(RT_LOG_WARN);
+  rtLogCapture capture("/tmp/rtLogAsyncTest.log");
+  uint64_t dropped = rtLogDroppedCount();
+  rtLogSetAsync(true);
+  logFromThreads(threads, count);
+  rtLogSetAsync(false);
+  dropped = rtLogDroppedCount() - dropped;
+  std::vector<std::string> lines = capture.lines();
+
+  // every line arrives whole, and each thread's lines in order
+  EXPECT_EQ((size_t)(threads*count), lines.size() + dropped);
+  std::vector<int> next(threads, 0);
+  for (size_t i = 0; i < lines.size(); i++)
+  {
+    int thread = -1, line = -1;
+    size_t pos = lines[i].find(" -- Thread-");
+    ASSERT_NE(std::string::npos, pos);
+    ASSERT_EQ(0u, lines[i].find("rt: WARN "));
+    ASSERT_EQ(2, sscanf(lines[i].c_str() + lines[i].find(": thread ") + 2, "thread %d line %d", &thread, &line));
+    ASSERT_TRUE(thread >= 0 && thread < threads);
+    EXPECT_GE(line, next[thread]);
+    next[thread] = line + 1;
+  }
+
+  // long lines are cut short rather than split
+  populateString();
+  rtLogCapture longCapture("/tmp/rtLogAsyncLong.log");
+  rtLogSetAsync(true);
+  rtLogWarn("%s", reallyLongString);
+  rtLogSetAsync(false);
+  lines = longCapture.lines();
+  ASSERT_EQ(1u, lines.size());
+  EXPECT_EQ(1022u, lines[0].length()); // and the newline
+}
+
+TEST_F(rtLogTest, rtLogCompileLevelTest)
+{
+  int evaluated = 0;
+  rtLogSetLevel(RT_LOG_DEBUG);
+  rtLogSetLogHandler(myRtLogHandler);
+  testNum = 0;
+#undef RT_LOG_COMPILE_LEVEL
+#define RT_LOG_COMPILE_LEVEL RT_LOG_INFO
+  rtLogDebug("not even evaluated %d", ++evaluated);
+  EXPECT_EQ(0, evaluated);
+  rtLogInfo("evaluated %d", ++evaluated);
+  EXPECT_EQ(1, evaluated);
+#undef RT_LOG_COMPILE_LEVEL
+#define RT_LOG_COMPILE_LEVEL RT_LOG_DEBUG
+  rtLogDebug("evaluated %d", ++evaluated);
+  EXPECT_EQ(2, evaluated);
+  rtLogSetLogHandler(NULL);
+  rtLogSetLevel(RT_LOG_WARN);
+}
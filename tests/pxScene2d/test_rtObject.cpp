@@ -58,23 +58,23 @@ class rtEmitTest : public testing::Test
     {
       rtString event("eventone");
       EXPECT_TRUE (RT_OK == mEmit->setListener(event.cString(),&fnCallback));
-      EXPECT_TRUE (1 == mEmit->mEntries.size());
+      EXPECT_TRUE (1 == mEmit->listenerCount());
     }
 
     void addListenerEmptyFnTest()
     {
       rtString event("eventone");
-      size_t listenerCountBeforeAdd = mEmit->mEntries.size();
+      size_t listenerCountBeforeAdd = mEmit->listenerCount();
       EXPECT_TRUE (RT_ERROR == mEmit->addListener(event.cString(),NULL));
-      EXPECT_TRUE (listenerCountBeforeAdd == mEmit->mEntries.size());
+      EXPECT_TRUE (listenerCountBeforeAdd == mEmit->listenerCount());
     }
 
     void addListenerDuplicateEventTest()
     {
       rtString event("eventone");
-      size_t listenerCountBeforeAdd = mEmit->mEntries.size();
+      size_t listenerCountBeforeAdd = mEmit->listenerCount();
       EXPECT_TRUE (RT_OK == mEmit->addListener(event.cString(),&fnCallback));
-      EXPECT_TRUE (listenerCountBeforeAdd /* TODO: remove +1 */ + 1 == mEmit->mEntries.size());
+      EXPECT_TRUE (listenerCountBeforeAdd /* TODO: remove +1 */ + 1 == mEmit->listenerCount());
     }
 
     void addPendingEventTest()
@@ -87,9 +87,95 @@ class rtEmitTest : public testing::Test
     void delListenerTest()
     {
       rtString event("eventone");
-      size_t listenerCountBeforeDel = mEmit->mEntries.size();
+      size_t listenerCountBeforeDel = mEmit->listenerCount();
       EXPECT_TRUE (RT_OK == mEmit->delListener(event.cString(),&fnCallback));
-      EXPECT_TRUE (listenerCountBeforeDel - 1 == mEmit->mEntries.size());
+      EXPECT_TRUE (listenerCountBeforeDel - 1 == mEmit->listenerCount());
+    }
+
+    static rtError countEvent(int numArgs, const rtValue* args, rtValue* result, void* context)
+    {
+      UNUSED_PARAM(numArgs);
+      UNUSED_PARAM(args);
+      UNUSED_PARAM(result);
+      (*(int*)context)++;
+      return RT_OK;
+    }
+
+    void indexedDispatchTest()
+    {
+      rtRefT<rtEmit> emit = new rtEmit;
+      const int numEvents = 40;
+      int counts[numEvents] = {0};
+      vector<rtFunctionRef> listeners;
+      char name[32];
+      for (int i = 0; i < numEvents; i++)
+      {
+        snprintf(name, sizeof(name), "onEvent%d", i);
+        rtFunctionRef f = new rtFunctionCallback(countEvent, &counts[i]);
+        listeners.push_back(f);
+        EXPECT_EQ(RT_OK, emit->addListener(name, f.getPtr()));
+      }
+      EXPECT_EQ((size_t)numEvents, emit->listenerCount());
+      EXPECT_EQ(1u, emit->listenerCount("onEvent7"));
+      EXPECT_EQ(0u, emit->listenerCount("onMissing"));
+
+      // only the listeners for the sent event run
+      rtEmitRef e = emit.getPtr();
+      e.send("onEvent7", 1);
+      e.send("onEvent7", 2);
+      e.send("onMissing", 3);
+      for (int i = 0; i < numEvents; i++)
+        EXPECT_EQ(i == 7 ? 2 : 0, counts[i]);
+
+      // a second listener on the same event runs after the first
+      int second = 0;
+      rtFunctionRef f = new rtFunctionCallback(countEvent, &second);
+      emit->addListener("onEvent7", f.getPtr(), true);
+      e.send("onEvent7", 4);
+      EXPECT_EQ(3, counts[7]);
+      EXPECT_EQ(1, second);
+      // the once listener removed itself
+      EXPECT_EQ(1u, emit->listenerCount("onEvent7"));
+
+      // property style listeners replace each other
+      emit->setListener("onEvent7", f.getPtr());
+      emit->setListener("onEvent7", f.getPtr());
+      EXPECT_EQ(2u, emit->listenerCount("onEvent7"));
+      emit->setListener("onEvent7", NULL);
+      EXPECT_EQ(1u, emit->listenerCount("onEvent7"));
+
+      EXPECT_EQ(RT_OK, emit->delListener("onEvent3", listeners[3].getPtr()));
+      EXPECT_EQ(0u, emit->listenerCount("onEvent3"));
+      EXPECT_EQ(RT_OK, emit->clearListeners("onEvent4"));
+      EXPECT_EQ((size_t)numEvents-2, emit->listenerCount());
+      emit->clearListeners();
+      EXPECT_EQ(0u, emit->listenerCount());
+    }
+
+    static rtError removeDuringSend(int numArgs, const rtValue* args, rtValue* result, void* context)
+    {
+      UNUSED_PARAM(numArgs);
+      UNUSED_PARAM(args);
+      UNUSED_PARAM(result);
+      rtEmit* emit = (rtEmit*)context;
+      // both of these are deferred until the send is done
+      emit->delListener("onTick", &fnCallback);
+      emit->addListener("onLater", &fnCallback);
+      return RT_OK;
+    }
+
+    void changeDuringSendTest()
+    {
+      rtRefT<rtEmit> emit = new rtEmit;
+      rtFunctionRef f = new rtFunctionCallback(removeDuringSend, emit.getPtr());
+      emit->addListener("onTick", f.getPtr());
+      emit->addListener("onTick", &fnCallback);
+      rtEmitRef e = emit.getPtr();
+      e.send("onTick");
+      EXPECT_EQ(1u, emit->listenerCount("onTick"));
+      EXPECT_EQ(1u, emit->listenerCount("onLater"));
+      EXPECT_EQ(0u, emit->mPendingEntriesToAdd.size());
+      EXPECT_FALSE(emit->mPendingDeletes);
     }
 
   private:
@@ -103,6 +189,8 @@ TEST_F(rtEmitTest, rtEmitTests)
   addListenerEmptyFnTest();
   addPendingEventTest();
   delListenerTest();
+  indexedDispatchTest();
+  changeDuringSendTest();
 }
 
 class rtArrayObjectTest : public testing::Test
@@ -189,6 +277,68 @@ TEST_F(rtArrayObjectTest, rtArrayObjectTests)
   setWithIdPassedTest();
 }
 
+class rtLookupBase : public rtObject
+{
+public:
+  rtDeclareObject(rtLookupBase, rtObject);
+  rtProperty(width, width, setWidth, int32_t);
+  rtReadOnlyProperty(kind, kind, rtString);
+  rtMethodNoArgAndReturn("area", area, int32_t);
+
+  rtLookupBase(): mWidth(0) {}
+
+  rtError width(int32_t& v) const { v = mWidth; return RT_OK; }
+  rtError setWidth(int32_t v) { mWidth = v; return RT_OK; }
+  virtual rtError kind(rtString& v) const { v = "base"; return RT_OK; }
+  rtError area(int32_t& v) { v = mWidth * mWidth; return RT_OK; }
+
+  int32_t mWidth;
+};
+
+class rtLookupDerived : public rtLookupBase
+{
+public:
+  rtDeclareObject(rtLookupDerived, rtLookupBase);
+  rtReadOnlyProperty(kind, derivedKind, rtString);
+
+  rtError derivedKind(rtString& v) const { v = "derived"; return RT_OK; }
+};
+
+// overrides Get/Set the way pxText and rtMapObject do
+class rtLookupOverride : public rtLookupDerived
+{
+public:
+  rtLookupOverride(): mGets(0), mSets(0) {}
+
+  virtual rtError Get(const char* name, rtValue* value) const override
+  {
+    mGets++;
+    if (!strcmp(name, "kind"))
+    {
+      *value = "override";
+      return RT_OK;
+    }
+    return rtLookupDerived::Get(name, value);
+  }
+
+  virtual rtError Set(const char* name, const rtValue* value) override
+  {
+    mSets++;
+    return rtLookupDerived::Set(name, value);
+  }
+
+  mutable int mGets;
+  int mSets;
+};
+
+rtDefineObject(rtLookupBase, rtObject);
+rtDefineProperty(rtLookupBase, width);
+rtDefineProperty(rtLookupBase, kind);
+rtDefineMethod(rtLookupBase, area);
+
+rtDefineObject(rtLookupDerived, rtLookupBase);
+rtDefineProperty(rtLookupDerived, kind);
+
 class rtObjectTest : public testing::Test
 {
   public:
@@ -233,6 +383,94 @@ class rtObjectTest : public testing::Test
       EXPECT_TRUE (RT_OK != e);
     }
 
+    void lookupTest()
+    {
+      rtObjectRef o = new rtLookupDerived;
+      rtValue v;
+
+      // inherited property
+      v = 7;
+      EXPECT_EQ (RT_OK, o->Set("width", &v));
+      EXPECT_EQ (RT_OK, o->Get("width", &v));
+      EXPECT_EQ (7, v.toInt32());
+
+      // derived class shadows its parent
+      EXPECT_EQ (RT_OK, o->Get("kind", &v));
+      EXPECT_TRUE (v.toString() == "derived");
+      EXPECT_EQ (RT_FAIL, o->Set("kind", &v));
+
+      // methods and rtObject's own entries
+      EXPECT_EQ (RT_OK, o->Get("area", &v));
+      EXPECT_EQ (RT_functionType, v.getType());
+      EXPECT_EQ (RT_OK, o->Get("description", &v));
+      EXPECT_EQ (RT_PROP_NOT_FOUND, o->Get("height", &v));
+      EXPECT_EQ (RT_PROP_NOT_FOUND, o->Set("area", &v));
+
+      rtLookupBase base;
+      EXPECT_EQ (RT_OK, base.Get("kind", &v));
+      EXPECT_TRUE (v.toString() == "base");
+    }
+
+    void atomTest()
+    {
+      std::string name("width");
+      rtAtom width = rtAtomIntern("width");
+      EXPECT_TRUE (width == rtAtomIntern(name.c_str()));
+      EXPECT_TRUE (width != rtAtomIntern("kind"));
+      EXPECT_STREQ ("width", width->name);
+
+      rtRef<rtLookupDerived> o = new rtLookupDerived;
+      rtValue v(12);
+      EXPECT_EQ (RT_OK, o->setByAtom(width, &v));
+      EXPECT_EQ (12, o->mWidth);
+      EXPECT_EQ (RT_OK, o->getByAtom(rtAtomIntern("kind"), &v));
+      EXPECT_TRUE (v.toString() == "derived");
+      EXPECT_EQ (RT_PROP_NOT_FOUND, o->getByAtom(rtAtomIntern("notAProperty"), &v));
+
+      // declared names go through the virtual Get/Set too
+      rtRef<rtLookupOverride> over = new rtLookupOverride;
+      v = 4;
+      EXPECT_EQ (RT_OK, over->setByAtom(width, &v));
+      EXPECT_EQ (1, over->mSets);
+      EXPECT_EQ (4, over->mWidth);
+      EXPECT_EQ (RT_OK, over->getByAtom(rtAtomIntern("kind"), &v));
+      EXPECT_EQ (1, over->mGets);
+      EXPECT_TRUE (v.toString() == "override");
+      EXPECT_EQ (RT_OK, over->getByAtom(width, &v));
+      EXPECT_EQ (4, v.toInt32());
+
+      // undeclared names go through the virtual Get
+      rtRef<rtMapObject> m = new rtMapObject;
+      v = 3;
+      EXPECT_EQ (RT_OK, m->Set("dynamic", &v));
+      EXPECT_EQ (RT_OK, m->getByAtom(rtAtomIntern("dynamic"), &v));
+      EXPECT_EQ (3, v.toInt32());
+    }
+
+    void methodFunctionCacheTest()
+    {
+      rtRef<rtLookupBase> o = new rtLookupBase;
+      o->mWidth = 5;
+
+      rtValue a, b;
+      EXPECT_EQ (RT_OK, o->Get("area", &a));
+      EXPECT_EQ (RT_OK, o->Get("area", &b));
+      EXPECT_TRUE (a.toFunction().getPtr() == b.toFunction().getPtr());
+      EXPECT_EQ (1, (int)o->mFunctions->size());
+
+      rtValue result;
+      EXPECT_EQ (RT_OK, a.toFunction().sendReturns<rtValue>(result));
+      EXPECT_EQ (25, result.toInt32());
+
+      // the bound function keeps the object alive and leaves the cache
+      // once the last reference to it is gone
+      a = rtValue();
+      EXPECT_EQ (1, (int)o->mFunctions->size());
+      b = rtValue();
+      EXPECT_EQ (0, (int)o->mFunctions->size());
+      EXPECT_EQ (1, (int)o->mRefCount);
+    }
+
     void sendReturnsTests()
     {
       rtObject obj;
@@ -256,6 +494,9 @@ TEST_F(rtObjectTest, rtObjectTests)
   setValWithIdFailedTest();
   sendTests();
   sendReturnsTests();
+  lookupTest();
+  atomTest();
+  methodFunctionCacheTest();
 }
 
 class rtMapObjectTest : public testing::Test
@@ -286,6 +527,50 @@ class rtMapObjectTest : public testing::Test
       rtMapObject obj;
       EXPECT_TRUE (RT_FAIL == obj.Set("entry",NULL));
     }
+
+    void indexedLookupTest()
+    {
+      rtRefT<rtMapObject> obj = new rtMapObject;
+      const int count = 100;
+      char name[32];
+      for (int i = 0; i < count; i++)
+      {
+        snprintf(name, sizeof(name), "key%d", i);
+        rtValue v(i);
+        EXPECT_EQ(RT_OK, obj->Set(name, &v));
+        if (i < 8)
+        {
+          EXPECT_TRUE(obj->mIndex.empty());
+        }
+      }
+      EXPECT_FALSE(obj->mIndex.empty());
+
+      // overwrite rather than add
+      rtValue v(-1);
+      EXPECT_EQ(RT_OK, obj->Set("key42", &v));
+      EXPECT_EQ((size_t)count, obj->mProps.size());
+
+      for (int i = 0; i < count; i++)
+      {
+        snprintf(name, sizeof(name), "key%d", i);
+        rtValue r;
+        EXPECT_EQ(RT_OK, obj->Get(name, &r));
+        EXPECT_EQ(i == 42 ? -1 : i, r.toInt32());
+      }
+      rtValue r;
+      EXPECT_EQ(RT_PROP_NOT_FOUND, obj->Get("key100", &r));
+
+      // allKeys stays in insertion order
+      rtObjectRef keys;
+      EXPECT_EQ(RT_OK, obj->Get("allKeys", &r));
+      keys = r.toObject();
+      EXPECT_EQ((uint32_t)count, keys.get<uint32_t>("length"));
+      for (int i = 0; i < count; i++)
+      {
+        snprintf(name, sizeof(name), "key%d", i);
+        EXPECT_TRUE(keys.get<rtString>(i) == name);
+      }
+    }
 };
 
 TEST_F(rtMapObjectTest, rtMapObjectTests)
@@ -293,5 +578,6 @@ TEST_F(rtMapObjectTest, rtMapObjectTests)
   setValByIndexTest();
   getValByIndexTest();
   setValByIndexWithEmptyValTest();
+  indexedLookupTest();
 }
 
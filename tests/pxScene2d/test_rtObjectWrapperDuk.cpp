@@ -0,0 +1,107 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sstream>
+#include <string.h>
+
+#define private public
+#define protected public
+
+#include "pxScene2d.h"
+#include "pxFont.h"
+#include "pxText.h"
+#include "rtScript.h"
+
+#ifdef RTSCRIPT_SUPPORT_DUKTAPE
+#include "rtScriptDuk/rtScriptDuk.h"
+#endif
+
+#include "test_includes.h" // Needs to be included last
+
+#if defined(RTSCRIPT_SUPPORT_DUKTAPE) && defined(PXSCENE_FONT_ATLAS)
+
+class rtObjectWrapperDukTest : public testing::Test
+{
+  public:
+    virtual void SetUp()
+    {
+      mScene = new pxScene2d();
+      pxFontManager::initFT();
+      mFont = new pxFont("FreeSans.ttf", 0, "");
+      mFontOk = mFont->init("../../examples/pxScene2d/src/FreeSans.ttf") == RT_OK;
+      mScriptOk = (createScriptDuk(mScript) == RT_OK) && (mScript->init() == RT_OK) &&
+                  (mScript->createContext("javascript", mContext) == RT_OK);
+    }
+
+    virtual void TearDown()
+    {
+      mContext = NULL;
+      mFont = NULL;
+      delete mScene;
+    }
+
+    static size_t vertexCount(const pxTexturedQuads& quads)
+    {
+      size_t count = 0;
+      for (size_t i = 0; i < quads.mQuads.size(); i++)
+        count += quads.mQuads[i].verts.size();
+      return count;
+    }
+
+    // pxText overrides Set to mark its quads dirty, so a property set from
+    // script has to reach it rather than going straight to the setter
+    void textSetFromScriptTest()
+    {
+      ASSERT_TRUE(mFontOk);
+      ASSERT_TRUE(mScriptOk);
+      rtRef<pxText> t = new pxText(mScene);
+      t->mFont = mFont.getPtr();
+      t->mFontLoaded = true;
+      t->mInitialized = true;
+      t->setText("hi");
+      t->draw();
+      EXPECT_FALSE(t->mDirty);
+      size_t before = vertexCount(t->mQuads);
+      EXPECT_GT(before, 0u);
+
+      mContext->add("label", rtValue(rtObjectRef(t.getPtr())));
+      EXPECT_EQ(RT_OK, mContext->runScript("label.text = 'a much longer label';"));
+      EXPECT_TRUE(t->mDirty);
+      rtString text;
+      t->text(text);
+      EXPECT_TRUE(text == "a much longer label");
+
+      t->draw();
+      EXPECT_GT(vertexCount(t->mQuads), before);
+    }
+
+  private:
+    pxScene2d* mScene;
+    rtRef<pxFont> mFont;
+    bool mFontOk;
+    rtScriptRef mScript;
+    rtScriptContextRef mContext;
+    bool mScriptOk;
+};
+
+TEST_F(rtObjectWrapperDukTest, rtObjectWrapperDukTests)
+{
+  textSetFromScriptTest();
+}
+
+#endif
@@ -26,6 +26,8 @@ limitations under the License.
 #include <string.h>
 #include <unistd.h>
 #include <dlfcn.h>
+#include <vector>
+#include <map>
 
 #include "test_includes.h" // Needs to be included last
 
@@ -157,6 +159,142 @@ class rtStringTest : public testing::Test
        EXPECT_TRUE(mData.find(0, 0x34) == -1 );  // Bad !   0x34 = "4"
     }
 
+    void inlineStorageTest()
+    {
+      const char* longText = "a string that is well past the inline capacity";
+      rtString shortString("width");
+      rtString boundary("12345678901234567890123");
+      rtString longString(longText);
+
+      EXPECT_FALSE(shortString.mHeap);
+      EXPECT_FALSE(boundary.mHeap);
+      EXPECT_TRUE(longString.mHeap);
+      EXPECT_EQ(23, boundary.byteLength());
+      EXPECT_EQ((int32_t)strlen(longText), longString.byteLength());
+      EXPECT_STREQ(longText, longString.cString());
+
+      // appending past the inline capacity moves to the heap
+      boundary.append("4");
+      EXPECT_TRUE(boundary.mHeap);
+      EXPECT_STREQ("123456789012345678901234", boundary.cString());
+
+      // embedded terminators end the string, as strlen did
+      rtString embedded("abc\0def", 7);
+      EXPECT_EQ(3, embedded.byteLength());
+      EXPECT_TRUE(embedded == "abc");
+
+      rtString empty(NULL);
+      EXPECT_TRUE(empty.isEmpty());
+      EXPECT_STREQ("", empty.cString());
+    }
+
+    void sharedBufferTest()
+    {
+      rtString a("a string that is well past the inline capacity");
+      rtString b(a);
+      rtString c;
+      c = b;
+
+      // copies share the buffer
+      EXPECT_EQ(a.mBuffer, b.mBuffer);
+      EXPECT_EQ(a.mBuffer, c.mBuffer);
+      EXPECT_EQ(3, a.mBuffer->mRefCount);
+
+      // and modifying one leaves the others alone
+      b.append("!");
+      EXPECT_NE(a.mBuffer, b.mBuffer);
+      EXPECT_STREQ("a string that is well past the inline capacity", a.cString());
+      EXPECT_STREQ("a string that is well past the inline capacity!", b.cString());
+      c = "short";
+      EXPECT_EQ(1, a.mBuffer->mRefCount);
+      EXPECT_EQ(46, a.length());
+
+      // appending to a string's own contents
+      rtString self("abcdefghijklmnopqrstuvwxyz");
+      self.append(self.cString());
+      EXPECT_STREQ("abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", self.cString());
+      self = self.cString() + 26;
+      EXPECT_STREQ("abcdefghijklmnopqrstuvwxyz", self.cString());
+      self = self.cString() + 20;
+      EXPECT_STREQ("uvwxyz", self.cString());
+
+      // utf8 length is cached with a heap buffer and reset on change
+      rtString utf8("\303\251t\303\251 \303\251t\303\251 \303\251t\303\251 \303\251t\303\251 \303\251t\303\251");
+      EXPECT_TRUE(utf8.mHeap);
+      EXPECT_EQ(19, utf8.length());
+      utf8.append("\303\251");
+      EXPECT_EQ(20, utf8.length());
+    }
+
+    void moveTest()
+    {
+      rtString a("a string that is well past the inline capacity");
+      rtString::rtStringBuffer* buffer = a.mBuffer;
+      uint32_t allocations = rtString::bufferAllocations();
+
+      rtString b(std::move(a));
+      EXPECT_EQ(buffer, b.mBuffer);
+      EXPECT_TRUE(a.isEmpty());
+
+      rtString c;
+      c = std::move(b);
+      EXPECT_EQ(buffer, c.mBuffer);
+      EXPECT_TRUE(b.isEmpty());
+
+      std::vector<rtString> v;
+      for (int i = 0; i < 64; i++)
+        v.push_back(c);
+      EXPECT_EQ(allocations, rtString::bufferAllocations());
+      EXPECT_EQ(65, c.mBuffer->mRefCount);
+    }
+
+    // One frame's worth of the string traffic we see in scene updates:
+    // property names looked up and copied into rtValues, event names
+    // keyed into maps, and urls and text passed around and extended
+    void allocationCountTest()
+    {
+      const char* names[] = {"x", "y", "w", "h", "a", "r", "sx", "sy", "cx", "cy",
+                             "draw", "interactive", "painting", "clip", "mask", "onMouseMove"};
+      const char* urls[] = {"https://px-apps.sys.comcast.net/pxscene-samples/images/tiles/008.jpg",
+                            "http://localhost:8080/examples/pxScene2d/src/browser/images/status_bg.png"};
+      const int frames = 10;
+      uint32_t strdupAllocations = 0;
+
+      uint32_t allocations = rtString::bufferAllocations();
+      for (int frame = 0; frame < frames; frame++)
+      {
+        std::map<rtString, int> events;
+        std::vector<rtString> values;
+        for (int object = 0; object < 100; object++)
+        {
+          for (size_t n = 0; n < sizeof(names)/sizeof(names[0]); n++)
+          {
+            rtString name(names[n]);
+            values.push_back(name);
+            strdupAllocations += 2;
+          }
+          rtString url(urls[object & 1]);
+          rtString copy = url;
+          values.push_back(copy);
+          strdupAllocations += 3;
+
+          rtString text("item ");
+          text.append(names[object % 16]);
+          text.append(" of the list");
+          values.push_back(text);
+          strdupAllocations += 4;
+        }
+        for (size_t n = 0; n < sizeof(names)/sizeof(names[0]); n++)
+        {
+          events[names[n]]++;
+          strdupAllocations += 1;
+        }
+      }
+      uint32_t sso = rtString::bufferAllocations() - allocations;
+
+      EXPECT_LT(sso * 10, strdupAllocations);
+    }
+
     private:
       rtString mData;
 };
@@ -174,5 +312,9 @@ TEST_F(rtStringTest, rtStringTests)
   beginsTest();
   substringTest();
   findTests();
+  inlineStorageTest();
+  sharedBufferTest();
+  moveTest();
+  allocationCountTest();
 }
 
@@ -23,7 +23,10 @@ limitations under the License.
 
 #include "rtThreadPool.h"
 #include "rtString.h"
+#include "rtMutex.h"
+#include "pxTimer.h"
 #include <string.h>
+#include <vector>
 
 #include "test_includes.h" // Needs to be included last
 
@@ -71,7 +74,112 @@ class rtThreadPoolTest : public testing::Test
       rtString s;
       p.raisePriority(s);
       EXPECT_TRUE(p.mRunning == true);
+
+      // with no threads running the queued tasks stay put and can be reordered
+      p.executeTask(new rtThreadTask(NULL, NULL, "a"));
+      p.executeTask(new rtThreadTask(NULL, NULL, "b"));
+      p.executeTask(new rtThreadTask(NULL, NULL, "c"));
+      p.raisePriority("c");
+      p.raisePriority("unknown");
+      EXPECT_EQ(3, (int)p.mPendingTasks);
+      expectNextKeys(p, "c", "a", "b");
+    }
+
+    void priorityLaneTest()
+    {
+      rtThreadPool p(0);
+      p.executeTask(new rtThreadTask(NULL, NULL, "background", RT_THREAD_TASK_PRIORITY_BACKGROUND));
+      p.executeTask(new rtThreadTask(NULL, NULL, "prefetch"));
+      p.executeTask(new rtThreadTask(NULL, NULL, "visible", RT_THREAD_TASK_PRIORITY_VISIBLE));
+      expectNextKeys(p, "visible", "prefetch", "background");
+
+      // promotion moves a background task ahead of queued visible work
+      p.executeTask(new rtThreadTask(NULL, NULL, "visible", RT_THREAD_TASK_PRIORITY_VISIBLE));
+      p.executeTask(new rtThreadTask(NULL, NULL, "background", RT_THREAD_TASK_PRIORITY_BACKGROUND));
+      p.executeTask(new rtThreadTask(NULL, NULL, "prefetch"));
+      p.raisePriority("background");
+      expectNextKeys(p, "background", "visible", "prefetch");
+    }
+
+    void cancelTest()
+    {
+      rtThreadPool p(0);
+      p.executeTask(new rtThreadTask(NULL, NULL, "a"));
+      p.executeTask(new rtThreadTask(NULL, NULL, "b"));
+      p.executeTask(new rtThreadTask(NULL, NULL, "a", RT_THREAD_TASK_PRIORITY_BACKGROUND));
+      p.executeTask(new rtThreadTask(NULL, NULL, "c"));
+      EXPECT_EQ(2, p.cancelTask("a"));
+      EXPECT_EQ(0, p.cancelTask("a"));
+      EXPECT_EQ(0, p.cancelTask(""));
+      EXPECT_EQ(2, (int)p.mPendingTasks);
+      expectNextKeys(p, "b", "c", NULL);
+    }
+
+    static void countTask(void* data)
+    {
+      rtThreadPoolTest* t = (rtThreadPoolTest*)data;
+      t->mMutex.lock();
+      t->mCompleted++;
+      t->mMutex.unlock();
     }
+
+    bool waitForCompleted(int count)
+    {
+      double start = pxMilliseconds();
+      while (pxMilliseconds() - start < 5000)
+      {
+        mMutex.lock();
+        int completed = mCompleted;
+        mMutex.unlock();
+        if (completed >= count)
+          return true;
+        pxSleepMS(1);
+      }
+      return false;
+    }
+
+    void threadCountTest()
+    {
+      mCompleted = 0;
+      rtThreadPool p(0);
+      for (int i = 0; i < 100; i++)
+        p.executeTask(new rtThreadTask(countTask, this, ""));
+      EXPECT_EQ(0, p.threadCount());
+
+      // tasks queued before there were threads still run
+      p.setThreadCount(4);
+      EXPECT_EQ(4, p.threadCount());
+      EXPECT_TRUE(waitForCompleted(100));
+
+      p.setThreadCount(1);
+      EXPECT_EQ(1, p.threadCount());
+      EXPECT_EQ(1u, p.mThreads.size());
+      for (int i = 0; i < 100; i++)
+        p.executeTask(new rtThreadTask(countTask, this, ""));
+      EXPECT_TRUE(waitForCompleted(200));
+    }
+
+  private:
+    void expectNextKeys(rtThreadPool& p, const char* k1, const char* k2, const char* k3)
+    {
+      const char* keys[] = {k1, k2, k3};
+      for (int i = 0; i < 3; i++)
+      {
+        rtThreadTask* t = p.nextTask(0);
+        if (keys[i] == NULL)
+        {
+          EXPECT_TRUE(t == NULL);
+          continue;
+        }
+        ASSERT_TRUE(t != NULL);
+        EXPECT_TRUE(t->getKey() == keys[i]);
+        delete t;
+      }
+      EXPECT_EQ(0, (int)p.mPendingTasks);
+    }
+
+    rtMutex mMutex;
+    int mCompleted;
 };
 
 TEST_F(rtThreadPoolTest, rtThreadPoolTests)
@@ -80,4 +188,7 @@ TEST_F(rtThreadPoolTest, rtThreadPoolTests)
   destructionNonGlobalTest();
   destructionGlobalTest();
   raisePriorityTest();
+  priorityLaneTest();
+  cancelTest();
+  threadCountTest();
 }
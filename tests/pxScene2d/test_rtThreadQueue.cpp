@@ -0,0 +1,176 @@
+/*
+
+pxCore Copyright 2005-2018 John Robinson
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <sstream>
+
+#define private public
+#define protected public
+
+#include "rtThreadQueue.h"
+#include "pxTimer.h"
+#include <pthread.h>
+#include <vector>
+
+#include "test_includes.h" // Needs to be included last
+
+using namespace std;
+
+static vector<intptr_t> gRan;
+
+static void recordTask(void* /*context*/, void* data)
+{
+  gRan.push_back((intptr_t)data);
+}
+
+static void countTask(void* context, void* /*data*/)
+{
+  (*(int*)context)++;
+}
+
+static void slowTask(void* context, void* /*data*/)
+{
+  (*(int*)context)++;
+  double start = pxSeconds();
+  while (pxSeconds()-start < 0.001)
+    ;
+}
+
+struct rtThreadQueueProducer
+{
+  rtThreadQueue* queue;
+  int* counter;
+  int count;
+};
+
+static void* produceTasks(void* arg)
+{
+  rtThreadQueueProducer* p = (rtThreadQueueProducer*)arg;
+  for (int i = 0; i < p->count; i++)
+    p->queue->addTask(countTask, p->counter, NULL);
+  return NULL;
+}
+
+class rtThreadQueueTest : public testing::Test
+{
+  public:
+    virtual void SetUp()
+    {
+      gRan.clear();
+    }
+
+    virtual void TearDown()
+    {
+    }
+
+    void orderTest()
+    {
+      rtThreadQueue q;
+      for (intptr_t i = 0; i < 100; i++)
+        q.addTask(recordTask, NULL, (void*)i);
+      EXPECT_EQ(100u, q.depth());
+      q.process();
+      EXPECT_EQ(0u, q.depth());
+      ASSERT_EQ(100u, gRan.size());
+      for (intptr_t i = 0; i < 100; i++)
+        EXPECT_EQ(i, gRan[i]);
+    }
+
+    void removeAllTasksForObjectTest()
+    {
+      rtThreadQueue q;
+      int a = 0, b = 0;
+      for (int i = 0; i < 10; i++)
+      {
+        q.addTask(countTask, &a, NULL);
+        q.addTask(countTask, &b, NULL);
+      }
+      // every task for the object goes, not just the first
+      q.removeAllTasksForObject(&a);
+      q.process();
+      EXPECT_EQ(0, a);
+      EXPECT_EQ(10, b);
+      EXPECT_EQ(0u, q.depth());
+
+      // tasks added after the removal still run, and the tombstone is
+      // gone once the queue has drained past it
+      q.addTask(countTask, &a, NULL);
+      q.process();
+      EXPECT_EQ(1, a);
+      EXPECT_TRUE(q.mTombstones.empty());
+    }
+
+    void timeBudgetTest()
+    {
+      rtThreadQueue q;
+      int count = 0;
+      for (int i = 0; i < 100; i++)
+        q.addTask(slowTask, &count, NULL);
+      q.process(0.01);
+      EXPECT_GT(count, 0);
+      EXPECT_LT(count, 100);
+      EXPECT_EQ(100u-count, q.depth());
+
+      rtThreadQueueStats s;
+      q.stats(s);
+      EXPECT_EQ((uint32_t)count, s.lastProcessed);
+      EXPECT_EQ(100u, s.maxDepth);
+      EXPECT_GE(s.lastDrainSeconds, 0.01);
+
+      q.process();
+      EXPECT_EQ(100, count);
+      q.stats(s);
+      EXPECT_EQ(100u, s.totalProcessed);
+      q.resetStats();
+      q.stats(s);
+      EXPECT_EQ(0u, s.maxDepth);
+      EXPECT_EQ(0, s.maxDrainSeconds);
+    }
+
+    void multiProducerTest()
+    {
+      const int producers = 4;
+      const int count = 20000;
+      rtThreadQueue q;
+      int counter = 0;
+      pthread_t threads[producers];
+      rtThreadQueueProducer p[producers];
+      for (int i = 0; i < producers; i++)
+      {
+        p[i].queue = &q;
+        p[i].counter = &counter;
+        p[i].count = count;
+        pthread_create(&threads[i], NULL, produceTasks, &p[i]);
+      }
+      // drain while the producers are still adding
+      for (int i = 0; i < 100; i++)
+        q.process(0.001);
+      for (int i = 0; i < producers; i++)
+        pthread_join(threads[i], NULL);
+      q.process();
+      EXPECT_EQ(producers*count, counter);
+      EXPECT_EQ(0u, q.depth());
+    }
+};
+
+TEST_F(rtThreadQueueTest, rtThreadQueueTests)
+{
+  orderTest();
+  removeAllTasksForObjectTest();
+  timeBudgetTest();
+  multiProducerTest();
+}
@@ -22,12 +22,56 @@ limitations under the License.
 #define protected public
 
 #include "rtValue.h"
+#include "rtObject.h"
 #include <string.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
 
 #include "test_includes.h" // Needs to be included last
 
 using namespace std;
 
+// Counts operator new calls made while sCountAllocations is set so the
+// argument tests can check heap allocations per call.  The operators
+// are kept out of line so the compiler does not pair the inlined free()
+// with the new expression at the call site.
+static bool sCountAllocations = false;
+static uint32_t sAllocations = 0;
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+  if (sCountAllocations)
+    sAllocations++;
+  void* p = malloc(size?size:1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+static uint32_t heapAllocations()
+{
+  return sAllocations + rtString::bufferAllocations();
+}
+
+static rtError countArgs(int numArgs, const rtValue* args, rtValue* result, void* context)
+{
+  *(int*)context += numArgs;
+  if (result && numArgs > 0)
+    *result = args[0];
+  return RT_OK;
+}
+
 class rtValueTest : public testing::Test
 {
   public:
@@ -745,6 +789,150 @@ class rtValueTest : public testing::Test
         // rtValue voidPtrVal(voidPtr v);
       }
 
+    void stringStorageTest()
+    {
+      rtValue v("short");
+      EXPECT_EQ(RT_stringType, v.getType());
+      EXPECT_TRUE(v.toString() == "short");
+#if defined(__LP64__)
+      static_assert(sizeof(rtValue) == 40, "strings stored in place must not grow rtValue");
+#endif
+
+      // copies of an rtValue holding a string share the payload
+      rtString longString("a string long enough to need a heap buffer");
+      rtValue l(longString);
+      uint32_t before = heapAllocations();
+      sCountAllocations = true;
+      rtValue copy(l);
+      rtValue assigned;
+      assigned = l;
+      rtString s = l.toString();
+      sCountAllocations = false;
+      EXPECT_EQ(before, heapAllocations());
+      EXPECT_TRUE(copy == l);
+      EXPECT_TRUE(assigned.toString() == longString);
+      EXPECT_TRUE(s == longString);
+
+      // string to string assignment, including from our own payload
+      assigned = rtString("other");
+      EXPECT_TRUE(assigned.toString() == "other");
+      assigned.setString(assigned.mValue.stringValue);
+      EXPECT_TRUE(assigned.toString() == "other");
+      assigned.setInt32(5);
+      EXPECT_EQ(5, assigned.toInt32());
+      assigned.setString(longString);
+      EXPECT_TRUE(assigned.toString() == longString);
+    }
+
+    void moveTest()
+    {
+      rtValue s(rtString("a string long enough to need a heap buffer"));
+      const char* p = s.mValue.stringValue.cString();
+      rtValue m(std::move(s));
+      EXPECT_TRUE(s.isEmpty());
+      EXPECT_EQ(RT_voidType, s.getType());
+      EXPECT_EQ(RT_stringType, m.getType());
+      EXPECT_EQ(p, m.mValue.stringValue.cString());
+
+      int calls = 0;
+      rtFunctionCallback* fp = new rtFunctionCallback(countArgs, &calls);
+      rtFunctionRef f(fp);
+      unsigned long refs = fp->getRefCount();
+      rtValue fv(f);
+      EXPECT_EQ(refs+1, fp->getRefCount());
+      rtValue moved;
+      moved = std::move(fv);
+      EXPECT_EQ(refs+1, fp->getRefCount());
+      EXPECT_TRUE(fv.isEmpty());
+      EXPECT_EQ((rtIFunction*)fp, moved.toFunction().getPtr());
+      moved.setEmpty();
+      EXPECT_EQ(refs, fp->getRefCount());
+
+      m = std::move(m);
+      EXPECT_EQ(p, m.mValue.stringValue.cString());
+    }
+
+    void valueListTest()
+    {
+      rtString longString("a string long enough to need a heap buffer");
+      rtValueList<4> args;
+      for (int i = 0; i < 4; i++)
+        args.push_back(rtValue(i));
+      EXPECT_FALSE(args.isHeap());
+      EXPECT_EQ(4, args.size());
+
+      // the fifth value spills the list to the heap
+      args.push_back(longString);
+      args.push_back(rtValue("short"));
+      EXPECT_TRUE(args.isHeap());
+      EXPECT_EQ(6, args.size());
+      for (int i = 0; i < 4; i++)
+        EXPECT_EQ(i, args[i].toInt32());
+      EXPECT_TRUE(args[4].toString() == longString);
+      EXPECT_TRUE(args.data()[5].toString() == "short");
+
+      int calls = 0;
+      rtFunctionRef f(new rtFunctionCallback(countArgs, &calls));
+      rtValue result;
+      EXPECT_EQ(RT_OK, f->Send(args.size(), args.data(), &result));
+      EXPECT_EQ(6, calls);
+      EXPECT_EQ(0, result.toInt32());
+
+      args.clear();
+      EXPECT_EQ(0, args.size());
+    }
+
+    void sendAllocationTest()
+    {
+      int calls = 0;
+      rtFunctionRef f(new rtFunctionCallback(countArgs, &calls));
+      rtString title("Channel 4 News");
+      rtString description("After a mysterious signal is picked up by an isolated research station");
+      rtObjectRef obj(new rtMapObject);
+
+      const int iterations = 100;
+      uint32_t before = heapAllocations();
+      sCountAllocations = true;
+      for (int i = 0; i < iterations; i++)
+        f.send(title, description, i, obj);
+      sCountAllocations = false;
+      uint32_t sendAllocs = heapAllocations()-before;
+
+      // argument lists built at runtime, the way the script bindings do it
+      before = heapAllocations();
+      sCountAllocations = true;
+      for (int i = 0; i < iterations; i++)
+      {
+        std::vector<rtValue> argv;
+        argv.push_back(title);
+        argv.push_back(description);
+        argv.push_back(i);
+        argv.push_back(obj);
+        f->Send((int)argv.size(), &argv[0], NULL);
+      }
+      sCountAllocations = false;
+      uint32_t vectorAllocs = heapAllocations()-before;
+
+      before = heapAllocations();
+      sCountAllocations = true;
+      for (int i = 0; i < iterations; i++)
+      {
+        rtValueList<8> argv;
+        argv.push_back(title);
+        argv.push_back(description);
+        argv.push_back(i);
+        argv.push_back(obj);
+        f->Send(argv.size(), argv.data(), NULL);
+      }
+      sCountAllocations = false;
+      uint32_t listAllocs = heapAllocations()-before;
+
+      EXPECT_EQ(0u, sendAllocs);
+      EXPECT_EQ(0u, listAllocs);
+      EXPECT_GT(vectorAllocs, listAllocs);
+      EXPECT_EQ(3*iterations*4, calls);
+    }
+
     private:
       rtValue    boolVal;
       rtValue    int8Val;
@@ -796,5 +984,10 @@ TEST_F(rtValueTest, rtValueTests)
   testStringType();
   
   compareTest();
+
+  stringStorageTest();
+  moveTest();
+  valueListTest();
+  sendAllocationTest();
 }
 